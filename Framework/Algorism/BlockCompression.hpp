@@ -0,0 +1,1026 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include "geommath_simd.hpp"
+
+namespace My {
+    // CPU decoders (and encoders, further down) for the BCn block
+    // compressed formats (BC1-BC7, BC6H).
+    // every block covers 4x4 pixels. the decoders write the 16 pixels of one
+    // block row by row to dest, with dest_pitch bytes between rows.
+    //  BC1, BC2, BC3, BC7 -> R8G8B8A8
+    //  BC4                -> R8G8B8A8 as (R, 0, 0, 255)
+    //  BC5                -> R8G8B8A8 as (R, G, 0, 255)
+    //  BC6H               -> R16G16B16A16 half float, alpha 1.0
+    // signed BC4/BC5 are biased to unsigned, -1.0 maps to 1 and 1.0 to 255
+    // with SSE2 the BC1-BC5 colour and channel writes and the BC7
+    // interpolation work on a row of 4 pixels at a time. the bit fields of
+    // a block are still read one by one
+
+    // bits of a 128 bit block, read from the least significant bit up
+    class BlockBitReader {
+        protected:
+            uint64_t m_nLow;
+            uint64_t m_nHigh;
+
+        public:
+            explicit BlockBitReader(const uint8_t* block)
+            {
+                std::memcpy(&m_nLow, block, sizeof(m_nLow));
+                std::memcpy(&m_nHigh, block + 8, sizeof(m_nHigh));
+            }
+
+            // n must be in [1, 32]
+            inline uint32_t GetBits(const int32_t n)
+            {
+                const uint32_t result = static_cast<uint32_t>(m_nLow & ((1ull << n) - 1));
+                m_nLow = (m_nLow >> n) | (m_nHigh << (64 - n));
+                m_nHigh >>= n;
+                return result;
+            }
+    };
+
+    // bits of a 128 bit block, written from the least significant bit up
+    class BlockBitWriter {
+        protected:
+            uint64_t m_nLow = 0;
+            uint64_t m_nHigh = 0;
+            int32_t m_nBits = 0;
+
+        public:
+            // n must be in [1, 32]
+            inline void PutBits(const uint32_t value, const int32_t n)
+            {
+                const uint64_t bits = value & ((1ull << n) - 1);
+                if (m_nBits < 64)
+                {
+                    m_nLow |= bits << m_nBits;
+                    if (m_nBits + n > 64) m_nHigh |= bits >> (64 - m_nBits);
+                }
+                else
+                {
+                    m_nHigh |= bits << (m_nBits - 64);
+                }
+                m_nBits += n;
+            }
+
+            void Store(uint8_t* block) const
+            {
+                std::memcpy(block, &m_nLow, sizeof(m_nLow));
+                std::memcpy(block + 8, &m_nHigh, sizeof(m_nHigh));
+            }
+    };
+
+    // 2 and 3 subset partitions of BC6H and BC7, one bit (2 bits for 3
+    // subsets) per pixel giving its subset
+    static const uint16_t kBCPartitions2[64] = {
+        0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80,
+        0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+        0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE,
+        0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+        0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A,
+        0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+        0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C,
+        0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22
+    };
+
+    static const uint32_t kBCPartitions3[64] = {
+        0xAA685050, 0x6A5A5040, 0x5A5A4200, 0x5450A0A8, 0xA5A50000, 0xA0A05050, 0x5555A0A0, 0x5A5A5050,
+        0xAA550000, 0xAA555500, 0xAAAA5500, 0x90909090, 0x94949494, 0xA4A4A4A4, 0xA9A59450, 0x2A0A4250,
+        0xA5945040, 0x0A425054, 0xA5A5A500, 0x55A0A0A0, 0xA8A85454, 0x6A6A4040, 0xA4A45000, 0x1A1A0500,
+        0x0050A4A4, 0xAAA59090, 0x14696914, 0x69691400, 0xA08585A0, 0xAA821414, 0x50A4A450, 0x6A5A0200,
+        0xA9A58000, 0x5090A0A8, 0xA8A09050, 0x24242424, 0x00AA5500, 0x24924924, 0x24499224, 0x50A50A50,
+        0x500AA550, 0xAAAA4444, 0x66660000, 0xA5A0A5A0, 0x50A050A0, 0x69286928, 0x44AAAA44, 0x66666600,
+        0xAA444444, 0x54A854A8, 0x95809580, 0x96969600, 0xA85454A8, 0x80959580, 0xAA141414, 0x96960000,
+        0xAAAA1414, 0xA05050A0, 0xA0A5A5A0, 0x96000000, 0x40804080, 0xA9A8A9A8, 0xAAAAAA44, 0x2A4A5254
+    };
+
+    // the index of the anchor pixel of subset 1 (and 2), which is stored with
+    // one bit less. pixel 0 is always the anchor of subset 0
+    static const uint8_t kBCAnchors2[64] = {
+        15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+        15,  2,  8,  2,  2,  8,  8, 15,  2,  8,  2,  2,  8,  8,  2,  2,
+        15, 15,  6,  8,  2,  8, 15, 15,  2,  8,  2,  2,  2, 15, 15,  6,
+         6,  2,  6,  8, 15, 15,  2,  2, 15, 15, 15, 15, 15,  2,  2, 15
+    };
+
+    static const uint8_t kBCAnchors3a[64] = {
+         3,  3, 15, 15,  8,  3, 15, 15,  8,  8,  6,  6,  6,  5,  3,  3,
+         3,  3,  8, 15,  3,  3,  6, 10,  5,  8,  8,  6,  8,  5, 15, 15,
+         8, 15,  3,  5,  6, 10,  8, 15, 15,  3, 15,  5, 15, 15, 15, 15,
+         3, 15,  5,  5,  5,  8,  5, 10,  5, 10,  8, 13, 15, 12,  3,  3
+    };
+
+    static const uint8_t kBCAnchors3b[64] = {
+        15,  8,  8,  3, 15, 15,  3,  8, 15, 15, 15, 15, 15, 15, 15,  8,
+        15,  8, 15,  3, 15,  8, 15,  8,  3, 15,  6, 10, 15, 15, 10,  8,
+        15,  3, 15, 10, 10,  8,  9, 10,  6, 15,  8, 15,  3,  6,  6,  8,
+        15,  3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,  3, 15, 15,  8
+    };
+
+    // interpolation weights of 2, 3 and 4 bit indices, in 1/64
+    static const uint8_t kBCWeights2[4] = { 0, 21, 43, 64 };
+    static const uint8_t kBCWeights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+    static const uint8_t kBCWeights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    inline const uint8_t* BCWeights(const int32_t index_bits)
+    {
+        return (index_bits == 2) ? kBCWeights2 : ((index_bits == 3) ? kBCWeights3 : kBCWeights4);
+    }
+
+    // RGB565 to 8 bit R, G and B by replicating the top bits
+    inline void DecodeRGB565(const uint16_t color, uint32_t rgb[3])
+    {
+        const uint32_t r = (color >> 11) & 0x1F;
+        const uint32_t g = (color >> 5) & 0x3F;
+        const uint32_t b = color & 0x1F;
+        rgb[0] = (r << 3) | (r >> 2);
+        rgb[1] = (g << 2) | (g >> 4);
+        rgb[2] = (b << 3) | (b >> 2);
+    }
+
+    // R in the lowest byte, so the uint32_t is stored as R8G8B8A8
+    inline uint32_t PackRGBA8(const uint32_t r, const uint32_t g, const uint32_t b, const uint32_t a)
+    {
+        return r | (g << 8) | (b << 16) | (a << 24);
+    }
+
+    // the colour part of BC1, BC2 and BC3. BC2 and BC3 always use 4 colours,
+    // BC1 switches to 3 colours and transparent black when color0 <= color1
+    inline void DecodeBCColorBlock(const uint8_t* block, uint8_t* dest, const size_t dest_pitch, const bool allow_transparent)
+    {
+        const uint16_t color0 = static_cast<uint16_t>(block[0] | (block[1] << 8));
+        const uint16_t color1 = static_cast<uint16_t>(block[2] | (block[3] << 8));
+        uint32_t c0[3], c1[3];
+        DecodeRGB565(color0, c0);
+        DecodeRGB565(color1, c1);
+
+        uint32_t palette[4];
+        palette[0] = PackRGBA8(c0[0], c0[1], c0[2], 255);
+        palette[1] = PackRGBA8(c1[0], c1[1], c1[2], 255);
+        if (color0 > color1 || !allow_transparent)
+        {
+            palette[2] = PackRGBA8((2 * c0[0] + c1[0]) / 3, (2 * c0[1] + c1[1]) / 3, (2 * c0[2] + c1[2]) / 3, 255);
+            palette[3] = PackRGBA8((c0[0] + 2 * c1[0]) / 3, (c0[1] + 2 * c1[1]) / 3, (c0[2] + 2 * c1[2]) / 3, 255);
+        }
+        else
+        {
+            palette[2] = PackRGBA8((c0[0] + c1[0]) / 2, (c0[1] + c1[1]) / 2, (c0[2] + c1[2]) / 2, 255);
+            palette[3] = 0;
+        }
+
+        uint32_t indices = static_cast<uint32_t>(block[4]) | (block[5] << 8) | (block[6] << 16) | (static_cast<uint32_t>(block[7]) << 24);
+#if MYGE_SIMD_SSE
+        // the low and high bit of every index are turned into masks which
+        // pick between the colours
+        const __m128i colors = _mm_loadu_si128(reinterpret_cast<const __m128i*>(palette));
+        const __m128i pick0 = _mm_shuffle_epi32(colors, 0x00);
+        const __m128i pick1 = _mm_shuffle_epi32(colors, 0x55);
+        const __m128i pick2 = _mm_shuffle_epi32(colors, 0xAA);
+        const __m128i pick3 = _mm_shuffle_epi32(colors, 0xFF);
+        const __m128i all_indices = _mm_set1_epi32(static_cast<int32_t>(indices));
+        __m128i low_bits = _mm_setr_epi32(1 << 0, 1 << 2, 1 << 4, 1 << 6);
+        __m128i high_bits = _mm_setr_epi32(1 << 1, 1 << 3, 1 << 5, 1 << 7);
+        for (int32_t y = 0; y < 4; y++)
+        {
+            const __m128i low = _mm_cmpeq_epi32(_mm_and_si128(all_indices, low_bits), low_bits);
+            const __m128i high = _mm_cmpeq_epi32(_mm_and_si128(all_indices, high_bits), high_bits);
+            const __m128i pick01 = _mm_or_si128(_mm_andnot_si128(low, pick0), _mm_and_si128(low, pick1));
+            const __m128i pick23 = _mm_or_si128(_mm_andnot_si128(low, pick2), _mm_and_si128(low, pick3));
+            const __m128i row = _mm_or_si128(_mm_andnot_si128(high, pick01), _mm_and_si128(high, pick23));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + y * dest_pitch), row);
+            low_bits = _mm_slli_epi32(low_bits, 8);
+            high_bits = _mm_slli_epi32(high_bits, 8);
+        }
+#else
+        for (int32_t y = 0; y < 4; y++)
+        {
+            uint32_t row[4];
+            for (int32_t x = 0; x < 4; x++)
+            {
+                row[x] = palette[indices & 0x3];
+                indices >>= 2;
+            }
+            std::memcpy(dest + y * dest_pitch, row, sizeof(row));
+        }
+#endif
+    }
+
+    // the 8 values of a BC3 alpha / BC4 channel block. the endpoints are
+    // compared as stored, signed -128 then decodes the same as -127
+    inline void DecodeBCChannelPalette(const int32_t endpoint0, const int32_t endpoint1, const int32_t min_value, const int32_t max_value, int32_t palette[8])
+    {
+        const int32_t value0 = std::max(endpoint0, min_value);
+        const int32_t value1 = std::max(endpoint1, min_value);
+        palette[0] = value0;
+        palette[1] = value1;
+        if (endpoint0 > endpoint1)
+        {
+            for (int32_t i = 1; i < 7; i++) palette[i + 1] = ((7 - i) * value0 + i * value1) / 7;
+        }
+        else
+        {
+            for (int32_t i = 1; i < 5; i++) palette[i + 1] = ((5 - i) * value0 + i * value1) / 5;
+            palette[6] = min_value;
+            palette[7] = max_value;
+        }
+    }
+
+    // one channel of 8 bytes to byte channel of every R8G8B8A8 pixel of dest,
+    // the other channels are left as they are
+    inline void DecodeBCChannelBlock(const uint8_t* block, uint8_t* dest, const size_t dest_pitch, const int32_t channel, const bool is_signed)
+    {
+        int32_t palette[8];
+        if (is_signed)
+        {
+            DecodeBCChannelPalette(static_cast<int8_t>(block[0]), static_cast<int8_t>(block[1]), -127, 127, palette);
+            for (int32_t i = 0; i < 8; i++) palette[i] += 128;
+        }
+        else
+        {
+            DecodeBCChannelPalette(block[0], block[1], 0, 255, palette);
+        }
+
+        uint64_t indices = 0;
+        for (int32_t i = 0; i < 6; i++) indices |= static_cast<uint64_t>(block[2 + i]) << (8 * i);
+        uint8_t values[16];
+        for (int32_t i = 0; i < 16; i++)
+        {
+            values[i] = static_cast<uint8_t>(palette[indices & 0x7]);
+            indices >>= 3;
+        }
+
+#if MYGE_SIMD_SSE
+        // the values of a row are widened to one per pixel and merged in
+        const __m128i keep = _mm_set1_epi32(static_cast<int32_t>(~(0xFFu << (channel * 8))));
+        const __m128i shift = _mm_cvtsi32_si128(channel * 8);
+        const __m128i zero = _mm_setzero_si128();
+        for (int32_t y = 0; y < 4; y++)
+        {
+            int32_t row_values;
+            std::memcpy(&row_values, values + y * 4, sizeof(row_values));
+            __m128i widened = _mm_unpacklo_epi8(_mm_cvtsi32_si128(row_values), zero);
+            widened = _mm_sll_epi32(_mm_unpacklo_epi16(widened, zero), shift);
+            __m128i* row = reinterpret_cast<__m128i*>(dest + y * dest_pitch);
+            _mm_storeu_si128(row, _mm_or_si128(_mm_and_si128(_mm_loadu_si128(row), keep), widened));
+        }
+#else
+        for (int32_t y = 0; y < 4; y++)
+        {
+            for (int32_t x = 0; x < 4; x++)
+            {
+                dest[y * dest_pitch + x * 4 + channel] = values[y * 4 + x];
+            }
+        }
+#endif
+    }
+
+    inline void DecodeBC1Block(const uint8_t* block, uint8_t* dest, const size_t dest_pitch)
+    {
+        DecodeBCColorBlock(block, dest, dest_pitch, true);
+    }
+
+    inline void DecodeBC2Block(const uint8_t* block, uint8_t* dest, const size_t dest_pitch)
+    {
+        DecodeBCColorBlock(block + 8, dest, dest_pitch, false);
+
+        // 4 bit explicit alpha
+        for (int32_t y = 0; y < 4; y++)
+        {
+            for (int32_t x = 0; x < 4; x++)
+            {
+                const uint8_t alpha = (block[y * 2 + (x >> 1)] >> ((x & 1) * 4)) & 0xF;
+                dest[y * dest_pitch + x * 4 + 3] = static_cast<uint8_t>(alpha | (alpha << 4));
+            }
+        }
+    }
+
+    inline void DecodeBC3Block(const uint8_t* block, uint8_t* dest, const size_t dest_pitch)
+    {
+        DecodeBCColorBlock(block + 8, dest, dest_pitch, false);
+        DecodeBCChannelBlock(block, dest, dest_pitch, 3, false);
+    }
+
+    inline void DecodeBC4Block(const uint8_t* block, uint8_t* dest, const size_t dest_pitch, const bool is_signed)
+    {
+        for (int32_t y = 0; y < 4; y++)
+        {
+            const uint32_t row[4] = { 0xFF000000, 0xFF000000, 0xFF000000, 0xFF000000 };
+            std::memcpy(dest + y * dest_pitch, row, sizeof(row));
+        }
+        DecodeBCChannelBlock(block, dest, dest_pitch, 0, is_signed);
+    }
+
+    inline void DecodeBC5Block(const uint8_t* block, uint8_t* dest, const size_t dest_pitch, const bool is_signed)
+    {
+        DecodeBC4Block(block, dest, dest_pitch, is_signed);
+        DecodeBCChannelBlock(block + 8, dest, dest_pitch, 1, is_signed);
+    }
+
+    inline void DecodeBC7Block(const uint8_t* block, uint8_t* dest, const size_t dest_pitch)
+    {
+        struct BC7ModeInfo {
+            uint8_t subsets;
+            uint8_t partition_bits;
+            uint8_t rotation_bits;
+            uint8_t index_selection_bits;
+            uint8_t color_bits;
+            uint8_t alpha_bits;
+            uint8_t endpoint_pbits;
+            uint8_t shared_pbits;
+            uint8_t index_bits;
+            uint8_t index_bits2;
+        };
+        static const BC7ModeInfo kModes[8] = {
+            { 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+            { 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+            { 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+            { 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+            { 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+            { 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+            { 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+            { 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 }
+        };
+
+        int32_t mode = 0;
+        while (mode < 8 && !(block[0] & (1 << mode))) mode++;
+        if (mode == 8)
+        {
+            // reserved, decodes to transparent black
+            for (int32_t y = 0; y < 4; y++) std::memset(dest + y * dest_pitch, 0x00, 16);
+            return;
+        }
+
+        const BC7ModeInfo& info = kModes[mode];
+        BlockBitReader reader(block);
+        reader.GetBits(mode + 1);
+        const uint32_t partition = info.partition_bits ? reader.GetBits(info.partition_bits) : 0;
+        const uint32_t rotation = info.rotation_bits ? reader.GetBits(info.rotation_bits) : 0;
+        const uint32_t index_selection = info.index_selection_bits ? reader.GetBits(info.index_selection_bits) : 0;
+
+        const int32_t num_endpoints = info.subsets * 2;
+        uint32_t endpoints[6][4];
+        for (int32_t c = 0; c < 3; c++)
+        {
+            for (int32_t e = 0; e < num_endpoints; e++) endpoints[e][c] = reader.GetBits(info.color_bits);
+        }
+        for (int32_t e = 0; e < num_endpoints; e++) endpoints[e][3] = info.alpha_bits ? reader.GetBits(info.alpha_bits) : 255;
+
+        // p-bits add a shared lowest bit to all channels of an endpoint
+        int32_t color_bits = info.color_bits;
+        int32_t alpha_bits = info.alpha_bits;
+        if (info.endpoint_pbits || info.shared_pbits)
+        {
+            uint32_t pbits[6];
+            if (info.endpoint_pbits)
+            {
+                for (int32_t e = 0; e < num_endpoints; e++) pbits[e] = reader.GetBits(1);
+            }
+            else
+            {
+                for (int32_t s = 0; s < info.subsets; s++) pbits[s * 2] = pbits[s * 2 + 1] = reader.GetBits(1);
+            }
+
+            for (int32_t e = 0; e < num_endpoints; e++)
+            {
+                for (int32_t c = 0; c < (alpha_bits ? 4 : 3); c++) endpoints[e][c] = (endpoints[e][c] << 1) | pbits[e];
+            }
+            color_bits++;
+            if (alpha_bits) alpha_bits++;
+        }
+
+        // expand to 8 bits by replicating the top bits
+        for (int32_t e = 0; e < num_endpoints; e++)
+        {
+            for (int32_t c = 0; c < 3; c++)
+            {
+                endpoints[e][c] = (endpoints[e][c] << (8 - color_bits)) | (endpoints[e][c] >> (2 * color_bits - 8));
+            }
+            if (alpha_bits)
+            {
+                endpoints[e][3] = (endpoints[e][3] << (8 - alpha_bits)) | (endpoints[e][3] >> (2 * alpha_bits - 8));
+            }
+        }
+
+        // subset of every pixel and the anchors, which are stored with one bit less
+        uint8_t subset_of[16];
+        uint32_t anchor_mask = 1;
+        for (int32_t i = 0; i < 16; i++)
+        {
+            if (info.subsets == 2) subset_of[i] = (kBCPartitions2[partition] >> i) & 0x1;
+            else if (info.subsets == 3) subset_of[i] = (kBCPartitions3[partition] >> (i * 2)) & 0x3;
+            else subset_of[i] = 0;
+        }
+        if (info.subsets == 2) anchor_mask |= 1u << kBCAnchors2[partition];
+        if (info.subsets == 3) anchor_mask |= (1u << kBCAnchors3a[partition]) | (1u << kBCAnchors3b[partition]);
+
+        uint8_t indices[16];
+        uint8_t indices2[16];
+        for (int32_t i = 0; i < 16; i++)
+        {
+            indices[i] = static_cast<uint8_t>(reader.GetBits(info.index_bits - ((anchor_mask >> i) & 1)));
+        }
+        if (info.index_bits2)
+        {
+            for (int32_t i = 0; i < 16; i++) indices2[i] = static_cast<uint8_t>(reader.GetBits(info.index_bits2 - (i == 0)));
+        }
+
+        // with a second index set, the index selection bit swaps which one
+        // the colour and the alpha use
+        const uint8_t* color_indices = indices;
+        const uint8_t* alpha_indices = info.index_bits2 ? indices2 : indices;
+        int32_t color_index_bits = info.index_bits;
+        int32_t alpha_index_bits = info.index_bits2 ? info.index_bits2 : info.index_bits;
+        if (index_selection)
+        {
+            std::swap(color_indices, alpha_indices);
+            std::swap(color_index_bits, alpha_index_bits);
+        }
+        const uint8_t* color_weights = BCWeights(color_index_bits);
+        const uint8_t* alpha_weights = BCWeights(alpha_index_bits);
+
+        // rotation swaps alpha with a colour channel after interpolation,
+        // the same as swapping the endpoint channels and which channel takes
+        // the alpha weight
+        const int32_t alpha_channel = rotation ? static_cast<int32_t>(rotation) - 1 : 3;
+        uint32_t packed_endpoints[6];
+        for (int32_t e = 0; e < num_endpoints; e++)
+        {
+            if (rotation) std::swap(endpoints[e][3], endpoints[e][alpha_channel]);
+            packed_endpoints[e] = PackRGBA8(endpoints[e][0], endpoints[e][1], endpoints[e][2], endpoints[e][3]);
+        }
+
+        // the endpoints and the 4 channel weights of every pixel
+        uint32_t pixel_e0[16], pixel_e1[16], pixel_weights[16];
+        for (int32_t i = 0; i < 16; i++)
+        {
+            pixel_e0[i] = packed_endpoints[subset_of[i] * 2];
+            pixel_e1[i] = packed_endpoints[subset_of[i] * 2 + 1];
+            const uint32_t cw = color_weights[color_indices[i]];
+            const uint32_t aw = alpha_weights[alpha_indices[i]];
+            pixel_weights[i] = (cw * 0x01010101u & ~(0xFFu << (alpha_channel * 8))) | (aw << (alpha_channel * 8));
+        }
+
+#if MYGE_SIMD_SSE
+        // ((64 - w) * e0 + w * e1 + 32) >> 6 in 16 bit lanes, 2 pixels per register
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i sixty_four = _mm_set1_epi16(64);
+        const __m128i round = _mm_set1_epi16(32);
+        for (int32_t y = 0; y < 4; y++)
+        {
+            const __m128i e0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixel_e0 + y * 4));
+            const __m128i e1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixel_e1 + y * 4));
+            const __m128i w = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixel_weights + y * 4));
+            __m128i halves[2];
+            for (int32_t h = 0; h < 2; h++)
+            {
+                const __m128i e0_16 = h ? _mm_unpackhi_epi8(e0, zero) : _mm_unpacklo_epi8(e0, zero);
+                const __m128i e1_16 = h ? _mm_unpackhi_epi8(e1, zero) : _mm_unpacklo_epi8(e1, zero);
+                const __m128i w_16 = h ? _mm_unpackhi_epi8(w, zero) : _mm_unpacklo_epi8(w, zero);
+                const __m128i sum = _mm_add_epi16(_mm_mullo_epi16(_mm_sub_epi16(sixty_four, w_16), e0_16), _mm_mullo_epi16(w_16, e1_16));
+                halves[h] = _mm_srli_epi16(_mm_add_epi16(sum, round), 6);
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + y * dest_pitch), _mm_packus_epi16(halves[0], halves[1]));
+        }
+#else
+        for (int32_t i = 0; i < 16; i++)
+        {
+            uint8_t pixel[4];
+            for (int32_t c = 0; c < 4; c++)
+            {
+                const uint32_t w = (pixel_weights[i] >> (c * 8)) & 0xFF;
+                const uint32_t e0 = (pixel_e0[i] >> (c * 8)) & 0xFF;
+                const uint32_t e1 = (pixel_e1[i] >> (c * 8)) & 0xFF;
+                pixel[c] = static_cast<uint8_t>(((64 - w) * e0 + w * e1 + 32) >> 6);
+            }
+            std::memcpy(dest + (i >> 2) * dest_pitch + (i & 3) * 4, pixel, 4);
+        }
+#endif
+    }
+
+    // BC6H endpoint layouts. every mode stores its endpoints as a list of bit
+    // ranges of the fields rw, rx, ry, rz, gw, ... bz (channel * 4 + endpoint)
+    // and the partition (12). a range is stored from bit first to bit last
+    struct BC6HBitRange {
+        uint8_t field;
+        uint8_t first;
+        uint8_t last;
+    };
+
+    struct BC6HModeInfo {
+        uint8_t transformed;
+        uint8_t subsets;
+        uint8_t endpoint_bits;
+        uint8_t delta_bits[3];
+        uint8_t range_count;
+        BC6HBitRange ranges[24];
+    };
+
+    inline const BC6HModeInfo& BC6HMode(const int32_t index)
+    {
+        static const BC6HModeInfo kModes[14] = {
+            { 1, 2, 10, { 5, 5, 5 }, 20,
+              { {6, 4, 4}, {10, 4, 4}, {11, 4, 4}, {0, 0, 9}, {4, 0, 9}, {8, 0, 9}, {1, 0, 4}, {7, 4, 4}, {6, 0, 3}, {5, 0, 4}, {11, 0, 0}, {7, 0, 3}, {9, 0, 4}, {11, 1, 1}, {10, 0, 3}, {2, 0, 4}, {11, 2, 2}, {3, 0, 4}, {11, 3, 3}, {12, 0, 4} } },
+            { 1, 2, 7, { 6, 6, 6 }, 24,
+              { {6, 5, 5}, {7, 4, 4}, {7, 5, 5}, {0, 0, 6}, {11, 0, 0}, {11, 1, 1}, {10, 4, 4}, {4, 0, 6}, {10, 5, 5}, {11, 2, 2}, {6, 4, 4}, {8, 0, 6}, {11, 3, 3}, {11, 5, 5}, {11, 4, 4}, {1, 0, 5}, {6, 0, 3}, {5, 0, 5}, {7, 0, 3}, {9, 0, 5}, {10, 0, 3}, {2, 0, 5}, {3, 0, 5}, {12, 0, 4} } },
+            { 1, 2, 11, { 5, 4, 4 }, 19,
+              { {0, 0, 9}, {4, 0, 9}, {8, 0, 9}, {1, 0, 4}, {0, 10, 10}, {6, 0, 3}, {5, 0, 3}, {4, 10, 10}, {11, 0, 0}, {7, 0, 3}, {9, 0, 3}, {8, 10, 10}, {11, 1, 1}, {10, 0, 3}, {2, 0, 4}, {11, 2, 2}, {3, 0, 4}, {11, 3, 3}, {12, 0, 4} } },
+            { 1, 2, 11, { 4, 5, 4 }, 21,
+              { {0, 0, 9}, {4, 0, 9}, {8, 0, 9}, {1, 0, 3}, {0, 10, 10}, {7, 4, 4}, {6, 0, 3}, {5, 0, 4}, {4, 10, 10}, {7, 0, 3}, {9, 0, 3}, {8, 10, 10}, {11, 1, 1}, {10, 0, 3}, {2, 0, 3}, {11, 0, 0}, {11, 2, 2}, {3, 0, 3}, {6, 4, 4}, {11, 3, 3}, {12, 0, 4} } },
+            { 1, 2, 11, { 4, 4, 5 }, 21,
+              { {0, 0, 9}, {4, 0, 9}, {8, 0, 9}, {1, 0, 3}, {0, 10, 10}, {10, 4, 4}, {6, 0, 3}, {5, 0, 3}, {4, 10, 10}, {11, 0, 0}, {7, 0, 3}, {9, 0, 4}, {8, 10, 10}, {10, 0, 3}, {2, 0, 3}, {11, 1, 1}, {11, 2, 2}, {3, 0, 3}, {11, 4, 4}, {11, 3, 3}, {12, 0, 4} } },
+            { 1, 2, 9, { 5, 5, 5 }, 20,
+              { {0, 0, 8}, {10, 4, 4}, {4, 0, 8}, {6, 4, 4}, {8, 0, 8}, {11, 4, 4}, {1, 0, 4}, {7, 4, 4}, {6, 0, 3}, {5, 0, 4}, {11, 0, 0}, {7, 0, 3}, {9, 0, 4}, {11, 1, 1}, {10, 0, 3}, {2, 0, 4}, {11, 2, 2}, {3, 0, 4}, {11, 3, 3}, {12, 0, 4} } },
+            { 1, 2, 8, { 6, 5, 5 }, 20,
+              { {0, 0, 7}, {7, 4, 4}, {10, 4, 4}, {4, 0, 7}, {11, 2, 2}, {6, 4, 4}, {8, 0, 7}, {11, 3, 3}, {11, 4, 4}, {1, 0, 5}, {6, 0, 3}, {5, 0, 4}, {11, 0, 0}, {7, 0, 3}, {9, 0, 4}, {11, 1, 1}, {10, 0, 3}, {2, 0, 5}, {3, 0, 5}, {12, 0, 4} } },
+            { 1, 2, 8, { 5, 6, 5 }, 22,
+              { {0, 0, 7}, {11, 0, 0}, {10, 4, 4}, {4, 0, 7}, {6, 5, 5}, {6, 4, 4}, {8, 0, 7}, {7, 5, 5}, {11, 4, 4}, {1, 0, 4}, {7, 4, 4}, {6, 0, 3}, {5, 0, 5}, {7, 0, 3}, {9, 0, 4}, {11, 1, 1}, {10, 0, 3}, {2, 0, 4}, {11, 2, 2}, {3, 0, 4}, {11, 3, 3}, {12, 0, 4} } },
+            { 1, 2, 8, { 5, 5, 6 }, 22,
+              { {0, 0, 7}, {11, 1, 1}, {10, 4, 4}, {4, 0, 7}, {10, 5, 5}, {6, 4, 4}, {8, 0, 7}, {11, 5, 5}, {11, 4, 4}, {1, 0, 4}, {7, 4, 4}, {6, 0, 3}, {5, 0, 4}, {11, 0, 0}, {7, 0, 3}, {9, 0, 5}, {10, 0, 3}, {2, 0, 4}, {11, 2, 2}, {3, 0, 4}, {11, 3, 3}, {12, 0, 4} } },
+            { 0, 2, 6, { 6, 6, 6 }, 24,
+              { {0, 0, 5}, {7, 4, 4}, {11, 0, 0}, {11, 1, 1}, {10, 4, 4}, {4, 0, 5}, {6, 5, 5}, {10, 5, 5}, {11, 2, 2}, {6, 4, 4}, {8, 0, 5}, {7, 5, 5}, {11, 3, 3}, {11, 5, 5}, {11, 4, 4}, {1, 0, 5}, {6, 0, 3}, {5, 0, 5}, {7, 0, 3}, {9, 0, 5}, {10, 0, 3}, {2, 0, 5}, {3, 0, 5}, {12, 0, 4} } },
+            { 0, 1, 10, { 10, 10, 10 }, 6,
+              { {0, 0, 9}, {4, 0, 9}, {8, 0, 9}, {1, 0, 9}, {5, 0, 9}, {9, 0, 9} } },
+            { 1, 1, 11, { 9, 9, 9 }, 9,
+              { {0, 0, 9}, {4, 0, 9}, {8, 0, 9}, {1, 0, 8}, {0, 10, 10}, {5, 0, 8}, {4, 10, 10}, {9, 0, 8}, {8, 10, 10} } },
+            { 1, 1, 12, { 8, 8, 8 }, 9,
+              { {0, 0, 9}, {4, 0, 9}, {8, 0, 9}, {1, 0, 7}, {0, 11, 10}, {5, 0, 7}, {4, 11, 10}, {9, 0, 7}, {8, 11, 10} } },
+            { 1, 1, 16, { 4, 4, 4 }, 9,
+              { {0, 0, 9}, {4, 0, 9}, {8, 0, 9}, {1, 0, 3}, {0, 15, 10}, {5, 0, 3}, {4, 15, 10}, {9, 0, 3}, {8, 15, 10} } }
+        };
+        return kModes[index];
+    }
+
+    inline int32_t SignExtend(const uint32_t value, const int32_t bits)
+    {
+        return static_cast<int32_t>(value << (32 - bits)) >> (32 - bits);
+    }
+
+    // endpoint to the 16 bit range, before interpolation
+    inline int32_t UnquantizeBC6H(const int32_t value, const int32_t bits, const bool is_signed)
+    {
+        if (!is_signed)
+        {
+            if (bits >= 15) return value;
+            if (value == 0) return 0;
+            if (value == (1 << bits) - 1) return 0xFFFF;
+            return ((value << 16) + 0x8000) >> bits;
+        }
+
+        if (bits >= 16) return value;
+        const bool negative = value < 0;
+        const int32_t magnitude = negative ? -value : value;
+        int32_t result;
+        if (magnitude == 0) result = 0;
+        else if (magnitude >= (1 << (bits - 1)) - 1) result = 0x7FFF;
+        else result = ((magnitude << 15) + 0x4000) >> (bits - 1);
+        return negative ? -result : result;
+    }
+
+    // interpolated value to the bits of a half float
+    inline uint16_t FinishUnquantizeBC6H(const int32_t value, const bool is_signed)
+    {
+        if (!is_signed) return static_cast<uint16_t>((value * 31) >> 6);
+        if (value < 0) return static_cast<uint16_t>(0x8000 | (((-value) * 31) >> 5));
+        return static_cast<uint16_t>((value * 31) >> 5);
+    }
+
+    inline void DecodeBC6HBlock(const uint8_t* block, uint8_t* dest, const size_t dest_pitch, const bool is_signed)
+    {
+        int32_t mode;
+        switch (block[0] & 0x3)
+        {
+            case 0: mode = 0; break;
+            case 1: mode = 1; break;
+            default:
+            {
+                // 5 bit modes ending in 10 are 2 subset, ending in 11 are 1 subset.
+                // 0x13, 0x17, 0x1B and 0x1F are reserved
+                static const int8_t kModeIndex[8] = { 2, 3, 4, 5, 6, 7, 8, 9 };
+                static const int8_t kModeIndexSingle[8] = { 10, 11, 12, 13, -1, -1, -1, -1 };
+                const int32_t bits = block[0] & 0x1F;
+                mode = ((bits & 0x3) == 0x2) ? kModeIndex[bits >> 2] : kModeIndexSingle[bits >> 2];
+            }
+        }
+
+        if (mode < 0)
+        {
+            // reserved, decodes to black
+            const uint16_t black[4] = { 0, 0, 0, 0x3C00 };
+            for (int32_t i = 0; i < 16; i++) std::memcpy(dest + (i >> 2) * dest_pitch + (i & 3) * 8, black, 8);
+            return;
+        }
+
+        const BC6HModeInfo& info = BC6HMode(mode);
+        BlockBitReader reader(block);
+        reader.GetBits(mode < 2 ? 2 : 5);
+
+        uint32_t fields[13] = { 0 };
+        for (int32_t r = 0; r < info.range_count; r++)
+        {
+            const BC6HBitRange& range = info.ranges[r];
+            if (range.first <= range.last)
+            {
+                fields[range.field] |= reader.GetBits(range.last - range.first + 1) << range.first;
+            }
+            else
+            {
+                // stored from the highest bit down
+                for (int32_t bit = range.first; bit >= range.last; bit--) fields[range.field] |= reader.GetBits(1) << bit;
+            }
+        }
+
+        // endpoints[channel][w, x, y, z]
+        const int32_t bits = info.endpoint_bits;
+        const int32_t num_endpoints = info.subsets * 2;
+        int32_t endpoints[3][4];
+        for (int32_t c = 0; c < 3; c++)
+        {
+            const uint32_t base = fields[c * 4];
+            endpoints[c][0] = is_signed ? SignExtend(base, bits) : static_cast<int32_t>(base);
+            for (int32_t e = 1; e < num_endpoints; e++)
+            {
+                uint32_t value = fields[c * 4 + e];
+                if (info.transformed)
+                {
+                    // the other endpoints are deltas to the base
+                    value = (base + SignExtend(value, info.delta_bits[c])) & ((1u << bits) - 1);
+                }
+                endpoints[c][e] = is_signed ? SignExtend(value, bits) : static_cast<int32_t>(value);
+            }
+            for (int32_t e = 0; e < num_endpoints; e++) endpoints[c][e] = UnquantizeBC6H(endpoints[c][e], bits, is_signed);
+        }
+
+        const uint32_t partition = fields[12];
+        const int32_t index_bits = (info.subsets == 2) ? 3 : 4;
+        const uint32_t anchor_mask = 1u | ((info.subsets == 2) ? (1u << kBCAnchors2[partition]) : 0u);
+        const uint8_t* weights = BCWeights(index_bits);
+
+        for (int32_t i = 0; i < 16; i++)
+        {
+            const uint32_t index = reader.GetBits(index_bits - ((anchor_mask >> i) & 1));
+            const int32_t subset = (info.subsets == 2) ? ((kBCPartitions2[partition] >> i) & 0x1) : 0;
+            const int32_t w = weights[index];
+            uint16_t pixel[4];
+            for (int32_t c = 0; c < 3; c++)
+            {
+                const int32_t value = ((64 - w) * endpoints[c][subset * 2] + w * endpoints[c][subset * 2 + 1] + 32) >> 6;
+                pixel[c] = FinishUnquantizeBC6H(value, is_signed);
+            }
+            pixel[3] = 0x3C00; // 1.0
+            std::memcpy(dest + (i >> 2) * dest_pitch + (i & 3) * 8, pixel, 8);
+        }
+    }
+
+    // the encoders read the 16 R8G8B8A8 pixels of a block row by row, with
+    // src_pitch bytes between rows, and write one block to block.
+    //  BC1: opaque colour, alpha is dropped
+    //  BC3: colour and alpha
+    //  BC5: R and G, for normal maps
+    //  BC7: mode 6 only, one RGBA subset with 4 bit indices
+    // the endpoints are fit along the principal axis of the pixels and then
+    // refined once by least squares on the chosen indices.
+    // the encoders are scalar code for one block at a time, throughput comes
+    // from TextureCompressor encoding block rows on every core. BC7 never
+    // tries the partitioned modes, so blocks of two or three distinct
+    // colours, hard edges and text, lose the most against a full encoder
+
+    inline void LoadBlockRGBA8(const uint8_t* src, const size_t src_pitch, float pixels[16][4])
+    {
+        for (int32_t i = 0; i < 16; i++)
+        {
+            const uint8_t* pixel = src + (i >> 2) * src_pitch + (i & 3) * 4;
+            for (int32_t c = 0; c < 4; c++) pixels[i][c] = pixel[c];
+        }
+    }
+
+    // endpoints at the extremes of the pixels projected to their principal axis
+    inline void FitBlockEndpoints(const float pixels[16][4], const int32_t channels, float e0[4], float e1[4])
+    {
+        float mean[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        for (int32_t i = 0; i < 16; i++)
+        {
+            for (int32_t c = 0; c < channels; c++) mean[c] += pixels[i][c];
+        }
+        for (int32_t c = 0; c < channels; c++) mean[c] /= 16.0f;
+
+        float covariance[4][4] = { { 0.0f } };
+        for (int32_t i = 0; i < 16; i++)
+        {
+            for (int32_t r = 0; r < channels; r++)
+            {
+                for (int32_t c = 0; c < channels; c++) covariance[r][c] += (pixels[i][r] - mean[r]) * (pixels[i][c] - mean[c]);
+            }
+        }
+
+        // power iteration, starting from the row of the widest channel
+        int32_t widest = 0;
+        for (int32_t c = 1; c < channels; c++)
+        {
+            if (covariance[c][c] > covariance[widest][widest]) widest = c;
+        }
+        float axis[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        for (int32_t c = 0; c < channels; c++) axis[c] = covariance[widest][c];
+        for (int32_t iteration = 0; iteration < 8; iteration++)
+        {
+            float next[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+            float scale = 0.0f;
+            for (int32_t r = 0; r < channels; r++)
+            {
+                for (int32_t c = 0; c < channels; c++) next[r] += covariance[r][c] * axis[c];
+                scale = std::max(scale, std::abs(next[r]));
+            }
+            if (scale == 0.0f) break;
+            for (int32_t c = 0; c < channels; c++) axis[c] = next[c] / scale;
+        }
+
+        float length = 0.0f;
+        for (int32_t c = 0; c < channels; c++) length += axis[c] * axis[c];
+        length = std::sqrt(length);
+        float min_t = 0.0f;
+        float max_t = 0.0f;
+        if (length > 0.0f)
+        {
+            for (int32_t c = 0; c < channels; c++) axis[c] /= length;
+            min_t = max_t = 0.0f;
+            for (int32_t i = 0; i < 16; i++)
+            {
+                float t = 0.0f;
+                for (int32_t c = 0; c < channels; c++) t += (pixels[i][c] - mean[c]) * axis[c];
+                min_t = std::min(min_t, t);
+                max_t = std::max(max_t, t);
+            }
+        }
+
+        for (int32_t c = 0; c < channels; c++)
+        {
+            e0[c] = std::min(std::max(mean[c] + min_t * axis[c], 0.0f), 255.0f);
+            e1[c] = std::min(std::max(mean[c] + max_t * axis[c], 0.0f), 255.0f);
+        }
+    }
+
+    // least squares endpoints for pixels interpolated with weights (0 is
+    // e0, 1 is e1). leaves the endpoints alone if all weights are the same
+    inline void RefineBlockEndpoints(const float pixels[16][4], const int32_t channels, const float weights[16], float e0[4], float e1[4])
+    {
+        float a = 0.0f, b = 0.0f, c = 0.0f;
+        float rhs0[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        float rhs1[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        for (int32_t i = 0; i < 16; i++)
+        {
+            const float w = weights[i];
+            a += (1.0f - w) * (1.0f - w);
+            b += (1.0f - w) * w;
+            c += w * w;
+            for (int32_t ch = 0; ch < channels; ch++)
+            {
+                rhs0[ch] += (1.0f - w) * pixels[i][ch];
+                rhs1[ch] += w * pixels[i][ch];
+            }
+        }
+
+        const float determinant = a * c - b * b;
+        if (std::abs(determinant) < 1e-6f) return;
+        for (int32_t ch = 0; ch < channels; ch++)
+        {
+            e0[ch] = std::min(std::max((c * rhs0[ch] - b * rhs1[ch]) / determinant, 0.0f), 255.0f);
+            e1[ch] = std::min(std::max((a * rhs1[ch] - b * rhs0[ch]) / determinant, 0.0f), 255.0f);
+        }
+    }
+
+    inline uint16_t QuantizeRGB565(const float rgb[4])
+    {
+        const uint32_t r = static_cast<uint32_t>(rgb[0] * 31.0f / 255.0f + 0.5f);
+        const uint32_t g = static_cast<uint32_t>(rgb[1] * 63.0f / 255.0f + 0.5f);
+        const uint32_t b = static_cast<uint32_t>(rgb[2] * 31.0f / 255.0f + 0.5f);
+        return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+    }
+
+    // pick the BC1 indices for two 565 endpoints, returns the squared error.
+    // color0 > color1 selects 4 colours, equal endpoints only use index 0
+    inline uint32_t EncodeBCColorIndices(const float pixels[16][4], uint16_t color0, uint16_t color1, uint8_t* block, float weights[16])
+    {
+        static const float kWeights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+        if (color0 < color1) std::swap(color0, color1);
+
+        uint32_t c0[3], c1[3];
+        DecodeRGB565(color0, c0);
+        DecodeRGB565(color1, c1);
+        int32_t palette[4][3];
+        for (int32_t c = 0; c < 3; c++)
+        {
+            palette[0][c] = c0[c];
+            palette[1][c] = c1[c];
+            palette[2][c] = (2 * c0[c] + c1[c]) / 3;
+            palette[3][c] = (c0[c] + 2 * c1[c]) / 3;
+        }
+        const int32_t palette_size = (color0 == color1) ? 1 : 4;
+
+        uint32_t indices = 0;
+        uint32_t error = 0;
+        for (int32_t i = 0; i < 16; i++)
+        {
+            uint32_t best_error = UINT32_MAX;
+            uint32_t best = 0;
+            for (int32_t j = 0; j < palette_size; j++)
+            {
+                uint32_t e = 0;
+                for (int32_t c = 0; c < 3; c++)
+                {
+                    const int32_t d = static_cast<int32_t>(pixels[i][c]) - palette[j][c];
+                    e += d * d;
+                }
+                if (e < best_error)
+                {
+                    best_error = e;
+                    best = j;
+                }
+            }
+            indices |= best << (i * 2);
+            weights[i] = kWeights[best];
+            error += best_error;
+        }
+
+        block[0] = static_cast<uint8_t>(color0);
+        block[1] = static_cast<uint8_t>(color0 >> 8);
+        block[2] = static_cast<uint8_t>(color1);
+        block[3] = static_cast<uint8_t>(color1 >> 8);
+        std::memcpy(block + 4, &indices, sizeof(indices));
+        return error;
+    }
+
+    inline void EncodeBC1Block(const uint8_t* src, const size_t src_pitch, uint8_t* block)
+    {
+        float pixels[16][4];
+        LoadBlockRGBA8(src, src_pitch, pixels);
+
+        float e0[4], e1[4], weights[16];
+        FitBlockEndpoints(pixels, 3, e0, e1);
+        const uint32_t error = EncodeBCColorIndices(pixels, QuantizeRGB565(e0), QuantizeRGB565(e1), block, weights);
+
+        uint8_t refined[8];
+        RefineBlockEndpoints(pixels, 3, weights, e0, e1);
+        if (EncodeBCColorIndices(pixels, QuantizeRGB565(e0), QuantizeRGB565(e1), refined, weights) < error)
+        {
+            std::memcpy(block, refined, sizeof(refined));
+        }
+    }
+
+    // one channel (byte offset channel of every pixel) as 8 bytes, with the
+    // interpolating 8 value mode over the channel's range
+    inline void EncodeBCChannelBlock(const uint8_t* src, const size_t src_pitch, const int32_t channel, uint8_t* block)
+    {
+        uint8_t values[16];
+        uint8_t min_value = 255;
+        uint8_t max_value = 0;
+        for (int32_t i = 0; i < 16; i++)
+        {
+            values[i] = src[(i >> 2) * src_pitch + (i & 3) * 4 + channel];
+            min_value = std::min(min_value, values[i]);
+            max_value = std::max(max_value, values[i]);
+        }
+
+        int32_t palette[8];
+        DecodeBCChannelPalette(max_value, min_value, 0, 255, palette);
+        const int32_t palette_size = (max_value == min_value) ? 1 : 8;
+
+        uint64_t indices = 0;
+        for (int32_t i = 0; i < 16; i++)
+        {
+            int32_t best_error = 256;
+            uint64_t best = 0;
+            for (int32_t j = 0; j < palette_size; j++)
+            {
+                const int32_t e = std::abs(values[i] - palette[j]);
+                if (e < best_error)
+                {
+                    best_error = e;
+                    best = j;
+                }
+            }
+            indices |= best << (i * 3);
+        }
+
+        block[0] = max_value;
+        block[1] = min_value;
+        for (int32_t i = 0; i < 6; i++) block[2 + i] = static_cast<uint8_t>(indices >> (i * 8));
+    }
+
+    inline void EncodeBC3Block(const uint8_t* src, const size_t src_pitch, uint8_t* block)
+    {
+        EncodeBCChannelBlock(src, src_pitch, 3, block);
+        EncodeBC1Block(src, src_pitch, block + 8);
+    }
+
+    inline void EncodeBC5Block(const uint8_t* src, const size_t src_pitch, uint8_t* block)
+    {
+        EncodeBCChannelBlock(src, src_pitch, 0, block);
+        EncodeBCChannelBlock(src, src_pitch, 1, block + 8);
+    }
+
+    // BC7 mode 6 for two endpoints, returns the squared error. the 7 bit
+    // endpoints and their p-bits are chosen to land closest to e0 and e1
+    inline uint32_t EncodeBC7Mode6(const float pixels[16][4], const float e0[4], const float e1[4], uint8_t* block, float weights[16])
+    {
+        uint32_t quantized[2][4];
+        uint32_t pbits[2];
+        uint32_t endpoints[2][4];
+        const float* targets[2] = { e0, e1 };
+        for (int32_t e = 0; e < 2; e++)
+        {
+            float best_error = 1e30f;
+            for (uint32_t p = 0; p < 2; p++)
+            {
+                uint32_t q[4];
+                float error = 0.0f;
+                for (int32_t c = 0; c < 4; c++)
+                {
+                    q[c] = static_cast<uint32_t>(std::min(std::max((targets[e][c] - p) / 2.0f + 0.5f, 0.0f), 127.0f));
+                    const float d = static_cast<float>(q[c] * 2 + p) - targets[e][c];
+                    error += d * d;
+                }
+                if (error < best_error)
+                {
+                    best_error = error;
+                    pbits[e] = p;
+                    std::memcpy(quantized[e], q, sizeof(q));
+                }
+            }
+            for (int32_t c = 0; c < 4; c++) endpoints[e][c] = quantized[e][c] * 2 + pbits[e];
+        }
+
+        int32_t palette[16][4];
+        for (int32_t j = 0; j < 16; j++)
+        {
+            const uint32_t w = kBCWeights4[j];
+            for (int32_t c = 0; c < 4; c++) palette[j][c] = ((64 - w) * endpoints[0][c] + w * endpoints[1][c] + 32) >> 6;
+        }
+
+        uint8_t indices[16];
+        uint32_t error = 0;
+        for (int32_t i = 0; i < 16; i++)
+        {
+            uint32_t best_error = UINT32_MAX;
+            for (int32_t j = 0; j < 16; j++)
+            {
+                uint32_t e = 0;
+                for (int32_t c = 0; c < 4; c++)
+                {
+                    const int32_t d = static_cast<int32_t>(pixels[i][c]) - palette[j][c];
+                    e += d * d;
+                }
+                if (e < best_error)
+                {
+                    best_error = e;
+                    indices[i] = static_cast<uint8_t>(j);
+                }
+            }
+            weights[i] = kBCWeights4[indices[i]] / 64.0f;
+            error += best_error;
+        }
+
+        // the anchor index is stored without its top bit, so it must be
+        // below 8. swapping the endpoints mirrors the indices
+        if (indices[0] & 0x8)
+        {
+            std::swap(quantized[0], quantized[1]);
+            std::swap(pbits[0], pbits[1]);
+            for (int32_t i = 0; i < 16; i++) indices[i] = 15 - indices[i];
+        }
+
+        BlockBitWriter writer;
+        writer.PutBits(1u << 6, 7);
+        for (int32_t c = 0; c < 4; c++)
+        {
+            writer.PutBits(quantized[0][c], 7);
+            writer.PutBits(quantized[1][c], 7);
+        }
+        writer.PutBits(pbits[0], 1);
+        writer.PutBits(pbits[1], 1);
+        writer.PutBits(indices[0], 3);
+        for (int32_t i = 1; i < 16; i++) writer.PutBits(indices[i], 4);
+        writer.Store(block);
+        return error;
+    }
+
+    inline void EncodeBC7Block(const uint8_t* src, const size_t src_pitch, uint8_t* block)
+    {
+        float pixels[16][4];
+        LoadBlockRGBA8(src, src_pitch, pixels);
+
+        float e0[4], e1[4], weights[16];
+        FitBlockEndpoints(pixels, 4, e0, e1);
+        const uint32_t error = EncodeBC7Mode6(pixels, e0, e1, block, weights);
+
+        uint8_t refined[16];
+        RefineBlockEndpoints(pixels, 4, weights, e0, e1);
+        if (EncodeBC7Mode6(pixels, e0, e1, refined, weights) < error)
+        {
+            std::memcpy(block, refined, sizeof(refined));
+        }
+    }
+}
@@ -37,6 +37,26 @@ namespace My {
                     std::clamp<float>(result[1] + 0.5f, 0.0f, 255.0f), 
                     std::clamp<float>(result[2] + 0.5f, 0.0f, 255.0f)});
     }
-}
 
+    // convert count pixels from separate Y, Cb and Cr rows to R8G8B8A8.
+    // same coefficients as YCbCr2RGB in 16.16 fixed point
+    inline void ConvertYCbCr2RGBA(const uint8_t* y, const uint8_t* cb, const uint8_t* cr, uint8_t* rgba, const size_t count)
+    {
+#ifdef USE_ISPC
+        ispc::YCbCrToRGBA8(count, y, cb, cr, rgba);
+#else
+        Dummy::YCbCrToRGBA8(count, y, cb, cr, rgba);
+#endif
+    }
 
+    // convert count pixels of interleaved 8 bit RGB (pixel_stride 3) or
+    // RGBA (pixel_stride 4) to separate Y, Cb and Cr rows
+    inline void ConvertRGB2YCbCr(const uint8_t* rgb, const int32_t pixel_stride, uint8_t* y, uint8_t* cb, uint8_t* cr, const size_t count)
+    {
+#ifdef USE_ISPC
+        ispc::RGBToYCbCr(count, rgb, pixel_stride, y, cb, cr);
+#else
+        Dummy::RGBToYCbCr(count, rgb, pixel_stride, y, cb, cr);
+#endif
+    }
+}
@@ -0,0 +1,423 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Image.hpp"
+
+namespace My {
+    // number of levels of a mip chain which halves width and height until
+    // either reaches 0, the layout DdsParser reads, at most max_levels
+    inline uint32_t MipmapLevelCount(uint32_t width, uint32_t height, const uint32_t max_levels)
+    {
+        uint32_t levels = 0;
+        while (width > 0 && height > 0 && levels < max_levels)
+        {
+            levels++;
+            width >>= 1;
+            height >>= 1;
+        }
+        return levels;
+    }
+
+    // batched row conversions and 2:1 filter passes, see Mipmap.ispc
+    inline void UnpackMipmapRow8(const uint8_t* src, const int32_t channels, const float* lut, float* out, const size_t count)
+    {
+#ifdef USE_ISPC
+        ispc::MipmapUnpackRow8(count, src, channels, lut, out);
+#else
+        Dummy::MipmapUnpackRow8(count, src, channels, lut, out);
+#endif
+    }
+
+    inline void PackMipmapRow8(const float* src, const int32_t channels, const bool srgb, uint8_t* out, const size_t count)
+    {
+#ifdef USE_ISPC
+        ispc::MipmapPackRow8(count, src, channels, srgb, out);
+#else
+        Dummy::MipmapPackRow8(count, src, channels, srgb, out);
+#endif
+    }
+
+    inline void UnpackMipmapRowHalf(const uint16_t* src, float* out, const size_t count)
+    {
+#ifdef USE_ISPC
+        ispc::MipmapUnpackRowHalf(count, src, out);
+#else
+        Dummy::MipmapUnpackRowHalf(count, src, out);
+#endif
+    }
+
+    inline void PackMipmapRowHalf(const float* src, uint16_t* out, const size_t count)
+    {
+#ifdef USE_ISPC
+        ispc::MipmapPackRowHalf(count, src, out);
+#else
+        Dummy::MipmapPackRowHalf(count, src, out);
+#endif
+    }
+
+    inline void FilterMipmapRow(const float* src, const int32_t src_width, const int32_t channels,
+            const float* weights, const int32_t taps, float* out, const int32_t dest_width)
+    {
+#ifdef USE_ISPC
+        ispc::MipmapFilterRow(dest_width, src, src_width, channels, weights, taps, out);
+#else
+        Dummy::MipmapFilterRow(dest_width, src, src_width, channels, weights, taps, out);
+#endif
+    }
+
+    inline void FilterMipmapColumns(const float* const* rows, const float* weights, const int32_t taps,
+            const float min_value, const float max_value, float* out, const size_t count)
+    {
+#ifdef USE_ISPC
+        ispc::MipmapFilterColumns(count, rows, weights, taps, min_value, max_value, out);
+#else
+        Dummy::MipmapFilterColumns(count, rows, weights, taps, min_value, max_value, out);
+#endif
+    }
+
+    enum class MipmapFilter {
+        kMipmapFilterBox,       // 2x2 average, fastest
+        kMipmapFilterKaiser,    // Kaiser windowed sinc, sharp with little ringing
+        kMipmapFilterLanczos    // Lanczos3, sharpest
+    };
+
+    // builds the mip chain of an uncompressed image. all levels are in one
+    // allocation in the layout DdsParser produces, described by mipmaps[].
+    // each level is filtered from the one above it, kept as float in between
+    // so 8 bit images are quantized once per level
+    class MipmapGenerator
+    {
+    protected:
+        MipmapFilter m_Filter = MipmapFilter::kMipmapFilterBox;
+        bool m_bSRGB = false;
+        bool m_bMultithreaded = true;
+
+        // a filter pass over fewer pixels than this runs on the calling thread
+        static const size_t kMinPixelsForThreading = 64 * 1024;
+
+        // the windowed sinc filters reach 3 pixels of the smaller level
+        static const int32_t kMaxTaps = 12;
+
+        enum class SampleType { kUnorm8, kHalf, kFloat };
+
+        static bool sampleLayout(const Image& img, SampleType& type, uint32_t& channels)
+        {
+            if (img.compressed || !img.data) return false;
+            if (img.is_float)
+            {
+                switch (img.bitcount)
+                {
+                    case 64: type = SampleType::kHalf; channels = 4; return true;
+                    case 96: type = SampleType::kFloat; channels = 3; return true;
+                    case 128: type = SampleType::kFloat; channels = 4; return true;
+                }
+            }
+            else
+            {
+                switch (img.bitcount)
+                {
+                    case 8: type = SampleType::kUnorm8; channels = 1; return true;
+                    case 24: type = SampleType::kUnorm8; channels = 3; return true;
+                    case 32: type = SampleType::kUnorm8; channels = 4; return true;
+                }
+            }
+            return false;
+        }
+
+        // 8 bit to [0, 1], index 0 linear and index 1 sRGB decoded
+        static const float* unpackTable(const bool srgb)
+        {
+            static const struct Tables {
+                float values[2][256];
+                Tables()
+                {
+                    for (int i = 0; i < 256; i++)
+                    {
+                        const float value = i / 255.0f;
+                        values[0][i] = value;
+                        values[1][i] = (value <= 0.04045f) ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+                    }
+                }
+            } tables;
+            return tables.values[srgb ? 1 : 0];
+        }
+
+        static float sinc(const float x)
+        {
+            if (std::fabs(x) < 1e-6f) return 1.0f;
+            return static_cast<float>(std::sin(PI * x) / (PI * x));
+        }
+
+        // modified Bessel function of the first kind, order 0
+        static float besselI0(const float x)
+        {
+            float sum = 1.0f;
+            float term = 1.0f;
+            for (int k = 1; k < 32 && term > sum * 1e-8f; k++)
+            {
+                const float half_x_over_k = x / (2.0f * k);
+                term *= half_x_over_k * half_x_over_k;
+                sum += term;
+            }
+            return sum;
+        }
+
+        // the filter at distance x in pixels of the smaller level
+        float filterValue(const float x) const
+        {
+            const float kWidth = 3.0f;
+            if (std::fabs(x) >= kWidth) return 0.0f;
+            if (m_Filter == MipmapFilter::kMipmapFilterKaiser)
+            {
+                const float kAlpha = 4.0f;
+                const float t = x / kWidth;
+                return sinc(x) * besselI0(kAlpha * std::sqrt(1.0f - t * t)) / besselI0(kAlpha);
+            }
+            return sinc(x) * sinc(x / kWidth);
+        }
+
+        // the weights of the source pixels around a dest pixel, see
+        // MipmapFilterRow. returns the number of taps
+        int32_t filterWeights(float weights[kMaxTaps]) const
+        {
+            if (m_Filter == MipmapFilter::kMipmapFilterBox)
+            {
+                weights[0] = weights[1] = 0.5f;
+                return 2;
+            }
+
+            float sum = 0.0f;
+            for (int32_t k = 0; k < kMaxTaps; k++)
+            {
+                // source pixel centres are half a pixel off the dest centre and
+                // the source is twice as dense
+                weights[k] = filterValue((k - kMaxTaps / 2 + 0.5f) * 0.5f);
+                sum += weights[k];
+            }
+            for (int32_t k = 0; k < kMaxTaps; k++)
+            {
+                weights[k] /= sum;
+            }
+            return kMaxTaps;
+        }
+
+        // calls func(begin, end) over [0, rows), on all cores for big passes
+        template <typename Func>
+        void forEachRow(const uint32_t rows, const uint32_t width, Func func) const
+        {
+#ifndef OS_WEBASSEMBLY
+            unsigned int thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+            thread_count = std::min(thread_count, rows);
+            if (m_bMultithreaded && thread_count > 1 && static_cast<size_t>(rows) * width >= kMinPixelsForThreading)
+            {
+                std::atomic<uint32_t> next_row(0);
+                auto worker = [&]() {
+                    uint32_t begin;
+                    while ((begin = next_row.fetch_add(1)) < rows)
+                    {
+                        func(begin, begin + 1);
+                    }
+                };
+
+                std::vector<std::thread> threads;
+                for (unsigned int i = 1; i < thread_count; i++)
+                {
+                    threads.emplace_back(worker);
+                }
+                worker();
+                for (auto& thread : threads)
+                {
+                    thread.join();
+                }
+                return;
+            }
+#endif
+            func(0, rows);
+        }
+
+    public:
+        void SetFilter(MipmapFilter filter) { m_Filter = filter; }
+        MipmapFilter GetFilter() const { return m_Filter; }
+
+        // filter the colour channels of 8 bit images in linear light and
+        // store them sRGB encoded. alpha and float images are always linear
+        void SetSRGB(bool srgb) { m_bSRGB = srgb; }
+        bool GetSRGB() const { return m_bSRGB; }
+
+        // filter the rows of each level on all cores
+        void SetMultithreaded(bool multithreaded) { m_bMultithreaded = multithreaded; }
+
+        // "box", "kaiser" or "lanczos"
+        static const char* FilterName(const MipmapFilter filter)
+        {
+            switch (filter)
+            {
+                case MipmapFilter::kMipmapFilterKaiser: return "kaiser";
+                case MipmapFilter::kMipmapFilterLanczos: return "lanczos";
+                default: return "box";
+            }
+        }
+
+        static bool ParseFilterName(const std::string& name, MipmapFilter& filter)
+        {
+            for (auto candidate : { MipmapFilter::kMipmapFilterBox,
+                                    MipmapFilter::kMipmapFilterKaiser,
+                                    MipmapFilter::kMipmapFilterLanczos })
+            {
+                if (name == FilterName(candidate))
+                {
+                    filter = candidate;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        static bool IsSupported(const Image& img)
+        {
+            SampleType type;
+            uint32_t channels;
+            return sampleLayout(img, type, channels);
+        }
+
+        // img is an uncompressed 8 bit gray, RGB or RGBA image, or an RGBA
+        // half float, RGB or RGBA float image. the result has the same pixel
+        // format, float levels are clamped at 0 against the ringing of the
+        // sinc filters. returns an empty image for anything else
+        Image Generate(const Image& img) const
+        {
+            Image result;
+            SampleType type;
+            uint32_t channels;
+            if (!sampleLayout(img, type, channels))
+            {
+                std::cerr << "[Error] mipmaps can only be generated for uncompressed 8 bit, half and float images" << std::endl;
+                return result;
+            }
+
+            const uint32_t pixel_size = img.bitcount >> 3;
+            result.Width = img.Width;
+            result.Height = img.Height;
+            result.bitcount = img.bitcount;
+            result.is_float = img.is_float;
+            result.mipmap_count = MipmapLevelCount(img.Width, img.Height, sizeof(result.mipmaps) / sizeof(result.mipmaps[0]));
+
+            result.data_size = 0;
+            for (uint32_t i = 0; i < result.mipmap_count; i++)
+            {
+                auto& mip = result.mipmaps[i];
+                mip.Width = img.Width >> i;
+                mip.Height = img.Height >> i;
+                mip.pitch = mip.Width * pixel_size;
+                mip.offset = result.data_size;
+                mip.data_size = static_cast<size_t>(mip.pitch) * mip.Height;
+                result.data_size += mip.data_size;
+            }
+            result.pitch = result.mipmaps[0].pitch;
+            result.data = new uint8_t[result.data_size];
+
+            for (uint32_t y = 0; y < img.Height; y++)
+            {
+                std::memcpy(result.data + static_cast<size_t>(result.pitch) * y, img.data + static_cast<size_t>(img.pitch) * y, result.pitch);
+            }
+
+            float weights[kMaxTaps];
+            const int32_t taps = filterWeights(weights);
+            const bool srgb = m_bSRGB && type == SampleType::kUnorm8;
+            const float* lut = unpackTable(srgb);
+            float max_value = FLT_MAX;
+            if (type == SampleType::kUnorm8) max_value = 1.0f;
+            else if (type == SampleType::kHalf) max_value = 65504.0f;
+
+            // the level above as float, empty while it is level 0
+            std::vector<float> previous;
+            for (uint32_t i = 1; i < result.mipmap_count; i++)
+            {
+                const auto& src = result.mipmaps[i - 1];
+                const auto& dest = result.mipmaps[i];
+                const size_t src_row_size = static_cast<size_t>(src.Width) * channels;
+                const size_t dest_row_size = static_cast<size_t>(dest.Width) * channels;
+
+                // horizontal pass over every source row
+                std::vector<float> horizontal(dest_row_size * src.Height);
+                forEachRow(src.Height, src.Width, [&](const uint32_t begin, const uint32_t end) {
+                    std::vector<float> unpacked;
+                    for (uint32_t y = begin; y < end; y++)
+                    {
+                        const float* row;
+                        if (!previous.empty())
+                        {
+                            row = previous.data() + src_row_size * y;
+                        }
+                        else
+                        {
+                            const uint8_t* packed = result.data + src.offset + static_cast<size_t>(src.pitch) * y;
+                            if (type == SampleType::kFloat)
+                            {
+                                row = reinterpret_cast<const float*>(packed);
+                            }
+                            else
+                            {
+                                unpacked.resize(src_row_size);
+                                if (type == SampleType::kHalf)
+                                {
+                                    UnpackMipmapRowHalf(reinterpret_cast<const uint16_t*>(packed), unpacked.data(), src_row_size);
+                                }
+                                else
+                                {
+                                    UnpackMipmapRow8(packed, channels, lut, unpacked.data(), src_row_size);
+                                }
+                                row = unpacked.data();
+                            }
+                        }
+                        FilterMipmapRow(row, src.Width, channels, weights, taps, horizontal.data() + dest_row_size * y, dest.Width);
+                    }
+                });
+
+                // vertical pass, which also stores the level
+                std::vector<float> current(dest_row_size * dest.Height);
+                forEachRow(dest.Height, dest.Width, [&](const uint32_t begin, const uint32_t end) {
+                    const float* rows[kMaxTaps];
+                    for (uint32_t y = begin; y < end; y++)
+                    {
+                        const int32_t first = static_cast<int32_t>(2 * y + 1) - taps / 2;
+                        for (int32_t k = 0; k < taps; k++)
+                        {
+                            const int32_t sy = std::min(std::max(first + k, 0), static_cast<int32_t>(src.Height) - 1);
+                            rows[k] = horizontal.data() + dest_row_size * sy;
+                        }
+
+                        float* row = current.data() + dest_row_size * y;
+                        FilterMipmapColumns(rows, weights, taps, 0.0f, max_value, row, dest_row_size);
+
+                        uint8_t* packed = result.data + dest.offset + static_cast<size_t>(dest.pitch) * y;
+                        switch (type)
+                        {
+                            case SampleType::kUnorm8:
+                                PackMipmapRow8(row, channels, srgb, packed, dest_row_size);
+                                break;
+                            case SampleType::kHalf:
+                                PackMipmapRowHalf(row, reinterpret_cast<uint16_t*>(packed), dest_row_size);
+                                break;
+                            case SampleType::kFloat:
+                                std::memcpy(packed, row, dest_row_size * sizeof(float));
+                                break;
+                        }
+                    }
+                });
+
+                previous.swap(current);
+            }
+
+            return result;
+        }
+    };
+}
@@ -0,0 +1,230 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include "geommath.hpp"
+// the byte shuffles need SSSE3, which x86-64 does not guarantee. they are
+// compiled for it whatever the build targets and picked at run time
+#if MYGE_SIMD_SSE && (defined(__GNUC__) || defined(__clang__))
+#include <tmmintrin.h>
+#define MYGE_PIXEL_SSSE3 1
+#define MYGE_TARGET_SSSE3 __attribute__((target("ssse3")))
+#elif MYGE_SIMD_SSE && defined(_MSC_VER)
+#include <intrin.h>
+#include <tmmintrin.h>
+#define MYGE_PIXEL_SSSE3 1
+#define MYGE_TARGET_SSSE3
+#endif
+
+namespace My {
+#if MYGE_PIXEL_SSSE3
+    inline bool CpuHasSsse3()
+    {
+#if defined(__SSSE3__)
+        return true;
+#elif defined(_MSC_VER)
+        static const bool has_ssse3 = []() {
+            int info[4];
+            __cpuid(info, 1);
+            return (info[2] & (1 << 9)) != 0;
+        }();
+        return has_ssse3;
+#else
+        static const bool has_ssse3 = []() {
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("ssse3") != 0;
+        }();
+        return has_ssse3;
+#endif
+    }
+
+    // the SSSE3 halves of the conversions below. each converts the pixels
+    // it can without reading past the end of src and returns how many
+    namespace Ssse3 {
+        MYGE_TARGET_SSSE3 inline size_t ExpandRGB8ToRGBA8(const uint8_t* src, uint8_t* dest, const size_t count)
+        {
+            size_t i = 0;
+            const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+            const __m128i alpha = _mm_set1_epi32(static_cast<int32_t>(0xFF000000));
+            // 16 bytes are loaded for the 12 used, stay clear of the end of src
+            for (; i + 6 <= count; i += 4) {
+                __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 3));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i * 4), _mm_or_si128(_mm_shuffle_epi8(x, shuffle), alpha));
+            }
+            return i;
+        }
+
+        MYGE_TARGET_SSSE3 inline size_t ExpandRGB16BEToRGBA16(const uint8_t* src, uint8_t* dest, const size_t count)
+        {
+            size_t i = 0;
+            const __m128i shuffle = _mm_setr_epi8(1, 0, 3, 2, 5, 4, -1, -1, 7, 6, 9, 8, 11, 10, -1, -1);
+            const __m128i alpha = _mm_set_epi32(static_cast<int32_t>(0xFFFF0000), 0, static_cast<int32_t>(0xFFFF0000), 0);
+            // 16 bytes are loaded for the 12 used, stay clear of the end of src
+            for (; i + 3 <= count; i += 2) {
+                __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 6));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i * 8), _mm_or_si128(_mm_shuffle_epi8(x, shuffle), alpha));
+            }
+            return i;
+        }
+
+        MYGE_TARGET_SSSE3 inline size_t SwizzleBGR8ToRGB8(const uint8_t* src, uint8_t* dest, const size_t count)
+        {
+            size_t i = 0;
+            // 5 pixels per 16 bytes, the 16th byte is written again by the next pixel
+            const __m128i shuffle = _mm_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 14, 13, 12, 15);
+            for (; i + 6 <= count; i += 5) {
+                __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 3));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i * 3), _mm_shuffle_epi8(x, shuffle));
+            }
+            return i;
+        }
+
+        MYGE_TARGET_SSSE3 inline size_t SwizzleBGR8ToRGBA8(const uint8_t* src, uint8_t* dest, const size_t count)
+        {
+            size_t i = 0;
+            const __m128i shuffle = _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+            const __m128i alpha = _mm_set1_epi32(static_cast<int32_t>(0xFF000000));
+            // 16 bytes are loaded for the 12 used, stay clear of the end of src
+            for (; i + 6 <= count; i += 4) {
+                __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 3));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i * 4), _mm_or_si128(_mm_shuffle_epi8(x, shuffle), alpha));
+            }
+            return i;
+        }
+
+        MYGE_TARGET_SSSE3 inline size_t SwizzleBGRA8ToRGBA8(const uint8_t* src, uint8_t* dest, const size_t count)
+        {
+            size_t i = 0;
+            const __m128i shuffle = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+            for (; i + 4 <= count; i += 4) {
+                __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i * 4), _mm_shuffle_epi8(x, shuffle));
+            }
+            return i;
+        }
+    }
+#endif
+    // GPUs have no 24/48 bit texture formats, these widen RGB rows to RGBA
+    // with opaque alpha. dest must not overlap src.
+
+    // count pixels of R8G8B8 to R8G8B8A8
+    inline void ExpandRGB8ToRGBA8(const uint8_t* src, uint8_t* dest, const size_t count)
+    {
+        size_t i = 0;
+#if MYGE_PIXEL_SSSE3
+        if (CpuHasSsse3()) i = Ssse3::ExpandRGB8ToRGBA8(src, dest, count);
+#endif
+        // a 4 byte copy per pixel, the byte it reads past the pixel is overwritten by alpha
+        for (; i + 1 < count; i++) {
+            std::memcpy(dest + i * 4, src + i * 3, 4);
+            dest[i * 4 + 3] = 0xFF;
+        }
+        for (; i < count; i++) {
+            std::memcpy(dest + i * 4, src + i * 3, 3);
+            dest[i * 4 + 3] = 0xFF;
+        }
+    }
+
+    // count pixels of native endian R16G16B16 to R16G16B16A16
+    inline void ExpandRGB16ToRGBA16(const uint8_t* src, uint8_t* dest, const size_t count)
+    {
+        size_t i = 0;
+        for (; i + 1 < count; i++) {
+            std::memcpy(dest + i * 8, src + i * 6, 8);
+            dest[i * 8 + 6] = 0xFF;
+            dest[i * 8 + 7] = 0xFF;
+        }
+        for (; i < count; i++) {
+            std::memcpy(dest + i * 8, src + i * 6, 6);
+            dest[i * 8 + 6] = 0xFF;
+            dest[i * 8 + 7] = 0xFF;
+        }
+    }
+
+    // count pixels of big endian R16G16B16 to native (little) endian R16G16B16A16
+    inline void ExpandRGB16BEToRGBA16(const uint8_t* src, uint8_t* dest, const size_t count)
+    {
+        size_t i = 0;
+#if MYGE_PIXEL_SSSE3
+        if (CpuHasSsse3()) i = Ssse3::ExpandRGB16BEToRGBA16(src, dest, count);
+#endif
+        for (; i < count; i++) {
+            const uint8_t* s = src + i * 6;
+            uint8_t* d = dest + i * 8;
+            d[0] = s[1];
+            d[1] = s[0];
+            d[2] = s[3];
+            d[3] = s[2];
+            d[4] = s[5];
+            d[5] = s[4];
+            d[6] = 0xFF;
+            d[7] = 0xFF;
+        }
+    }
+
+    // BMP and TGA store blue first, these swap it with red. dest must not
+    // overlap src.
+
+    // count pixels of B8G8R8 to R8G8B8
+    inline void SwizzleBGR8ToRGB8(const uint8_t* src, uint8_t* dest, const size_t count)
+    {
+        size_t i = 0;
+#if MYGE_PIXEL_SSSE3
+        if (CpuHasSsse3()) i = Ssse3::SwizzleBGR8ToRGB8(src, dest, count);
+#endif
+        for (; i < count; i++) {
+            dest[i * 3]     = src[i * 3 + 2];
+            dest[i * 3 + 1] = src[i * 3 + 1];
+            dest[i * 3 + 2] = src[i * 3];
+        }
+    }
+
+    // count pixels of B8G8R8 to R8G8B8A8 with opaque alpha
+    inline void SwizzleBGR8ToRGBA8(const uint8_t* src, uint8_t* dest, const size_t count)
+    {
+        size_t i = 0;
+#if MYGE_PIXEL_SSSE3
+        if (CpuHasSsse3()) i = Ssse3::SwizzleBGR8ToRGBA8(src, dest, count);
+#endif
+        for (; i < count; i++) {
+            dest[i * 4]     = src[i * 3 + 2];
+            dest[i * 4 + 1] = src[i * 3 + 1];
+            dest[i * 4 + 2] = src[i * 3];
+            dest[i * 4 + 3] = 0xFF;
+        }
+    }
+
+    // count pixels of B8G8R8A8 to R8G8B8A8
+    inline void SwizzleBGRA8ToRGBA8(const uint8_t* src, uint8_t* dest, const size_t count)
+    {
+        size_t i = 0;
+#if MYGE_PIXEL_SSSE3
+        if (CpuHasSsse3()) i = Ssse3::SwizzleBGRA8ToRGBA8(src, dest, count);
+#endif
+        for (; i < count; i++) {
+            dest[i * 4]     = src[i * 4 + 2];
+            dest[i * 4 + 1] = src[i * 4 + 1];
+            dest[i * 4 + 2] = src[i * 4];
+            dest[i * 4 + 3] = src[i * 4 + 3];
+        }
+    }
+
+    // count Radiance RGBE pixels to float[3], or float[4] with alpha 1.0 if components is 4
+    inline void ConvertRGBEToFloat(const uint8_t* rgbe, float* out, const int32_t components, const size_t count)
+    {
+#ifdef USE_ISPC
+        ispc::RGBEToFloat(count, rgbe, components, out);
+#else
+        Dummy::RGBEToFloat(count, rgbe, components, out);
+#endif
+    }
+
+    // count Radiance RGBE pixels to R16G16B16A16 half float with alpha 1.0
+    inline void ConvertRGBEToHalf4(const uint8_t* rgbe, uint16_t* out, const size_t count)
+    {
+#ifdef USE_ISPC
+        ispc::RGBEToHalf4(count, rgbe, out);
+#else
+        Dummy::RGBEToHalf4(count, rgbe, out);
+#endif
+    }
+}
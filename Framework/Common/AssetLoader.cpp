@@ -1,4 +1,16 @@
 #include "AssetLoader.hpp"
+#include "AssetPack.hpp"
+#include "config.h"
+
+#if defined(OS_WINDOWS)
+#include <io.h>
+#include <windows.h>
+#elif defined(OS_LINUX) || defined(OS_MACOS) || defined(OS_BSD)
+#define USE_POSIX_FILES 1
+#include <dirent.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 using namespace My;
 using namespace std;
@@ -10,16 +22,235 @@ int AssetLoader::Initialize()
 
 void AssetLoader::Finalize()
 {
+    stopIoThreads();
+    {
+        lock_guard<mutex> lock(m_AsyncMutex);
+        m_CompletedRequests.clear();
+    }
+
+    lock_guard<mutex> lock(m_PathMutex);
     m_strSearchPath.clear();
+    m_Packs.clear();
+    m_ResolvedPaths.clear();
+    m_bIndexDirty = true;
 }
 
 void AssetLoader::Tick()
 {
+    // callbacks may queue more loads, so they run without the lock
+    vector<unique_ptr<AsyncLoadRequest>> completed;
+    {
+        lock_guard<mutex> lock(m_AsyncMutex);
+        completed.swap(m_CompletedRequests);
+    }
+
+    for (auto& request : completed) {
+        request->callback(request->result);
+    }
+}
+
+future<Buffer> AssetLoader::AsyncLoad(const char *filePath, int32_t priority, AssetOpenMode mode, AsyncLoadId* id)
+{
+    unique_ptr<AsyncLoadRequest> request(new AsyncLoadRequest);
+    request->name = filePath;
+    request->mode = mode;
+    future<Buffer> result = request->promise.get_future();
+
+    AsyncLoadId request_id = queueRequest(std::move(request), priority);
+    if (id) *id = request_id;
+
+    return result;
+}
+
+AssetLoader::AsyncLoadId AssetLoader::AsyncLoad(const char *filePath, AsyncLoadCallback callback, int32_t priority, AssetOpenMode mode)
+{
+    unique_ptr<AsyncLoadRequest> request(new AsyncLoadRequest);
+    request->name = filePath;
+    request->mode = mode;
+    request->callback = std::move(callback);
+
+    return queueRequest(std::move(request), priority);
+}
+
+bool AssetLoader::CancelLoad(AsyncLoadId id)
+{
+    lock_guard<mutex> lock(m_AsyncMutex);
+    for (auto it = m_PendingRequests.begin(); it != m_PendingRequests.end(); it++) {
+        if (it->second->id == id) {
+            if (!it->second->callback) it->second->promise.set_value(Buffer());
+            m_PendingRequests.erase(it);
+            m_QueueCondition.notify_one();
+            return true;
+        }
+    }
+
+    for (auto it = m_CompletedRequests.begin(); it != m_CompletedRequests.end(); it++) {
+        if ((*it)->id == id) {
+            m_CompletedRequests.erase(it);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+AssetLoader::AsyncLoadId AssetLoader::queueRequest(unique_ptr<AsyncLoadRequest>&& request, int32_t priority)
+{
+#if defined(OS_WEBASSEMBLY)
+    // no threads, the file is read right away
+    (void)priority;
+    {
+        lock_guard<mutex> lock(m_AsyncMutex);
+        request->id = m_nNextLoadId++;
+    }
+    AsyncLoadId id = request->id;
+    request->result = (request->mode == MY_OPEN_TEXT) ? SyncOpenAndReadText(request->name.c_str())
+                                                      : SyncOpenAndReadBinary(request->name.c_str());
+    finishRequest(std::move(request));
+    return id;
+#else
+    unique_lock<mutex> lock(m_AsyncMutex);
+    // the I/O threads take requests without waiting for Tick(), so this
+    // also makes progress when called from a callback
+    m_QueueCondition.wait(lock, [this] { return m_PendingRequests.size() < m_nMaxPendingRequests; });
+
+    AsyncLoadId id = m_nNextLoadId++;
+    request->id = id;
+
+    startIoThreads();
+    m_PendingRequests.emplace(priority, std::move(request));
+    m_AsyncCondition.notify_one();
+    return id;
+#endif
+}
+
+uint32_t AssetLoader::QueueIoTask(const function<void()>& task, uint32_t count)
+{
+#if defined(OS_WEBASSEMBLY)
+    (void)task;
+    (void)count;
+    return 0;
+#else
+    lock_guard<mutex> lock(m_AsyncMutex);
+    startIoThreads();
+    if (count > m_nIoThreadCount) count = m_nIoThreadCount;
+    for (uint32_t i = 0; i < count; i++) {
+        unique_ptr<AsyncLoadRequest> request(new AsyncLoadRequest);
+        request->id = m_nNextLoadId++;
+        request->task = task;
+        m_PendingRequests.emplace(INT32_MAX, std::move(request));
+    }
+    m_AsyncCondition.notify_all();
+    return count;
+#endif
+}
+
+// m_AsyncMutex is held
+void AssetLoader::startIoThreads()
+{
+    if (!m_IoThreads.empty()) return;
 
+    m_bStopIoThreads = false;
+    for (uint32_t i = 0; i < m_nIoThreadCount; i++) {
+        m_IoThreads.emplace_back(&AssetLoader::ioThreadMain, this);
+    }
+}
+
+void AssetLoader::ioThreadMain()
+{
+    while (true) {
+        unique_ptr<AsyncLoadRequest> request;
+        {
+            unique_lock<mutex> lock(m_AsyncMutex);
+            m_AsyncCondition.wait(lock, [this] { return m_bStopIoThreads || !m_PendingRequests.empty(); });
+            if (m_bStopIoThreads) return;
+
+            auto next = m_PendingRequests.begin();
+            request = std::move(next->second);
+            m_PendingRequests.erase(next);
+        }
+        m_QueueCondition.notify_one();
+
+        if (request->task) {
+            request->task();
+            continue;
+        }
+
+        request->result = (request->mode == MY_OPEN_TEXT) ? SyncOpenAndReadText(request->name.c_str())
+                                                          : SyncOpenAndReadBinary(request->name.c_str());
+        finishRequest(std::move(request));
+    }
+}
+
+void AssetLoader::finishRequest(unique_ptr<AsyncLoadRequest>&& request)
+{
+    if (request->callback) {
+        lock_guard<mutex> lock(m_AsyncMutex);
+        m_CompletedRequests.push_back(std::move(request));
+    } else {
+        request->promise.set_value(std::move(request->result));
+    }
+}
+
+// requests which have not been read yet are dropped, their futures get
+// an empty buffer
+void AssetLoader::stopIoThreads()
+{
+    vector<thread> threads;
+    {
+        lock_guard<mutex> lock(m_AsyncMutex);
+        m_bStopIoThreads = true;
+        threads.swap(m_IoThreads);
+    }
+    m_AsyncCondition.notify_all();
+
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    lock_guard<mutex> lock(m_AsyncMutex);
+    for (auto& pending : m_PendingRequests) {
+        if (!pending.second->callback && !pending.second->task) pending.second->promise.set_value(Buffer());
+    }
+    m_PendingRequests.clear();
+    m_bStopIoThreads = false;
+    m_QueueCondition.notify_all();
+}
+
+static bool isPackPath(const char *path)
+{
+    const size_t length = strlen(path);
+    return length > 5 && strcmp(path + length - 5, ".pack") == 0;
 }
 
 bool AssetLoader::AddSearchPath(const char *path)
 {
+    if (isPackPath(path)) {
+        {
+            lock_guard<mutex> lock(m_PathMutex);
+            for (const auto& pack : m_Packs) {
+                if (pack->GetPath() == path)
+                    return true;
+            }
+        }
+
+        auto pack = make_shared<AssetPack>();
+        if (!pack->Open(path)) {
+            fprintf(stderr, "Error opening asset pack '%s'\n", path);
+            return false;
+        }
+        pack->SetIoThreads(this);
+
+        if (m_Verbosity >= MY_VERBOSITY_INFO) {
+            fprintf(stderr, "Opened asset pack '%s', %zu assets\n", path, pack->GetEntryCount());
+        }
+
+        lock_guard<mutex> lock(m_PathMutex);
+        m_Packs.push_back(pack);
+        return true;
+    }
+
+    lock_guard<mutex> lock(m_PathMutex);
     std::vector<std::string>::iterator src = m_strSearchPath.begin();
 
     while (src != m_strSearchPath.end()) {
@@ -29,16 +260,26 @@ bool AssetLoader::AddSearchPath(const char *path)
     }
 
     m_strSearchPath.push_back(path);
+    m_bIndexDirty = true;
     return true;
 }
 
 bool AssetLoader::RemoveSearchPath(const char *path)
 {
+    lock_guard<mutex> lock(m_PathMutex);
+    for (auto it = m_Packs.begin(); it != m_Packs.end(); it++) {
+        if ((*it)->GetPath() == path) {
+            m_Packs.erase(it);
+            return true;
+        }
+    }
+
     std::vector<std::string>::iterator src = m_strSearchPath.begin();
 
     while (src != m_strSearchPath.end()) {
         if (!(*src).compare(path)) {
             m_strSearchPath.erase(src);
+            m_bIndexDirty = true;
             return true;
         }
         src++;
@@ -47,8 +288,34 @@ bool AssetLoader::RemoveSearchPath(const char *path)
     return true;
 }
 
+// a pack may be removed while it is read, so the list is copied
+bool AssetLoader::readFromPacks(const char *filePath, Buffer& buf, bool text)
+{
+    vector<shared_ptr<AssetPack>> packs;
+    {
+        lock_guard<mutex> lock(m_PathMutex);
+        if (m_Packs.empty()) return false;
+        packs = m_Packs;
+    }
+
+    for (const auto& pack : packs) {
+        if (pack->Read(filePath, buf, text))
+            return true;
+    }
+
+    return false;
+}
+
 bool AssetLoader::FileExists(const char *filePath)
 {
+    {
+        lock_guard<mutex> lock(m_PathMutex);
+        for (const auto& pack : m_Packs) {
+            if (pack->Contains(filePath))
+                return true;
+        }
+    }
+
     AssetFilePtr fp = OpenFile(filePath, MY_OPEN_BINARY);
     if (fp != nullptr) {
         CloseFile(fp);
@@ -57,10 +324,10 @@ bool AssetLoader::FileExists(const char *filePath)
     return false;
 }
 
-AssetLoader::AssetFilePtr AssetLoader::OpenFile(const char* name, AssetOpenMode mode)
+// the Asset directories which are tried for a file, in the order they
+// are tried: N times up the hierarchy, every search path at each level
+vector<string> AssetLoader::assetRoots() const
 {
-    FILE *fp = nullptr;
-    // loop N times up the hierarchy, testing at each level
 #ifdef __psp2__
     std::string upPath = "app0:/";
 #elseif __ORBIS__
@@ -68,38 +335,142 @@ AssetLoader::AssetFilePtr AssetLoader::OpenFile(const char* name, AssetOpenMode
 #else
     std::string upPath;
 #endif
-    std::string fullPath;
+    vector<string> roots;
     for (int32_t i = 0; i < 10; i++) {
-        std::vector<std::string>::iterator src = m_strSearchPath.begin();
-        bool looping = true;
-        while (looping) {
-            fullPath.assign(upPath);  // reset to current upPath.
-            if (src != m_strSearchPath.end()) {
-                fullPath.append(*src);
-                fullPath.append("/Asset/");
-                src++;
-            }
-            else {
-                fullPath.append("Asset/");
-                looping = false;
-            }
-            fullPath.append(name);
-            fprintf(stderr, "Trying to open %s\n", fullPath.c_str());
+        for (const auto& path : m_strSearchPath) {
+            roots.push_back(upPath + path + "/Asset/");
+        }
+        roots.push_back(upPath + "Asset/");
 
-            switch(mode) {
-                case MY_OPEN_TEXT:
-                fp = fopen(fullPath.c_str(), "r");
-                break;
-                case MY_OPEN_BINARY:
-                fp = fopen(fullPath.c_str(), "rb");
-                break;
-            }
+        upPath.append("../");
+    }
+
+    return roots;
+}
 
-            if (fp)
-                return (AssetFilePtr)fp;
+// appends the files below dir to files as prefix + file name
+static void listDirectory(const string& dir, const string& prefix, int32_t depth, vector<string>& files)
+{
+    if (depth > 16) return;
+
+#if defined(OS_WINDOWS)
+    WIN32_FIND_DATAA entry;
+    HANDLE find = FindFirstFileA((dir + "*").c_str(), &entry);
+    if (find == INVALID_HANDLE_VALUE) return;
+    do {
+        const string name = entry.cFileName;
+        if (name == "." || name == "..") continue;
+        if (entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+            listDirectory(dir + name + "/", prefix + name + "/", depth + 1, files);
+        } else {
+            files.push_back(prefix + name);
+        }
+    } while (FindNextFileA(find, &entry));
+    FindClose(find);
+#elif defined(USE_POSIX_FILES)
+    DIR* d = opendir(dir.c_str());
+    if (!d) return;
+    while (struct dirent* entry = readdir(d)) {
+        const string name = entry->d_name;
+        if (name == "." || name == "..") continue;
+        bool is_dir = (entry->d_type == DT_DIR);
+        if (entry->d_type == DT_UNKNOWN || entry->d_type == DT_LNK) {
+            DIR* sub = opendir((dir + name).c_str());
+            if (sub) closedir(sub);
+            is_dir = (sub != nullptr);
         }
+        if (is_dir) {
+            listDirectory(dir + name + "/", prefix + name + "/", depth + 1, files);
+        } else {
+            files.push_back(prefix + name);
+        }
+    }
+    closedir(d);
+#else
+    (void)dir;
+    (void)prefix;
+    (void)files;
+#endif
+}
 
-        upPath.append("../");
+void AssetLoader::ListFiles(const string& dir, vector<string>& files)
+{
+    string root = dir;
+    if (!root.empty() && root.back() != '/' && root.back() != '\\') root.push_back('/');
+    listDirectory(root, string(), 0, files);
+}
+
+// files which are already in the index came from an earlier root and win
+void AssetLoader::buildDirectoryIndex()
+{
+    m_ResolvedPaths.clear();
+    size_t count = 0;
+    vector<string> files;
+    for (const auto& root : assetRoots()) {
+        files.clear();
+        ListFiles(root, files);
+        for (const auto& file : files) {
+            if (m_ResolvedPaths.emplace(file, root + file).second) count++;
+        }
+    }
+    m_bIndexDirty = false;
+
+    if (m_Verbosity >= MY_VERBOSITY_INFO) {
+        fprintf(stderr, "Indexed %zu asset files\n", count);
+    }
+}
+
+static FILE* openPath(const string& path, AssetLoader::AssetOpenMode mode)
+{
+    switch(mode) {
+        case AssetLoader::MY_OPEN_TEXT:
+        return fopen(path.c_str(), "r");
+        case AssetLoader::MY_OPEN_BINARY:
+        return fopen(path.c_str(), "rb");
+    }
+
+    return nullptr;
+}
+
+AssetLoader::AssetFilePtr AssetLoader::OpenFile(const char* name, AssetOpenMode mode)
+{
+    FILE *fp = nullptr;
+
+    // files seen before, or found by the directory index, take one lookup
+    string resolved;
+    vector<string> roots;
+    {
+        lock_guard<mutex> lock(m_PathMutex);
+        if (m_bIndexDirty) buildDirectoryIndex();
+        auto it = m_ResolvedPaths.find(name);
+        if (it != m_ResolvedPaths.end()) resolved = it->second;
+        else roots = assetRoots();
+    }
+
+    if (!resolved.empty()) {
+        fp = openPath(resolved, mode);
+        if (fp)
+            return (AssetFilePtr)fp;
+
+        lock_guard<mutex> lock(m_PathMutex);
+        roots = assetRoots();
+    }
+
+    // not in the index, e.g. written after it was built, or spelled
+    // differently. try every root and remember where it was found
+    for (const auto& root : roots) {
+        std::string fullPath = root + name;
+        if (m_Verbosity >= MY_VERBOSITY_PROBE) {
+            fprintf(stderr, "Trying to open %s\n", fullPath.c_str());
+        }
+
+        fp = openPath(fullPath, mode);
+
+        if (fp) {
+            lock_guard<mutex> lock(m_PathMutex);
+            m_ResolvedPaths[name] = fullPath;
+            return (AssetFilePtr)fp;
+        }
     }
 
     return nullptr;
@@ -107,51 +478,156 @@ AssetLoader::AssetFilePtr AssetLoader::OpenFile(const char* name, AssetOpenMode
 
 Buffer AssetLoader::SyncOpenAndReadText(const char *filePath)
 {
+    Buffer packed;
+    if (readFromPacks(filePath, packed, true)) return packed;
+
     AssetFilePtr fp = OpenFile(filePath, MY_OPEN_TEXT);
-    Buffer* pBuff = nullptr;
 
     if (fp) {
         size_t length = GetSize(fp);
 
-        pBuff = new Buffer(length + 1);
-        length = fread(pBuff->GetData(), 1, length, static_cast<FILE*>(fp));
+        Buffer buff(length + 1);
+        length = fread(buff.GetData(), 1, length, static_cast<FILE*>(fp));
 #ifdef DEBUG
         fprintf(stderr, "Read file '%s', %zu bytes\n", filePath, length);
 #endif
 
-        pBuff->GetData()[length] = '\0';
+        buff.GetData()[length] = '\0';
 
         CloseFile(fp);
-    } else {
-        fprintf(stderr, "Error opening file '%s'\n", filePath);
-        pBuff = new Buffer();
+        return buff;
     }
 
-    return *pBuff;
+    fprintf(stderr, "Error opening file '%s'\n", filePath);
+    return Buffer();
 }
 
 Buffer AssetLoader::SyncOpenAndReadBinary(const char *filePath)
 {
+    Buffer packed;
+    if (readFromPacks(filePath, packed, false)) return packed;
+
     AssetFilePtr fp = OpenFile(filePath, MY_OPEN_BINARY);
-    Buffer* pBuff = nullptr;
 
     if (fp) {
         size_t length = GetSize(fp);
 
-        pBuff = new Buffer(length);
-        fread(pBuff->GetData(), length, 1, static_cast<FILE*>(fp));
+        Buffer buff(length);
+        if (fread(buff.GetData(), 1, length, static_cast<FILE*>(fp)) != length) {
+            fprintf(stderr, "Error reading file '%s'\n", filePath);
+        }
 #ifdef DEBUG
         fprintf(stderr, "Read file '%s', %zu bytes\n", filePath, length);
 #endif
 
         CloseFile(fp);
-    } else {
+        return buff;
+    }
+
+    fprintf(stderr, "Error opening file '%s'\n", filePath);
+    return Buffer();
+}
+
+// views start at a multiple of this, 64 KiB on Windows rather than a page
+#if defined(OS_WINDOWS)
+static size_t mapGranularity()
+{
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwAllocationGranularity;
+}
+#elif defined(USE_POSIX_FILES)
+static size_t mapGranularity()
+{
+    return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+#endif
+
+// the view was mapped from the boundary below data, which it starts at
+#if defined(OS_WINDOWS)
+static void unmapFile(uint8_t* data, size_t)
+{
+    const size_t skipped = reinterpret_cast<uintptr_t>(data) % mapGranularity();
+    UnmapViewOfFile(data - skipped);
+}
+#elif defined(USE_POSIX_FILES)
+static void unmapFile(uint8_t* data, size_t size)
+{
+    const size_t skipped = reinterpret_cast<uintptr_t>(data) % mapGranularity();
+    munmap(data - skipped, size + skipped);
+}
+#endif
+
+Buffer AssetLoader::MapFileRange(const AssetFilePtr& fp, size_t offset, size_t length)
+{
+    void* data = nullptr;
+    // an empty range can not be mapped
+    if (!fp || !length) return Buffer();
+
+#if defined(OS_WINDOWS) || defined(USE_POSIX_FILES)
+    const size_t skipped = offset % mapGranularity();
+    const size_t view_offset = offset - skipped;
+    const size_t view_length = length + skipped;
+#endif
+
+#if defined(OS_WINDOWS)
+    HANDLE file = reinterpret_cast<HANDLE>(_get_osfhandle(_fileno(static_cast<FILE*>(fp))));
+    HANDLE mapping = CreateFileMapping(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+    if (mapping) {
+        const uint64_t offset64 = view_offset;
+        data = MapViewOfFile(mapping, FILE_MAP_COPY, static_cast<DWORD>(offset64 >> 32), static_cast<DWORD>(offset64), view_length);
+        // the view keeps the mapping alive
+        CloseHandle(mapping);
+    }
+#elif defined(USE_POSIX_FILES)
+    data = mmap(nullptr, view_length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(static_cast<FILE*>(fp)), static_cast<off_t>(view_offset));
+    if (data == MAP_FAILED) data = nullptr;
+#else
+    (void)offset;
+#endif
+
+    if (!data) return Buffer();
+
+#if defined(OS_WINDOWS) || defined(USE_POSIX_FILES)
+    return Buffer(static_cast<uint8_t*>(data) + skipped, length, unmapFile);
+#else
+    return Buffer();
+#endif
+}
+
+Buffer AssetLoader::MapFile(const char *filePath)
+{
+    Buffer buff;
+    if (readFromPacks(filePath, buff, false)) return buff;
+
+#if defined(OS_WINDOWS) || defined(USE_POSIX_FILES)
+    AssetFilePtr fp = OpenFile(filePath, MY_OPEN_BINARY);
+    if (!fp) {
         fprintf(stderr, "Error opening file '%s'\n", filePath);
-        pBuff = new Buffer();
+        return Buffer();
     }
 
+    size_t length = GetSize(fp);
+    buff = MapFileRange(fp, 0, length);
+    // the mapping stays valid after the file is closed
+    CloseFile(fp);
+
+    if (!buff.GetData()) {
+        if (length) {
+            fprintf(stderr, "Error mapping file '%s', reading it instead\n", filePath);
+            return SyncOpenAndReadBinary(filePath);
+        }
+        return Buffer();
+    }
 
-    return *pBuff;
+#ifdef DEBUG
+    fprintf(stderr, "Mapped file '%s', %zu bytes\n", filePath, length);
+#endif
+
+    return buff;
+#else
+    return SyncOpenAndReadBinary(filePath);
+#endif
 }
 
 void AssetLoader::CloseFile(AssetFilePtr& fp)
@@ -1,16 +1,26 @@
 #pragma once
 
+#include <condition_variable>
 #include <cstdio>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 #include "IRuntimeModule.hpp"
 #include "Buffer.hpp"
 
 namespace My {
+    class AssetPack;
+
 	class AssetLoader : public IRuntimeModule {
     public:
-        virtual ~AssetLoader() {};
+        virtual ~AssetLoader() { stopIoThreads(); };
 
         virtual int Initialize();
         virtual void Finalize();
@@ -30,6 +40,20 @@ namespace My {
             MY_SEEK_END = 2  /// SEEK_END
         };
 
+        // what goes to stderr besides errors
+        enum AssetVerbosity {
+            MY_VERBOSITY_ERROR = 0, /// Errors Only
+            MY_VERBOSITY_INFO  = 1, /// Directory Index
+            MY_VERBOSITY_PROBE = 2  /// Every Path Tried
+        };
+
+        void SetVerbosity(AssetVerbosity verbosity) { m_Verbosity = verbosity; }
+
+        // the search paths are indexed once when a file is first opened after
+        // they changed, after that a file is found with one lookup. a path
+        // ending in .pack is opened as an asset pack, packs are searched
+        // before loose files in the order they were added. OpenFile and the
+        // functions taking an AssetFilePtr only see loose files
         bool AddSearchPath(const char *path);
 
         bool RemoveSearchPath(const char *path);
@@ -42,6 +66,12 @@ namespace My {
 
         virtual Buffer SyncOpenAndReadBinary(const char *filePath);
 
+        // maps the file into memory instead of reading it. the pages are
+        // copy on write, so the file is never changed, and are unmapped when
+        // the buffer goes away. falls back to SyncOpenAndReadBinary where
+        // files can not be mapped
+        virtual Buffer MapFile(const char *filePath);
+
         virtual size_t SyncRead(const AssetFilePtr& fp, Buffer& buf);
 
         virtual void CloseFile(AssetFilePtr& fp);
@@ -50,6 +80,42 @@ namespace My {
 
         virtual int32_t Seek(AssetFilePtr fp, long offset, AssetSeekBase where);
 
+        // maps length bytes of an open file from offset. the view starts at
+        // the boundary the platform maps at below offset, the buffer at
+        // offset. an empty buffer if it can not be mapped
+        static Buffer MapFileRange(const AssetFilePtr& fp, size_t offset, size_t length);
+
+        // appends the files below dir to files, as paths relative to dir
+        static void ListFiles(const std::string& dir, std::vector<std::string>& files);
+
+        typedef uint64_t AsyncLoadId;
+        typedef std::function<void(Buffer&)> AsyncLoadCallback;
+
+        // at most this many I/O threads are started, on the first async load
+        void SetIoThreadCount(uint32_t count) { m_nIoThreadCount = count ? count : 1; }
+
+        // at most this many requests wait for an I/O thread, AsyncLoad blocks
+        // until one of them is taken once there are more
+        void SetMaxPendingRequests(size_t count) { std::lock_guard<std::mutex> lock(m_AsyncMutex); m_nMaxPendingRequests = count ? count : 1; }
+
+        // reads the file on an I/O thread. requests of higher priority are
+        // read first, requests of the same priority in order
+        std::future<Buffer> AsyncLoad(const char *filePath, int32_t priority = 0, AssetOpenMode mode = MY_OPEN_BINARY, AsyncLoadId* id = nullptr);
+
+        // the callback runs in Tick() on the thread which calls it, once the
+        // file has been read
+        AsyncLoadId AsyncLoad(const char *filePath, AsyncLoadCallback callback, int32_t priority = 0, AssetOpenMode mode = MY_OPEN_BINARY);
+
+        // runs task on up to count I/O threads, ahead of the loads waiting
+        // for them and without waiting for room in the queue. gives how many
+        // were queued, 0 where there are no I/O threads. a task may run long
+        // after it was queued, or never if the threads are stopped first
+        uint32_t QueueIoTask(const std::function<void()>& task, uint32_t count);
+
+        // true if the request was dropped before its callback ran. the future
+        // of a request cancelled before it was read gets an empty buffer
+        bool CancelLoad(AsyncLoadId id);
+
         inline std::string SyncOpenAndReadTextFileToString(const char* fileName)
         {
             std::string result;
@@ -67,7 +133,46 @@ namespace My {
             return result;
         }
     private:
+        std::vector<std::string> assetRoots() const;
+        void buildDirectoryIndex();
+        bool readFromPacks(const char *filePath, Buffer& buf, bool text);
+
         std::vector<std::string> m_strSearchPath;
+        std::vector<std::shared_ptr<AssetPack>> m_Packs;
+        // logical name to the path the file was found at
+        std::unordered_map<std::string, std::string> m_ResolvedPaths;
+        bool m_bIndexDirty = true;
+        AssetVerbosity m_Verbosity = MY_VERBOSITY_ERROR;
+        std::mutex m_PathMutex;
+
+        struct AsyncLoadRequest {
+            AsyncLoadId id;
+            std::string name;
+            AssetOpenMode mode;
+            std::promise<Buffer> promise;
+            AsyncLoadCallback callback;  // empty for requests with a future
+            Buffer result;
+            std::function<void()> task;  // set for QueueIoTask, nothing is read
+        };
+
+        AsyncLoadId queueRequest(std::unique_ptr<AsyncLoadRequest>&& request, int32_t priority);
+        void ioThreadMain();
+        void finishRequest(std::unique_ptr<AsyncLoadRequest>&& request);
+        void startIoThreads();
+        void stopIoThreads();
+
+        // requests waiting for an I/O thread, highest priority first
+        std::multimap<int32_t, std::unique_ptr<AsyncLoadRequest>, std::greater<int32_t>> m_PendingRequests;
+        // read requests whose callback waits for Tick()
+        std::vector<std::unique_ptr<AsyncLoadRequest>> m_CompletedRequests;
+        std::vector<std::thread> m_IoThreads;
+        std::mutex m_AsyncMutex;
+        std::condition_variable m_AsyncCondition;
+        std::condition_variable m_QueueCondition;  // a pending request was taken
+        AsyncLoadId m_nNextLoadId = 1;
+        uint32_t m_nIoThreadCount = 2;
+        size_t m_nMaxPendingRequests = 1024;
+        bool m_bStopIoThreads = false;
 	};
 
     extern AssetLoader*     g_pAssetLoader;
@@ -0,0 +1,425 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <zlib.h>
+#include "AssetPack.hpp"
+#include "AssetLoader.hpp"
+#include "config.h"
+
+using namespace My;
+using namespace std;
+
+static int seekTo(FILE* fp, uint64_t offset)
+{
+#if defined(OS_WINDOWS)
+    return _fseeki64(fp, static_cast<__int64>(offset), SEEK_SET);
+#elif defined(OS_LINUX) || defined(OS_MACOS) || defined(OS_BSD)
+    return fseeko(fp, static_cast<off_t>(offset), SEEK_SET);
+#else
+    return fseek(fp, static_cast<long>(offset), SEEK_SET);
+#endif
+}
+
+static bool fileSize(FILE* fp, uint64_t& size)
+{
+#if defined(OS_WINDOWS)
+    if (_fseeki64(fp, 0, SEEK_END) != 0) return false;
+    const __int64 end = _ftelli64(fp);
+#elif defined(OS_LINUX) || defined(OS_MACOS) || defined(OS_BSD)
+    if (fseeko(fp, 0, SEEK_END) != 0) return false;
+    const off_t end = ftello(fp);
+#else
+    if (fseek(fp, 0, SEEK_END) != 0) return false;
+    const long end = ftell(fp);
+#endif
+    if (end < 0) return false;
+    size = static_cast<uint64_t>(end);
+    return true;
+}
+
+// a read whose chunks are inflated on the I/O threads too. a helper may
+// only start once the read is over, it then finds it done and leaves
+// without touching the read
+struct HelpedRead {
+    mutex lock;
+    condition_variable idle;
+    uint32_t active = 0;
+    bool done = false;
+    function<void()> work;
+};
+
+static void helpRead(const shared_ptr<HelpedRead>& read)
+{
+    {
+        lock_guard<mutex> lock(read->lock);
+        if (read->done) return;
+        read->active++;
+    }
+
+    read->work();
+
+    lock_guard<mutex> lock(read->lock);
+    read->active--;
+    read->idle.notify_all();
+}
+
+bool AssetPack::Open(const char* path)
+{
+    Close();
+
+    m_pFile = fopen(path, "rb");
+    if (!m_pFile) return false;
+
+    uint64_t file_size = 0;
+    bool ok = fileSize(m_pFile, file_size)
+        && seekTo(m_pFile, 0) == 0
+        && fread(&m_Header, sizeof(m_Header), 1, m_pFile) == 1
+        && memcmp(m_Header.Magic, "GEPK", 4) == 0
+        && m_Header.Version == kAssetPackVersion
+        && m_Header.ChunkSize > 0
+        && m_Header.IndexOffset <= file_size
+        && m_Header.EntryCount <= (file_size - m_Header.IndexOffset) / sizeof(ASSET_PACK_ENTRY)
+        && m_Header.NamesOffset <= file_size
+        && m_Header.NamesSize <= file_size - m_Header.NamesOffset;
+
+    if (ok) {
+        m_Entries.resize(m_Header.EntryCount);
+        m_Names.resize(m_Header.NamesSize);
+        ok = seekTo(m_pFile, m_Header.IndexOffset) == 0
+            && fread(m_Entries.data(), sizeof(ASSET_PACK_ENTRY), m_Entries.size(), m_pFile) == m_Entries.size()
+            && seekTo(m_pFile, m_Header.NamesOffset) == 0
+            && fread(m_Names.data(), 1, m_Names.size(), m_pFile) == m_Names.size();
+    }
+
+    // entries are read and mapped without further checks, so none may reach
+    // past the end of the file. a compressed entry holds its chunk offsets
+    // and one chunk per ChunkSize bytes of the asset
+    for (size_t i = 0; ok && i < m_Entries.size(); i++) {
+        const ASSET_PACK_ENTRY& entry = m_Entries[i];
+        ok = static_cast<uint64_t>(entry.NameOffset) + entry.NameLength <= m_Header.NamesSize
+            && (i == 0 || m_Entries[i - 1].NameHash <= entry.NameHash)
+            && entry.DataOffset <= file_size
+            && entry.StoredSize <= file_size - entry.DataOffset;
+        if (!ok) break;
+
+        if (!entry.ChunkCount) {
+            ok = entry.StoredSize == entry.Size;
+        } else {
+            ok = entry.ChunkCount == (entry.Size + m_Header.ChunkSize - 1) / m_Header.ChunkSize
+                && entry.StoredSize >= (static_cast<uint64_t>(entry.ChunkCount) + 1) * sizeof(uint64_t);
+        }
+    }
+
+    if (!ok) {
+        fprintf(stderr, "Error reading asset pack '%s'\n", path);
+        Close();
+        return false;
+    }
+
+    m_Path = path;
+    return true;
+}
+
+void AssetPack::Close()
+{
+    if (m_pFile) fclose(m_pFile);
+    m_pFile = nullptr;
+    m_Path.clear();
+    m_Entries.clear();
+    m_Names.clear();
+}
+
+const ASSET_PACK_ENTRY* AssetPack::find(const char* name) const
+{
+    const size_t length = strlen(name);
+    const uint64_t hash = AssetPackHash(name, length);
+
+    auto it = lower_bound(m_Entries.begin(), m_Entries.end(), hash, [](const ASSET_PACK_ENTRY& entry, uint64_t value) {
+        return entry.NameHash < value;
+    });
+
+    for (; it != m_Entries.end() && it->NameHash == hash; it++) {
+        if (it->NameLength == length && memcmp(m_Names.data() + it->NameOffset, name, length) == 0)
+            return &*it;
+    }
+
+    return nullptr;
+}
+
+bool AssetPack::readStored(uint64_t offset, size_t size, uint8_t* dest) const
+{
+    if (!size) return true;
+
+    lock_guard<mutex> lock(m_FileMutex);
+    return seekTo(m_pFile, offset) == 0 && fread(dest, 1, size, m_pFile) == size;
+}
+
+bool AssetPack::readEntry(const ASSET_PACK_ENTRY& entry, size_t offset, size_t length, uint8_t* dest) const
+{
+    if (!length) return true;
+    if (!entry.ChunkCount) return readStored(entry.DataOffset + offset, length, dest);
+
+    const size_t chunk_size = m_Header.ChunkSize;
+    const uint32_t first = static_cast<uint32_t>(offset / chunk_size);
+    const uint32_t last = static_cast<uint32_t>((offset + length - 1) / chunk_size);
+    if (last >= entry.ChunkCount) return false;
+
+    // the offsets of the chunks, then all of their bytes in one read
+    const uint32_t count = last - first + 1;
+    vector<uint64_t> chunk_offsets(count + 1);
+    if (!readStored(entry.DataOffset + first * sizeof(uint64_t), chunk_offsets.size() * sizeof(uint64_t),
+                reinterpret_cast<uint8_t*>(chunk_offsets.data()))) return false;
+    for (uint32_t i = 0; i < count; i++) {
+        if (chunk_offsets[i] > chunk_offsets[i + 1]) return false;
+    }
+    if (chunk_offsets[count] > entry.StoredSize) return false;
+
+    vector<uint8_t> stored(static_cast<size_t>(chunk_offsets[count] - chunk_offsets[0]));
+    if (!readStored(entry.DataOffset + chunk_offsets[0], stored.size(), stored.data())) return false;
+
+    // chunks which are only partly wanted are inflated aside and copied
+    atomic<bool> ok(true);
+    auto inflateChunk = [&](uint32_t i, vector<uint8_t>& scratch) {
+        const size_t chunk_begin = static_cast<size_t>(first + i) * chunk_size;
+        const size_t raw_size = min(chunk_size, static_cast<size_t>(entry.Size) - chunk_begin);
+        const uint8_t* src = stored.data() + (chunk_offsets[i] - chunk_offsets[0]);
+        const size_t src_size = static_cast<size_t>(chunk_offsets[i + 1] - chunk_offsets[i]);
+
+        const size_t begin = max(chunk_begin, offset);
+        const size_t end = min(chunk_begin + raw_size, offset + length);
+        const bool whole = (begin == chunk_begin && end == chunk_begin + raw_size);
+        if (src_size == raw_size) {
+            memcpy(dest + (begin - offset), src + (begin - chunk_begin), end - begin);
+            return;
+        }
+
+        uint8_t* out = dest + (chunk_begin - offset);
+        if (!whole) {
+            scratch.resize(raw_size);
+            out = scratch.data();
+        }
+        uLongf out_size = static_cast<uLongf>(raw_size);
+        if (uncompress(out, &out_size, src, static_cast<uLong>(src_size)) != Z_OK || out_size != raw_size) {
+            ok = false;
+            return;
+        }
+        if (!whole) memcpy(dest + (begin - offset), out + (begin - chunk_begin), end - begin);
+    };
+
+#ifndef OS_WEBASSEMBLY
+    AssetLoader* io_threads = m_pIoThreads;
+    unsigned int thread_count = max(thread::hardware_concurrency(), 1u);
+    thread_count = min(thread_count, count);
+    if (m_bMultithreaded && io_threads && thread_count > 1 && count >= kMinChunksForThreading) {
+        atomic<uint32_t> next_chunk(0);
+        auto read = make_shared<HelpedRead>();
+        read->work = [&]() {
+            vector<uint8_t> scratch;
+            uint32_t i;
+            while ((i = next_chunk.fetch_add(1)) < count) {
+                inflateChunk(i, scratch);
+            }
+        };
+
+        // the helpers take chunks as they get to it, whatever is left
+        // is inflated here, so busy I/O threads never hold the read up
+        io_threads->QueueIoTask([read]() { helpRead(read); }, thread_count - 1);
+        read->work();
+
+        unique_lock<mutex> lock(read->lock);
+        read->done = true;
+        read->idle.wait(lock, [&]() { return read->active == 0; });
+        read->work = nullptr;
+        return ok;
+    }
+#endif
+
+    vector<uint8_t> scratch;
+    for (uint32_t i = 0; i < count; i++) {
+        inflateChunk(i, scratch);
+    }
+    return ok;
+}
+
+bool AssetPack::Read(const char* name, Buffer& buf, bool text) const
+{
+    const ASSET_PACK_ENTRY* entry = find(name);
+    if (!entry) return false;
+
+    // the mapping starts at the boundary below the entry, which may cover
+    // the end of the entry before it
+    if (!entry->ChunkCount && !text) {
+        Buffer mapped = AssetLoader::MapFileRange(m_pFile, static_cast<size_t>(entry->DataOffset), static_cast<size_t>(entry->Size));
+        if (mapped.GetData()) {
+            buf = std::move(mapped);
+            return true;
+        }
+    }
+
+    Buffer result(static_cast<size_t>(entry->Size) + (text ? 1 : 0));
+    if (!readEntry(*entry, 0, static_cast<size_t>(entry->Size), result.GetData())) {
+        fprintf(stderr, "Error reading '%s' from asset pack '%s'\n", name, m_Path.c_str());
+        return false;
+    }
+    if (text) result.GetData()[entry->Size] = '\0';
+
+    buf = std::move(result);
+    return true;
+}
+
+bool AssetPack::ReadRange(const char* name, size_t offset, size_t length, Buffer& buf) const
+{
+    const ASSET_PACK_ENTRY* entry = find(name);
+    if (!entry || offset > entry->Size || length > entry->Size - offset) return false;
+
+    Buffer result(length);
+    if (!readEntry(*entry, offset, length, result.GetData())) {
+        fprintf(stderr, "Error reading '%s' from asset pack '%s'\n", name, m_Path.c_str());
+        return false;
+    }
+
+    buf = std::move(result);
+    return true;
+}
+
+static bool writeAt(FILE* fp, uint64_t& position, const void* data, size_t size)
+{
+    position += size;
+    return !size || fwrite(data, 1, size, fp) == size;
+}
+
+// zero bytes up to the next multiple of kAssetPackAlignment
+static bool padToAlignment(FILE* fp, uint64_t& position)
+{
+    static const uint8_t kZeros[kAssetPackAlignment] = {};
+    const size_t padding = static_cast<size_t>((kAssetPackAlignment - position % kAssetPackAlignment) % kAssetPackAlignment);
+    return writeAt(fp, position, kZeros, padding);
+}
+
+static bool readWholeFile(const string& path, vector<uint8_t>& data)
+{
+    FILE* fp = fopen(path.c_str(), "rb");
+    if (!fp) return false;
+
+    data.clear();
+    uint8_t block[64 * 1024];
+    size_t read;
+    while ((read = fread(block, 1, sizeof(block), fp)) > 0) {
+        data.insert(data.end(), block, block + read);
+    }
+    const bool ok = !ferror(fp);
+    fclose(fp);
+    return ok;
+}
+
+bool AssetPackWriter::Write(const char* path) const
+{
+    FILE* fp = fopen(path, "wb");
+    if (!fp) {
+        fprintf(stderr, "Error creating asset pack '%s'\n", path);
+        return false;
+    }
+
+    ASSET_PACK_HEADER header;
+    memcpy(header.Magic, "GEPK", 4);
+    header.Version = kAssetPackVersion;
+    header.EntryCount = static_cast<uint32_t>(m_Files.size());
+    header.ChunkSize = m_nChunkSize;
+
+    // the header is written again once the offsets are known
+    uint64_t position = 0;
+    bool ok = writeAt(fp, position, &header, sizeof(header));
+
+    vector<ASSET_PACK_ENTRY> entries;
+    string names;
+    vector<uint8_t> data;
+    vector<uint8_t> stored;
+    vector<uint8_t> compressed;
+    for (size_t i = 0; ok && i < m_Files.size(); i++) {
+        const SourceFile& file = m_Files[i];
+        if (!readWholeFile(file.path, data)) {
+            fprintf(stderr, "Error reading '%s'\n", file.path.c_str());
+            ok = false;
+            break;
+        }
+
+        ASSET_PACK_ENTRY entry;
+        entry.NameHash = AssetPackHash(file.name.data(), file.name.size());
+        entry.NameOffset = static_cast<uint32_t>(names.size());
+        entry.NameLength = static_cast<uint32_t>(file.name.size());
+        entry.Size = data.size();
+        entry.ChunkCount = 0;
+        entry.Reserved = 0;
+        names += file.name;
+
+        // chunk offsets followed by the chunks, each deflated on its own
+        if (m_nCompressionLevel > 0 && !data.empty()) {
+            const uint32_t chunk_count = static_cast<uint32_t>((data.size() + m_nChunkSize - 1) / m_nChunkSize);
+            vector<uint64_t> chunk_offsets(chunk_count + 1);
+            stored.assign(chunk_offsets.size() * sizeof(uint64_t), 0);
+            for (uint32_t c = 0; c < chunk_count; c++) {
+                chunk_offsets[c] = stored.size();
+                const uint8_t* chunk = data.data() + static_cast<size_t>(c) * m_nChunkSize;
+                const size_t chunk_size = min(static_cast<size_t>(m_nChunkSize), data.size() - static_cast<size_t>(c) * m_nChunkSize);
+
+                uLongf compressed_size = compressBound(static_cast<uLong>(chunk_size));
+                compressed.resize(compressed_size);
+                if (compress2(compressed.data(), &compressed_size, chunk, static_cast<uLong>(chunk_size), m_nCompressionLevel) == Z_OK
+                        && compressed_size < chunk_size) {
+                    stored.insert(stored.end(), compressed.begin(), compressed.begin() + compressed_size);
+                } else {
+                    stored.insert(stored.end(), chunk, chunk + chunk_size);
+                }
+            }
+            chunk_offsets[chunk_count] = stored.size();
+            memcpy(stored.data(), chunk_offsets.data(), chunk_offsets.size() * sizeof(uint64_t));
+
+            // not worth inflating, e.g. PNG or JPEG files
+            if (stored.size() < data.size()) entry.ChunkCount = chunk_count;
+        }
+
+        ok = padToAlignment(fp, position);
+        entry.DataOffset = position;
+        if (entry.ChunkCount) {
+            entry.StoredSize = stored.size();
+            ok = ok && writeAt(fp, position, stored.data(), stored.size());
+        } else {
+            entry.StoredSize = data.size();
+            ok = ok && writeAt(fp, position, data.data(), data.size());
+        }
+        entries.push_back(entry);
+    }
+
+    // the index is sorted by hash for the binary search
+    sort(entries.begin(), entries.end(), [](const ASSET_PACK_ENTRY& a, const ASSET_PACK_ENTRY& b) {
+        return a.NameHash < b.NameHash;
+    });
+    for (size_t i = 1; ok && i < entries.size(); i++) {
+        const ASSET_PACK_ENTRY& a = entries[i - 1];
+        const ASSET_PACK_ENTRY& b = entries[i];
+        if (a.NameHash == b.NameHash && a.NameLength == b.NameLength
+                && names.compare(a.NameOffset, a.NameLength, names, b.NameOffset, b.NameLength) == 0) {
+            fprintf(stderr, "Asset '%s' is added twice\n", names.substr(a.NameOffset, a.NameLength).c_str());
+            ok = false;
+        }
+    }
+
+    header.IndexOffset = position;
+    ok = ok && writeAt(fp, position, entries.data(), entries.size() * sizeof(ASSET_PACK_ENTRY));
+    header.NamesOffset = position;
+    header.NamesSize = names.size();
+    ok = ok && writeAt(fp, position, names.data(), names.size());
+
+    ok = ok && seekTo(fp, 0) == 0 && fwrite(&header, sizeof(header), 1, fp) == 1;
+    ok = (fclose(fp) == 0) && ok;
+
+    if (!ok) {
+        fprintf(stderr, "Error writing asset pack '%s'\n", path);
+        remove(path);
+    }
+
+    return ok;
+}
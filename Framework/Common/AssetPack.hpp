@@ -0,0 +1,135 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Buffer.hpp"
+
+namespace My {
+    class AssetLoader;
+
+    // an asset pack holds many assets in one file:
+    //
+    //   header | entry data, each starting at a 4 KiB boundary | index | names
+    //
+    // the index is sorted by the hash of the asset names, an asset is found
+    // with a binary search. uncompressed entries can be mapped straight from
+    // the file, from the mapping boundary of the platform below them. compressed
+    // entries are split into chunks of ChunkSize bytes which are deflated on
+    // their own, so any range of an entry can be inflated without the chunks
+    // before it and large entries are inflated on several threads. a compressed entry starts with ChunkCount + 1
+    // chunk offsets, relative to the entry, and a chunk which does not
+    // shrink is stored as is.
+#pragma pack(push, 1)
+    typedef struct _ASSET_PACK_HEADER {
+        char     Magic[4];      // "GEPK"
+        uint32_t Version;
+        uint32_t EntryCount;
+        uint32_t ChunkSize;
+        uint64_t IndexOffset;   // EntryCount entries
+        uint64_t NamesOffset;
+        uint64_t NamesSize;
+    } ASSET_PACK_HEADER;
+
+    typedef struct _ASSET_PACK_ENTRY {
+        uint64_t NameHash;
+        uint32_t NameOffset;    // into the names, which are not terminated
+        uint32_t NameLength;
+        uint64_t DataOffset;
+        uint64_t Size;          // of the asset
+        uint64_t StoredSize;    // in the pack
+        uint32_t ChunkCount;    // 0 if the entry is not compressed
+        uint32_t Reserved;
+    } ASSET_PACK_ENTRY;
+#pragma pack(pop)
+
+    static const uint32_t kAssetPackVersion = 1;
+    static const uint64_t kAssetPackAlignment = 4096;
+    static const uint32_t kAssetPackDefaultChunkSize = 64 * 1024;
+
+    // 64 bit FNV-1a
+    inline uint64_t AssetPackHash(const char* name, const size_t length)
+    {
+        uint64_t hash = 0xcbf29ce484222325ull;
+        for (size_t i = 0; i < length; i++) {
+            hash ^= static_cast<uint8_t>(name[i]);
+            hash *= 0x100000001b3ull;
+        }
+        return hash;
+    }
+
+    class AssetPack
+    {
+    public:
+        AssetPack() = default;
+        AssetPack(const AssetPack&) = delete;
+        AssetPack& operator=(const AssetPack&) = delete;
+        ~AssetPack() { Close(); }
+
+        // reads the header and the index, the file stays open for the entries
+        bool Open(const char* path);
+        void Close();
+
+        const std::string& GetPath() const { return m_Path; }
+        size_t GetEntryCount() const { return m_Entries.size(); }
+        bool Contains(const char* name) const { return find(name) != nullptr; }
+
+        // false if the pack has no such asset. uncompressed assets are
+        // mapped where the platform allows it. text adds a terminating 0
+        bool Read(const char* name, Buffer& buf, bool text = false) const;
+
+        // length bytes of the asset from offset, only the chunks which cover
+        // them are inflated
+        bool ReadRange(const char* name, size_t offset, size_t length, Buffer& buf) const;
+
+        // the chunks of large entries are inflated on the I/O threads of
+        // loader as well as the calling thread. without one, or when not
+        // multithreaded, only the calling thread inflates
+        void SetIoThreads(AssetLoader* loader) { m_pIoThreads = loader; }
+        void SetMultithreaded(bool multithreaded) { m_bMultithreaded = multithreaded; }
+
+    protected:
+        // below this many chunks the helpers cost more than they save
+        static const uint32_t kMinChunksForThreading = 8;
+
+        const ASSET_PACK_ENTRY* find(const char* name) const;
+        bool readStored(uint64_t offset, size_t size, uint8_t* dest) const;
+        bool readEntry(const ASSET_PACK_ENTRY& entry, size_t offset, size_t length, uint8_t* dest) const;
+
+        std::string m_Path;
+        FILE* m_pFile = nullptr;
+        ASSET_PACK_HEADER m_Header;
+        std::vector<ASSET_PACK_ENTRY> m_Entries;
+        std::vector<char> m_Names;
+        std::atomic<AssetLoader*> m_pIoThreads{nullptr};
+        std::atomic<bool> m_bMultithreaded{true};
+        mutable std::mutex m_FileMutex;
+    };
+
+    // builds a pack out of files on disk, they are read one at a time while
+    // the pack is written
+    class AssetPackWriter
+    {
+    public:
+        // name is what the asset is loaded as, path the file it comes from
+        void AddFile(const std::string& name, const std::string& path) { m_Files.push_back({ name, path }); }
+
+        // 0 stores the assets uncompressed, 1 to 9 as for zlib
+        void SetCompressionLevel(int level) { m_nCompressionLevel = level; }
+        void SetChunkSize(uint32_t size) { m_nChunkSize = size ? size : kAssetPackDefaultChunkSize; }
+
+        bool Write(const char* path) const;
+
+    protected:
+        struct SourceFile {
+            std::string name;
+            std::string path;
+        };
+
+        std::vector<SourceFile> m_Files;
+        int m_nCompressionLevel = 6;
+        uint32_t m_nChunkSize = kAssetPackDefaultChunkSize;
+    };
+}
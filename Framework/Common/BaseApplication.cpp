@@ -1,6 +1,7 @@
 #include "BaseApplication.hpp"
 #include <iostream>
 #include <cassert>
+#include "geommath.hpp"
 
 using namespace My;
 using namespace std;
@@ -18,6 +19,8 @@ int BaseApplication::Initialize()
     int ret = 0;
 
     cout << m_Config;
+    cout << "GeomMath SIMD Target: " << GetSimdTargetName()
+         << " (" << GetSimdWidth() << " lanes)" << endl;
 
 	return ret;
 }
@@ -11,6 +11,11 @@ namespace My {
 
         Buffer(size_t size, size_t alignment = 4) : m_szSize(size) { m_pData = reinterpret_cast<uint8_t*>(new uint8_t[size]); }
 
+        // memory which was not allocated by new[], e.g. a mapped file. release
+        // is called with the data and the size when the buffer lets go of it
+        typedef void (*ReleaseFunc)(uint8_t* data, size_t size);
+        Buffer(uint8_t* data, size_t size, ReleaseFunc release) : m_pData(data), m_szSize(size), m_pRelease(release) {}
+
         Buffer(const Buffer& rhs) { 
             m_pData = reinterpret_cast<uint8_t*>(new uint8_t[rhs.m_szSize]); 
             memcpy(m_pData, rhs.m_pData, rhs.m_szSize);
@@ -20,16 +25,21 @@ namespace My {
         Buffer(Buffer&& rhs) {
             m_pData = rhs.m_pData;
             m_szSize = rhs.m_szSize;
+            m_pRelease = rhs.m_pRelease;
             rhs.m_pData = nullptr;
             rhs.m_szSize = 0;
+            rhs.m_pRelease = nullptr;
         }
 
         Buffer& operator = (const Buffer& rhs) { 
-            if (m_szSize >= rhs.m_szSize) {
+            if (this == &rhs) return *this;
+            // memory of a release function, e.g. a copy on write mapping of
+            // a file, is never written to but replaced by memory of our own
+            if (!m_pRelease && m_szSize >= rhs.m_szSize) {
                 memcpy(m_pData, rhs.m_pData, rhs.m_szSize);
             } 
             else {
-                if (m_pData) delete[] m_pData; 
+                release();
                 m_pData = reinterpret_cast<uint8_t*>(new uint8_t[rhs.m_szSize]); 
                 memcpy(m_pData, rhs.m_pData, rhs.m_szSize);
                 m_szSize =  rhs.m_szSize;
@@ -38,23 +48,37 @@ namespace My {
         }
 
         Buffer& operator = (Buffer&& rhs) { 
-            if (m_pData) delete[] m_pData; 
+            if (this == &rhs) return *this;
+            release();
             m_pData = rhs.m_pData;
             m_szSize = rhs.m_szSize;
+            m_pRelease = rhs.m_pRelease;
             rhs.m_pData = nullptr;
             rhs.m_szSize = 0;
+            rhs.m_pRelease = nullptr;
             return *this; 
         }
 
-        ~Buffer() { if (m_pData) delete[] m_pData; m_pData = nullptr; }
+        ~Buffer() { release(); }
 
         uint8_t* GetData(void) { return m_pData; };
         const uint8_t* GetData(void) const { return m_pData; };
         size_t GetDataSize(void) const { return m_szSize; };
 
     protected:
+        void release()
+        {
+            if (m_pData) {
+                if (m_pRelease) m_pRelease(m_pData, m_szSize);
+                else delete[] m_pData;
+            }
+            m_pData = nullptr;
+            m_pRelease = nullptr;
+        }
+
         uint8_t* m_pData;
         size_t m_szSize;
+        ReleaseFunc m_pRelease = nullptr;
     };
 }
 
@@ -1,202 +1,285 @@
-#include <memory>
+#pragma once
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
 #include <vector>
 #include "portable.hpp"
 
 namespace My {
-    template<typename T>
-    class HuffmanNode {
+    // MSB first bit reader with a 64 bit buffer. bits are consumed from the top
+    // of the buffer, which is refilled several bytes at a time. reading past the
+    // end of the stream returns zero bits and marks the reader as overrun.
+    class BitReader {
         protected:
-            T m_Value;
-            std::shared_ptr<HuffmanNode<T>> m_pLeft;
-            std::shared_ptr<HuffmanNode<T>> m_pRight;
-            bool m_isLeaf = false;
-        public:
-            HuffmanNode() = default;
-            HuffmanNode(T value) : m_Value(value), m_isLeaf(true) {};
-            ~HuffmanNode() = default;
-            HuffmanNode(HuffmanNode&) = default;
-            HuffmanNode(HuffmanNode&&) = default;
-            HuffmanNode& operator=(HuffmanNode&) = default;
-            HuffmanNode& operator=(HuffmanNode&&) = default;
-            bool IsLeaf(void) const { return m_isLeaf; };
-            void SetLeft(std::shared_ptr<HuffmanNode> pNode) { m_pLeft = pNode; };
-            void SetRight(std::shared_ptr<HuffmanNode> pNode) { m_pRight = pNode; };
-            const std::shared_ptr<HuffmanNode<T>> GetLeft(void) const { return m_pLeft; };
-            const std::shared_ptr<HuffmanNode<T>> GetRight(void) const { return m_pRight; };
-            void SetValue(T value) { m_Value = value; m_isLeaf = true; };
-            T GetValue() const { return m_Value; };
-    };
+            const uint8_t* m_pData;
+            const uint8_t* m_pDataBegin;
+            const uint8_t* m_pDataEnd;
+            uint64_t m_nBitBuffer = 0;  // left aligned
+            int32_t  m_nBitCount = 0;   // valid bits in m_nBitBuffer
+            int32_t  m_nPaddingBits = 0; // zero bits appended after the end of stream
 
-    template<typename T>
-    class HuffmanTree {
-        protected:
-            std::shared_ptr<HuffmanNode<T>> m_pRoot;
+        public:
+            BitReader(const uint8_t* data, const size_t size)
+                : m_pData(data), m_pDataBegin(data), m_pDataEnd(data + size) {};
 
-        private:
-            void recursiveDump(const std::shared_ptr<HuffmanNode<T>>& pNode, std::string bit_stream)
+            // make sure there are at least 57 bits in the buffer
+            inline void Refill()
             {
-                if (pNode) {
-                    if (pNode->IsLeaf()) {
-                        printf("%20s | %x\n", bit_stream.c_str(), pNode->GetValue());
-                    } else {
-                        recursiveDump(pNode->GetLeft(), bit_stream + "0");
-                        recursiveDump(pNode->GetRight(), bit_stream + "1");
+                if (m_nBitCount > 56) return;
+
+                if (m_pDataEnd - m_pData >= 8)
+                {
+                    // bulk path, load 8 bytes and keep as many whole bytes as fit
+                    uint64_t next;
+                    std::memcpy(&next, m_pData, sizeof(next));
+                    next = endian_net_unsigned_int(next);
+                    int32_t bytes = (63 - m_nBitCount) >> 3;
+                    m_nBitBuffer |= (next >> m_nBitCount) & ~(~0ull >> (m_nBitCount + (bytes << 3)));
+                    m_pData += bytes;
+                    m_nBitCount += bytes << 3;
+                }
+                else
+                {
+                    while (m_nBitCount <= 56)
+                    {
+                        uint64_t byte = 0;
+                        if (m_pData < m_pDataEnd) {
+                            byte = *m_pData++;
+                        } else {
+                            m_nPaddingBits += 8;
+                        }
+                        m_nBitBuffer |= byte << (56 - m_nBitCount);
+                        m_nBitCount += 8;
                     }
                 }
             }
 
-        public:
-            HuffmanTree() { m_pRoot = std::make_shared<HuffmanNode<uint8_t>>(); };
+            // n must be in [1, 32] and no more than the bits in the buffer
+            inline uint32_t PeekBits(const int32_t n) const
+            {
+                assert(n > 0 && n <= 32 && n <= m_nBitCount);
+                return static_cast<uint32_t>(m_nBitBuffer >> (64 - n));
+            }
 
-            size_t PopulateWithHuffmanTable(const uint8_t num_of_codes[16], const uint8_t* code_values)
+            inline void SkipBits(const int32_t n)
             {
-                int num_symbo = 0;
-                for (int i = 0; i < 16; i++)
-                {
-                    num_symbo += num_of_codes[i];
-                }
-                const uint8_t* pCodeValueEnd = code_values + num_symbo - 1;
+                assert(n <= m_nBitCount);
+                m_nBitBuffer <<= n;
+                m_nBitCount -= n;
+            }
+
+            inline uint32_t GetBits(const int32_t n)
+            {
+                if (n == 0) return 0;
+                if (m_nBitCount < n) Refill();
+                uint32_t result = PeekBits(n);
+                SkipBits(n);
+                return result;
+            }
 
-                std::queue<std::shared_ptr<HuffmanNode<uint8_t>>> node_queue;
-                bool found_bottom = false;
+            inline int32_t GetBitCount() const { return m_nBitCount; }
 
-                for (int i = 15; i >= 0; i--) {
-                    int l = num_of_codes[i];
-                    if (!found_bottom)
-                    {
-                        if (l == 0)
-                        {
-                            // simply move to upper layer
-                            continue;
-                        } else {
-                            found_bottom = true;
-                        }
-                    }
+            // skip the remaining bits of the current byte
+            inline void AlignToByte()
+            {
+                SkipBits(m_nBitCount & 0x7);
+            }
+
+            // number of bytes consumed so far, bytes sitting in the buffer are not counted
+            inline size_t GetBytePosition() const
+            {
+                return (m_pData - m_pDataBegin) - ((m_nBitCount - m_nPaddingBits) >> 3);
+            }
 
-                    auto childrenCount = node_queue.size();
+            // true if more bits were consumed than the stream contains
+            inline bool IsOverrun() const
+            {
+                return m_nPaddingBits > m_nBitCount;
+            }
+    };
 
-                    if(l) {
-                        // create leaf node for level i
-                        pCodeValueEnd = pCodeValueEnd - l;
-                            const uint8_t* pCodeValue = pCodeValueEnd + 1;
+    // canonical Huffman decoder (ITU-T81 Annex C). codes up to kLookupBits
+    // long are decoded with a single table lookup, longer codes fall back to
+    // the code length limits of ITU-T81 F.2.2.3.
+    template<typename T>
+    class HuffmanTree {
+        public:
+            static const int32_t kLookupBits = 9;
+            static const int32_t kMaxCodeLength = 16;
 
-                        for (int j = 0; j < l; j++) {
-                            auto pNode = std::make_shared<HuffmanNode<uint8_t>>(*pCodeValue++);
-                            node_queue.push(pNode);
-                        }
-                    }
+        protected:
+            uint8_t  m_LookupLength[1 << kLookupBits]; // 0 means the code is longer than kLookupBits
+            T        m_LookupValue[1 << kLookupBits];
+            int32_t  m_MaxCode[kMaxCodeLength + 1];    // largest code of each length, -1 if none
+            int32_t  m_ValueOffset[kMaxCodeLength + 1];
+            uint8_t  m_NumOfCodes[kMaxCodeLength + 1];
+            T        m_Values[256];
+            int32_t  m_nNumOfSymbols = 0;
 
-                    // create non-leaf node and append children
-                    while (childrenCount > 0) {
-                        auto pNode = std::make_shared<HuffmanNode<uint8_t>>();
-                        auto pLeftNode = node_queue.front();
-                        node_queue.pop();
-                        pNode->SetLeft(pLeftNode);
-                        childrenCount--;
+        public:
+            HuffmanTree()
+            {
+                std::memset(m_LookupLength, 0x00, sizeof(m_LookupLength));
+                std::memset(m_NumOfCodes, 0x00, sizeof(m_NumOfCodes));
+                for (int32_t l = 0; l <= kMaxCodeLength; l++) m_MaxCode[l] = -1;
+            };
 
-                        if (childrenCount > 0)
+            // code_values holds code_size bytes. returns the number of symbols,
+            // or 0 and an empty tree if the table is corrupt: more than 256
+            // symbols, more than code_size values or more codes of a length
+            // than there are codes of that length
+            size_t PopulateWithHuffmanTable(const uint8_t num_of_codes[16], const uint8_t* code_values, const size_t code_size)
+            {
+                std::memset(m_LookupLength, 0x00, sizeof(m_LookupLength));
+                std::memset(m_NumOfCodes, 0x00, sizeof(m_NumOfCodes));
+                for (int32_t l = 0; l <= kMaxCodeLength; l++) m_MaxCode[l] = -1;
+                m_nNumOfSymbols = 0;
+
+                int32_t num_symbo = 0;
+                int32_t code = 0;
+                for (int32_t l = 1; l <= kMaxCodeLength; l++)
+                {
+                    num_symbo += num_of_codes[l - 1];
+                    code += num_of_codes[l - 1];
+                    if (code > (1 << l)) return 0;
+                    code <<= 1;
+                }
+                if (num_symbo == 0 || num_symbo > 256 || static_cast<size_t>(num_symbo) > code_size) return 0;
+
+                num_symbo = 0;
+                code = 0;
+                for (int32_t l = 1; l <= kMaxCodeLength; l++)
+                {
+                    int32_t count = num_of_codes[l - 1];
+                    m_NumOfCodes[l] = static_cast<uint8_t>(count);
+                    m_ValueOffset[l] = num_symbo - code;
+
+                    for (int32_t i = 0; i < count; i++)
+                    {
+                        T value = static_cast<T>(code_values[num_symbo]);
+                        m_Values[num_symbo] = value;
+
+                        if (l <= kLookupBits)
                         {
-                            auto pRightNode = node_queue.front();
-                            node_queue.pop();
-                            pNode->SetRight(pRightNode);
-                            childrenCount--;
+                            // every index which starts with this code decodes to value
+                            int32_t shift = kLookupBits - l;
+                            int32_t first = code << shift;
+                            for (int32_t j = 0; j < (1 << shift); j++)
+                            {
+                                m_LookupLength[first + j] = static_cast<uint8_t>(l);
+                                m_LookupValue[first + j] = value;
+                            }
                         }
 
-                        node_queue.push(pNode);
+                        num_symbo++;
+                        code++;
                     }
-                }
 
-                // now append to the root node
-                assert(node_queue.size() <= 2 && node_queue.size() > 0);
-                auto pLeftNode = node_queue.front();
-                node_queue.pop();
-                m_pRoot->SetLeft(pLeftNode);
-                if (!node_queue.empty())
-                {
-                    auto pRightNode = node_queue.front();
-                    node_queue.pop();
-                    m_pRoot->SetRight(pRightNode);
+                    m_MaxCode[l] = count ? code - 1 : -1;
+                    code <<= 1;
                 }
 
+                m_nNumOfSymbols = num_symbo;
+
                 return num_symbo;
             }
 
-            T DecodeSingleValue(const uint8_t* encoded_stream, const size_t encoded_stream_length,
-                    size_t* byte_offset, uint8_t* bit_offset)
+            // true if the tree was populated from exactly this table, files
+            // written by the same encoder mostly carry the same tables
+            bool IsBuiltFrom(const uint8_t num_of_codes[16], const uint8_t* code_values, const size_t code_size) const
             {
-                T res = 0;
-                std::shared_ptr<HuffmanNode<T>> pNode = m_pRoot;
-                for (size_t i = *byte_offset; i < encoded_stream_length; i++)
+                if (m_nNumOfSymbols == 0) return false;
+                int32_t num_symbo = 0;
+                for (int32_t l = 1; l <= kMaxCodeLength; l++)
                 {
-                    uint8_t data = encoded_stream[i];
-                    for (int j = *bit_offset; j < 8; j++)
-                    {
-                        uint8_t bit = (data & (0x1 << (7 - j))) >> (7 - j);
-                        if (bit == 0) { // left child
-                            pNode = pNode->GetLeft();
-                        } else {                     // right child
-                            pNode = pNode->GetRight();
-                        }
+                    if (m_NumOfCodes[l] != num_of_codes[l - 1]) return false;
+                    num_symbo += num_of_codes[l - 1];
+                }
+                if (static_cast<size_t>(num_symbo) > code_size) return false;
+                for (int32_t i = 0; i < num_symbo; i++)
+                {
+                    if (m_Values[i] != static_cast<T>(code_values[i])) return false;
+                }
+                return true;
+            }
 
-                        assert(pNode);
+            // corrupt is set, and 0 returned, when the bits are no code of the tree
+            template <typename Reader>
+            inline T DecodeSingleValue(Reader& reader, bool& corrupt) const
+            {
+                if (reader.GetBitCount() < kMaxCodeLength) reader.Refill();
 
-                        if (pNode->IsLeaf()) {
-                            // move pointers to next bit
-                            if (j == 7) {
-                                *bit_offset = 0;
-                                *byte_offset = i + 1;
-                            } else {
-                                *bit_offset = j + 1;
-                                *byte_offset = i;
-                            }
-                            res = pNode->GetValue();
-                            return res;
-                        }
+                uint32_t look = reader.PeekBits(kLookupBits);
+                int32_t length = m_LookupLength[look];
+                if (length)
+                {
+                    reader.SkipBits(length);
+                    return m_LookupValue[look];
+                }
+
+                // slow path
+                uint32_t bits = reader.PeekBits(kMaxCodeLength);
+                for (length = kLookupBits + 1; length <= kMaxCodeLength; length++)
+                {
+                    int32_t code = static_cast<int32_t>(bits >> (kMaxCodeLength - length));
+                    if (code <= m_MaxCode[length])
+                    {
+                        reader.SkipBits(length);
+                        return m_Values[m_ValueOffset[length] + code];
                     }
-                    *bit_offset = 0;
                 }
 
-                // decode failed
-                *byte_offset = -1;
-                *bit_offset = -1;
+                // corrupted stream
+                corrupt = true;
+                reader.SkipBits(kMaxCodeLength);
+                return 0;
+            }
 
-                return res;
+            // a code which is not in the tree decodes as 0
+            template <typename Reader>
+            inline T DecodeSingleValue(Reader& reader) const
+            {
+                bool corrupt = false;
+                return DecodeSingleValue(reader, corrupt);
             }
 
-            std::vector<T> Decode(const uint8_t* encoded_stream, const size_t encoded_stream_length)
+            std::vector<T> Decode(const uint8_t* encoded_stream, const size_t encoded_stream_length) const
             {
                 std::vector<T> res;
-                std::shared_ptr<HuffmanNode<T>> pNode = m_pRoot;
-                for (size_t i = 0; i < encoded_stream_length; i++)
+                BitReader reader(encoded_stream, encoded_stream_length);
+                reader.Refill();
+                bool corrupt = false;
+                while (true)
                 {
-                    uint8_t data = encoded_stream[i];
-                    for (int j = 0; j < 8; j++)
-                    {
-                        uint8_t bit = (data & (0x1 << (7 - j))) >> (7 - j);
-                        if (bit == 0) { // left child
-                            pNode = pNode->GetLeft();
-                        } else {                     // right child
-                            pNode = pNode->GetRight();
-                        }
-
-                        assert(pNode);
-
-                        if (pNode->IsLeaf()) {
-                            res.push_back(pNode->GetValue());
-                            pNode = m_pRoot;
-                        }
-                    }
+                    T value = DecodeSingleValue(reader, corrupt);
+                    if (corrupt || reader.IsOverrun()) break;
+                    res.push_back(value);
                 }
 
                 return res;
             }
 
-            void Dump()
+            void Dump() const
             {
-                std::string bit_stream;
-                recursiveDump(m_pRoot, bit_stream);
+                int32_t code = 0;
+                int32_t index = 0;
+                for (int32_t l = 1; l <= kMaxCodeLength; l++)
+                {
+                    for (int32_t i = 0; i < m_NumOfCodes[l]; i++)
+                    {
+                        std::string bit_stream;
+                        for (int32_t b = l - 1; b >= 0; b--)
+                        {
+                            bit_stream += ((code >> b) & 0x1) ? "1" : "0";
+                        }
+                        printf("%20s | %x\n", bit_stream.c_str(), m_Values[index++]);
+                        code++;
+                    }
+                    code <<= 1;
+                }
                 std::cout << std::endl;
             }
     };
 }
-
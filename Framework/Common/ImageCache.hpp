@@ -0,0 +1,341 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Buffer.hpp"
+#include "Image.hpp"
+
+namespace My {
+    // decoded images shared by every texture which loads the same file.
+    // an image is found by the canonical form of its name, or failing that
+    // by the content of the file, so the same file under two names or two
+    // copies of one file are decoded once. files are looked up by the hash
+    // of their content and told apart by their size and a second, independent
+    // hash, so an image does not keep the file it was decoded from. the cache only
+    // holds weak references to the images, plus strong ones to the most
+    // recently used images up to a byte budget of decoded data, so images
+    // which go out of use stay around for a while in case they are loaded
+    // again
+    class ImageCache
+    {
+    public:
+        typedef std::function<Buffer()> ReadFunc;
+        typedef std::function<Image(Buffer&)> DecodeFunc;
+
+        struct Stats {
+            uint64_t hits = 0;      // found by name or content
+            uint64_t misses = 0;    // decoded
+            size_t retained_bytes = 0;
+            size_t retained_count = 0;
+        };
+
+        static const size_t kDefaultByteBudget = 256 * 1024 * 1024;
+
+        explicit ImageCache(size_t byte_budget = kDefaultByteBudget) : m_nByteBudget(byte_budget) {}
+        ImageCache(const ImageCache&) = delete;
+        ImageCache& operator=(const ImageCache&) = delete;
+
+        // '\' to '/', no "." segments and ".." folded into the segment before
+        static std::string CanonicalName(const std::string& name)
+        {
+            std::vector<std::string> segments;
+            size_t begin = 0;
+            while (begin <= name.size())
+            {
+                size_t end = name.find_first_of("/\\", begin);
+                if (end == std::string::npos) end = name.size();
+                const std::string segment = name.substr(begin, end - begin);
+                if (segment == "..")
+                {
+                    if (!segments.empty() && segments.back() != "..") segments.pop_back();
+                    else segments.push_back(segment);
+                }
+                else if (!segment.empty() && segment != ".")
+                {
+                    segments.push_back(segment);
+                }
+                begin = end + 1;
+            }
+
+            std::string result;
+            for (const auto& segment : segments)
+            {
+                if (!result.empty()) result += '/';
+                result += segment;
+            }
+            return result;
+        }
+
+        // 64 bit FNV-1a
+        static uint64_t ContentHash(const Buffer& buf)
+        {
+            uint64_t value = 0xCBF29CE484222325ull;
+            const uint8_t* pData = buf.GetData();
+            const size_t size = buf.GetDataSize();
+            for (size_t i = 0; i < size; i++)
+            {
+                value = (value ^ pData[i]) * 0x100000001B3ull;
+            }
+            return value;
+        }
+
+        // a second 64 bit hash, independent of ContentHash, over 8 byte words
+        // in the manner of MurmurHash3. a file matches a cached one only if
+        // both hashes and the size agree
+        static uint64_t ContentCheck(const Buffer& buf)
+        {
+            const uint8_t* pData = buf.GetData();
+            const size_t size = buf.GetDataSize();
+            uint64_t value = size * 0x9E3779B97F4A7C15ull;
+            size_t i = 0;
+            for (; i + 8 <= size; i += 8)
+            {
+                uint64_t word;
+                std::memcpy(&word, pData + i, sizeof(word));
+                value = mixWord(value, word);
+            }
+            uint64_t tail = 0;
+            for (; i < size; i++) tail = (tail << 8) | pData[i];
+            value = mixWord(value, tail);
+
+            value ^= value >> 30;
+            value *= 0xBF58476D1CE4E5B9ull;
+            value ^= value >> 27;
+            value *= 0x94D049BB133111EBull;
+            value ^= value >> 31;
+            return value;
+        }
+
+        // the image of name. read is only called if no image of that name is
+        // alive, decode only if none of the same content is either. images
+        // which fail to decode are not cached. the data of a cached image is
+        // freed with delete[] once the last reference goes away
+        std::shared_ptr<Image> Load(const std::string& name, const ReadFunc& read, const DecodeFunc& decode)
+        {
+            const std::string canonical = CanonicalName(name);
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                auto it = m_Names.find(canonical);
+                if (it != m_Names.end())
+                {
+                    std::shared_ptr<Cached> cached = it->second.cached.lock();
+                    if (cached)
+                    {
+                        m_Stats.hits++;
+                        return use(it->second.hash, cached);
+                    }
+                }
+            }
+
+            Buffer buf = read();
+            const uint64_t hash = ContentHash(buf);
+            const uint64_t check = ContentCheck(buf);
+            const size_t size = buf.GetDataSize();
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                std::shared_ptr<Cached> cached = find(hash, size, check);
+                if (cached)
+                {
+                    m_Names[canonical] = { hash, cached };
+                    m_Stats.hits++;
+                    return use(hash, cached);
+                }
+            }
+
+            Image decoded = decode(buf);
+            if (!decoded.data)
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                m_Stats.misses++;
+                return std::make_shared<Image>(decoded);
+            }
+
+            std::shared_ptr<Cached> cached = std::make_shared<Cached>();
+            cached->image = decoded;
+            cached->source_size = size;
+            cached->source_check = check;
+
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Stats.misses++;
+            // another thread decoded the same file meanwhile, ours goes away
+            std::shared_ptr<Cached> existing = find(hash, size, check);
+            if (existing)
+            {
+                m_Names[canonical] = { hash, existing };
+                return use(hash, existing);
+            }
+
+            purgeExpired();
+            m_Names[canonical] = { hash, cached };
+            Entry& entry = m_Entries[hash];
+            // a live file of the same hash keeps the entry, this one is
+            // only shared by name
+            if (entry.cached.expired())
+            {
+                entry.cached = cached;
+                entry.retained = false;
+            }
+            return use(hash, cached);
+        }
+
+        // evicts least recently used images until the retained ones fit
+        void SetByteBudget(size_t byte_budget)
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_nByteBudget = byte_budget;
+            evict();
+        }
+
+        // forget every image, e.g. after the way textures are decoded changed.
+        // images still in use elsewhere stay valid
+        void Clear()
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Recent.clear();
+            m_Entries.clear();
+            m_Names.clear();
+            m_Stats.retained_bytes = 0;
+            m_Stats.retained_count = 0;
+        }
+
+        Stats GetStats() const
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            return m_Stats;
+        }
+
+        void ResetStats()
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Stats.hits = 0;
+            m_Stats.misses = 0;
+        }
+
+    protected:
+        // the images handed out share ownership of this
+        struct Cached {
+            Image image;
+            size_t source_size = 0;     // of the file, with its ContentCheck
+            uint64_t source_check = 0;  // to tell files of the same hash apart
+            Cached() = default;
+            Cached(const Cached&) = delete;
+            Cached& operator=(const Cached&) = delete;
+            ~Cached() { delete[] image.data; }
+        };
+
+        struct Retained {
+            uint64_t hash;
+            std::shared_ptr<Cached> cached;
+        };
+
+        struct Entry {
+            std::weak_ptr<Cached> cached;
+            bool retained = false;
+            std::list<Retained>::iterator recent;
+        };
+
+        struct Name {
+            uint64_t hash;
+            std::weak_ptr<Cached> cached;
+        };
+
+        static uint64_t rotateLeft(uint64_t value, int bits)
+        {
+            return (value << bits) | (value >> (64 - bits));
+        }
+
+        static uint64_t mixWord(uint64_t value, uint64_t word)
+        {
+            word *= 0x87C37B91114253D5ull;
+            word = rotateLeft(word, 31);
+            word *= 0x4CF5AD432745937Full;
+            value ^= word;
+            return rotateLeft(value, 27) * 5 + 0x52DCE729;
+        }
+
+        // the live image decoded from a file of the same hashes and size.
+        // m_Mutex is held
+        std::shared_ptr<Cached> find(uint64_t hash, size_t size, uint64_t check)
+        {
+            auto it = m_Entries.find(hash);
+            if (it == m_Entries.end()) return nullptr;
+            std::shared_ptr<Cached> cached = it->second.cached.lock();
+            if (!cached || cached->source_size != size || cached->source_check != check) return nullptr;
+            return cached;
+        }
+
+        // the image of cached, which moves to the front of the recently used
+        // ones if it is the one cached for its hash. m_Mutex is held
+        std::shared_ptr<Image> use(uint64_t hash, const std::shared_ptr<Cached>& cached)
+        {
+            auto it = m_Entries.find(hash);
+            if (it != m_Entries.end() && it->second.cached.lock() == cached) retain(hash, it->second, cached);
+            return std::shared_ptr<Image>(cached, &cached->image);
+        }
+
+        void retain(uint64_t hash, Entry& entry, const std::shared_ptr<Cached>& cached)
+        {
+            if (entry.retained)
+            {
+                m_Recent.splice(m_Recent.begin(), m_Recent, entry.recent);
+                return;
+            }
+
+            // larger than the whole budget, only kept while in use
+            if (cached->image.data_size > m_nByteBudget) return;
+
+            m_Recent.push_front({ hash, cached });
+            entry.recent = m_Recent.begin();
+            entry.retained = true;
+            m_Stats.retained_bytes += cached->image.data_size;
+            m_Stats.retained_count++;
+            evict();
+        }
+
+        void evict()
+        {
+            while (m_Stats.retained_bytes > m_nByteBudget && !m_Recent.empty())
+            {
+                const Retained& last = m_Recent.back();
+                m_Entries[last.hash].retained = false;
+                m_Stats.retained_bytes -= last.cached->image.data_size;
+                m_Stats.retained_count--;
+                m_Recent.pop_back();
+            }
+        }
+
+        // drops entries of images which are gone, once there are twice as
+        // many entries as after the last time
+        void purgeExpired()
+        {
+            if (m_Entries.size() < m_nPurgeThreshold) return;
+
+            for (auto it = m_Entries.begin(); it != m_Entries.end();)
+            {
+                if (it->second.cached.expired()) it = m_Entries.erase(it);
+                else it++;
+            }
+            for (auto it = m_Names.begin(); it != m_Names.end();)
+            {
+                if (it->second.cached.expired()) it = m_Names.erase(it);
+                else it++;
+            }
+            m_nPurgeThreshold = std::max<size_t>(64, m_Entries.size() * 2);
+        }
+
+        mutable std::mutex m_Mutex;
+        std::unordered_map<std::string, Name> m_Names;      // by canonical name
+        std::unordered_map<uint64_t, Entry> m_Entries;      // by content hash
+        std::list<Retained> m_Recent;                       // most recently used first
+        size_t m_nByteBudget;
+        size_t m_nPurgeThreshold = 64;
+        Stats m_Stats;
+    };
+}
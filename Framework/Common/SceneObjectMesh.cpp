@@ -15,21 +15,15 @@ BoundingBox SceneObjectMesh::GetBoundingBox() const
             auto data_type = m_VertexArray[n].GetDataType();
             auto vertices_count = m_VertexArray[n].GetVertexCount();	
             auto data = m_VertexArray[n].GetData();
-            for (decltype(vertices_count) i = 0; i < vertices_count; i++)
-            {
-                switch(data_type) {
-                    case VertexDataType::kVertexDataTypeFloat3:
-                    {
-                        const Vector3f* vertex = reinterpret_cast<const Vector3f*>(data) + i;
-                        bbmin[0] = (bbmin[0] < vertex->data[0])? bbmin[0] : vertex->data[0];
-                        bbmin[1] = (bbmin[1] < vertex->data[1])? bbmin[1] : vertex->data[1];
-                        bbmin[2] = (bbmin[2] < vertex->data[2])? bbmin[2] : vertex->data[2];
-                        bbmax[0] = (bbmax[0] > vertex->data[0])? bbmax[0] : vertex->data[0];
-                        bbmax[1] = (bbmax[1] > vertex->data[1])? bbmax[1] : vertex->data[1];
-                        bbmax[2] = (bbmax[2] > vertex->data[2])? bbmax[2] : vertex->data[2];
-                        break;
-                    }
-                    case VertexDataType::kVertexDataTypeDouble3:
+            switch(data_type) {
+                case VertexDataType::kVertexDataTypeFloat3:
+                {
+                    CalculateAabb(vertices_count, reinterpret_cast<const Vector3f*>(data), bbmin, bbmax);
+                    break;
+                }
+                case VertexDataType::kVertexDataTypeDouble3:
+                {
+                    for (decltype(vertices_count) i = 0; i < vertices_count; i++)
                     {
                         const Vector3* vertex = reinterpret_cast<const Vector3*>(data) + i;
                         bbmin[0] = static_cast<float>((bbmin[0] < vertex->data[0])? bbmin[0] : vertex->data[0]);
@@ -38,11 +32,11 @@ BoundingBox SceneObjectMesh::GetBoundingBox() const
                         bbmax[0] = static_cast<float>((bbmax[0] > vertex->data[0])? bbmax[0] : vertex->data[0]);
                         bbmax[1] = static_cast<float>((bbmax[1] > vertex->data[1])? bbmax[1] : vertex->data[1]);
                         bbmax[2] = static_cast<float>((bbmax[2] > vertex->data[2])? bbmax[2] : vertex->data[2]);
-                        break;
                     }
-                    default:
-                        assert(0);
+                    break;
                 }
+                default:
+                    assert(0);
             }
         }
     }
@@ -1,13 +1,11 @@
 #pragma once
 #include "BaseSceneObject.hpp"
 #include "geommath.hpp"
-#include "JPEG.hpp"
-#include "PNG.hpp"
-#include "BMP.hpp"
-#include "TGA.hpp"
-#include "DDS.hpp"
-#include "HDR.hpp"
+#include "ImageParserRegistry.hpp"
 #include "AssetLoader.hpp"
+#include "ImageCache.hpp"
+#include "PixelFormatConversion.hpp"
+#include "TextureCompressor.hpp"
 
 namespace My {
     class SceneObjectTexture : public BaseSceneObject
@@ -18,6 +16,55 @@ namespace My {
             std::shared_ptr<Image> m_pImage;
             std::vector<Matrix4X4f> m_Transforms;
 
+            // the parsers decode straight to the 32/64 bit layouts GPUs support
+            static Image decodeTexture(const std::string& name, Buffer& buf)
+            {
+                // the format comes from the file content, the parsers of this
+                // thread are reused from one texture to the next
+                ImageParserRegistry& registry = ImageParserRegistry::ThreadInstance();
+                const ImageFileFormat format = ImageParserRegistry::DetectFormat(buf);
+                registry.GetParser<HdrParser>(ImageFileFormat::kImageFileFormatHDR)->SetHalfFloatOutput(true);
+                auto decode = [&buf, &registry]() -> Image {
+                    return registry.Parse(buf, ImageOutputFormat::kImageOutputFormatRGBA);
+                };
+
+                Image image;
+                const auto& cache = CompressionCache();
+                if (cache && format != ImageFileFormat::kImageFileFormatDDS && format != ImageFileFormat::kImageFileFormatHDR
+                        && format != ImageFileFormat::kImageFileFormatUnknown)
+                {
+                    image = cache->Load(name, buf, decode);
+                }
+                else
+                {
+                    image = decode();
+                }
+
+                const auto& generator = MipmapGeneration();
+                if (generator && image.mipmap_count == 1 && MipmapGenerator::IsSupported(image))
+                {
+                    Image mipmapped = generator->Generate(image);
+                    delete[] image.data;
+                    image = mipmapped;
+                }
+
+                return image;
+            }
+
+            // textures load on several threads while the cache may be
+            // replaced, so it is only reached through these under the lock
+            static std::shared_ptr<ImageCache>& imageCacheSlot()
+            {
+                static std::shared_ptr<ImageCache> cache = std::make_shared<ImageCache>();
+                return cache;
+            }
+
+            static std::mutex& imageCacheMutex()
+            {
+                static std::mutex mutex;
+                return mutex;
+            }
+
         public:
             SceneObjectTexture() : BaseSceneObject(SceneObjectType::kSceneObjectTypeTexture), m_nTexCoordIndex(0) {};
             SceneObjectTexture(const std::string& name) : BaseSceneObject(SceneObjectType::kSceneObjectTypeTexture), m_Name(name), m_nTexCoordIndex(0) {};
@@ -29,114 +76,110 @@ namespace My {
             void SetName(const std::string& name) { m_Name = name; };
             void SetName(std::string&& name) { m_Name = std::move(name); };
             const std::string& GetName() const { return m_Name; };
+
+            // when set, PNG, JPEG, BMP and TGA textures are BCn compressed at
+            // load time through this on disk cache
+            static std::shared_ptr<TextureCompressionCache>& CompressionCache()
+            {
+                static std::shared_ptr<TextureCompressionCache> cache;
+                return cache;
+            }
+
+            static void SetCompressionCache(const std::shared_ptr<TextureCompressionCache>& cache)
+            {
+                CompressionCache() = cache;
+                const auto image_cache = SharedImageCache();
+                if (image_cache) image_cache->Clear();
+            }
+
+            // when set, textures loaded without mipmaps get them generated
+            // here instead of by the driver
+            static std::shared_ptr<MipmapGenerator>& MipmapGeneration()
+            {
+                static std::shared_ptr<MipmapGenerator> generator;
+                return generator;
+            }
+
+            static void SetMipmapGenerator(const std::shared_ptr<MipmapGenerator>& generator)
+            {
+                MipmapGeneration() = generator;
+                const auto image_cache = SharedImageCache();
+                if (image_cache) image_cache->Clear();
+            }
+
+            // the decoded images of every texture in the process, so materials,
+            // the sky box and the terrain which use the same file share one
+            // image. set to nullptr to decode every texture on its own
+            static std::shared_ptr<ImageCache> SharedImageCache()
+            {
+                std::lock_guard<std::mutex> lock(imageCacheMutex());
+                return imageCacheSlot();
+            }
+
+            static void SetImageCache(const std::shared_ptr<ImageCache>& cache)
+            {
+                std::lock_guard<std::mutex> lock(imageCacheMutex());
+                imageCacheSlot() = cache;
+            }
+
             void LoadTexture() {
                 if (!m_pImage)
                 {
-                    // we should lookup if the texture has been loaded already to prevent
-                    // duplicated load. This could be done in Asset Loader Manager.
-                    Buffer buf = g_pAssetLoader->SyncOpenAndReadBinary(m_Name.c_str());
-                    std::string ext = m_Name.substr(m_Name.find_last_of("."));
-                    if (ext == ".jpg" || ext == ".jpeg")
-                    {
-                        JfifParser jfif_parser;
-                        m_pImage = std::make_shared<Image>(jfif_parser.Parse(buf));
-                    }
-                    else if (ext == ".png")
-                    {
-                        PngParser png_parser;
-                        m_pImage = std::make_shared<Image>(png_parser.Parse(buf));
-                    }
-                    else if (ext == ".bmp")
-                    {
-                        BmpParser bmp_parser;
-                        m_pImage = std::make_shared<Image>(bmp_parser.Parse(buf));
-                    }
-                    else if (ext == ".tga")
-                    {
-                        TgaParser tga_parser;
-                        m_pImage = std::make_shared<Image>(tga_parser.Parse(buf));
-                    }
-                    else if (ext == ".dds")
+                    const std::string& name = m_Name;
+                    auto read = [&name]() -> Buffer {
+                        return g_pAssetLoader->MapFile(name.c_str());
+                    };
+                    auto decode = [&name](Buffer& buf) -> Image {
+                        return decodeTexture(name, buf);
+                    };
+
+                    const auto image_cache = SharedImageCache();
+                    if (image_cache)
                     {
-                        DdsParser dds_parser;
-                        m_pImage = std::make_shared<Image>(dds_parser.Parse(buf));
+                        m_pImage = image_cache->Load(m_Name, read, decode);
                     }
-                    else if (ext == ".hdr")
+                    else
                     {
-                        HdrParser hdr_parser;
-                        m_pImage = std::make_shared<Image>(hdr_parser.Parse(buf));
+                        Buffer buf = read();
+                        m_pImage = std::make_shared<Image>(decode(buf));
                     }
                 }
             }
         
             void AdjustTextureBitcount()
             {
-                // GPU does not support 24bit and 48bit textures, so adjust it
-                if (m_pImage->bitcount == 24)
-                {
-                    // DXGI does not have 24bit formats so we have to extend it to 32bit
-                    uint32_t new_pitch = m_pImage->pitch / 3 * 4;
-                    size_t data_size = new_pitch * m_pImage->Height;
-                    uint8_t* data = new uint8_t[data_size];
-                    uint8_t* buf;
-                    uint8_t* src;
-                    for (uint32_t row = 0; row < m_pImage->Height; row++) {
-                        buf = data + row * new_pitch;
-                        src = m_pImage->data + row * m_pImage->pitch;
-                        for (uint32_t col = 0; col < m_pImage->Width; col++) {
-                            memcpy(buf, src, 3);
-                            memset(buf+3, 0x00, 1);  // set alpha to 0
-                            buf += 4;
-                            src += 3;
-                        }
-                    }
+                // GPU does not support 24bit and 48bit textures, so adjust it.
+                // the parsers already decode to RGBA, this only catches images
+                // which come from somewhere else
+                if (m_pImage->bitcount != 24 && m_pImage->bitcount != 48) return;
 
-                    delete m_pImage->data;
-                    m_pImage->data = data;
-                    m_pImage->data_size = data_size;
-                    m_pImage->pitch = new_pitch;
-                    m_pImage->bitcount = 32;
-                    
-                    // adjust mipmaps
-                    for (uint32_t mip = 0; mip < m_pImage->mipmap_count; mip++)
-                    {
-                        m_pImage->mipmaps[mip].pitch = m_pImage->mipmaps[mip].pitch / 3 * 4;
-                        m_pImage->mipmaps[mip].offset = m_pImage->mipmaps[mip].offset / 3 * 4;
-                        m_pImage->mipmaps[mip].data_size = m_pImage->mipmaps[mip].data_size / 3 * 4;
+                // DXGI does not have 24/48bit formats so we have to extend it to 32/64bit
+                const bool wide = (m_pImage->bitcount == 48);
+                uint32_t new_pitch = m_pImage->pitch / 3 * 4;
+                size_t data_size = new_pitch * m_pImage->Height;
+                uint8_t* data = new uint8_t[data_size];
+                for (uint32_t row = 0; row < m_pImage->Height; row++) {
+                    const uint8_t* src = m_pImage->data + row * m_pImage->pitch;
+                    uint8_t* dest = data + row * new_pitch;
+                    if (wide) {
+                        ExpandRGB16ToRGBA16(src, dest, m_pImage->Width);
+                    } else {
+                        ExpandRGB8ToRGBA8(src, dest, m_pImage->Width);
                     }
                 }
-                else if (m_pImage->bitcount == 48)
-                {
-                    // DXGI does not have 48bit formats so we have to extend it to 64bit
-                    uint32_t new_pitch = m_pImage->pitch / 3 * 4;
-                    size_t data_size = new_pitch * m_pImage->Height;
-                    uint8_t* data = new uint8_t[data_size];
-                    uint8_t* buf;
-                    uint8_t* src;
-                    for (uint32_t row = 0; row < m_pImage->Height; row++) {
-                        buf = data + row * new_pitch;
-                        src = m_pImage->data + row * m_pImage->pitch;
-                        for (uint32_t col = 0; col < m_pImage->Width; col++) {
-                            memcpy(buf, src, 6);
-                            memset(buf+6, 0x00, 2); // set alpha to 0
-                            buf += 8;
-                            src += 6;
-                        }
-                    }
 
-                    delete m_pImage->data;
-                    m_pImage->data = data;
-                    m_pImage->data_size = data_size;
-                    m_pImage->pitch = new_pitch;
-                    m_pImage->bitcount = 64;
-                    
-                    // adjust mipmaps
-                    for (uint32_t mip = 0; mip < m_pImage->mipmap_count; mip++)
-                    {
-                        m_pImage->mipmaps[mip].pitch = m_pImage->mipmaps[mip].pitch / 3 * 4;
-                        m_pImage->mipmaps[mip].offset = m_pImage->mipmaps[mip].offset / 3 * 4;
-                        m_pImage->mipmaps[mip].data_size = m_pImage->mipmaps[mip].data_size / 3 * 4;
-                    }
+                delete[] m_pImage->data;
+                m_pImage->data = data;
+                m_pImage->data_size = data_size;
+                m_pImage->pitch = new_pitch;
+                m_pImage->bitcount = wide ? 64 : 32;
+
+                // adjust mipmaps
+                for (uint32_t mip = 0; mip < m_pImage->mipmap_count; mip++)
+                {
+                    m_pImage->mipmaps[mip].pitch = m_pImage->mipmaps[mip].pitch / 3 * 4;
+                    m_pImage->mipmaps[mip].offset = m_pImage->mipmaps[mip].offset / 3 * 4;
+                    m_pImage->mipmaps[mip].data_size = m_pImage->mipmaps[mip].data_size / 3 * 4;
                 }
             }
 
@@ -0,0 +1,416 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Buffer.hpp"
+#include "Image.hpp"
+#include "BlockCompression.hpp"
+#include "MipmapGeneration.hpp"
+#include "PixelFormatConversion.hpp"
+#include "DDS.hpp"
+
+namespace My {
+    enum class TextureCompressionFormat {
+        kTextureCompressionFormatBC1,   // opaque colour
+        kTextureCompressionFormatBC3,   // colour and alpha
+        kTextureCompressionFormatBC5,   // two channel normal maps
+        kTextureCompressionFormatBC7    // high quality colour and alpha
+    };
+
+    // compresses R8G8B8A8 images to BCn with their mip chain, in the layout
+    // DdsParser produces so DdsWriter can save it and the RHIs upload it
+    class TextureCompressor
+    {
+    protected:
+        TextureCompressionFormat m_Format = TextureCompressionFormat::kTextureCompressionFormatBC7;
+        bool m_bGenerateMipmaps = true;
+        bool m_bMultithreaded = true;
+        MipmapGenerator m_MipmapGenerator;
+
+        // below this many blocks a thread costs more than it saves
+        static const uint32_t kMinBlocksForThreading = 1024;
+
+        uint32_t blockSize() const
+        {
+            return (m_Format == TextureCompressionFormat::kTextureCompressionFormatBC1) ? 8 : 16;
+        }
+
+        void encodeBlock(const uint8_t* src, const size_t src_pitch, uint8_t* block) const
+        {
+            switch (m_Format)
+            {
+                case TextureCompressionFormat::kTextureCompressionFormatBC1:
+                    EncodeBC1Block(src, src_pitch, block);
+                    break;
+                case TextureCompressionFormat::kTextureCompressionFormatBC3:
+                    EncodeBC3Block(src, src_pitch, block);
+                    break;
+                case TextureCompressionFormat::kTextureCompressionFormatBC5:
+                    EncodeBC5Block(src, src_pitch, block);
+                    break;
+                case TextureCompressionFormat::kTextureCompressionFormatBC7:
+                    EncodeBC7Block(src, src_pitch, block);
+                    break;
+            }
+        }
+
+        // encode block rows [begin, end) of one mip level. blocks which reach
+        // over the right or bottom edge repeat the last row and column
+        void encodeBlockRows(const uint8_t* src, const Image::Mipmap& src_mip, uint8_t* dest, const Image::Mipmap& dest_mip,
+                const uint32_t begin, const uint32_t end) const
+        {
+            const uint32_t blocks_x = (src_mip.Width + 3) >> 2;
+            uint8_t edge[4 * 4 * 4];
+            for (uint32_t by = begin; by < end; by++)
+            {
+                uint8_t* block = dest + dest_mip.pitch * by;
+                for (uint32_t bx = 0; bx < blocks_x; bx++, block += blockSize())
+                {
+                    if (bx * 4 + 4 <= src_mip.Width && by * 4 + 4 <= src_mip.Height)
+                    {
+                        encodeBlock(src + src_mip.pitch * by * 4 + bx * 16, src_mip.pitch, block);
+                    }
+                    else
+                    {
+                        for (uint32_t y = 0; y < 4; y++)
+                        {
+                            const uint32_t sy = std::min(by * 4 + y, src_mip.Height - 1);
+                            for (uint32_t x = 0; x < 4; x++)
+                            {
+                                const uint32_t sx = std::min(bx * 4 + x, src_mip.Width - 1);
+                                std::memcpy(edge + y * 16 + x * 4, src + src_mip.pitch * sy + sx * 4, 4);
+                            }
+                        }
+                        encodeBlock(edge, 16, block);
+                    }
+                }
+            }
+        }
+
+        // 8 and 24 bit images widened to R8G8B8A8, gray to all three colours
+        static bool toRGBA8(const Image& img, Image& rgba)
+        {
+            if (img.compressed || img.is_float || (img.bitcount != 8 && img.bitcount != 24 && img.bitcount != 32)) return false;
+
+            rgba.Width = img.Width;
+            rgba.Height = img.Height;
+            rgba.bitcount = 32;
+            rgba.pitch = img.Width * 4;
+            rgba.data_size = static_cast<size_t>(rgba.pitch) * img.Height;
+            rgba.data = new uint8_t[rgba.data_size];
+            for (uint32_t y = 0; y < img.Height; y++)
+            {
+                const uint8_t* src = img.data + static_cast<size_t>(img.pitch) * y;
+                uint8_t* dest = rgba.data + static_cast<size_t>(rgba.pitch) * y;
+                if (img.bitcount == 32)
+                {
+                    std::memcpy(dest, src, rgba.pitch);
+                }
+                else if (img.bitcount == 24)
+                {
+                    ExpandRGB8ToRGBA8(src, dest, img.Width);
+                }
+                else
+                {
+                    for (uint32_t x = 0; x < img.Width; x++)
+                    {
+                        dest[x * 4] = dest[x * 4 + 1] = dest[x * 4 + 2] = src[x];
+                        dest[x * 4 + 3] = 0xFF;
+                    }
+                }
+            }
+            rgba.mipmap_count = 1;
+            rgba.mipmaps[0].Width = rgba.Width;
+            rgba.mipmaps[0].Height = rgba.Height;
+            rgba.mipmaps[0].pitch = rgba.pitch;
+            rgba.mipmaps[0].offset = 0;
+            rgba.mipmaps[0].data_size = rgba.data_size;
+            return true;
+        }
+
+    public:
+        void SetFormat(TextureCompressionFormat format) { m_Format = format; }
+        TextureCompressionFormat GetFormat() const { return m_Format; }
+
+        // without mipmaps only the top level is compressed
+        void SetGenerateMipmaps(bool generate_mipmaps) { m_bGenerateMipmaps = generate_mipmaps; }
+        bool GetGenerateMipmaps() const { return m_bGenerateMipmaps; }
+
+        // see MipmapGenerator, the default is a linear box filter
+        void SetMipmapFilter(MipmapFilter filter) { m_MipmapGenerator.SetFilter(filter); }
+        MipmapFilter GetMipmapFilter() const { return m_MipmapGenerator.GetFilter(); }
+        void SetSRGB(bool srgb) { m_MipmapGenerator.SetSRGB(srgb); }
+        bool GetSRGB() const { return m_MipmapGenerator.GetSRGB(); }
+
+        // encode the blocks and generate the mipmaps on all cores
+        void SetMultithreaded(bool multithreaded)
+        {
+            m_bMultithreaded = multithreaded;
+            m_MipmapGenerator.SetMultithreaded(multithreaded);
+        }
+
+        // "bc1", "bc3", "bc5" or "bc7"
+        static const char* FormatName(const TextureCompressionFormat format)
+        {
+            switch (format)
+            {
+                case TextureCompressionFormat::kTextureCompressionFormatBC1: return "bc1";
+                case TextureCompressionFormat::kTextureCompressionFormatBC3: return "bc3";
+                case TextureCompressionFormat::kTextureCompressionFormatBC5: return "bc5";
+                default: return "bc7";
+            }
+        }
+
+        static bool ParseFormatName(const std::string& name, TextureCompressionFormat& format)
+        {
+            for (auto candidate : { TextureCompressionFormat::kTextureCompressionFormatBC1,
+                                    TextureCompressionFormat::kTextureCompressionFormatBC3,
+                                    TextureCompressionFormat::kTextureCompressionFormatBC5,
+                                    TextureCompressionFormat::kTextureCompressionFormatBC7 })
+            {
+                if (name == FormatName(candidate))
+                {
+                    format = candidate;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // img is an uncompressed 8 bit gray, RGB or RGBA image. returns an
+        // empty image for anything else
+        Image Compress(const Image& img) const
+        {
+            Image compressed;
+            Image rgba;
+            if (!toRGBA8(img, rgba))
+            {
+                std::cerr << "[Error] only 8, 24 and 32 bit images can be compressed" << std::endl;
+                return compressed;
+            }
+            if (m_bGenerateMipmaps)
+            {
+                Image mipmapped = m_MipmapGenerator.Generate(rgba);
+                delete[] rgba.data;
+                rgba = mipmapped;
+            }
+
+            compressed.Width = rgba.Width;
+            compressed.Height = rgba.Height;
+            compressed.compressed = true;
+            compressed.mipmap_count = rgba.mipmap_count;
+            switch (m_Format)
+            {
+                case TextureCompressionFormat::kTextureCompressionFormatBC1:
+                    compressed.compress_format = "DXT1"_u32;
+                    break;
+                case TextureCompressionFormat::kTextureCompressionFormatBC3:
+                    compressed.compress_format = "DXT5"_u32;
+                    break;
+                case TextureCompressionFormat::kTextureCompressionFormatBC5:
+                    compressed.compress_format = "BC5U"_u32;
+                    break;
+                case TextureCompressionFormat::kTextureCompressionFormatBC7:
+                    compressed.compress_format = "BC7U"_u32;
+                    break;
+            }
+            compressed.bitcount = blockSize() / 2; // bits per pixel
+
+            // every block row of every mip is a work item
+            uint32_t first_row[11] = { 0 };
+            uint32_t total_blocks = 0;
+            compressed.data_size = 0;
+            for (uint32_t i = 0; i < rgba.mipmap_count; i++)
+            {
+                const uint32_t blocks_x = (rgba.mipmaps[i].Width + 3) >> 2;
+                const uint32_t blocks_y = (rgba.mipmaps[i].Height + 3) >> 2;
+                auto& mip = compressed.mipmaps[i];
+                mip.Width = rgba.mipmaps[i].Width;
+                mip.Height = rgba.mipmaps[i].Height;
+                mip.pitch = blocks_x * blockSize();
+                mip.offset = compressed.data_size;
+                mip.data_size = static_cast<size_t>(mip.pitch) * blocks_y;
+                compressed.data_size += mip.data_size;
+                first_row[i + 1] = first_row[i] + blocks_y;
+                total_blocks += blocks_x * blocks_y;
+            }
+            compressed.pitch = compressed.mipmaps[0].pitch;
+            compressed.data = new uint8_t[compressed.data_size];
+
+            auto encodeRows = [&](const uint32_t begin, const uint32_t end) {
+                for (uint32_t i = 0; i < rgba.mipmap_count; i++)
+                {
+                    const uint32_t row_begin = std::max(begin, first_row[i]);
+                    const uint32_t row_end = std::min(end, first_row[i + 1]);
+                    if (row_begin >= row_end) continue;
+                    encodeBlockRows(rgba.data + rgba.mipmaps[i].offset, rgba.mipmaps[i],
+                            compressed.data + compressed.mipmaps[i].offset, compressed.mipmaps[i],
+                            row_begin - first_row[i], row_end - first_row[i]);
+                }
+            };
+
+            const uint32_t total_rows = first_row[rgba.mipmap_count];
+#ifndef OS_WEBASSEMBLY
+            unsigned int thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+            thread_count = std::min(thread_count, total_rows);
+            if (m_bMultithreaded && thread_count > 1 && total_blocks >= kMinBlocksForThreading)
+            {
+                std::atomic<uint32_t> next_row(0);
+                auto worker = [&]() {
+                    uint32_t begin;
+                    while ((begin = next_row.fetch_add(1)) < total_rows)
+                    {
+                        encodeRows(begin, begin + 1);
+                    }
+                };
+
+                std::vector<std::thread> threads;
+                for (unsigned int i = 1; i < thread_count; i++)
+                {
+                    threads.emplace_back(worker);
+                }
+                worker();
+                for (auto& thread : threads)
+                {
+                    thread.join();
+                }
+            }
+            else
+#endif
+            {
+                encodeRows(0, total_rows);
+            }
+
+            delete[] rgba.data;
+            return compressed;
+        }
+    };
+
+    // compresses textures when they are loaded and keeps the result as .dds
+    // in a cache directory, so the next load skips decoding and compressing.
+    // the cache file name carries a hash of the source file and the
+    // compressor settings, an edited source or a change of settings gets a
+    // new entry. the directory must exist
+    class TextureCompressionCache
+    {
+    protected:
+        std::string m_strDirectory;
+        TextureCompressor m_Compressor;
+
+        static uint64_t hash(const Buffer& buf)
+        {
+            // FNV-1a
+            uint64_t value = 0xCBF29CE484222325ull;
+            const uint8_t* pData = buf.GetData();
+            for (size_t i = 0; i < buf.GetDataSize(); i++)
+            {
+                value = (value ^ pData[i]) * 0x100000001B3ull;
+            }
+            return value;
+        }
+
+        std::string cachePath(const std::string& name, const Buffer& source) const
+        {
+            std::string flat_name = name;
+            std::replace(flat_name.begin(), flat_name.end(), '/', '_');
+            std::replace(flat_name.begin(), flat_name.end(), '\\', '_');
+
+            // e.g. name.0123456789abcdef.bc7.kaiser.srgb.dds
+            char suffix[96];
+            std::snprintf(suffix, sizeof(suffix), ".%016llx.%s.%s%s.dds", static_cast<unsigned long long>(hash(source)),
+                    TextureCompressor::FormatName(m_Compressor.GetFormat()),
+                    m_Compressor.GetGenerateMipmaps() ? MipmapGenerator::FilterName(m_Compressor.GetMipmapFilter()) : "nomips",
+                    m_Compressor.GetSRGB() ? ".srgb" : "");
+            return m_strDirectory + "/" + flat_name + suffix;
+        }
+
+        static bool readFile(const std::string& path, Buffer& buf)
+        {
+            FILE* fp = std::fopen(path.c_str(), "rb");
+            if (!fp) return false;
+            std::fseek(fp, 0, SEEK_END);
+            const long length = std::ftell(fp);
+            std::fseek(fp, 0, SEEK_SET);
+            bool result = false;
+            if (length > 0)
+            {
+                buf = Buffer(static_cast<size_t>(length));
+                result = (std::fread(buf.GetData(), buf.GetDataSize(), 1, fp) == 1);
+            }
+            std::fclose(fp);
+            return result;
+        }
+
+        // written to a file of its own first and renamed into place, so an
+        // interrupted write or another process loading the same texture never
+        // leaves a partial entry under path
+        static bool writeFile(const std::string& path, const Buffer& buf)
+        {
+            static std::atomic<uint32_t> counter(0);
+            char suffix[64];
+            std::snprintf(suffix, sizeof(suffix), ".%llx.%x.tmp",
+                    static_cast<unsigned long long>(std::chrono::steady_clock::now().time_since_epoch().count()),
+                    counter.fetch_add(1));
+            const std::string temp_path = path + suffix;
+
+            FILE* fp = std::fopen(temp_path.c_str(), "wb");
+            if (!fp) return false;
+            bool result = (std::fwrite(buf.GetData(), buf.GetDataSize(), 1, fp) == 1);
+            result = (std::fclose(fp) == 0) && result;
+
+            // rename does not replace an existing file everywhere
+            if (result && std::rename(temp_path.c_str(), path.c_str()) != 0)
+            {
+                std::remove(path.c_str());
+                result = (std::rename(temp_path.c_str(), path.c_str()) == 0);
+            }
+            if (!result) std::remove(temp_path.c_str());
+            return result;
+        }
+
+    public:
+        TextureCompressionCache(const std::string& directory, TextureCompressionFormat format) : m_strDirectory(directory)
+        {
+            m_Compressor.SetFormat(format);
+        }
+
+        // the compressor the textures go through, its settings are part of
+        // the cache key
+        TextureCompressor& GetCompressor() { return m_Compressor; }
+
+        // the compressed texture of asset name, from the cache or by
+        // decoding source with decode() and compressing it. images which
+        // cannot be compressed are returned as decoded
+        template <typename Decode>
+        Image Load(const std::string& name, const Buffer& source, Decode decode)
+        {
+            const std::string path = cachePath(name, source);
+
+            Buffer cached;
+            if (readFile(path, cached) && cached.GetDataSize() > sizeof(uint32_t) + sizeof(DDS_HEADER)
+                    && std::memcmp(cached.GetData(), "DDS ", 4) == 0)
+            {
+                DdsParser dds_parser;
+                Image img = dds_parser.Parse(cached);
+                if (img.data && img.compressed) return img;
+                delete[] img.data;
+            }
+
+            Image img = decode();
+            Image compressed = m_Compressor.Compress(img);
+            if (!compressed.data) return img;
+            delete[] img.data;
+
+            if (!writeFile(path, DdsWriter().Write(compressed)))
+            {
+                std::cerr << "[Warning] could not write texture cache file " << path << std::endl;
+            }
+            return compressed;
+        }
+    };
+}
@@ -0,0 +1,33 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+namespace Dummy
+{
+    void YCbCrToRGBA8(const size_t count, const uint8_t * y, const uint8_t * cb, const uint8_t * cr, uint8_t * rgba)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            const int32_t luma = y[i];
+            const int32_t b = static_cast<int32_t>(cb[i]) - 128;
+            const int32_t r = static_cast<int32_t>(cr[i]) - 128;
+            rgba[i * 4]     = static_cast<uint8_t>(std::min(std::max(luma + ((91881 * r + 32768) >> 16), 0), 255));
+            rgba[i * 4 + 1] = static_cast<uint8_t>(std::min(std::max(luma + ((-22554 * b - 46802 * r + 32768) >> 16), 0), 255));
+            rgba[i * 4 + 2] = static_cast<uint8_t>(std::min(std::max(luma + ((116130 * b + 32768) >> 16), 0), 255));
+            rgba[i * 4 + 3] = 255;
+        }
+    }
+
+    void RGBToYCbCr(const size_t count, const uint8_t * rgb, const int32_t pixel_stride, uint8_t * y, uint8_t * cb, uint8_t * cr)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            const int32_t red   = rgb[i * pixel_stride];
+            const int32_t green = rgb[i * pixel_stride + 1];
+            const int32_t blue  = rgb[i * pixel_stride + 2];
+            y[i]  = static_cast<uint8_t>(std::min(std::max((19595 * red + 38470 * green + 7471 * blue + 32768) >> 16, 0), 255));
+            cb[i] = static_cast<uint8_t>(std::min(std::max(((-11059 * red - 21709 * green + 32768 * blue + 32768) >> 16) + 128, 0), 255));
+            cr[i] = static_cast<uint8_t>(std::min(std::max(((32768 * red - 27439 * green - 5329 * blue + 32768) >> 16) + 128, 0), 255));
+        }
+    }
+}
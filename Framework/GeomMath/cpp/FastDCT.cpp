@@ -0,0 +1,265 @@
+#include <cstddef>
+#include <cstdint>
+
+// separable 8x8 DCT/IDCT. the float versions use the AAN (Arai, Agui, Nakajima)
+// factorization, the int16 IDCT uses the LLM (Loeffler, Ligtenberg, Moschytz)
+// factorization in 13 bit fixed point. both follow the IJG libjpeg implementations.
+// the results have the same scale as the reference DCT8X8 / IDCT8X8.
+
+namespace {
+    // aan_scale[k] = cos(k * PI / 16) * sqrt(2), aan_scale[0] = 1
+    const float aan_scale[8] = {
+        1.0f, 1.387039845f, 1.306562965f, 1.175875602f,
+        1.0f, 0.785694958f, 0.541196100f, 0.275899379f
+    };
+
+    inline void idct_1d_aan(float& d0, float& d1, float& d2, float& d3, 
+                            float& d4, float& d5, float& d6, float& d7)
+    {
+        // even part
+        float tmp10 = d0 + d4;
+        float tmp11 = d0 - d4;
+        float tmp13 = d2 + d6;
+        float tmp12 = (d2 - d6) * 1.414213562f - tmp13;
+
+        float tmp0 = tmp10 + tmp13;
+        float tmp3 = tmp10 - tmp13;
+        float tmp1 = tmp11 + tmp12;
+        float tmp2 = tmp11 - tmp12;
+
+        // odd part
+        float z13 = d5 + d3;
+        float z10 = d5 - d3;
+        float z11 = d1 + d7;
+        float z12 = d1 - d7;
+
+        float tmp7 = z11 + z13;
+        tmp11 = (z11 - z13) * 1.414213562f;
+
+        float z5 = (z10 + z12) * 1.847759065f;
+        tmp10 = 1.082392200f * z12 - z5;
+        tmp12 = -2.613125930f * z10 + z5;
+
+        float tmp6 = tmp12 - tmp7;
+        float tmp5 = tmp11 - tmp6;
+        float tmp4 = tmp10 + tmp5;
+
+        d0 = tmp0 + tmp7;
+        d7 = tmp0 - tmp7;
+        d1 = tmp1 + tmp6;
+        d6 = tmp1 - tmp6;
+        d2 = tmp2 + tmp5;
+        d5 = tmp2 - tmp5;
+        d4 = tmp3 + tmp4;
+        d3 = tmp3 - tmp4;
+    }
+
+    inline void dct_1d_aan(float& d0, float& d1, float& d2, float& d3, 
+                           float& d4, float& d5, float& d6, float& d7)
+    {
+        float tmp0 = d0 + d7;
+        float tmp7 = d0 - d7;
+        float tmp1 = d1 + d6;
+        float tmp6 = d1 - d6;
+        float tmp2 = d2 + d5;
+        float tmp5 = d2 - d5;
+        float tmp3 = d3 + d4;
+        float tmp4 = d3 - d4;
+
+        // even part
+        float tmp10 = tmp0 + tmp3;
+        float tmp13 = tmp0 - tmp3;
+        float tmp11 = tmp1 + tmp2;
+        float tmp12 = tmp1 - tmp2;
+
+        d0 = tmp10 + tmp11;
+        d4 = tmp10 - tmp11;
+
+        float z1 = (tmp12 + tmp13) * 0.707106781f;
+        d2 = tmp13 + z1;
+        d6 = tmp13 - z1;
+
+        // odd part
+        tmp10 = tmp4 + tmp5;
+        tmp11 = tmp5 + tmp6;
+        tmp12 = tmp6 + tmp7;
+
+        float z5 = (tmp10 - tmp12) * 0.382683433f;
+        float z2 = 0.541196100f * tmp10 + z5;
+        float z4 = 1.306562965f * tmp12 + z5;
+        float z3 = tmp11 * 0.707106781f;
+
+        float z11 = tmp7 + z3;
+        float z13 = tmp7 - z3;
+
+        d5 = z13 + z2;
+        d3 = z13 - z2;
+        d1 = z11 + z4;
+        d7 = z11 - z4;
+    }
+
+    const int32_t CONST_BITS = 13;
+    const int32_t PASS1_BITS = 2;
+
+    const int32_t FIX_0_298631336 = 2446;
+    const int32_t FIX_0_390180644 = 3196;
+    const int32_t FIX_0_541196100 = 4433;
+    const int32_t FIX_0_765366865 = 6270;
+    const int32_t FIX_0_899976223 = 7373;
+    const int32_t FIX_1_175875602 = 9633;
+    const int32_t FIX_1_501321110 = 12299;
+    const int32_t FIX_1_847759065 = 15137;
+    const int32_t FIX_1_961570560 = 16069;
+    const int32_t FIX_2_053119869 = 16819;
+    const int32_t FIX_2_562915447 = 20995;
+    const int32_t FIX_3_072711026 = 25172;
+
+    inline int32_t descale(int32_t x, int32_t n)
+    {
+        return (x + (1 << (n - 1))) >> n;
+    }
+
+    // d[k * stride] are the 8 inputs, out[k * stride] receive the outputs descaled by shift
+    template <typename T>
+    inline void idct_1d_llm(const int32_t d[8], T* out, const size_t stride, const int32_t shift)
+    {
+        // even part
+        int32_t z2 = d[2];
+        int32_t z3 = d[6];
+        int32_t z1 = (z2 + z3) * FIX_0_541196100;
+        int32_t tmp2 = z1 + z3 * (-FIX_1_847759065);
+        int32_t tmp3 = z1 + z2 * FIX_0_765366865;
+
+        int32_t tmp0 = (d[0] + d[4]) * (1 << CONST_BITS);
+        int32_t tmp1 = (d[0] - d[4]) * (1 << CONST_BITS);
+
+        int32_t tmp10 = tmp0 + tmp3;
+        int32_t tmp13 = tmp0 - tmp3;
+        int32_t tmp11 = tmp1 + tmp2;
+        int32_t tmp12 = tmp1 - tmp2;
+
+        // odd part
+        tmp0 = d[7];
+        tmp1 = d[5];
+        tmp2 = d[3];
+        tmp3 = d[1];
+
+        z1 = tmp0 + tmp3;
+        z2 = tmp1 + tmp2;
+        z3 = tmp0 + tmp2;
+        int32_t z4 = tmp1 + tmp3;
+        int32_t z5 = (z3 + z4) * FIX_1_175875602;
+
+        tmp0 = tmp0 * FIX_0_298631336;
+        tmp1 = tmp1 * FIX_2_053119869;
+        tmp2 = tmp2 * FIX_3_072711026;
+        tmp3 = tmp3 * FIX_1_501321110;
+        z1 = z1 * (-FIX_0_899976223);
+        z2 = z2 * (-FIX_2_562915447);
+        z3 = z3 * (-FIX_1_961570560) + z5;
+        z4 = z4 * (-FIX_0_390180644) + z5;
+
+        tmp0 += z1 + z3;
+        tmp1 += z2 + z4;
+        tmp2 += z2 + z3;
+        tmp3 += z1 + z4;
+
+        out[0]          = static_cast<T>(descale(tmp10 + tmp3, shift));
+        out[stride * 7] = static_cast<T>(descale(tmp10 - tmp3, shift));
+        out[stride * 1] = static_cast<T>(descale(tmp11 + tmp2, shift));
+        out[stride * 6] = static_cast<T>(descale(tmp11 - tmp2, shift));
+        out[stride * 2] = static_cast<T>(descale(tmp12 + tmp1, shift));
+        out[stride * 5] = static_cast<T>(descale(tmp12 - tmp1, shift));
+        out[stride * 3] = static_cast<T>(descale(tmp13 + tmp0, shift));
+        out[stride * 4] = static_cast<T>(descale(tmp13 - tmp0, shift));
+    }
+}
+
+namespace Dummy
+{
+    void FastDCT8X8(const size_t count, const float * g, float * G)
+    {
+        for (size_t b = 0; b < count; b++)
+        {
+            float ws[64];
+            for (int i = 0; i < 64; i++) ws[i] = g[b * 64 + i];
+
+            // rows
+            for (int r = 0; r < 8; r++)
+            {
+                float* p = ws + r * 8;
+                dct_1d_aan(p[0], p[1], p[2], p[3], p[4], p[5], p[6], p[7]);
+            }
+
+            // columns
+            for (int c = 0; c < 8; c++)
+            {
+                float* p = ws + c;
+                dct_1d_aan(p[0], p[8], p[16], p[24], p[32], p[40], p[48], p[56]);
+            }
+
+            for (int u = 0; u < 8; u++)
+            {
+                for (int v = 0; v < 8; v++)
+                {
+                    G[b * 64 + u * 8 + v] = ws[u * 8 + v] / (aan_scale[u] * aan_scale[v] * 8.0f);
+                }
+            }
+        }
+    }
+
+    void FastIDCT8X8(const size_t count, const float * G, float * g)
+    {
+        for (size_t b = 0; b < count; b++)
+        {
+            float ws[64];
+            for (int u = 0; u < 8; u++)
+            {
+                for (int v = 0; v < 8; v++)
+                {
+                    ws[u * 8 + v] = G[b * 64 + u * 8 + v] * aan_scale[u] * aan_scale[v] * 0.125f;
+                }
+            }
+
+            // columns
+            for (int c = 0; c < 8; c++)
+            {
+                float* p = ws + c;
+                idct_1d_aan(p[0], p[8], p[16], p[24], p[32], p[40], p[48], p[56]);
+            }
+
+            // rows
+            for (int r = 0; r < 8; r++)
+            {
+                float* p = ws + r * 8;
+                idct_1d_aan(p[0], p[1], p[2], p[3], p[4], p[5], p[6], p[7]);
+            }
+
+            for (int i = 0; i < 64; i++) g[b * 64 + i] = ws[i];
+        }
+    }
+
+    void FastIDCT8X8i16(const size_t count, const int16_t * G, int16_t * g)
+    {
+        for (size_t b = 0; b < count; b++)
+        {
+            const int16_t* in = G + b * 64;
+            int32_t ws[64];
+            int32_t d[8];
+
+            // columns, keep PASS1_BITS extra bits of precision for the second pass
+            for (int c = 0; c < 8; c++)
+            {
+                for (int k = 0; k < 8; k++) d[k] = in[k * 8 + c];
+                idct_1d_llm(d, ws + c, 8, CONST_BITS - PASS1_BITS);
+            }
+
+            // rows, also remove the factor 8 of the 2D transform
+            for (int r = 0; r < 8; r++)
+            {
+                for (int k = 0; k < 8; k++) d[k] = ws[r * 8 + k];
+                idct_1d_llm(d, g + b * 64 + r * 8, 1, CONST_BITS + PASS1_BITS + 3);
+            }
+        }
+    }
+}
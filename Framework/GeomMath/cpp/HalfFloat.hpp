@@ -0,0 +1,72 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+namespace Dummy
+{
+    // round to nearest even, values here are never negative or NaN
+    static inline uint16_t FloatToHalf(float f)
+    {
+        if (f >= 65504.0f) return 0x7BFF; // clamp to the largest finite half
+
+        uint32_t bits;
+        std::memcpy(&bits, &f, sizeof(bits));
+        const int32_t exponent = static_cast<int32_t>(bits >> 23) - 127 + 15;
+        uint32_t mantissa = bits & 0x7FFFFF;
+
+        if (exponent <= 0)
+        {
+            // denormal half
+            if (exponent < -10) return 0;
+            mantissa |= 0x800000;
+            const uint32_t shift = static_cast<uint32_t>(14 - exponent);
+            uint32_t half = mantissa >> shift;
+            const uint32_t rest = mantissa & ((1u << shift) - 1);
+            const uint32_t midpoint = 1u << (shift - 1);
+            if (rest > midpoint || (rest == midpoint && (half & 1))) half++;
+            return static_cast<uint16_t>(half);
+        }
+
+        uint32_t half = (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+        const uint32_t rest = mantissa & 0x1FFF;
+        if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) half++; // may carry into the exponent, which is right
+        return static_cast<uint16_t>(half);
+    }
+
+    static inline float HalfToFloat(const uint16_t half)
+    {
+        const uint32_t sign = static_cast<uint32_t>(half & 0x8000) << 16;
+        const uint32_t exponent = (half >> 10) & 0x1F;
+        uint32_t mantissa = half & 0x3FF;
+
+        uint32_t bits;
+        if (exponent == 0x1F)
+        {
+            // inf and NaN
+            bits = sign | 0x7F800000 | (mantissa << 13);
+        }
+        else if (exponent != 0)
+        {
+            bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+        }
+        else if (mantissa == 0)
+        {
+            bits = sign;
+        }
+        else
+        {
+            // denormal half, normalize it
+            uint32_t e = 127 - 15 + 1;
+            while (!(mantissa & 0x400))
+            {
+                mantissa <<= 1;
+                e--;
+            }
+            bits = sign | (e << 23) | ((mantissa & 0x3FF) << 13);
+        }
+
+        float f;
+        std::memcpy(&f, &bits, sizeof(f));
+        return f;
+    }
+}
@@ -0,0 +1,78 @@
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include "HalfFloat.hpp"
+
+namespace Dummy
+{
+    void MipmapUnpackRow8(const size_t count, const uint8_t * src, const int32_t channels, const float * lut, float * out)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            out[i] = (channels == 4 && (i & 3) == 3) ? src[i] * (1.0f / 255.0f) : lut[src[i]];
+        }
+    }
+
+    void MipmapPackRow8(const size_t count, const float * src, const int32_t channels, const bool srgb, uint8_t * out)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            float value = std::min(std::max(src[i], 0.0f), 1.0f);
+            if (srgb && !(channels == 4 && (i & 3) == 3))
+            {
+                value = (value <= 0.0031308f) ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+            }
+            out[i] = static_cast<uint8_t>(value * 255.0f + 0.5f);
+        }
+    }
+
+    void MipmapUnpackRowHalf(const size_t count, const uint16_t * src, float * out)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            out[i] = HalfToFloat(src[i]);
+        }
+    }
+
+    void MipmapPackRowHalf(const size_t count, const float * src, uint16_t * out)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            out[i] = FloatToHalf(src[i]);
+        }
+    }
+
+    void MipmapFilterRow(const int32_t dest_width, const float * src, const int32_t src_width, const int32_t channels,
+            const float * weights, const int32_t taps, float * out)
+    {
+        for (int32_t x = 0; x < dest_width; x++)
+        {
+            const int32_t first = 2 * x + 1 - taps / 2;
+            for (int32_t c = 0; c < channels; c++)
+            {
+                float sum = 0.0f;
+                for (int32_t k = 0; k < taps; k++)
+                {
+                    const int32_t sx = std::min(std::max(first + k, 0), src_width - 1);
+                    sum += weights[k] * src[sx * channels + c];
+                }
+                out[x * channels + c] = sum;
+            }
+        }
+    }
+
+    void MipmapFilterColumns(const size_t count, const float * const * rows, const float * weights, const int32_t taps,
+            const float min_value, const float max_value, float * out)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            float sum = 0.0f;
+            for (int32_t k = 0; k < taps; k++)
+            {
+                sum += weights[k] * rows[k][i];
+            }
+            out[i] = std::min(std::max(sum, min_value), max_value);
+        }
+    }
+}
@@ -0,0 +1,43 @@
+#include <cstddef>
+
+namespace Dummy
+{
+    void MultiplyMatrixArray(const size_t count, const float * a, const float * b, float * result)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            const float* _a = a + i * 16;
+            const float* _b = b + i * 16;
+            float* _r = result + i * 16;
+            for (int row = 0; row < 4; row++)
+            {
+                for (int col = 0; col < 4; col++)
+                {
+                    _r[row * 4 + col] = _a[row * 4] * _b[col] 
+                        + _a[row * 4 + 1] * _b[4 + col]
+                        + _a[row * 4 + 2] * _b[8 + col]
+                        + _a[row * 4 + 3] * _b[12 + col];
+                }
+            }
+        }
+    }
+
+    void MultiplyMatrixArrayByMatrix(const size_t count, const float * a, const float matrix[16], float * result)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            const float* _a = a + i * 16;
+            float* _r = result + i * 16;
+            for (int row = 0; row < 4; row++)
+            {
+                for (int col = 0; col < 4; col++)
+                {
+                    _r[row * 4 + col] = _a[row * 4] * matrix[col] 
+                        + _a[row * 4 + 1] * matrix[4 + col]
+                        + _a[row * 4 + 2] * matrix[8 + col]
+                        + _a[row * 4 + 3] * matrix[12 + col];
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,36 @@
+#include <cstddef>
+#include <cmath>
+
+namespace Dummy
+{
+    void NormalizeArray(const size_t count, float * v)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            float* _v = v + i * 3;
+            const float length_square = _v[0] * _v[0] + _v[1] * _v[1] + _v[2] * _v[2];
+            if (length_square > 0.0f)
+            {
+                const float one_over_length = 1.0f / std::sqrt(length_square);
+                _v[0] *= one_over_length;
+                _v[1] *= one_over_length;
+                _v[2] *= one_over_length;
+            }
+        }
+    }
+
+    void NormalizeArraySoA(const size_t count, float * x, float * y, float * z)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            const float length_square = x[i] * x[i] + y[i] * y[i] + z[i] * z[i];
+            if (length_square > 0.0f)
+            {
+                const float one_over_length = 1.0f / std::sqrt(length_square);
+                x[i] *= one_over_length;
+                y[i] *= one_over_length;
+                z[i] *= one_over_length;
+            }
+        }
+    }
+}
@@ -0,0 +1,42 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include "HalfFloat.hpp"
+
+namespace Dummy
+{
+    // 2^(exponent - 136) built from its bits. exponents below 10 would give
+    // denormals under 2^-126, they are flushed to zero to keep this branchless
+    static inline float RGBEScale(const uint32_t exponent)
+    {
+        const uint32_t bits = (exponent > 9) ? (exponent - 9) << 23 : 0;
+        float scale;
+        std::memcpy(&scale, &bits, sizeof(scale));
+        return scale;
+    }
+
+    void RGBEToFloat(const size_t count, const uint8_t * rgbe, const int32_t components, float * out)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            const float scale = RGBEScale(rgbe[i * 4 + 3]);
+            out[0] = rgbe[i * 4]     * scale;
+            out[1] = rgbe[i * 4 + 1] * scale;
+            out[2] = rgbe[i * 4 + 2] * scale;
+            if (components == 4) out[3] = 1.0f;
+            out += components;
+        }
+    }
+
+    void RGBEToHalf4(const size_t count, const uint8_t * rgbe, uint16_t * out)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            const float scale = RGBEScale(rgbe[i * 4 + 3]);
+            out[i * 4]     = FloatToHalf(rgbe[i * 4]     * scale);
+            out[i * 4 + 1] = FloatToHalf(rgbe[i * 4 + 1] * scale);
+            out[i * 4 + 2] = FloatToHalf(rgbe[i * 4 + 2] * scale);
+            out[i * 4 + 3] = 0x3C00; // 1.0
+        }
+    }
+}
@@ -0,0 +1,15 @@
+#include <cstdint>
+
+namespace Dummy
+{
+    int32_t GetSimdTarget()
+    {
+        // plain C++ reference implementation
+        return 0;
+    }
+
+    int32_t GetSimdWidth()
+    {
+        return 1;
+    }
+}
@@ -2,12 +2,13 @@ namespace Dummy
 {
     void Transform(float vector[4], const float matrix[16])
     {
+        const float v[4] = { vector[0], vector[1], vector[2], vector[3] };
         for(int index = 0; index < 4; index++)
         {
-            vector[index] = (vector[0] * matrix[index]) 
-                + (vector[1] * matrix[index + 4]) 
-                + (vector[2] * matrix[index + 8]) 
-                + (vector[3] * matrix[index + 12]);
+            vector[index] = (v[0] * matrix[index]) 
+                + (v[1] * matrix[index + 4]) 
+                + (v[2] * matrix[index + 8]) 
+                + (v[3] * matrix[index + 12]);
         }
     }
 }
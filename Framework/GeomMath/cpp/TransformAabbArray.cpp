@@ -0,0 +1,40 @@
+#include <cstddef>
+#include <cmath>
+
+namespace Dummy
+{
+    void TransformAabbArray(const size_t count, 
+            const float * centroids, const float * extents,
+            float * out_centroids, float * out_extents,
+            const float matrix[16])
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            const float cx = centroids[i * 3];
+            const float cy = centroids[i * 3 + 1];
+            const float cz = centroids[i * 3 + 2];
+            const float ex = extents[i * 3];
+            const float ey = extents[i * 3 + 1];
+            const float ez = extents[i * 3 + 2];
+
+            for (int j = 0; j < 3; j++)
+            {
+                out_centroids[i * 3 + j] = cx * matrix[j] + cy * matrix[4 + j] + cz * matrix[8 + j] + matrix[12 + j];
+                out_extents[i * 3 + j] = ex * std::fabs(matrix[j]) + ey * std::fabs(matrix[4 + j]) + ez * std::fabs(matrix[8 + j]);
+            }
+        }
+    }
+
+    void CalculateAabb(const size_t count, const float * points, float bbmin[3], float bbmax[3])
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            for (int j = 0; j < 3; j++)
+            {
+                const float v = points[i * 3 + j];
+                bbmin[j] = (bbmin[j] < v) ? bbmin[j] : v;
+                bbmax[j] = (bbmax[j] > v) ? bbmax[j] : v;
+            }
+        }
+    }
+}
@@ -0,0 +1,48 @@
+#include <cstddef>
+
+namespace Dummy
+{
+    void TransformPoints(const size_t count, const float * in, float * out, const float matrix[16])
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            const float x = in[i * 3];
+            const float y = in[i * 3 + 1];
+            const float z = in[i * 3 + 2];
+            out[i * 3]     = x * matrix[0] + y * matrix[4] + z * matrix[8]  + matrix[12];
+            out[i * 3 + 1] = x * matrix[1] + y * matrix[5] + z * matrix[9]  + matrix[13];
+            out[i * 3 + 2] = x * matrix[2] + y * matrix[6] + z * matrix[10] + matrix[14];
+        }
+    }
+
+    void TransformPointsSoA(const size_t count, 
+            const float * in_x, const float * in_y, const float * in_z, 
+            float * out_x, float * out_y, float * out_z, 
+            const float matrix[16])
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            const float x = in_x[i];
+            const float y = in_y[i];
+            const float z = in_z[i];
+            out_x[i] = x * matrix[0] + y * matrix[4] + z * matrix[8]  + matrix[12];
+            out_y[i] = x * matrix[1] + y * matrix[5] + z * matrix[9]  + matrix[13];
+            out_z[i] = x * matrix[2] + y * matrix[6] + z * matrix[10] + matrix[14];
+        }
+    }
+
+    void TransformVectors(const size_t count, const float * in, float * out, const float matrix[16])
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            const float x = in[i * 4];
+            const float y = in[i * 4 + 1];
+            const float z = in[i * 4 + 2];
+            const float w = in[i * 4 + 3];
+            out[i * 4]     = x * matrix[0] + y * matrix[4] + z * matrix[8]  + w * matrix[12];
+            out[i * 4 + 1] = x * matrix[1] + y * matrix[5] + z * matrix[9]  + w * matrix[13];
+            out[i * 4 + 2] = x * matrix[2] + y * matrix[6] + z * matrix[10] + w * matrix[14];
+            out[i * 4 + 3] = x * matrix[3] + y * matrix[7] + z * matrix[11] + w * matrix[15];
+        }
+    }
+}
@@ -14,6 +14,7 @@
 #include <vector>
 
 #include "config.h"
+#include "geommath_simd.hpp"
 
 #ifdef USE_ISPC
 namespace ispc { /* namespace */
@@ -39,8 +40,32 @@ namespace Dummy { /* namespace */
         bool InverseMatrix4X4f(float matrix[16]);
         void DCT8X8(const float g[64], float G[64]);
         void IDCT8X8(const float G[64], float g[64]);
+        void FastDCT8X8(const size_t count, const float * g, float * G);
+        void FastIDCT8X8(const size_t count, const float * G, float * g);
+        void FastIDCT8X8i16(const size_t count, const int16_t * G, int16_t * g);
         void Absolute(float * result, const float * a, const size_t count);
         void Pow(const float * v, const size_t count, const float exponent, float * result);
+        void TransformPoints(const size_t count, const float * in, float * out, const float matrix[16]);
+        void TransformPointsSoA(const size_t count, const float * in_x, const float * in_y, const float * in_z, float * out_x, float * out_y, float * out_z, const float matrix[16]);
+        void TransformVectors(const size_t count, const float * in, float * out, const float matrix[16]);
+        void MultiplyMatrixArray(const size_t count, const float * a, const float * b, float * result);
+        void MultiplyMatrixArrayByMatrix(const size_t count, const float * a, const float matrix[16], float * result);
+        void TransformAabbArray(const size_t count, const float * centroids, const float * extents, float * out_centroids, float * out_extents, const float matrix[16]);
+        void CalculateAabb(const size_t count, const float * points, float bbmin[3], float bbmax[3]);
+        void NormalizeArray(const size_t count, float * v);
+        void NormalizeArraySoA(const size_t count, float * x, float * y, float * z);
+        int32_t GetSimdTarget();
+        int32_t GetSimdWidth();
+        void YCbCrToRGBA8(const size_t count, const uint8_t * y, const uint8_t * cb, const uint8_t * cr, uint8_t * rgba);
+        void RGBToYCbCr(const size_t count, const uint8_t * rgb, const int32_t pixel_stride, uint8_t * y, uint8_t * cb, uint8_t * cr);
+        void RGBEToFloat(const size_t count, const uint8_t * rgbe, const int32_t components, float * out);
+        void RGBEToHalf4(const size_t count, const uint8_t * rgbe, uint16_t * out);
+        void MipmapUnpackRow8(const size_t count, const uint8_t * src, const int32_t channels, const float * lut, float * out);
+        void MipmapPackRow8(const size_t count, const float * src, const int32_t channels, const bool srgb, uint8_t * out);
+        void MipmapUnpackRowHalf(const size_t count, const uint16_t * src, float * out);
+        void MipmapPackRowHalf(const size_t count, const float * src, uint16_t * out);
+        void MipmapFilterRow(const int32_t dest_width, const float * src, const int32_t src_width, const int32_t channels, const float * weights, const int32_t taps, float * out);
+        void MipmapFilterColumns(const size_t count, const float * const * rows, const float * weights, const int32_t taps, const float min_value, const float max_value, float * out);
 #ifdef USE_ISPC
     } /* end extern C */
 #endif
@@ -133,11 +158,9 @@ namespace My {
             return *this;
         };
 
-        Vector& operator=(const Vector& v) 
-        { 
-            std::memcpy(this, &v, sizeof(v));
-            return *this;
-        };
+        // trivial, so vectors are copied as plain memory and the implicit
+        // copy constructor is not deprecated
+        Vector& operator=(const Vector& v) = default;
     };
 
     typedef Vector<float, 2> Vector2f;
@@ -178,13 +201,17 @@ namespace My {
     }
 
     template <typename T, int N>
-    void VectorAdd(Vector<T, N>& result, const Vector<T, N>& vec1, const Vector<T, N>& vec2)
+    inline void VectorAdd(Vector<T, N>& result, const Vector<T, N>& vec1, const Vector<T, N>& vec2)
     {
-    #ifdef USE_ISPC
-        ispc::AddByElement(vec1, vec2, result, N);
-    #else
-        Dummy::AddByElement(vec1, vec2, result, N);
-    #endif
+        for (int i = 0; i < N; i++)
+        {
+            result.data[i] = vec1.data[i] + vec2.data[i];
+        }
+    }
+
+    inline void VectorAdd(Vector4f& result, const Vector4f& vec1, const Vector4f& vec2)
+    {
+        Simd::AddByElement4(vec1, vec2, result);
     }
 
     template <typename T, int N>
@@ -206,13 +233,17 @@ namespace My {
     }
 
     template <typename T, int N>
-    void VectorSub(Vector<T, N>& result, const Vector<T, N>& vec1, const Vector<T, N>& vec2)
+    inline void VectorSub(Vector<T, N>& result, const Vector<T, N>& vec1, const Vector<T, N>& vec2)
     {
-    #ifdef USE_ISPC
-        ispc::SubByElement(vec1, vec2, result, N);
-    #else
-        Dummy::SubByElement(vec1, vec2, result, N);
-    #endif
+        for (int i = 0; i < N; i++)
+        {
+            result.data[i] = vec1.data[i] - vec2.data[i];
+        }
+    }
+
+    inline void VectorSub(Vector4f& result, const Vector4f& vec1, const Vector4f& vec2)
+    {
+        Simd::SubByElement4(vec1, vec2, result);
     }
 
     template <typename T, int N>
@@ -242,11 +273,13 @@ namespace My {
     template <typename T>
     inline void CrossProduct(Vector<T, 3>& result, const Vector<T, 3>& vec1, const Vector<T, 3>& vec2)
     {
-    #ifdef USE_ISPC
-        ispc::CrossProduct(vec1, vec2, result);
-    #else
-        Dummy::CrossProduct(vec1, vec2, result);
-    #endif
+        // go through temporaries so result can alias vec1 or vec2
+        const T x = vec1.data[1] * vec2.data[2] - vec1.data[2] * vec2.data[1];
+        const T y = vec1.data[2] * vec2.data[0] - vec1.data[0] * vec2.data[2];
+        const T z = vec1.data[0] * vec2.data[1] - vec1.data[1] * vec2.data[0];
+        result.data[0] = x;
+        result.data[1] = y;
+        result.data[2] = z;
     }
 
     template <typename T>
@@ -272,28 +305,45 @@ namespace My {
     template <typename T, int N>
     inline void DotProduct(T& result, const Vector<T, N>& vec1, const Vector<T, N>& vec2)
     {
-        DotProduct(result, static_cast<const T*>(vec1), static_cast<const T*>(vec2), N);
+        T sum = static_cast<T>(0);
+        for (int i = 0; i < N; i++)
+        {
+            sum += vec1.data[i] * vec2.data[i];
+        }
+        result = sum;
+    }
+
+    inline void DotProduct(float& result, const Vector4f& vec1, const Vector4f& vec2)
+    {
+        result = Simd::DotProduct4(vec1, vec2);
     }
 
     template <typename T, int N>
     inline void MulByElement(Vector<T, N>& result, const Vector<T, N>& a, const Vector<T, N>& b)
     {
-    #ifdef USE_ISPC
-        ispc::MulByElement(a, b, result, N);
-    #else
-        Dummy::MulByElement(a, b, result, N);
-    #endif
+        for (int i = 0; i < N; i++)
+        {
+            result.data[i] = a.data[i] * b.data[i];
+        }
+    }
+
+    inline void MulByElement(Vector4f& result, const Vector4f& a, const Vector4f& b)
+    {
+        Simd::MulByElement4(a, b, result);
     }
 
     template <typename T, int N>
     inline void MulByElement(Vector<T, N>& result, const Vector<T, N>& a, const T scalar)
     {
-        Vector<T, N> v(scalar);
-    #ifdef USE_ISPC
-        ispc::MulByElement(a, v, result, N);
-    #else
-        Dummy::MulByElement(a, v, result, N);
-    #endif
+        for (int i = 0; i < N; i++)
+        {
+            result.data[i] = a.data[i] * scalar;
+        }
+    }
+
+    inline void MulByElement(Vector4f& result, const Vector4f& a, const float scalar)
+    {
+        Simd::MulByElement4(a, scalar, result);
     }
 
     template <typename T, int N>
@@ -326,22 +376,24 @@ namespace My {
     template <typename T, int N>
     inline void DivByElement(Vector<T, N>& result, const Vector<T, N>& a, const Vector<T, N>& b)
     {
-    #ifdef USE_ISPC
-        ispc::DivByElement(a, b, result, N);
-    #else
-        Dummy::DivByElement(a, b, result, N);
-    #endif
+        for (int i = 0; i < N; i++)
+        {
+            result.data[i] = a.data[i] / b.data[i];
+        }
+    }
+
+    inline void DivByElement(Vector4f& result, const Vector4f& a, const Vector4f& b)
+    {
+        Simd::DivByElement4(a, b, result);
     }
 
     template <typename T, int N>
     inline void DivByElement(Vector<T, N>& result, const Vector<T, N>& a, const T scalar)
     {
-        Vector<T, N> v(scalar);
-    #ifdef USE_ISPC
-        ispc::DivByElement(a, v, result, N);
-    #else
-        Dummy::DivByElement(a, v, result, N);
-    #endif
+        for (int i = 0; i < N; i++)
+        {
+            result.data[i] = a.data[i] / scalar;
+        }
     }
 
     template <typename T, int N>
@@ -455,13 +507,10 @@ namespace My {
     inline void Normalize(Vector<T, N>& a)
     {
         T length;
-        DotProduct(length, static_cast<T*>(a), static_cast<T*>(a), N);
-        length = std::sqrt(length);
-    #ifdef USE_ISPC
-        ispc::Normalize(N, a, length);
-    #else
-        Dummy::Normalize(N, a, length);
-    #endif
+        DotProduct(length, a, a);
+        if (!length) return;
+        length = static_cast<T>(1) / std::sqrt(length);
+        MulByElement(a, a, length);
     }
 
     // Matrix
@@ -488,11 +537,7 @@ namespace My {
             return *this;
         }
 
-        Matrix& operator=(const Matrix& rhs) 
-        {
-            std::memcpy(data, rhs, sizeof(Matrix));
-            return *this;
-        }
+        Matrix& operator=(const Matrix& rhs) = default;
 
         bool isOrthogonal() const
         {
@@ -510,6 +555,7 @@ namespace My {
     typedef Matrix<float, 3, 3> Matrix3X3f;
     typedef Matrix<float, 4, 4> Matrix4X4f;
     typedef Matrix<int32_t, 8, 8> Matrix8X8i;
+    typedef Matrix<int16_t, 8, 8> Matrix8X8i16;
     typedef Matrix<float, 8, 8> Matrix8X8f;
 
     template <typename T, int ROWS, int COLS>
@@ -596,6 +642,11 @@ namespace My {
         return;
     }
 
+    inline void MatrixMultiply(Matrix4X4f& result, const Matrix4X4f& matrix1, const Matrix4X4f& matrix2)
+    {
+        Simd::MatrixMultiply4X4(result, matrix1, matrix2);
+    }
+
     template <typename T, int ROWS, int COLS>
     Matrix<T, ROWS, COLS> operator*(const Matrix<T, ROWS, COLS>& matrix1, const Matrix<T, ROWS, COLS>& matrix2)
     {
@@ -687,6 +738,11 @@ namespace My {
     #endif
     }
 
+    inline void Transpose(Matrix4X4f& result, const Matrix4X4f& matrix1)
+    {
+        Simd::Transpose4X4(matrix1, result);
+    }
+
     template <typename T, int N>
     inline T Trace(const Matrix<T, N, N>& matrix)
     {
@@ -749,21 +805,13 @@ namespace My {
     inline void TransformCoord(Vector3f& vector, const Matrix4X4f& matrix)
     {
 		Vector4f tmp ({vector[0], vector[1], vector[2], 1.0f});
-    #ifdef USE_ISPC
-        ispc::Transform(tmp, matrix);
-    #else
-        Dummy::Transform(tmp, matrix);
-    #endif
+        Simd::Transform(tmp, matrix);
         std::memcpy(&vector, &tmp, sizeof(vector));
     }
 
     inline void Transform(Vector4f& vector, const Matrix4X4f& matrix)
     {
-    #ifdef USE_ISPC
-        ispc::Transform(vector, matrix);
-    #else
-        Dummy::Transform(vector, matrix);
-    #endif
+        Simd::Transform(vector, matrix);
 
         return;
     }
@@ -1036,26 +1084,209 @@ namespace My {
     #endif
     }
 
-    inline Matrix8X8f DCT8X8(const Matrix8X8f& matrix)
+    // separable AAN transforms. the reference O(n^4) versions are still
+    // available as ispc::DCT8X8 / ispc::IDCT8X8 (Dummy:: without ispc)
+    inline void DCT8X8(const Matrix8X8f* blocks, Matrix8X8f* result, const size_t count)
+    {
+    #ifdef USE_ISPC
+        ispc::FastDCT8X8(count, reinterpret_cast<const float*>(blocks), reinterpret_cast<float*>(result));
+    #else
+        Dummy::FastDCT8X8(count, reinterpret_cast<const float*>(blocks), reinterpret_cast<float*>(result));
+    #endif
+    }
+
+    inline void IDCT8X8(const Matrix8X8f* blocks, Matrix8X8f* result, const size_t count)
     {
-        Matrix8X8f result;
     #ifdef USE_ISPC
-        ispc::DCT8X8(matrix, result);
+        ispc::FastIDCT8X8(count, reinterpret_cast<const float*>(blocks), reinterpret_cast<float*>(result));
     #else
-        Dummy::DCT8X8(matrix, result);
+        Dummy::FastIDCT8X8(count, reinterpret_cast<const float*>(blocks), reinterpret_cast<float*>(result));
     #endif
+    }
+
+    // fixed point version, the result is rounded to integer
+    inline void IDCT8X8(const Matrix8X8i16* blocks, Matrix8X8i16* result, const size_t count)
+    {
+    #ifdef USE_ISPC
+        ispc::FastIDCT8X8i16(count, reinterpret_cast<const int16_t*>(blocks), reinterpret_cast<int16_t*>(result));
+    #else
+        Dummy::FastIDCT8X8i16(count, reinterpret_cast<const int16_t*>(blocks), reinterpret_cast<int16_t*>(result));
+    #endif
+    }
+
+    inline Matrix8X8f DCT8X8(const Matrix8X8f& matrix)
+    {
+        Matrix8X8f result;
+        DCT8X8(&matrix, &result, 1);
         return result;
     }
 
     inline Matrix8X8f IDCT8X8(const Matrix8X8f& matrix)
     {
         Matrix8X8f result;
+        IDCT8X8(&matrix, &result, 1);
+        return result;
+    }
+
+    inline Matrix8X8i16 IDCT8X8(const Matrix8X8i16& matrix)
+    {
+        Matrix8X8i16 result;
+        IDCT8X8(&matrix, &result, 1);
+        return result;
+    }
+
+    // instruction set the GeomMath kernels run with. the ispc library is built
+    // for several targets and the widest one the cpu supports is picked at startup
+    enum class SimdTarget : int32_t {
+        kReference = 0, // C++ reference implementation, no ispc
+        kSSE2,
+        kSSE4,
+        kAVX,
+        kAVX2,
+        kAVX512KNL,
+        kAVX512SKX,
+        kNEON
+    };
+
+    inline SimdTarget GetSimdTarget()
+    {
     #ifdef USE_ISPC
-        ispc::IDCT8X8(matrix, result);
+        return static_cast<SimdTarget>(ispc::GetSimdTarget());
     #else
-        Dummy::IDCT8X8(matrix, result);
+        return static_cast<SimdTarget>(Dummy::GetSimdTarget());
+    #endif
+    }
+
+    // number of lanes processed per instruction by the selected target
+    inline int32_t GetSimdWidth()
+    {
+    #ifdef USE_ISPC
+        return ispc::GetSimdWidth();
+    #else
+        return Dummy::GetSimdWidth();
+    #endif
+    }
+
+    inline const char* GetSimdTargetName()
+    {
+        switch (GetSimdTarget())
+        {
+            case SimdTarget::kSSE2:
+                return "SSE2";
+            case SimdTarget::kSSE4:
+                return "SSE4";
+            case SimdTarget::kAVX:
+                return "AVX";
+            case SimdTarget::kAVX2:
+                return "AVX2";
+            case SimdTarget::kAVX512KNL:
+                return "AVX512KNL";
+            case SimdTarget::kAVX512SKX:
+                return "AVX512SKX";
+            case SimdTarget::kNEON:
+                return "NEON";
+            default:
+                return "C++ Reference";
+        }
+    }
+
+    // batch operations. the arrays are tightly packed, so Vector3f / Vector4f / Matrix4X4f
+    // arrays can be passed to the kernels as plain float arrays
+    static_assert(sizeof(Vector3f) == sizeof(float) * 3, "Vector3f must be tightly packed");
+    static_assert(sizeof(Vector4f) == sizeof(float) * 4, "Vector4f must be tightly packed");
+    static_assert(sizeof(Matrix4X4f) == sizeof(float) * 16, "Matrix4X4f must be tightly packed");
+
+    // out[i] = TransformCoord(in[i], matrix), in and out may be the same array
+    inline void TransformPoints(const size_t count, const Vector3f* in, Vector3f* out, const Matrix4X4f& matrix)
+    {
+    #ifdef USE_ISPC
+        ispc::TransformPoints(count, reinterpret_cast<const float*>(in), reinterpret_cast<float*>(out), matrix);
+    #else
+        Dummy::TransformPoints(count, reinterpret_cast<const float*>(in), reinterpret_cast<float*>(out), matrix);
+    #endif
+    }
+
+    inline void TransformPoints(const size_t count, const float* in_x, const float* in_y, const float* in_z, 
+            float* out_x, float* out_y, float* out_z, const Matrix4X4f& matrix)
+    {
+    #ifdef USE_ISPC
+        ispc::TransformPointsSoA(count, in_x, in_y, in_z, out_x, out_y, out_z, matrix);
+    #else
+        Dummy::TransformPointsSoA(count, in_x, in_y, in_z, out_x, out_y, out_z, matrix);
+    #endif
+    }
+
+    // out[i] = in[i] * matrix, in and out may be the same array
+    inline void TransformVectors(const size_t count, const Vector4f* in, Vector4f* out, const Matrix4X4f& matrix)
+    {
+    #ifdef USE_ISPC
+        ispc::TransformVectors(count, reinterpret_cast<const float*>(in), reinterpret_cast<float*>(out), matrix);
+    #else
+        Dummy::TransformVectors(count, reinterpret_cast<const float*>(in), reinterpret_cast<float*>(out), matrix);
+    #endif
+    }
+
+    // result[i] = a[i] * b[i], result must not overlap a or b
+    inline void MultiplyMatrixArray(const size_t count, const Matrix4X4f* a, const Matrix4X4f* b, Matrix4X4f* result)
+    {
+        assert(result != a && result != b);
+    #ifdef USE_ISPC
+        ispc::MultiplyMatrixArray(count, reinterpret_cast<const float*>(a), reinterpret_cast<const float*>(b), reinterpret_cast<float*>(result));
+    #else
+        Dummy::MultiplyMatrixArray(count, reinterpret_cast<const float*>(a), reinterpret_cast<const float*>(b), reinterpret_cast<float*>(result));
+    #endif
+    }
+
+    // result[i] = a[i] * b, result must not overlap a
+    inline void MultiplyMatrixArray(const size_t count, const Matrix4X4f* a, const Matrix4X4f& b, Matrix4X4f* result)
+    {
+        assert(result != a);
+    #ifdef USE_ISPC
+        ispc::MultiplyMatrixArrayByMatrix(count, reinterpret_cast<const float*>(a), b, reinterpret_cast<float*>(result));
+    #else
+        Dummy::MultiplyMatrixArrayByMatrix(count, reinterpret_cast<const float*>(a), b, reinterpret_cast<float*>(result));
+    #endif
+    }
+
+    // transform (centroid, extent) boxes and return the axis aligned box which encloses each result
+    inline void TransformAabbArray(const size_t count, const Vector3f* centroids, const Vector3f* extents, 
+            Vector3f* out_centroids, Vector3f* out_extents, const Matrix4X4f& matrix)
+    {
+    #ifdef USE_ISPC
+        ispc::TransformAabbArray(count, reinterpret_cast<const float*>(centroids), reinterpret_cast<const float*>(extents),
+                reinterpret_cast<float*>(out_centroids), reinterpret_cast<float*>(out_extents), matrix);
+    #else
+        Dummy::TransformAabbArray(count, reinterpret_cast<const float*>(centroids), reinterpret_cast<const float*>(extents),
+                reinterpret_cast<float*>(out_centroids), reinterpret_cast<float*>(out_extents), matrix);
+    #endif
+    }
+
+    // grow [bbmin, bbmax] so that it encloses all the points
+    inline void CalculateAabb(const size_t count, const Vector3f* points, Vector3f& bbmin, Vector3f& bbmax)
+    {
+    #ifdef USE_ISPC
+        ispc::CalculateAabb(count, reinterpret_cast<const float*>(points), bbmin, bbmax);
+    #else
+        Dummy::CalculateAabb(count, reinterpret_cast<const float*>(points), bbmin, bbmax);
+    #endif
+    }
+
+    inline void NormalizeArray(const size_t count, Vector3f* v)
+    {
+    #ifdef USE_ISPC
+        ispc::NormalizeArray(count, reinterpret_cast<float*>(v));
+    #else
+        Dummy::NormalizeArray(count, reinterpret_cast<float*>(v));
+    #endif
+    }
+
+    inline void NormalizeArray(const size_t count, float* x, float* y, float* z)
+    {
+    #ifdef USE_ISPC
+        ispc::NormalizeArraySoA(count, x, y, z);
+    #else
+        Dummy::NormalizeArraySoA(count, x, y, z);
     #endif
-        return result;
     }
 
     typedef Vector<float, 2> Point2D;
@@ -0,0 +1,256 @@
+#pragma once
+#include <cmath>
+
+// Header-only fast path for the small fixed size float operations
+// (4 component vectors and 4x4 matrices). These are called many times
+// per frame, so they must be inlinable by the compiler instead of being
+// out-of-line ISPC calls. ISPC is still used for the large array operations.
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define MYGE_SIMD_SSE 1
+    #include <emmintrin.h>
+    #if defined(__SSE4_1__)
+        #include <smmintrin.h>
+    #endif
+    #if defined(__AVX__)
+        #define MYGE_SIMD_AVX 1
+        #include <immintrin.h>
+    #endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    #define MYGE_SIMD_NEON 1
+    #include <arm_neon.h>
+#endif
+
+namespace Simd { /* namespace */
+#if MYGE_SIMD_SSE
+    typedef __m128 float4;
+
+    inline float4 Load4(const float* p) { return _mm_loadu_ps(p); }
+    inline void Store4(float* p, float4 v) { _mm_storeu_ps(p, v); }
+    inline float4 Splat4(const float f) { return _mm_set1_ps(f); }
+    inline float4 Add4(float4 a, float4 b) { return _mm_add_ps(a, b); }
+    inline float4 Sub4(float4 a, float4 b) { return _mm_sub_ps(a, b); }
+    inline float4 Mul4(float4 a, float4 b) { return _mm_mul_ps(a, b); }
+    inline float4 Div4(float4 a, float4 b) { return _mm_div_ps(a, b); }
+    #if defined(__FMA__)
+    inline float4 MulAdd4(float4 a, float4 b, float4 c) { return _mm_fmadd_ps(a, b, c); }
+    #else
+    inline float4 MulAdd4(float4 a, float4 b, float4 c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+    #endif
+    template <int i>
+    inline float4 Broadcast4(float4 v) { return _mm_shuffle_ps(v, v, _MM_SHUFFLE(i, i, i, i)); }
+
+    inline float HorizontalSum4(float4 v)
+    {
+        float4 shuf = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+        float4 sums = _mm_add_ps(v, shuf);
+        shuf = _mm_movehl_ps(shuf, sums);
+        sums = _mm_add_ss(sums, shuf);
+        return _mm_cvtss_f32(sums);
+    }
+#elif MYGE_SIMD_NEON
+    typedef float32x4_t float4;
+
+    inline float4 Load4(const float* p) { return vld1q_f32(p); }
+    inline void Store4(float* p, float4 v) { vst1q_f32(p, v); }
+    inline float4 Splat4(const float f) { return vdupq_n_f32(f); }
+    inline float4 Add4(float4 a, float4 b) { return vaddq_f32(a, b); }
+    inline float4 Sub4(float4 a, float4 b) { return vsubq_f32(a, b); }
+    inline float4 Mul4(float4 a, float4 b) { return vmulq_f32(a, b); }
+    #if defined(__aarch64__)
+    inline float4 Div4(float4 a, float4 b) { return vdivq_f32(a, b); }
+    #else
+    inline float4 Div4(float4 a, float4 b)
+    {
+        // two Newton-Raphson steps are accurate enough for float
+        float4 r = vrecpeq_f32(b);
+        r = vmulq_f32(vrecpsq_f32(b, r), r);
+        r = vmulq_f32(vrecpsq_f32(b, r), r);
+        return vmulq_f32(a, r);
+    }
+    #endif
+    inline float4 MulAdd4(float4 a, float4 b, float4 c) { return vmlaq_f32(c, a, b); }
+    template <int i>
+    inline float4 Broadcast4(float4 v) { return vdupq_n_f32(vgetq_lane_f32(v, i)); }
+
+    inline float HorizontalSum4(float4 v)
+    {
+        float32x2_t r = vadd_f32(vget_high_f32(v), vget_low_f32(v));
+        return vget_lane_f32(vpadd_f32(r, r), 0);
+    }
+#endif
+
+#if MYGE_SIMD_SSE || MYGE_SIMD_NEON
+    inline void AddByElement4(const float a[4], const float b[4], float result[4])
+    {
+        Store4(result, Add4(Load4(a), Load4(b)));
+    }
+
+    inline void SubByElement4(const float a[4], const float b[4], float result[4])
+    {
+        Store4(result, Sub4(Load4(a), Load4(b)));
+    }
+
+    inline void MulByElement4(const float a[4], const float b[4], float result[4])
+    {
+        Store4(result, Mul4(Load4(a), Load4(b)));
+    }
+
+    inline void MulByElement4(const float a[4], const float b, float result[4])
+    {
+        Store4(result, Mul4(Load4(a), Splat4(b)));
+    }
+
+    inline void DivByElement4(const float a[4], const float b[4], float result[4])
+    {
+        Store4(result, Div4(Load4(a), Load4(b)));
+    }
+
+    inline float DotProduct4(const float a[4], const float b[4])
+    {
+        return HorizontalSum4(Mul4(Load4(a), Load4(b)));
+    }
+
+    // row vector * matrix, the same convention as ispc::Transform
+    inline void Transform(float vector[4], const float matrix[16])
+    {
+        float4 v = Load4(vector);
+        float4 r = Mul4(Broadcast4<0>(v), Load4(matrix));
+        r = MulAdd4(Broadcast4<1>(v), Load4(matrix + 4), r);
+        r = MulAdd4(Broadcast4<2>(v), Load4(matrix + 8), r);
+        r = MulAdd4(Broadcast4<3>(v), Load4(matrix + 12), r);
+        Store4(vector, r);
+    }
+
+    // result = a * b. all rows of b and each row of a are loaded before
+    // the corresponding row of result is written, so result may alias a or b
+    inline void MatrixMultiply4X4(float result[16], const float a[16], const float b[16])
+    {
+    #if MYGE_SIMD_AVX
+        // process two rows of the result per 256bit register
+        const __m256 b0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(b));
+        const __m256 b1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(b + 4));
+        const __m256 b2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(b + 8));
+        const __m256 b3 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(b + 12));
+        const __m256 a01 = _mm256_loadu_ps(a);
+        const __m256 a23 = _mm256_loadu_ps(a + 8);
+
+        __m256 r01 = _mm256_mul_ps(_mm256_shuffle_ps(a01, a01, 0x00), b0);
+        r01 = _mm256_add_ps(r01, _mm256_mul_ps(_mm256_shuffle_ps(a01, a01, 0x55), b1));
+        r01 = _mm256_add_ps(r01, _mm256_mul_ps(_mm256_shuffle_ps(a01, a01, 0xAA), b2));
+        r01 = _mm256_add_ps(r01, _mm256_mul_ps(_mm256_shuffle_ps(a01, a01, 0xFF), b3));
+
+        __m256 r23 = _mm256_mul_ps(_mm256_shuffle_ps(a23, a23, 0x00), b0);
+        r23 = _mm256_add_ps(r23, _mm256_mul_ps(_mm256_shuffle_ps(a23, a23, 0x55), b1));
+        r23 = _mm256_add_ps(r23, _mm256_mul_ps(_mm256_shuffle_ps(a23, a23, 0xAA), b2));
+        r23 = _mm256_add_ps(r23, _mm256_mul_ps(_mm256_shuffle_ps(a23, a23, 0xFF), b3));
+
+        _mm256_storeu_ps(result, r01);
+        _mm256_storeu_ps(result + 8, r23);
+    #else
+        const float4 b0 = Load4(b);
+        const float4 b1 = Load4(b + 4);
+        const float4 b2 = Load4(b + 8);
+        const float4 b3 = Load4(b + 12);
+
+        for (int i = 0; i < 4; i++)
+        {
+            float4 row = Load4(a + i * 4);
+            float4 r = Mul4(Broadcast4<0>(row), b0);
+            r = MulAdd4(Broadcast4<1>(row), b1, r);
+            r = MulAdd4(Broadcast4<2>(row), b2, r);
+            r = MulAdd4(Broadcast4<3>(row), b3, r);
+            Store4(result + i * 4, r);
+        }
+    #endif
+    }
+
+    inline void Transpose4X4(const float a[16], float result[16])
+    {
+    #if MYGE_SIMD_SSE
+        float4 r0 = Load4(a);
+        float4 r1 = Load4(a + 4);
+        float4 r2 = Load4(a + 8);
+        float4 r3 = Load4(a + 12);
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        Store4(result, r0);
+        Store4(result + 4, r1);
+        Store4(result + 8, r2);
+        Store4(result + 12, r3);
+    #else
+        float32x4x4_t m = vld4q_f32(a);
+        vst1q_f32(result, m.val[0]);
+        vst1q_f32(result + 4, m.val[1]);
+        vst1q_f32(result + 8, m.val[2]);
+        vst1q_f32(result + 12, m.val[3]);
+    #endif
+    }
+#else
+    // portable scalar version, still fully inlinable
+    inline void AddByElement4(const float a[4], const float b[4], float result[4])
+    {
+        for (int i = 0; i < 4; i++) result[i] = a[i] + b[i];
+    }
+
+    inline void SubByElement4(const float a[4], const float b[4], float result[4])
+    {
+        for (int i = 0; i < 4; i++) result[i] = a[i] - b[i];
+    }
+
+    inline void MulByElement4(const float a[4], const float b[4], float result[4])
+    {
+        for (int i = 0; i < 4; i++) result[i] = a[i] * b[i];
+    }
+
+    inline void MulByElement4(const float a[4], const float b, float result[4])
+    {
+        for (int i = 0; i < 4; i++) result[i] = a[i] * b;
+    }
+
+    inline void DivByElement4(const float a[4], const float b[4], float result[4])
+    {
+        for (int i = 0; i < 4; i++) result[i] = a[i] / b[i];
+    }
+
+    inline float DotProduct4(const float a[4], const float b[4])
+    {
+        return a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+    }
+
+    inline void Transform(float vector[4], const float matrix[16])
+    {
+        const float v[4] = { vector[0], vector[1], vector[2], vector[3] };
+        for (int i = 0; i < 4; i++)
+        {
+            vector[i] = v[0] * matrix[i] + v[1] * matrix[i + 4] + v[2] * matrix[i + 8] + v[3] * matrix[i + 12];
+        }
+    }
+
+    inline void MatrixMultiply4X4(float result[16], const float a[16], const float b[16])
+    {
+        float r[16];
+        for (int i = 0; i < 4; i++)
+        {
+            for (int j = 0; j < 4; j++)
+            {
+                r[i * 4 + j] = a[i * 4] * b[j] + a[i * 4 + 1] * b[4 + j]
+                    + a[i * 4 + 2] * b[8 + j] + a[i * 4 + 3] * b[12 + j];
+            }
+        }
+        for (int i = 0; i < 16; i++) result[i] = r[i];
+    }
+
+    inline void Transpose4X4(const float a[16], float result[16])
+    {
+        float r[16];
+        for (int i = 0; i < 4; i++)
+        {
+            for (int j = 0; j < 4; j++)
+            {
+                r[j * 4 + i] = a[i * 4 + j];
+            }
+        }
+        for (int i = 0; i < 16; i++) result[i] = r[i];
+    }
+#endif
+} /* namespace */
@@ -4,11 +4,19 @@
 #include "Buffer.hpp"
 
 namespace My {
+    // layout the decoded image is written in. kImageOutputFormatRGBA widens
+    // 24/48 bit RGB and float RGB images with an opaque alpha channel, since
+    // GPUs have no such texture formats. other layouts are left alone
+    enum class ImageOutputFormat {
+        kImageOutputFormatNative,
+        kImageOutputFormatRGBA
+    };
+
     Interface ImageParser
     {
     public:
         virtual ~ImageParser() = default;
-        virtual Image Parse(Buffer& buf) = 0;
+        virtual Image Parse(Buffer& buf, ImageOutputFormat format = ImageOutputFormat::kImageOutputFormatNative) = 0;
     };
 }
 
@@ -1,6 +1,7 @@
 #pragma once
 #include <iostream>
 #include "ImageParser.hpp"
+#include "PixelFormatConversion.hpp"
 
 namespace My {
 #pragma pack(push, 1)
@@ -31,9 +32,13 @@ namespace My {
     class BmpParser : implements ImageParser
     {
     public:
-        virtual Image Parse(Buffer& buf)
+        virtual Image Parse(Buffer& buf, ImageOutputFormat format = ImageOutputFormat::kImageOutputFormatNative)
         {
             Image img;
+            if (buf.GetDataSize() < BITMAP_FILEHEADER_SIZE + sizeof(BITMAP_HEADER)) {
+                std::cerr << "BMP file is truncated." << std::endl;
+                return img;
+            }
             const BITMAP_FILEHEADER* pFileHeader = reinterpret_cast<const BITMAP_FILEHEADER*>(buf.GetData());
             const BITMAP_HEADER* pBmpHeader = reinterpret_cast<const BITMAP_HEADER*>(reinterpret_cast<const uint8_t*>(buf.GetData())+ BITMAP_FILEHEADER_SIZE);
             if (pFileHeader->Signature == 0x4D42 /* 'B''M' */) {
@@ -49,26 +54,40 @@ namespace My {
                 std::cerr << "Image Compression: " << pBmpHeader->Compression << std::endl;
                 std::cerr << "Image Size: " << pBmpHeader->SizeImage << std::endl;
 
-                img.Width = pBmpHeader->Width;
-                img.Height = pBmpHeader->Height;
-                img.bitcount = 32;
-                auto byte_count = img.bitcount >> 3;
-                img.pitch = ((img.Width * byte_count) + 3) & ~3;
-                img.data_size = img.pitch * img.Height;
-                img.data = new uint8_t[img.data_size];
+                // rows are stored bottom up unless the height is negative, each
+                // padded to 4 bytes
+                const bool top_down = pBmpHeader->Height < 0;
+                const uint32_t src_byte_count = pBmpHeader->BitCount >> 3;
+                img.Width = static_cast<uint32_t>(pBmpHeader->Width);
+                img.Height = static_cast<uint32_t>(top_down ? -pBmpHeader->Height : pBmpHeader->Height);
+                const size_t src_pitch = ((img.Width * src_byte_count) + 3) & ~3u;
 
-                if (img.bitcount < 24) {
-                    std::cerr << "Sorry, only true color BMP is supported at now." << std::endl;
+                if (pBmpHeader->Width <= 0 || (pBmpHeader->BitCount != 24 && pBmpHeader->BitCount != 32)
+                        || (pBmpHeader->Compression != 0 /* BI_RGB */ && pBmpHeader->Compression != 3 /* BI_BITFIELDS */)) {
+                    std::cerr << "Sorry, only uncompressed 24 and 32 bit BMP is supported at now." << std::endl;
+                    img.Width = img.Height = 0;
+                } else if (pFileHeader->BitsOffset > buf.GetDataSize()
+                        || src_pitch * img.Height > buf.GetDataSize() - pFileHeader->BitsOffset) {
+                    std::cerr << "BMP file is truncated." << std::endl;
+                    img.Width = img.Height = 0;
                 } else {
+                    // 24 bit stays 24 bit unless RGBA is asked for
+                    const bool expand_to_rgba = (pBmpHeader->BitCount == 32 || format == ImageOutputFormat::kImageOutputFormatRGBA);
+                    img.bitcount = expand_to_rgba ? 32 : 24;
+                    img.pitch = ((img.Width * (img.bitcount >> 3)) + 3) & ~3u;
+                    img.data_size = img.pitch * img.Height;
+                    img.data = new uint8_t[img.data_size];
+
                     const uint8_t* pSourceData = reinterpret_cast<const uint8_t*>(buf.GetData()) + pFileHeader->BitsOffset;
-                    for (int32_t y = img.Height - 1; y >= 0; y--) {
-                        for (uint32_t x = 0; x < img.Width; x++) {
-                            auto dst = reinterpret_cast<R8G8B8A8Unorm*>(reinterpret_cast<uint8_t*>(img.data) + img.pitch * (img.Height - y - 1) + x * byte_count);
-                            auto src = reinterpret_cast<const R8G8B8A8Unorm*>(pSourceData + img.pitch * y + x * byte_count);
-                            dst->data[2] = src->data[0];
-                            dst->data[1] = src->data[1];
-                            dst->data[0] = src->data[2];
-                            dst->data[3] = src->data[3];
+                    for (uint32_t y = 0; y < img.Height; y++) {
+                        const uint8_t* src = pSourceData + src_pitch * (top_down ? y : img.Height - y - 1);
+                        uint8_t* dest = img.data + img.pitch * y;
+                        if (pBmpHeader->BitCount == 32) {
+                            SwizzleBGRA8ToRGBA8(src, dest, img.Width);
+                        } else if (expand_to_rgba) {
+                            SwizzleBGR8ToRGBA8(src, dest, img.Width);
+                        } else {
+                            SwizzleBGR8ToRGB8(src, dest, img.Width);
                         }
                     }
                 }
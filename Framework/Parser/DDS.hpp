@@ -1,5 +1,8 @@
 #pragma once
 #include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
 
 #ifdef _WIN32
 #include <dxgiformat.h>
@@ -8,6 +11,7 @@
 
 #include "ImageParser.hpp"
 #include "portable.hpp"
+#include "BlockCompression.hpp"
 
 namespace My {
     typedef enum MY_DXGI_FORMAT {
@@ -184,8 +188,219 @@ namespace My {
 
     class DdsParser : implements ImageParser
     {
+    protected:
+        bool m_bDecompress = false;
+        bool m_bMultithreaded = true;
+
+        // below this many blocks a thread costs more than it saves
+        static const uint32_t kMinBlocksForThreading = 4096;
+
+        static bool isBlockCompressed(const MY_DXGI_FORMAT format)
+        {
+            return (format >= DXGI_FORMAT_BC1_TYPELESS && format <= DXGI_FORMAT_BC5_SNORM)
+                || (format >= DXGI_FORMAT_BC6H_TYPELESS && format <= DXGI_FORMAT_BC7_UNORM_SRGB);
+        }
+
+        // bytes of a 4x4 block
+        static uint32_t blockSize(const MY_DXGI_FORMAT format)
+        {
+            return (format <= DXGI_FORMAT_BC1_UNORM_SRGB || (format >= DXGI_FORMAT_BC4_TYPELESS && format <= DXGI_FORMAT_BC4_SNORM)) ? 8 : 16;
+        }
+
+        // the tag Image::compress_format uses for a DXGI block format
+        static uint32_t compressFormat(const MY_DXGI_FORMAT format)
+        {
+            switch (format)
+            {
+                case DXGI_FORMAT_BC1_TYPELESS:
+                case DXGI_FORMAT_BC1_UNORM:
+                case DXGI_FORMAT_BC1_UNORM_SRGB:
+                    return "DXT1"_u32;
+                case DXGI_FORMAT_BC2_TYPELESS:
+                case DXGI_FORMAT_BC2_UNORM:
+                case DXGI_FORMAT_BC2_UNORM_SRGB:
+                    return "DXT3"_u32;
+                case DXGI_FORMAT_BC3_TYPELESS:
+                case DXGI_FORMAT_BC3_UNORM:
+                case DXGI_FORMAT_BC3_UNORM_SRGB:
+                    return "DXT5"_u32;
+                case DXGI_FORMAT_BC5_TYPELESS:
+                case DXGI_FORMAT_BC5_UNORM:
+                    return "BC5U"_u32;
+                case DXGI_FORMAT_BC7_TYPELESS:
+                case DXGI_FORMAT_BC7_UNORM:
+                case DXGI_FORMAT_BC7_UNORM_SRGB:
+                    return "BC7U"_u32;
+                default:
+                    return "DX10"_u32;
+            }
+        }
+
+        static void decodeBlock(const MY_DXGI_FORMAT format, const uint8_t* block, uint8_t* dest, const size_t dest_pitch)
+        {
+            switch (format)
+            {
+                case DXGI_FORMAT_BC1_TYPELESS:
+                case DXGI_FORMAT_BC1_UNORM:
+                case DXGI_FORMAT_BC1_UNORM_SRGB:
+                    DecodeBC1Block(block, dest, dest_pitch);
+                    break;
+                case DXGI_FORMAT_BC2_TYPELESS:
+                case DXGI_FORMAT_BC2_UNORM:
+                case DXGI_FORMAT_BC2_UNORM_SRGB:
+                    DecodeBC2Block(block, dest, dest_pitch);
+                    break;
+                case DXGI_FORMAT_BC3_TYPELESS:
+                case DXGI_FORMAT_BC3_UNORM:
+                case DXGI_FORMAT_BC3_UNORM_SRGB:
+                    DecodeBC3Block(block, dest, dest_pitch);
+                    break;
+                case DXGI_FORMAT_BC4_TYPELESS:
+                case DXGI_FORMAT_BC4_UNORM:
+                case DXGI_FORMAT_BC4_SNORM:
+                    DecodeBC4Block(block, dest, dest_pitch, format == DXGI_FORMAT_BC4_SNORM);
+                    break;
+                case DXGI_FORMAT_BC5_TYPELESS:
+                case DXGI_FORMAT_BC5_UNORM:
+                case DXGI_FORMAT_BC5_SNORM:
+                    DecodeBC5Block(block, dest, dest_pitch, format == DXGI_FORMAT_BC5_SNORM);
+                    break;
+                case DXGI_FORMAT_BC6H_TYPELESS:
+                case DXGI_FORMAT_BC6H_UF16:
+                case DXGI_FORMAT_BC6H_SF16:
+                    DecodeBC6HBlock(block, dest, dest_pitch, format == DXGI_FORMAT_BC6H_SF16);
+                    break;
+                default:
+                    DecodeBC7Block(block, dest, dest_pitch);
+            }
+        }
+
+        // decode block rows [begin, end) of one mip level. blocks which
+        // reach over the right or bottom edge go through a 4x4 buffer
+        static void decodeBlockRows(const MY_DXGI_FORMAT format, const uint8_t* src, const Image::Mipmap& src_mip,
+                uint8_t* dest, const Image::Mipmap& dest_mip, const uint32_t pixel_size, const uint32_t begin, const uint32_t end)
+        {
+            const uint32_t block_size = blockSize(format);
+            const uint32_t blocks_x = (src_mip.Width + 3) >> 2;
+            uint8_t edge[4 * 4 * 8];
+            for (uint32_t by = begin; by < end; by++)
+            {
+                const uint8_t* block = src + src_mip.pitch * by;
+                const uint32_t rows = std::min(4u, src_mip.Height - by * 4);
+                uint8_t* out = dest + dest_mip.pitch * by * 4;
+                for (uint32_t bx = 0; bx < blocks_x; bx++, block += block_size)
+                {
+                    const uint32_t columns = std::min(4u, src_mip.Width - bx * 4);
+                    if (rows == 4 && columns == 4)
+                    {
+                        decodeBlock(format, block, out + bx * 4 * pixel_size, dest_mip.pitch);
+                    }
+                    else
+                    {
+                        decodeBlock(format, block, edge, 4 * pixel_size);
+                        for (uint32_t y = 0; y < rows; y++)
+                        {
+                            std::memcpy(out + dest_mip.pitch * y + bx * 4 * pixel_size, edge + 4 * pixel_size * y, columns * pixel_size);
+                        }
+                    }
+                }
+            }
+        }
+
+        // block compressed image to R8G8B8A8, or R16G16B16A16 half float for
+        // BC6H, with all of its mip levels
+        Image decompress(const Image& src, const MY_DXGI_FORMAT format) const
+        {
+            Image img;
+            img.Width = src.Width;
+            img.Height = src.Height;
+            img.compressed = false;
+            img.is_float = (format >= DXGI_FORMAT_BC6H_TYPELESS && format <= DXGI_FORMAT_BC6H_SF16);
+            img.bitcount = img.is_float ? 64 : 32;
+            const uint32_t pixel_size = img.bitcount >> 3;
+
+            // every block row of every mip is a work item
+            uint32_t mip_count = 0;
+            uint32_t first_row[11] = { 0 };
+            uint32_t total_blocks = 0;
+            img.data_size = 0;
+            for (uint32_t i = 0; i < 10 && src.mipmaps[i].data_size; i++, mip_count++)
+            {
+                const Image::Mipmap& mip = src.mipmaps[i];
+                img.mipmaps[i].Width = mip.Width;
+                img.mipmaps[i].Height = mip.Height;
+                img.mipmaps[i].pitch = mip.Width * pixel_size;
+                img.mipmaps[i].offset = img.data_size;
+                img.mipmaps[i].data_size = img.mipmaps[i].pitch * mip.Height;
+                img.data_size += img.mipmaps[i].data_size;
+                first_row[i + 1] = first_row[i] + ((mip.Height + 3) >> 2);
+                total_blocks += ((mip.Width + 3) >> 2) * ((mip.Height + 3) >> 2);
+            }
+            img.mipmap_count = mip_count;
+            img.pitch = img.mipmaps[0].pitch;
+            img.data = new uint8_t[img.data_size];
+
+            auto decodeRows = [&](const uint32_t begin, const uint32_t end) {
+                for (uint32_t i = 0; i < mip_count; i++)
+                {
+                    const uint32_t row_begin = std::max(begin, first_row[i]);
+                    const uint32_t row_end = std::min(end, first_row[i + 1]);
+                    if (row_begin >= row_end) continue;
+                    decodeBlockRows(format, src.data + src.mipmaps[i].offset, src.mipmaps[i],
+                            img.data + img.mipmaps[i].offset, img.mipmaps[i], pixel_size,
+                            row_begin - first_row[i], row_end - first_row[i]);
+                }
+            };
+
+#ifndef OS_WEBASSEMBLY
+            const uint32_t total_rows = first_row[mip_count];
+            unsigned int thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+            thread_count = std::min(thread_count, total_rows);
+            if (m_bMultithreaded && thread_count > 1 && total_blocks >= kMinBlocksForThreading)
+            {
+                // the mips make the rows uneven, so the threads take a few
+                // block rows at a time instead of fixed bands
+                std::atomic<uint32_t> next_row(0);
+                const uint32_t rows_per_task = std::max(1u, total_rows / (thread_count * 16));
+                auto worker = [&]() {
+                    uint32_t begin;
+                    while ((begin = next_row.fetch_add(rows_per_task)) < total_rows)
+                    {
+                        decodeRows(begin, std::min(begin + rows_per_task, total_rows));
+                    }
+                };
+
+                std::vector<std::thread> threads;
+                for (unsigned int i = 1; i < thread_count; i++)
+                {
+                    threads.emplace_back(worker);
+                }
+                worker();
+                for (auto& thread : threads)
+                {
+                    thread.join();
+                }
+                return img;
+            }
+#endif
+            decodeRows(0, first_row[mip_count]);
+
+            return img;
+        }
+
     public:
-        virtual Image Parse(Buffer& buf)
+        // decode BC1-BC7 images on the CPU, for paths without a GPU or with
+        // one that lacks the format. the result is uncompressed R8G8B8A8
+        // (R16G16B16A16 half float for BC6H) and keeps every mip level.
+        // signed BC4/BC5 are biased by 128
+        void SetDecompress(bool decompress) { m_bDecompress = decompress; }
+
+        // decode the blocks on all cores
+        void SetMultithreaded(bool multithreaded) { m_bMultithreaded = multithreaded; }
+
+        // the pixels keep the layout stored in the file, or R8G8B8A8 when
+        // decompressed, so format needs no handling
+        virtual Image Parse(Buffer& buf, ImageOutputFormat /*format*/ = ImageOutputFormat::kImageOutputFormatNative)
         {
             Image img;
             uint8_t* pData = buf.GetData();
@@ -202,7 +417,7 @@ namespace My {
             img.Width = pHeader->dwWidth;
             img.Height = pHeader->dwHeight;
             img.pitch = pHeader->dwPitchOrLinearSize; //unreliable
-            img.mipmap_count = pHeader->dwMipMapCount;
+            img.mipmap_count = std::min(pHeader->dwMipMapCount, 10u); // size of Image::mipmaps
             assert(pHeader->ddspf.dwSize == 32);
 
             if (pHeader->ddspf.dwFlags & 0x4 /* DDPF_FOURCC */)
@@ -242,36 +457,42 @@ namespace My {
                 }
             }
 
+            MY_DXGI_FORMAT block_format = DXGI_FORMAT_UNKNOWN;
             if (img.compressed)
             {
                 const uint32_t* pdwFourCC = &pHeader->ddspf.dwFourCC;
                 if (*pdwFourCC == endian_net_unsigned_int("DXT1"_u32))
                 {
                     img.compress_format = "DXT1"_u32;
+                    block_format = DXGI_FORMAT_BC1_UNORM;
                     img.pitch = std::max(1u, ALIGN(img.Width, 4)) * 2;
                     img.bitcount = 4;
                 }
                 else if (*pdwFourCC == endian_net_unsigned_int("DXT2"_u32))
                 {
                     img.compress_format = "DXT2"_u32;
+                    block_format = DXGI_FORMAT_BC2_UNORM;
                     img.pitch = std::max(1u, ALIGN(img.Width, 4)) * 4;
                     img.bitcount = 8;
                 }
                 else if (*pdwFourCC == endian_net_unsigned_int("DXT3"_u32))
                 {
                     img.compress_format = "DXT3"_u32;
+                    block_format = DXGI_FORMAT_BC2_UNORM;
                     img.pitch = std::max(1u, ALIGN(img.Width, 4)) * 4;
                     img.bitcount = 8;
                 }
                 else if (*pdwFourCC == endian_net_unsigned_int("DXT4"_u32))
                 {
                     img.compress_format = "DXT4"_u32;
+                    block_format = DXGI_FORMAT_BC3_UNORM;
                     img.pitch = std::max(1u, ALIGN(img.Width, 4)) * 4;
                     img.bitcount = 8;
                 }
                 else if (*pdwFourCC == endian_net_unsigned_int("DXT5"_u32))
                 {
                     img.compress_format = "DXT5"_u32;
+                    block_format = DXGI_FORMAT_BC3_UNORM;
                     img.pitch = std::max(1u, ALIGN(img.Width, 4)) * 4;
                     img.bitcount = 8;
                 }
@@ -281,6 +502,14 @@ namespace My {
                     const DDS_HEADER_DXT10* pHeaderDXT10 = reinterpret_cast<const DDS_HEADER_DXT10*>(pData);
                     pData += sizeof(DDS_HEADER_DXT10);
                     std::cerr << "DXGI_FORMAT: " << pHeaderDXT10->dxgiFormat << std::endl;
+
+                    if (isBlockCompressed(pHeaderDXT10->dxgiFormat))
+                    {
+                        block_format = pHeaderDXT10->dxgiFormat;
+                        img.bitcount = blockSize(block_format) / 2; // bits per pixel
+                        img.pitch = std::max(1u, ALIGN(img.Width, 4) >> 2) * blockSize(block_format);
+                        img.compress_format = compressFormat(block_format);
+                    }
                 }
                 
                 img.data_size = img.pitch * (ALIGN(img.Height, 4) >> 2);
@@ -364,7 +593,88 @@ namespace My {
 
             memcpy(img.data, pData, img.data_size);
 
+            if (m_bDecompress && block_format != DXGI_FORMAT_UNKNOWN)
+            {
+                Image decompressed = decompress(img, block_format);
+                delete[] img.data;
+                return decompressed;
+            }
+
             return img;
         }
     };
-}
\ No newline at end of file
+
+    // block compressed images to .dds files DdsParser reads back. DXT1, DXT3
+    // and DXT5 use the legacy header, BC5 and BC7 the DX10 one
+    class DdsWriter
+    {
+    public:
+        Buffer Write(const Image& img) const
+        {
+            MY_DXGI_FORMAT dxgi_format = DXGI_FORMAT_UNKNOWN;
+            uint32_t four_cc = img.compress_format;
+            switch (img.compress_format)
+            {
+                case "DXT1"_u32:
+                case "DXT3"_u32:
+                case "DXT5"_u32:
+                    break;
+                case "BC5U"_u32:
+                    dxgi_format = DXGI_FORMAT_BC5_UNORM;
+                    four_cc = "DX10"_u32;
+                    break;
+                case "BC7U"_u32:
+                    dxgi_format = DXGI_FORMAT_BC7_UNORM;
+                    four_cc = "DX10"_u32;
+                    break;
+                default:
+                    four_cc = 0;
+            }
+            if (!img.compressed || !four_cc)
+            {
+                std::cerr << "[Error] DdsWriter only writes DXT1, DXT3, DXT5, BC5 and BC7 images" << std::endl;
+                return Buffer();
+            }
+
+            const uint32_t mipmap_count = std::max(img.mipmap_count, 1u);
+            DDS_HEADER header;
+            std::memset(&header, 0x00, sizeof(header));
+            header.dwSize = sizeof(DDS_HEADER);
+            header.dwFlags = 0x1 | 0x2 | 0x4 | 0x1000 | 0x80000; // CAPS | HEIGHT | WIDTH | PIXELFORMAT | LINEARSIZE
+            if (mipmap_count > 1) header.dwFlags |= 0x20000;    // MIPMAPCOUNT
+            header.dwHeight = img.Height;
+            header.dwWidth = img.Width;
+            header.dwPitchOrLinearSize = static_cast<uint32_t>(img.mipmaps[0].data_size);
+            header.dwMipMapCount = mipmap_count;
+            header.ddspf.dwSize = sizeof(DDS_PIXELFORMAT);
+            header.ddspf.dwFlags = 0x4; // DDPF_FOURCC
+            header.ddspf.dwFourCC = endian_net_unsigned_int(four_cc);
+            header.dwCaps = 0x1000; // DDSCAPS_TEXTURE
+            if (mipmap_count > 1) header.dwCaps |= 0x8 | 0x400000; // DDSCAPS_COMPLEX | DDSCAPS_MIPMAP
+
+            const size_t header_size = sizeof(uint32_t) + sizeof(DDS_HEADER) + (dxgi_format ? sizeof(DDS_HEADER_DXT10) : 0);
+            Buffer buf(header_size + img.data_size);
+            uint8_t* pData = buf.GetData();
+
+            const uint32_t magic = endian_net_unsigned_int("DDS "_u32);
+            std::memcpy(pData, &magic, sizeof(magic));
+            pData += sizeof(magic);
+            std::memcpy(pData, &header, sizeof(header));
+            pData += sizeof(header);
+            if (dxgi_format)
+            {
+                DDS_HEADER_DXT10 header_dxt10;
+                header_dxt10.dxgiFormat = dxgi_format;
+                header_dxt10.resourceDimension = D3D10_RESOURCE_DIMENSION_TEXTURE2D;
+                header_dxt10.miscFlag = 0;
+                header_dxt10.arraySize = 1;
+                header_dxt10.miscFlag2 = 0;
+                std::memcpy(pData, &header_dxt10, sizeof(header_dxt10));
+                pData += sizeof(header_dxt10);
+            }
+            std::memcpy(pData, img.data, img.data_size);
+
+            return buf;
+        }
+    };
+}
@@ -1,157 +1,203 @@
 #pragma once
 #include <cstdio>
 #include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
 #include "ImageParser.hpp"
+#include "PixelFormatConversion.hpp"
 
 namespace My {
-    static inline void 
-    rgbe2float(float *red, float *green, float *blue, unsigned char rgbe[4])
+    // Radiance RGBE (.hdr) images. the pixels are stored as 8 bit mantissas
+    // sharing an 8 bit exponent, either flat, with old style run length
+    // encoding or with the per channel scan line run length encoding of
+    // newer files, which most files use
+    class HdrParser : implements ImageParser
     {
-        float f;
+    protected:
+        bool m_bHalfFloatOutput = false;
 
-        if (rgbe[3]) {   /*nonzero pixel*/
-            f = ldexp(1.0f, rgbe[3]-(int)(128+8));
-            *red = rgbe[0] * f;
-            *green = rgbe[1] * f;
-            *blue = rgbe[2] * f;
+        // a header line without the '\n', pData is advanced past it
+        static bool readLine(const uint8_t*& pData, const uint8_t* pDataEnd, std::string& line)
+        {
+            const uint8_t* p = pData;
+            while (p < pDataEnd && *p != '\n') p++;
+            if (p == pDataEnd) return false;
+            line.assign(reinterpret_cast<const char*>(pData), p - pData);
+            pData = p + 1;
+            return true;
         }
-        else
-            *red = *green = *blue = 0.0f;
-    }
 
-    class HdrParser : implements ImageParser
-    {
-    public:
-        virtual Image Parse(Buffer& buf)
+        // decode one scan line of width RGBE pixels into scanline
+        static bool decodeScanLine(const uint8_t*& pData, const uint8_t* pDataEnd, const uint32_t width, uint8_t* scanline)
         {
-            Image img;
-            char* pData = reinterpret_cast<char*>(buf.GetData());
-            auto remain_size = buf.GetDataSize();
+            if (pDataEnd - pData < 4) return false;
 
-            if (std::strncmp(pData, "#?RADIANCE\n", sizeof("#?RADIANCE\n")))
+            // new style run length encoding starts with 2, 2 and the width. it is
+            // only used for widths in [8, 32767]
+            if (width < 8 || width > 0x7FFF || pData[0] != 2 || pData[1] != 2 || (pData[2] & 0x80)
+                    || static_cast<uint32_t>((pData[2] << 8) | pData[3]) != width)
             {
-                std::cerr << "Image File is HDR format" << std::endl;
-                pData += sizeof("#?RADIANCE");
+                return decodeOldScanLine(pData, pDataEnd, width, scanline);
+            }
+            pData += 4;
 
-                // process the header
-                while(*pData != '\n')
+            // the 4 channels follow each other, each as runs and literal spans
+            for (uint32_t channel = 0; channel < 4; channel++)
+            {
+                uint32_t x = 0;
+                while (x < width)
                 {
-                    char* p = pData;
-                    // find the line end
-                    while(*++p != '\n' && --remain_size > 0) {}
-                    if (remain_size == 0) break;
-                    assert(*p == '\n');
-                    *p = '\0';
-                    if (*pData == '#')
+                    if (pData >= pDataEnd) return false;
+                    uint32_t count = *pData++;
+                    if (count > 128)
                     {
-                        // comment line, just ignore it
-                        std::cerr << pData << std::endl;
+                        // run
+                        count -= 128;
+                        if (count > width - x || pData >= pDataEnd) return false;
+                        const uint8_t value = *pData++;
+                        for (uint32_t i = 0; i < count; i++) scanline[(x++) * 4 + channel] = value;
                     }
                     else
                     {
-                        // assignments
-                        std::cerr << pData << std::endl;
+                        // literal
+                        if (count == 0 || count > width - x || count > static_cast<size_t>(pDataEnd - pData)) return false;
+                        for (uint32_t i = 0; i < count; i++) scanline[(x++) * 4 + channel] = *pData++;
                     }
+                }
+            }
 
-                    if (remain_size)
-                    {
-                        pData = p + 1;
-                        remain_size--;
-                    }
-                    else
+            return true;
+        }
+
+        // flat pixels, where (1, 1, 1, n) repeats the previous pixel n << shift times
+        static bool decodeOldScanLine(const uint8_t*& pData, const uint8_t* pDataEnd, const uint32_t width, uint8_t* scanline)
+        {
+            uint32_t shift = 0;
+            uint32_t x = 0;
+            while (x < width)
+            {
+                if (pDataEnd - pData < 4) return false;
+                if (pData[0] == 1 && pData[1] == 1 && pData[2] == 1)
+                {
+                    if (x == 0) return false; // nothing to repeat
+                    const uint32_t count = static_cast<uint32_t>(pData[3]) << shift;
+                    if (count > width - x) return false;
+                    for (uint32_t i = 0; i < count; i++, x++)
                     {
-                        break;
+                        std::memcpy(scanline + x * 4, scanline + (x - 1) * 4, 4);
                     }
+                    shift += 8;
+                }
+                else
+                {
+                    std::memcpy(scanline + x * 4, pData, 4);
+                    x++;
+                    shift = 0;
                 }
+                pData += 4;
+            }
 
-                // process dimension
-                assert(remain_size > 8);
+            return true;
+        }
 
-                pData++;
-                remain_size--;
+    public:
+        // decode to R16G16B16A16 half float instead of float, which halves the
+        // memory of environment maps and is the format they are sampled in
+        void SetHalfFloatOutput(bool half_float) { m_bHalfFloatOutput = half_float; }
 
-                // find the line end
-                char* p = pData;
-                while(*++p != '\n' && --remain_size > 0) {}
-                if (remain_size == 0) assert(0);
-                assert(*p == '\n');
-                *p = '\0';
+        virtual Image Parse(Buffer& buf, ImageOutputFormat format = ImageOutputFormat::kImageOutputFormatNative)
+        {
+            Image img;
+            const uint8_t* pData = buf.GetData();
+            const uint8_t* pDataEnd = buf.GetData() + buf.GetDataSize();
 
-                char axis1[2];
-                char axis2[2];
-                uint32_t dimension1;
-                uint32_t dimension2;
-                std::sscanf(pData, "%2c %u %2c %u", axis1, &dimension1, axis2, &dimension2);
+            std::string line;
+            if (!readLine(pData, pDataEnd, line) || line.compare(0, 2, "#?") != 0)
+            {
+                std::cerr << "Image File is not HDR format" << std::endl;
+                return img;
+            }
+            std::cerr << "Image File is HDR format" << std::endl;
 
-                if (axis1[1] == 'Y')
+            // process the header, it ends with an empty line
+            while (true)
+            {
+                if (!readLine(pData, pDataEnd, line))
                 {
-                    img.Height = dimension1;
-                    assert(axis2[1] == 'X');
-                    img.Width = dimension2;
+                    std::cerr << "[Error] HDR header is truncated" << std::endl;
+                    return img;
                 }
-                else
+                if (line.empty()) break;
+
+                // comment lines and assignments
+                std::cerr << line << std::endl;
+                if (line.compare(0, 7, "FORMAT=") == 0 && line != "FORMAT=32-bit_rle_rgbe")
                 {
-                    assert(axis1[1] == 'X');
-                    img.Width = dimension1;
-                    assert(axis2[1] == 'X');
-                    img.Height = dimension2;
+                    std::cerr << "[Error] Unsupported HDR pixel format: " << line << std::endl;
+                    return img;
                 }
+            }
 
-                assert(remain_size);
-                *p++ = '\n';
-                remain_size--;
+            // process dimension, -Y is top to bottom and +Y bottom to top
+            if (!readLine(pData, pDataEnd, line))
+            {
+                std::cerr << "[Error] HDR resolution is missing" << std::endl;
+                return img;
+            }
 
-                pData = p;
-                assert(remain_size);
+            char axis1[3];
+            char axis2[3];
+            uint32_t dimension1;
+            uint32_t dimension2;
+            if (std::sscanf(line.c_str(), "%2s %u %2s %u", axis1, &dimension1, axis2, &dimension2) != 4
+                    || axis1[1] != 'Y' || axis2[1] != 'X' || axis2[0] != '+')
+            {
+                std::cerr << "[Error] Unsupported HDR resolution: " << line << std::endl;
+                return img;
             }
+            const bool bottom_up = (axis1[0] == '+');
 
-            img.bitcount = 32 * 3; // float[3]
+            img.Height = dimension1;
+            img.Width = dimension2;
+            img.is_float = true;
+            if (m_bHalfFloatOutput)
+            {
+                img.bitcount = 16 * 4; // half[4]
+            }
+            else
+            {
+                // float[3], or float[4] with alpha 1.0 when RGBA is requested
+                img.bitcount = 32 * ((format == ImageOutputFormat::kImageOutputFormatRGBA) ? 4 : 3);
+            }
             img.pitch = (img.bitcount >> 3) * img.Width;
             img.data_size = img.pitch * img.Height;
             img.data = new uint8_t[img.data_size];
 
-            // now data section
-            assert(remain_size <= 4 * img.Height * img.Width);
-            float r, g, b;
-            unsigned char (*pRGBE)[4] = reinterpret_cast<unsigned char (*)[4]>(pData);
-            float (*pOutData)[3] = reinterpret_cast<float (*)[3]>(img.data);
-            if ((*pRGBE)[0] == 2 && (*pRGBE)[1] == 2 && (*pRGBE)[2] == img.Width >> 8 && (*pRGBE)[3] == (img.Width & 0xFF))
+            // now data section, one scan line at a time so the RGBE line stays in cache
+            std::vector<uint8_t> scanline(img.Width * 4);
+            for (uint32_t y = 0; y < img.Height; y++)
             {
-                // the file IS run lenght encoded
-                std::cerr << "The file *IS* run-length encoded" << std::endl;
-            }
-            else {
-                std::cerr << "The file is *NOT* run-length encoded" << std::endl;
-                // the file is NOT run lenght encoded
-                while (remain_size)
+                if (!decodeScanLine(pData, pDataEnd, img.Width, scanline.data()))
                 {
-                    if ((*pRGBE)[0] == 255 && (*pRGBE)[1] == 255 && (*pRGBE)[2] == 255)
-                    {
-                        uint8_t repeat_times = (*pRGBE)[3];
-                        for (uint8_t i = 0; i < repeat_times; i++)
-                        {
-                            (*pOutData)[0] = r;
-                            (*pOutData)[1] = g;
-                            (*pOutData)[2] = b;
-                        }
-
-                        remain_size -= 4;
-                        pRGBE++;
-                    }
-                    
-                    rgbe2float(&r, &g, &b, *pRGBE);
-                    (*pOutData)[0] = r;
-                    (*pOutData)[1] = g;
-                    (*pOutData)[2] = b;
-
-                    remain_size -= 4;
-                    pRGBE++;
-                    pOutData++;
-                } 
+                    std::cerr << "[Error] HDR pixel data is corrupted at scan line " << y << std::endl;
+                    std::memset(img.data + (bottom_up ? 0 : img.pitch * y), 0x00, img.pitch * (img.Height - y));
+                    break;
+                }
+
+                uint8_t* pOut = img.data + img.pitch * (bottom_up ? img.Height - 1 - y : y);
+                if (m_bHalfFloatOutput)
+                {
+                    ConvertRGBEToHalf4(scanline.data(), reinterpret_cast<uint16_t*>(pOut), img.Width);
+                }
+                else
+                {
+                    ConvertRGBEToFloat(scanline.data(), reinterpret_cast<float*>(pOut), img.bitcount / 32, img.Width);
+                }
             }
 
-            img.mipmaps[0].Width = img.Width; 
-            img.mipmaps[0].Height = img.Height; 
+            img.mipmaps[0].Width = img.Width;
+            img.mipmaps[0].Height = img.Height;
             img.mipmaps[0].pitch = img.pitch;
             img.mipmaps[0].offset = 0;
             img.mipmaps[0].data_size = img.data_size;
@@ -159,4 +205,4 @@ namespace My {
             return img;
         }
     };
-}
\ No newline at end of file
+}
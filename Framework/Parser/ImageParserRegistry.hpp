@@ -0,0 +1,117 @@
+#pragma once
+#include <cstring>
+#include <memory>
+#include "ImageParser.hpp"
+#include "JPEG.hpp"
+#include "PNG.hpp"
+#include "BMP.hpp"
+#include "TGA.hpp"
+#include "DDS.hpp"
+#include "HDR.hpp"
+
+namespace My {
+    enum class ImageFileFormat {
+        kImageFileFormatUnknown,
+        kImageFileFormatJPEG,
+        kImageFileFormatPNG,
+        kImageFileFormatDDS,
+        kImageFileFormatHDR,
+        kImageFileFormatBMP,
+        kImageFileFormatTGA,
+        kImageFileFormatCount
+    };
+
+    // picks the parser of an image from its first bytes instead of the file
+    // name, and keeps one parser per format so the tables and buffers they
+    // own (Huffman lookups, the zlib stream) carry over from one file to the
+    // next. a registry is not thread safe, ThreadInstance() gives every
+    // thread its own
+    class ImageParserRegistry
+    {
+    protected:
+        std::unique_ptr<ImageParser> m_Parsers[static_cast<size_t>(ImageFileFormat::kImageFileFormatCount)];
+
+        // TGA has no signature, only a header with a few fields which can be
+        // checked. it is tried last
+        static bool looksLikeTga(const uint8_t* pData, const size_t size)
+        {
+            if (size < sizeof(TGA_FILEHEADER)) return false;
+            const TGA_FILEHEADER* pFileHeader = reinterpret_cast<const TGA_FILEHEADER*>(pData);
+            const uint32_t image_type = pFileHeader->ImageType & ~8u;
+            const uint32_t width = pFileHeader->ImageSpec[4] | (pFileHeader->ImageSpec[5] << 8);
+            const uint32_t height = pFileHeader->ImageSpec[6] | (pFileHeader->ImageSpec[7] << 8);
+            const uint8_t pixel_depth = pFileHeader->ImageSpec[8];
+            if (pFileHeader->ColorMapType > 1 || image_type < 1 || image_type > 3 || pFileHeader->ImageType > 11) return false;
+            if (!width || !height || (pFileHeader->ImageSpec[9] & 0xC0)) return false;
+            return pixel_depth == 8 || pixel_depth == 15 || pixel_depth == 16 || pixel_depth == 24 || pixel_depth == 32;
+        }
+
+    public:
+        ImageParserRegistry()
+        {
+            SetParser(ImageFileFormat::kImageFileFormatJPEG, std::unique_ptr<ImageParser>(new JfifParser));
+            SetParser(ImageFileFormat::kImageFileFormatPNG, std::unique_ptr<ImageParser>(new PngParser));
+            SetParser(ImageFileFormat::kImageFileFormatDDS, std::unique_ptr<ImageParser>(new DdsParser));
+            SetParser(ImageFileFormat::kImageFileFormatHDR, std::unique_ptr<ImageParser>(new HdrParser));
+            SetParser(ImageFileFormat::kImageFileFormatBMP, std::unique_ptr<ImageParser>(new BmpParser));
+            SetParser(ImageFileFormat::kImageFileFormatTGA, std::unique_ptr<ImageParser>(new TgaParser));
+        }
+
+        ImageParserRegistry(const ImageParserRegistry&) = delete;
+        ImageParserRegistry& operator=(const ImageParserRegistry&) = delete;
+
+        // the registry of the calling thread
+        static ImageParserRegistry& ThreadInstance()
+        {
+            static thread_local ImageParserRegistry registry;
+            return registry;
+        }
+
+        static ImageFileFormat DetectFormat(const uint8_t* pData, const size_t size)
+        {
+            static const uint8_t kPngSignature[8] = { 0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A };
+            if (size >= 3 && pData[0] == 0xFF && pData[1] == 0xD8 && pData[2] == 0xFF) return ImageFileFormat::kImageFileFormatJPEG;
+            if (size >= 8 && std::memcmp(pData, kPngSignature, 8) == 0) return ImageFileFormat::kImageFileFormatPNG;
+            if (size >= 4 && std::memcmp(pData, "DDS ", 4) == 0) return ImageFileFormat::kImageFileFormatDDS;
+            if (size >= 2 && pData[0] == '#' && pData[1] == '?') return ImageFileFormat::kImageFileFormatHDR;
+            if (size >= 2 && pData[0] == 'B' && pData[1] == 'M') return ImageFileFormat::kImageFileFormatBMP;
+            if (looksLikeTga(pData, size)) return ImageFileFormat::kImageFileFormatTGA;
+            return ImageFileFormat::kImageFileFormatUnknown;
+        }
+
+        static ImageFileFormat DetectFormat(const Buffer& buf)
+        {
+            return DetectFormat(buf.GetData(), buf.GetDataSize());
+        }
+
+        // replace the parser of a format, e.g. with a differently configured one
+        void SetParser(ImageFileFormat format, std::unique_ptr<ImageParser> parser)
+        {
+            m_Parsers[static_cast<size_t>(format)] = std::move(parser);
+        }
+
+        ImageParser* GetParser(ImageFileFormat format) const
+        {
+            return m_Parsers[static_cast<size_t>(format)].get();
+        }
+
+        // the parser of a format as its own type, to change its options
+        template <typename T>
+        T* GetParser(ImageFileFormat format) const
+        {
+            return dynamic_cast<T*>(GetParser(format));
+        }
+
+        // an empty image if the format is not recognized
+        Image Parse(Buffer& buf, ImageOutputFormat format = ImageOutputFormat::kImageOutputFormatNative)
+        {
+            ImageParser* parser = GetParser(DetectFormat(buf));
+            if (!parser)
+            {
+                std::cerr << "[Error] Unknown image format" << std::endl;
+                return Image();
+            }
+            return parser->Parse(buf, format);
+        }
+    };
+}
@@ -1,10 +1,16 @@
 #pragma once
 #include <cstdio>
+#include <cstring>
 #include <iostream>
 #include <string>
 #include <cassert>
 #include <queue>
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include "ImageParser.hpp"
 #include "portable.hpp"
 #include "HuffmanTree.hpp"
@@ -72,7 +78,7 @@ namespace My {
 
         public:
             uint16_t     DcEntropyCodingTableDestSelector() const { return EntropyCodingTableDestSelector >> 4; };
-            uint16_t     AcEntropyCodingTableDestSelector() const { return EntropyCodingTableDestSelector & 0x07; };
+            uint16_t     AcEntropyCodingTableDestSelector() const { return EntropyCodingTableDestSelector & 0x0F; };
     };
 
     struct SCAN_HEADER : public JPEG_SEGMENT_HEADER {
@@ -85,7 +91,7 @@ namespace My {
 
         public:
             uint16_t ElementPrecision() const { return data >> 4; };
-            uint16_t DestinationIdentifier() const { return data & 0x07; };
+            uint16_t DestinationIdentifier() const { return data & 0x0F; };
     };
 
     struct HUFFMAN_TABLE_SPEC {
@@ -96,7 +102,7 @@ namespace My {
             uint8_t NumOfHuffmanCodes[16];
 
             uint16_t TableClass() const { return data >> 4; };
-            uint16_t DestinationIdentifier() const { return data & 0x07; };
+            uint16_t DestinationIdentifier() const { return data & 0x0F; };
     };
 
     struct RESTART_INTERVAL_DEF : public JPEG_SEGMENT_HEADER {
@@ -105,307 +111,1065 @@ namespace My {
 
 #pragma pack(pop)
 
+    // bit reader over the entropy coded segment of a scan. it reads straight
+    // from the file buffer, drops the 0x00 byte stuffed after every 0xFF data
+    // byte and stops in front of markers. once a marker is reached zero bits
+    // are returned until Restart() moves past it.
+    class JpegBitReader {
+        protected:
+            const uint8_t* m_pData;
+            const uint8_t* m_pDataEnd;
+            uint64_t m_nBitBuffer = 0;  // left aligned
+            int32_t  m_nBitCount = 0;   // valid bits in m_nBitBuffer
+            bool     m_bMarkerHit = false;
+
+        public:
+            JpegBitReader(const uint8_t* data, const uint8_t* data_end)
+                : m_pData(data), m_pDataEnd(data_end) {};
+
+            // make sure there are at least 57 bits in the buffer
+            inline void Refill()
+            {
+                if (m_nBitCount > 56) return;
+
+                if (!m_bMarkerHit && m_pDataEnd - m_pData >= 8)
+                {
+                    uint64_t next;
+                    std::memcpy(&next, m_pData, sizeof(next));
+                    // bulk path when none of the next 8 bytes is 0xFF
+                    const uint64_t inverted = ~next;
+                    if (!((inverted - 0x0101010101010101ull) & ~inverted & 0x8080808080808080ull))
+                    {
+                        next = endian_net_unsigned_int(next);
+                        int32_t bytes = (63 - m_nBitCount) >> 3;
+                        m_nBitBuffer |= (next >> m_nBitCount) & ~(~0ull >> (m_nBitCount + (bytes << 3)));
+                        m_pData += bytes;
+                        m_nBitCount += bytes << 3;
+                        return;
+                    }
+                }
+
+                while (m_nBitCount <= 56)
+                {
+                    uint64_t byte = 0;
+                    if (!m_bMarkerHit && m_pData < m_pDataEnd)
+                    {
+                        byte = *m_pData;
+                        if (byte == 0xFF)
+                        {
+                            const uint8_t next = (m_pData + 1 < m_pDataEnd) ? *(m_pData + 1) : 0xD9;
+                            if (next == 0x00) {
+                                // stuffed byte
+                                m_pData += 2;
+                            } else if (next == 0xFF) {
+                                // fill byte before a marker
+                                m_pData++;
+                                continue;
+                            } else {
+                                m_bMarkerHit = true;
+                                byte = 0;
+                            }
+                        }
+                        else
+                        {
+                            m_pData++;
+                        }
+                    }
+                    m_nBitBuffer |= byte << (56 - m_nBitCount);
+                    m_nBitCount += 8;
+                }
+            }
+
+            // n must be in [1, 32] and no more than the bits in the buffer
+            inline uint32_t PeekBits(const int32_t n) const
+            {
+                assert(n > 0 && n <= 32 && n <= m_nBitCount);
+                return static_cast<uint32_t>(m_nBitBuffer >> (64 - n));
+            }
+
+            inline void SkipBits(const int32_t n)
+            {
+                assert(n <= m_nBitCount);
+                m_nBitBuffer <<= n;
+                m_nBitCount -= n;
+            }
+
+            inline uint32_t GetBits(const int32_t n)
+            {
+                if (n == 0) return 0;
+                if (m_nBitCount < n) Refill();
+                uint32_t result = PeekBits(n);
+                SkipBits(n);
+                return result;
+            }
+
+            inline int32_t GetBitCount() const { return m_nBitCount; }
+
+            // position of the marker which ends the entropy coded data read so far
+            const uint8_t* FindMarker() const
+            {
+                const uint8_t* p = m_pData;
+                while (p + 1 < m_pDataEnd && !(*p == 0xFF && *(p + 1) != 0x00 && *(p + 1) != 0xFF)) p++;
+                return (p + 1 < m_pDataEnd) ? p : m_pDataEnd;
+            }
+
+            // drop the buffered bits and move past the RSTn marker which ends
+            // the current restart interval. returns false if there is none.
+            bool Restart()
+            {
+                m_nBitBuffer = 0;
+                m_nBitCount = 0;
+                m_bMarkerHit = false;
+
+                const uint8_t* p = FindMarker();
+                if (p + 1 < m_pDataEnd && *(p + 1) >= 0xD0 && *(p + 1) <= 0xD7)
+                {
+                    m_pData = p + 2;
+                    return true;
+                }
+
+                m_pData = p;
+                return false;
+            }
+    };
+
+    // "fancy" (triangle filter) chroma upsampling as in the IJG library. every
+    // output sample is weighted 3:1 between the nearest input sample and the
+    // next nearest one, which avoids the blockiness of pixel replication.
+
+    // 2x horizontal, out receives 2 * width samples
+    inline void UpsampleH2V1Fancy(const uint8_t* in, const int width, uint8_t* out)
+    {
+        if (width == 1) {
+            out[0] = out[1] = in[0];
+            return;
+        }
+
+        out[0] = in[0];
+        out[1] = static_cast<uint8_t>((in[0] * 3 + in[1] + 2) >> 2);
+
+        int i = 1;
+#if MYGE_SIMD_SSE
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i one = _mm_set1_epi16(1);
+        const __m128i two = _mm_set1_epi16(2);
+        for (; i + 8 < width; i += 8) {
+            __m128i cur  = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(in + i)), zero);
+            __m128i prev = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(in + i - 1)), zero);
+            __m128i next = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(in + i + 1)), zero);
+            __m128i three = _mm_add_epi16(_mm_add_epi16(cur, cur), cur);
+            __m128i even = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(three, prev), one), 2);
+            __m128i odd  = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(three, next), two), 2);
+            __m128i packed = _mm_unpacklo_epi8(_mm_packus_epi16(even, even), _mm_packus_epi16(odd, odd));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * 2), packed);
+        }
+#elif MYGE_SIMD_NEON
+        for (; i + 8 < width; i += 8) {
+            uint16x8_t three = vmulq_n_u16(vmovl_u8(vld1_u8(in + i)), 3);
+            uint8x8x2_t packed;
+            packed.val[0] = vshrn_n_u16(vaddq_u16(vaddw_u8(three, vld1_u8(in + i - 1)), vdupq_n_u16(1)), 2);
+            packed.val[1] = vshrn_n_u16(vaddq_u16(vaddw_u8(three, vld1_u8(in + i + 1)), vdupq_n_u16(2)), 2);
+            vst2_u8(out + i * 2, packed);
+        }
+#endif
+        for (; i < width - 1; i++) {
+            const int three = in[i] * 3;
+            out[i * 2]     = static_cast<uint8_t>((three + in[i - 1] + 1) >> 2);
+            out[i * 2 + 1] = static_cast<uint8_t>((three + in[i + 1] + 2) >> 2);
+        }
+
+        out[i * 2]     = static_cast<uint8_t>((in[i] * 3 + in[i - 1] + 1) >> 2);
+        out[i * 2 + 1] = in[i];
+    }
+
+    // 2x vertical. near is the input row above (upper output row, bias 1)
+    // or below (lower output row, bias 2) the row the output belongs to
+    inline void UpsampleH1V2Fancy(const uint8_t* in, const uint8_t* near, const int width, const int bias, uint8_t* out)
+    {
+        for (int i = 0; i < width; i++) {
+            out[i] = static_cast<uint8_t>((in[i] * 3 + near[i] + bias) >> 2);
+        }
+    }
+
+    // 2x in both directions, out receives 2 * width samples. near has the
+    // same meaning as for UpsampleH1V2Fancy
+    inline void UpsampleH2V2Fancy(const uint8_t* in, const uint8_t* near, const int width, uint8_t* out)
+    {
+        int this_sum = in[0] * 3 + near[0];
+        if (width == 1) {
+            out[0] = static_cast<uint8_t>((this_sum * 4 + 8) >> 4);
+            out[1] = static_cast<uint8_t>((this_sum * 4 + 7) >> 4);
+            return;
+        }
+
+        int next_sum = in[1] * 3 + near[1];
+        out[0] = static_cast<uint8_t>((this_sum * 4 + 8) >> 4);
+        out[1] = static_cast<uint8_t>((this_sum * 3 + next_sum + 7) >> 4);
+
+        int i = 1;
+#if MYGE_SIMD_SSE
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i seven = _mm_set1_epi16(7);
+        const __m128i eight = _mm_set1_epi16(8);
+        auto column_sum = [&](const int x) {
+            __m128i a = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(in + x)), zero);
+            __m128i b = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(near + x)), zero);
+            return _mm_add_epi16(_mm_add_epi16(_mm_add_epi16(a, a), a), b);
+        };
+        for (; i + 8 < width; i += 8) {
+            __m128i cur = column_sum(i);
+            __m128i three = _mm_add_epi16(_mm_add_epi16(cur, cur), cur);
+            __m128i even = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(three, column_sum(i - 1)), eight), 4);
+            __m128i odd  = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(three, column_sum(i + 1)), seven), 4);
+            __m128i packed = _mm_unpacklo_epi8(_mm_packus_epi16(even, even), _mm_packus_epi16(odd, odd));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * 2), packed);
+        }
+#elif MYGE_SIMD_NEON
+        auto column_sum = [&](const int x) {
+            return vaddw_u8(vmulq_n_u16(vmovl_u8(vld1_u8(in + x)), 3), vld1_u8(near + x));
+        };
+        for (; i + 8 < width; i += 8) {
+            uint16x8_t three = vmulq_n_u16(column_sum(i), 3);
+            uint8x8x2_t packed;
+            packed.val[0] = vshrn_n_u16(vaddq_u16(vaddq_u16(three, column_sum(i - 1)), vdupq_n_u16(8)), 4);
+            packed.val[1] = vshrn_n_u16(vaddq_u16(vaddq_u16(three, column_sum(i + 1)), vdupq_n_u16(7)), 4);
+            vst2_u8(out + i * 2, packed);
+        }
+#endif
+        int last_sum = in[i - 1] * 3 + near[i - 1];
+        this_sum = in[i] * 3 + near[i];
+        for (; i < width - 1; i++) {
+            next_sum = in[i + 1] * 3 + near[i + 1];
+            out[i * 2]     = static_cast<uint8_t>((this_sum * 3 + last_sum + 8) >> 4);
+            out[i * 2 + 1] = static_cast<uint8_t>((this_sum * 3 + next_sum + 7) >> 4);
+            last_sum = this_sum;
+            this_sum = next_sum;
+        }
+
+        out[i * 2]     = static_cast<uint8_t>((this_sum * 3 + last_sum + 8) >> 4);
+        out[i * 2 + 1] = static_cast<uint8_t>((this_sum * 4 + 7) >> 4);
+    }
+
     class JfifParser : implements ImageParser
     {
     private:
         const uint8_t m_zigzagIndex[64] = { 0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5, 12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6, 7, 14, 21, 28, 35, 42, 49, 56,
                                     57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51, 58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63 };
 
+        // ITU-T81 B.2.3 limits an interleaved MCU to 10 blocks
+        static const int kMaxBlocksPerMcu = 10;
+
+        // B.2.4.2: up to 4 DC and 4 AC tables, the AC ones follow the DC ones
+        static const int kHuffmanDestinations = 4;
+
+        struct Component {
+            uint8_t  id;
+            uint16_t h;                 // sampling factors
+            uint16_t v;
+            uint16_t quantization_table;
+            int      width;             // samples actually covered by the image
+            int      height;
+            int      blocks_per_line;   // block grid of a non-interleaved scan
+            int      blocks_per_column;
+            int      stride;            // the sample plane is padded to whole MCUs
+            std::vector<uint8_t> samples;
+            std::vector<int16_t> coefficients; // progressive only, 64 per block in natural order
+            bool     has_ac = false;    // any AC scan seen, otherwise the blocks are flat
+        };
+
+        struct ScanComponent {
+            int      component;
+            uint16_t dc_table;
+            uint16_t ac_table;
+        };
+
+        // position of one block inside the MCU of the current scan
+        struct McuBlock {
+            int scan_component;
+            int h;
+            int v;
+            int x;
+            int y;
+        };
+
     protected:
-        HuffmanTree<uint8_t> m_treeHuffman[4];
+        HuffmanTree<uint8_t> m_treeHuffman[2 * kHuffmanDestinations];
         Matrix8X8f m_tableQuantization[4];
-        std::vector<FRAME_COMPONENT_SPEC_PARAMS> m_tableFrameComponentsSpec;
+        std::vector<Component> m_Components;
         uint16_t m_nSamplePrecision;
         uint16_t m_nLines;
         uint16_t m_nSamplesPerLine;
         uint16_t m_nComponentsInFrame;
+        uint16_t m_nMaxH;
+        uint16_t m_nMaxV;
         uint16_t m_nRestartInterval = 0;
-        int mcu_index;
+        bool m_bMultithreaded = true;
+        bool m_bProgressive = false;
+        int m_nScanLimit = 0;
         int mcu_count_x;
         int mcu_count_y;
-        int mcu_count;
-        const SCAN_COMPONENT_SPEC_PARAMS* pScsp;
+
+        // current scan
+        ScanComponent m_ScanComponents[4]; // 4 is max num of components defined by ITU-T81
+        int m_nScanComponents;
+        McuBlock m_McuBlocks[kMaxBlocksPerMcu];
+        int m_nBlocksPerMcu;
+        int m_nScanMcusPerLine;
+        int m_nScanMcuCount;
+        int m_nSpectralStart;   // Ss
+        int m_nSpectralEnd;     // Se
+        int m_nApproxHigh;      // Ah
+        int m_nApproxLow;       // Al
+
+        // below this size the threads cost more than they save
+        static const int kMinMcusForThreading = 256;
 
     protected:
-        size_t parseScanData(const uint8_t* pScanData, const uint8_t* pDataEnd, Image& img)
+        // F.2.2.1: turn the bit_length bits of value into a signed coefficient
+        static inline int16_t extend(const uint32_t value, const uint8_t bit_length)
         {
-            std::vector<uint8_t> scan_data;
-            size_t scanLength = 0;
+            if (bit_length == 0) return 0;
+            return static_cast<int16_t>((value < (1u << (bit_length - 1))) ?
+                    static_cast<int32_t>(value) - (1 << bit_length) + 1 : static_cast<int32_t>(value));
+        }
 
-            {
-                const uint8_t* p = pScanData;
+        // entropy decode one MCU. the coefficients are dequantized and level shifted
+        void decodeMcu(JpegBitReader& reader, int16_t previous_dc[4], Matrix8X8f block[]) const
+        {
+            memset(block, 0x00, sizeof(Matrix8X8f) * m_nBlocksPerMcu);
 
-                // scan for scan data buffer size and remove bitstuff
-                bool bitstuff = false;
-                while (p < pDataEnd && (*p != 0xFF || *(p+1) == 0x00)) {
-                    if(!bitstuff) {
-                        scan_data.push_back(*p);
-                    } else {
-                        // ignore it and reset the flag
-                        assert(*p == 0x00);
-                        bitstuff = false;
-                    }
+            for (int i = 0; i < m_nBlocksPerMcu; i++) {
+                const int sc = m_McuBlocks[i].scan_component;
+                const ScanComponent& scan_component = m_ScanComponents[sc];
+                const Component& component = m_Components[scan_component.component];
+#if DUMP_DETAILS
+                std::cerr << "\tComponent Selector: " << (uint16_t)component.id << std::endl;
+                std::cerr << "\tQuantization Table Destination Selector: " << (uint16_t)component.quantization_table << std::endl;
+                std::cerr << "\tDC Entropy Coding Table Destination Selector: " << (uint16_t)scan_component.dc_table << std::endl;
+                std::cerr << "\tAC Entropy Coding Table Destination Selector: " << (uint16_t)scan_component.ac_table << std::endl;
+#endif
+                const HuffmanTree<uint8_t>& dc_tree = m_treeHuffman[scan_component.dc_table];
+                const HuffmanTree<uint8_t>& ac_tree = m_treeHuffman[kHuffmanDestinations + scan_component.ac_table];
 
-                    if(*(uint16_t*)p == endian_net_unsigned_int((uint16_t)0xFF00)) {
-                        bitstuff = true;
-                    }
+                // Decode DC
+                uint8_t dc_code = dc_tree.DecodeSingleValue(reader);
+                uint8_t dc_bit_length = dc_code & 0x0F;
+                int16_t dc_value = extend(reader.GetBits(dc_bit_length), dc_bit_length);
 
-                    p++;
-                    scanLength++;
-                }
+                // add with previous DC value
+                dc_value += previous_dc[sc];
+                // save the value for next DC
+                previous_dc[sc] = dc_value;
+
+#ifdef DUMP_DETAILS
+                printf("DC Code: %x\n", dc_code);
+                printf("DC Bit Length: %d\n", dc_bit_length);
+                printf("DC Value: %d\n", dc_value);
+#endif
+
+                block[i][0][0] = dc_value;
 
-                if(*p == 0xFF && *(p + 1) >= 0xD0 && *(p + 1) <= 0xD7) 
+                // Decode AC
+                int ac_index = 1;
+                while (ac_index < 64)
                 {
-                    // found restart mark
+                    uint8_t ac_code = ac_tree.DecodeSingleValue(reader);
+
+                    if (!ac_code)
+                    {
+#if DUMP_DETAILS
+                        std::cerr << "Found EOB when decode AC!" << std::endl;
+#endif
+                        break;
+                    }
+                    else if (ac_code == 0xF0)
+                    {
 #if DUMP_DETAILS
-                    std::cerr << "Found RST while scan the ECS." << std::endl;
+                        std::cerr << "Found ZRL when decode AC!" << std::endl;
+#endif
+                        ac_index += 16;
+                        continue;
+                    }
+
+                    uint8_t ac_zero_length = ac_code >> 4;
+                    ac_index += ac_zero_length;
+                    uint8_t ac_bit_length = ac_code & 0x0F;
+                    int16_t ac_value = extend(reader.GetBits(ac_bit_length), ac_bit_length);
+
+#ifdef DUMP_DETAILS
+                    printf("AC Code: %x\n", ac_code);
+                    printf("AC Bit Length: %d\n", ac_bit_length);
+                    printf("AC Value: %d\n", ac_value);
 #endif
+
+                    if (ac_index > 63) break; // corrupted stream
+
+                    int index = m_zigzagIndex[ac_index];
+                    block[i][index >> 3][index & 0x07] = ac_value;
+
+                    ac_index++;
                 }
 
-#if DUMP_DETAILS
-                std::cerr << "Size Of Scan: " << scanLength << " bytes" << std::endl;
-                std::cerr << "Size Of Scan (after remove bitstuff): " << scan_data.size() << " bytes" << std::endl;
+#ifdef DUMP_DETAILS
+                printf("Extracted Block[%d] 8x8 block: ", i);
+                std::cerr << block[i];
+#endif
+                MatrixMulByElement(block[i], block[i], m_tableQuantization[component.quantization_table]);
+#ifdef DUMP_DETAILS
+                std::cerr << "After Quantization: " << block[i];
+#endif
+                block[i][0][0] += 1024.0f; // level shift. same as +128 to each element after IDCT
+            }
+        }
+
+        // round and clamp the IDCT output of a block into a sample plane
+        static void storeBlock(const Matrix8X8f& block, uint8_t* dest, const int stride)
+        {
+            for (int i = 0; i < 8; i++) {
+#if MYGE_SIMD_SSE
+                // packing saturates to [0, 255]
+                __m128i lo = _mm_cvtps_epi32(_mm_loadu_ps(&block[i][0]));
+                __m128i hi = _mm_cvtps_epi32(_mm_loadu_ps(&block[i][4]));
+                __m128i packed = _mm_packs_epi32(lo, hi);
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(dest + i * stride), _mm_packus_epi16(packed, packed));
+#else
+                for (int j = 0; j < 8; j++) {
+                    dest[i * stride + j] = static_cast<uint8_t>(std::clamp<int32_t>(
+                                static_cast<int32_t>(std::floor(block[i][j] + 0.5f)), 0, 255));
+                }
+#endif
+            }
+        }
+
+        // IDCT of all the blocks of one MCU into the sample planes
+        void reconstructMcu(Matrix8X8f block[], const int mcu_index)
+        {
+            // transform all the blocks of the MCU in one call
+            IDCT8X8(block, block, m_nBlocksPerMcu);
+
+            int mcu_index_x = mcu_index % m_nScanMcusPerLine;
+            int mcu_index_y = mcu_index / m_nScanMcusPerLine;
+
+            for (int i = 0; i < m_nBlocksPerMcu; i++) {
+#ifdef DUMP_DETAILS
+                std::cerr << "After IDCT: " << block[i];
 #endif
+                const McuBlock& mcu_block = m_McuBlocks[i];
+                Component& component = m_Components[m_ScanComponents[mcu_block.scan_component].component];
+                int x = (mcu_index_x * mcu_block.h + mcu_block.x) * 8;
+                int y = (mcu_index_y * mcu_block.v + mcu_block.y) * 8;
+                storeBlock(block[i], &component.samples[y * component.stride + x], component.stride);
             }
-            
+        }
+
+        // decode MCUs [first_mcu, last_mcu) of a scan
+        void decodeMcus(JpegBitReader& reader, const int first_mcu, const int last_mcu)
+        {
             int16_t previous_dc[4]; // 4 is max num of components defined by ITU-T81
             memset(previous_dc, 0x00, sizeof(previous_dc));
 
-            size_t byte_offset = 0;
-            uint8_t bit_offset = 0;
+            Matrix8X8f block[kMaxBlocksPerMcu];
 
-            while (byte_offset < scan_data.size() && mcu_index < mcu_count) {
+            for (int mcu = first_mcu; mcu < last_mcu; mcu++) {
 #if DUMP_DETAILS
-                std::cerr << "MCU: " << mcu_index << std::endl;
+                std::cerr << "MCU: " << mcu << std::endl;
 #endif
-                Matrix8X8f block[4]; // 4 is max num of components defined by ITU-T81
-                memset(&block, 0x00, sizeof(block));
+                decodeMcu(reader, previous_dc, block);
+                reconstructMcu(block, mcu);
 
-                for (uint8_t i = 0; i < m_nComponentsInFrame; i++) {
-                    const FRAME_COMPONENT_SPEC_PARAMS& fcsp = m_tableFrameComponentsSpec[i];
+                if (m_nRestartInterval != 0 && ((mcu + 1) % m_nRestartInterval == 0) && mcu + 1 < last_mcu) {
+                    // the rest of the current byte is padding, the RST marker follows
+                    if (!reader.Restart()) {
+                        std::cerr << "Missing RST marker at MCU " << mcu + 1 << std::endl;
+                    }
 #if DUMP_DETAILS
-                    std::cerr << "\tComponent Selector: " << (uint16_t)pScsp[i].ComponentSelector << std::endl;
-                    std::cerr << "\tQuantization Table Destination Selector: " << (uint16_t)fcsp.QuantizationTableDestSelector << std::endl;
-                    std::cerr << "\tDC Entropy Coding Table Destination Selector: " << (uint16_t)pScsp[i].DcEntropyCodingTableDestSelector() << std::endl;
-                    std::cerr << "\tAC Entropy Coding Table Destination Selector: " << (uint16_t)pScsp[i].AcEntropyCodingTableDestSelector() << std::endl;
+                    std::cerr << "Restart Of Scan" << std::endl;
 #endif
+                    memset(previous_dc, 0x00, sizeof(previous_dc));
+                }
+            }
+        }
+
+#ifndef OS_WEBASSEMBLY
+        // every restart interval is entropy coded independently, so the intervals
+        // are decoded in parallel. returns the end of the scan, or nullptr if the
+        // RST markers do not match the restart interval.
+        const uint8_t* decodeRestartIntervalsParallel(const uint8_t* pScanData, const uint8_t* pDataEnd,
+                const unsigned int thread_count)
+        {
+            const int interval_count = (m_nScanMcuCount + m_nRestartInterval - 1) / m_nRestartInterval;
+
+            // locate the start of every interval
+            std::vector<const uint8_t*> intervals;
+            intervals.reserve(interval_count);
+            intervals.push_back(pScanData);
+            const uint8_t* p = pScanData;
+            while (static_cast<int>(intervals.size()) < interval_count) {
+                p = reinterpret_cast<const uint8_t*>(memchr(p, 0xFF, pDataEnd - p));
+                if (!p || p + 1 >= pDataEnd) return nullptr;
+
+                uint8_t marker = *(p + 1);
+                if (marker >= 0xD0 && marker <= 0xD7) {
+                    p += 2;
+                    intervals.push_back(p);
+                } else if (marker == 0x00 || marker == 0xFF) {
+                    p++;
+                } else {
+                    // end of scan before the last interval
+                    return nullptr;
+                }
+            }
+
+            const uint8_t* pScanEnd = pDataEnd;
+            std::atomic<int> next_interval(0);
+
+            auto worker = [&]() {
+                int interval;
+                while ((interval = next_interval++) < interval_count) {
+                    JpegBitReader reader(intervals[interval], pDataEnd);
+                    int begin = interval * m_nRestartInterval;
+                    int end = std::min(begin + static_cast<int>(m_nRestartInterval), m_nScanMcuCount);
+                    decodeMcus(reader, begin, end);
+                    if (interval == interval_count - 1) {
+                        pScanEnd = reader.FindMarker();
+                    }
+                }
+            };
+
+            std::vector<std::thread> threads;
+            for (unsigned int i = 1; i < thread_count; i++) {
+                threads.emplace_back(worker);
+            }
+            worker();
+            for (auto& thread : threads) {
+                thread.join();
+            }
 
-                    // Decode DC
-                    uint8_t dc_code = m_treeHuffman[pScsp[i].DcEntropyCodingTableDestSelector()].DecodeSingleValue(scan_data.data(), scan_data.size(), &byte_offset, &bit_offset);
-                    uint8_t dc_bit_length = dc_code & 0x0F;
-                    int16_t dc_value;
-                    uint32_t tmp_value;
+            return pScanEnd;
+        }
 
-                    if (!dc_code)
+        // no restart markers: entropy decoding stays on this thread and hands rows
+        // of MCUs over to a second thread for the IDCT
+        const uint8_t* decodePipelined(const uint8_t* pScanData, const uint8_t* pDataEnd)
+        {
+            const int kPipelineDepth = 4; // rows of MCUs in flight
+            const int batch_size = m_nScanMcusPerLine;
+            const int batch_count = (m_nScanMcuCount + batch_size - 1) / batch_size;
+            const int batch_blocks = batch_size * m_nBlocksPerMcu;
+
+            std::vector<Matrix8X8f> ring(kPipelineDepth * batch_blocks);
+            std::mutex lock;
+            std::condition_variable produced_cv;
+            std::condition_variable consumed_cv;
+            int produced = 0;
+            int consumed = 0;
+
+            std::thread consumer([&]() {
+                for (int batch = 0; batch < batch_count; batch++) {
                     {
-#if DUMP_DETAILS
-                        std::cerr << "Found EOB when decode DC!" << std::endl;
-#endif
-                        dc_value = 0;
-                    } else {
-                        if (dc_bit_length + bit_offset <= 8)
-                        {
-                            tmp_value = ((scan_data[byte_offset] & ((0x01u << (8 - bit_offset)) - 1)) >> (8 - dc_bit_length - bit_offset));
-                        }
-                        else
-                        {
-                            uint8_t bits_in_first_byte = 8 - bit_offset;
-                            uint8_t append_full_bytes = (dc_bit_length - bits_in_first_byte) / 8;
-                            uint8_t bits_in_last_byte = dc_bit_length - bits_in_first_byte - 8 * append_full_bytes;
-                            tmp_value = (scan_data[byte_offset] & ((0x01u << (8 - bit_offset)) - 1));
-                            for (int m = 1; m <= append_full_bytes; m++)
-                            {
-                                tmp_value <<= 8;
-                                tmp_value += scan_data[byte_offset + m];
-                            }
-                            tmp_value <<= bits_in_last_byte;
-                            tmp_value += (scan_data[byte_offset + append_full_bytes + 1] >> (8 - bits_in_last_byte));
-                        }
+                        std::unique_lock<std::mutex> guard(lock);
+                        produced_cv.wait(guard, [&]() { return produced > batch; });
+                    }
 
-                        // decode dc value
-                        if ((tmp_value >> (dc_bit_length - 1)) == 0) {
-                            // MSB = 1, turn it to minus value
-                            dc_value = -(int16_t)(~tmp_value & ((0x0001u << dc_bit_length) - 1));
-                        } else {
-                            dc_value = tmp_value;
-                        }
+                    Matrix8X8f* slot = &ring[(batch % kPipelineDepth) * batch_blocks];
+                    int begin = batch * batch_size;
+                    int end = std::min(begin + batch_size, m_nScanMcuCount);
+                    for (int mcu = begin; mcu < end; mcu++) {
+                        reconstructMcu(slot + (mcu - begin) * m_nBlocksPerMcu, mcu);
                     }
 
-                    // add with previous DC value
-                    dc_value += previous_dc[i];
-                    // save the value for next DC
-                    previous_dc[i] = dc_value;
+                    {
+                        std::lock_guard<std::mutex> guard(lock);
+                        consumed = batch + 1;
+                    }
+                    consumed_cv.notify_one();
+                }
+            });
 
-#ifdef DUMP_DETAILS
-                    printf("DC Code: %x\n", dc_code);
-                    printf("DC Bit Length: %d\n", dc_bit_length);
-                    printf("DC Value: %d\n", dc_value);
-#endif
+            JpegBitReader reader(pScanData, pDataEnd);
+            int16_t previous_dc[4]; // 4 is max num of components defined by ITU-T81
+            memset(previous_dc, 0x00, sizeof(previous_dc));
+
+            for (int batch = 0; batch < batch_count; batch++) {
+                {
+                    std::unique_lock<std::mutex> guard(lock);
+                    consumed_cv.wait(guard, [&]() { return batch - consumed < kPipelineDepth; });
+                }
+
+                Matrix8X8f* slot = &ring[(batch % kPipelineDepth) * batch_blocks];
+                int begin = batch * batch_size;
+                int end = std::min(begin + batch_size, m_nScanMcuCount);
+                for (int mcu = begin; mcu < end; mcu++) {
+                    decodeMcu(reader, previous_dc, slot + (mcu - begin) * m_nBlocksPerMcu);
+                }
+
+                {
+                    std::lock_guard<std::mutex> guard(lock);
+                    produced = batch + 1;
+                }
+                produced_cv.notify_one();
+            }
 
-                    block[i][0][0] = dc_value;
+            consumer.join();
 
-                    // forward pointers to end of DC
-                    bit_offset += dc_bit_length;
-                    while (bit_offset >= 8 ) {
-                        bit_offset -= 8;
-                        byte_offset++;
+            return reader.FindMarker();
+        }
+#endif
+
+        size_t parseScanData(const uint8_t* pScanData, const uint8_t* pDataEnd)
+        {
+            const uint8_t* pScanEnd = nullptr;
+
+#ifndef OS_WEBASSEMBLY
+            unsigned int thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+            if (m_bMultithreaded && thread_count > 1 && m_nScanMcuCount >= kMinMcusForThreading) {
+                if (m_nRestartInterval != 0) {
+                    int interval_count = (m_nScanMcuCount + m_nRestartInterval - 1) / m_nRestartInterval;
+                    if (interval_count > 1) {
+                        pScanEnd = decodeRestartIntervalsParallel(pScanData, pDataEnd,
+                                std::min(thread_count, static_cast<unsigned int>(interval_count)));
                     }
+                } else {
+                    pScanEnd = decodePipelined(pScanData, pDataEnd);
+                }
+            }
+#endif
 
-                    // Decode AC 
-                    int ac_index = 1;
-                    while (byte_offset < scan_data.size() && ac_index < 64)
-                    {
-                        uint8_t ac_code = m_treeHuffman[2 + pScsp[i].AcEntropyCodingTableDestSelector()].DecodeSingleValue(scan_data.data(), scan_data.size(), &byte_offset, &bit_offset);
+            if (!pScanEnd) {
+                JpegBitReader reader(pScanData, pDataEnd);
+                decodeMcus(reader, 0, m_nScanMcuCount);
+                pScanEnd = reader.FindMarker();
+            }
 
-                        if (!ac_code)
-                        {
+            size_t scanLength = pScanEnd - pScanData;
 #if DUMP_DETAILS
-                            std::cerr << "Found EOB when decode AC!" << std::endl;
+            std::cerr << "Size Of Scan: " << scanLength << " bytes" << std::endl;
 #endif
+
+            return scanLength;
+        }
+
+        // G.1.2.1 DC coefficients of a progressive scan, first pass or refinement
+        void decodeDcProgressive(JpegBitReader& reader, const int scan_component, int16_t previous_dc[4], int16_t* coef) const
+        {
+            if (m_nApproxHigh == 0) {
+                const HuffmanTree<uint8_t>& dc_tree = m_treeHuffman[m_ScanComponents[scan_component].dc_table];
+                uint8_t dc_bit_length = dc_tree.DecodeSingleValue(reader) & 0x0F;
+                int16_t dc_value = extend(reader.GetBits(dc_bit_length), dc_bit_length);
+                dc_value += previous_dc[scan_component];
+                previous_dc[scan_component] = dc_value;
+                coef[0] = static_cast<int16_t>(dc_value * (1 << m_nApproxLow));
+            } else if (reader.GetBits(1)) {
+                coef[0] |= static_cast<int16_t>(1 << m_nApproxLow);
+            }
+        }
+
+        // G.1.2.2 first pass over a band of AC coefficients
+        void decodeAcFirst(JpegBitReader& reader, const HuffmanTree<uint8_t>& ac_tree, uint32_t& eob_run, int16_t* coef) const
+        {
+            if (eob_run > 0) {
+                eob_run--;
+                return;
+            }
+
+            for (int k = m_nSpectralStart; k <= m_nSpectralEnd; k++) {
+                uint8_t ac_code = ac_tree.DecodeSingleValue(reader);
+                int r = ac_code >> 4;
+                int s = ac_code & 0x0F;
+                if (s) {
+                    k += r;
+                    if (k > 63) break; // corrupted stream
+                    coef[m_zigzagIndex[k]] = static_cast<int16_t>(extend(reader.GetBits(s), s) * (1 << m_nApproxLow));
+                } else if (r == 15) {
+                    k += 15; // ZRL
+                } else {
+                    // end of band for this block and eob_run more
+                    eob_run = (1u << r) - 1;
+                    if (r) eob_run += reader.GetBits(r);
+                    break;
+                }
+            }
+        }
+
+        // G.1.2.3 successive approximation refinement of a band of AC coefficients.
+        // coefficients which are already non-zero get a correction bit, new ones
+        // are +-1 at the current bit position
+        void decodeAcRefine(JpegBitReader& reader, const HuffmanTree<uint8_t>& ac_tree, uint32_t& eob_run, int16_t* coef) const
+        {
+            const int16_t p1 = static_cast<int16_t>(1 << m_nApproxLow);
+            const int16_t m1 = static_cast<int16_t>(-1 * (1 << m_nApproxLow));
+
+            auto refine = [&](int16_t& c) {
+                if (reader.GetBits(1) && (c & p1) == 0) {
+                    c += (c >= 0) ? p1 : m1;
+                }
+            };
+
+            int k = m_nSpectralStart;
+            if (eob_run == 0) {
+                for (; k <= m_nSpectralEnd; k++) {
+                    uint8_t ac_code = ac_tree.DecodeSingleValue(reader);
+                    int r = ac_code >> 4;
+                    int s = ac_code & 0x0F;
+                    int16_t value = 0;
+                    if (s) {
+                        // s is always 1 in a refinement scan
+                        value = reader.GetBits(1) ? p1 : m1;
+                    } else if (r != 15) {
+                        eob_run = 1u << r;
+                        if (r) eob_run += reader.GetBits(r);
+                        break;
+                    }
+
+                    // skip r zero coefficients, refining the non-zero ones on the way
+                    while (k <= m_nSpectralEnd) {
+                        int16_t& c = coef[m_zigzagIndex[k]];
+                        if (c != 0) {
+                            refine(c);
+                        } else if (--r < 0) {
                             break;
                         }
-                        else if (ac_code == 0xF0)
-                        {
+                        k++;
+                    }
+
+                    if (value && k <= 63) {
+                        coef[m_zigzagIndex[k]] = value;
+                    }
+                }
+            }
+
+            if (eob_run > 0) {
+                // the rest of the band only has correction bits
+                for (; k <= m_nSpectralEnd; k++) {
+                    int16_t& c = coef[m_zigzagIndex[k]];
+                    if (c != 0) refine(c);
+                }
+                eob_run--;
+            }
+        }
+
+        // progressive scans only update the coefficient buffers, the IDCT runs
+        // once all the scans are decoded
+        size_t parseProgressiveScanData(const uint8_t* pScanData, const uint8_t* pDataEnd)
+        {
+            JpegBitReader reader(pScanData, pDataEnd);
+            int16_t previous_dc[4]; // 4 is max num of components defined by ITU-T81
+            memset(previous_dc, 0x00, sizeof(previous_dc));
+            uint32_t eob_run = 0;
+
+            if (m_nSpectralStart > 0) {
+                m_Components[m_ScanComponents[0].component].has_ac = true;
+            }
+
+            for (int mcu = 0; mcu < m_nScanMcuCount; mcu++) {
+                int mcu_index_x = mcu % m_nScanMcusPerLine;
+                int mcu_index_y = mcu / m_nScanMcusPerLine;
+
+                for (int i = 0; i < m_nBlocksPerMcu; i++) {
+                    const McuBlock& mcu_block = m_McuBlocks[i];
+                    const ScanComponent& scan_component = m_ScanComponents[mcu_block.scan_component];
+                    Component& component = m_Components[scan_component.component];
+                    int x = mcu_index_x * mcu_block.h + mcu_block.x;
+                    int y = mcu_index_y * mcu_block.v + mcu_block.y;
+                    int16_t* coef = &component.coefficients[(y * (component.stride >> 3) + x) * 64];
+
+                    if (m_nSpectralStart == 0) {
+                        decodeDcProgressive(reader, mcu_block.scan_component, previous_dc, coef);
+                    } else if (m_nApproxHigh == 0) {
+                        decodeAcFirst(reader, m_treeHuffman[kHuffmanDestinations + scan_component.ac_table], eob_run, coef);
+                    } else {
+                        decodeAcRefine(reader, m_treeHuffman[kHuffmanDestinations + scan_component.ac_table], eob_run, coef);
+                    }
+                }
+
+                if (m_nRestartInterval != 0 && ((mcu + 1) % m_nRestartInterval == 0) && mcu + 1 < m_nScanMcuCount) {
+                    if (!reader.Restart()) {
+                        std::cerr << "Missing RST marker at MCU " << mcu + 1 << std::endl;
+                    }
+                    memset(previous_dc, 0x00, sizeof(previous_dc));
+                    eob_run = 0;
+                }
+            }
+
+            size_t scanLength = reader.FindMarker() - pScanData;
 #if DUMP_DETAILS
-                            std::cerr << "Found ZRL when decode AC!" << std::endl;
+            std::cerr << "Size Of Scan: " << scanLength << " bytes" << std::endl;
 #endif
-                            ac_index += 16;
-                            continue;
-                        }
 
-                        uint8_t ac_zero_length = ac_code >> 4;
-                        ac_index += ac_zero_length;
-                        uint8_t ac_bit_length = ac_code & 0x0F;
-                        int16_t ac_value;
+            return scanLength;
+        }
 
-                        if (ac_bit_length + bit_offset <= 8)
-                        {
-                            tmp_value = ((scan_data[byte_offset] & ((0x01u << (8 - bit_offset)) - 1)) >> (8 - ac_bit_length - bit_offset));
-                        }
-                        else
-                        {
-                            uint8_t bits_in_first_byte = 8 - bit_offset;
-                            uint8_t append_full_bytes = (ac_bit_length - bits_in_first_byte) / 8;
-                            uint8_t bits_in_last_byte = ac_bit_length - bits_in_first_byte - 8 * append_full_bytes;
-                            tmp_value = (scan_data[byte_offset] & ((0x01u << (8 - bit_offset)) - 1));
-                            for (int m = 1; m <= append_full_bytes; m++)
-                            {
-                                tmp_value <<= 8;
-                                tmp_value += scan_data[byte_offset + m];
-                            }
-                            tmp_value <<= bits_in_last_byte;
-                            tmp_value += (scan_data[byte_offset + append_full_bytes + 1] >> (8 - bits_in_last_byte));
+        // dequantize and IDCT block rows [first_row, last_row) of a progressive component
+        void reconstructBlockRows(Component& component, const int first_row, const int last_row) const
+        {
+            const int blocks_per_line = component.stride >> 3;
+            const Matrix8X8f& quantization = m_tableQuantization[component.quantization_table];
+            std::vector<Matrix8X8f> blocks(blocks_per_line);
+
+            for (int by = first_row; by < last_row; by++) {
+                const int16_t* coef = &component.coefficients[by * blocks_per_line * 64];
+                uint8_t* dest = &component.samples[by * 8 * component.stride];
+
+                if (!component.has_ac) {
+                    // only DC so far, the blocks are flat and need no IDCT
+                    for (int bx = 0; bx < blocks_per_line; bx++) {
+                        int value = static_cast<int>(std::floor(coef[bx * 64] * quantization[0][0] / 8.0f + 128.5f));
+                        uint8_t sample = static_cast<uint8_t>(std::clamp(value, 0, 255));
+                        for (int i = 0; i < 8; i++) {
+                            memset(dest + i * component.stride + bx * 8, sample, 8);
                         }
+                    }
+                    continue;
+                }
 
-                        // decode ac value
-                        if ((tmp_value >> (ac_bit_length - 1)) == 0) {
-                            // MSB = 1, turn it to minus value
-                            ac_value = -(int16_t)(~tmp_value & ((0x0001u << ac_bit_length) - 1));
-                        } else {
-                            ac_value = tmp_value;
+                for (int bx = 0; bx < blocks_per_line; bx++) {
+                    for (int i = 0; i < 8; i++) {
+                        for (int j = 0; j < 8; j++) {
+                            blocks[bx][i][j] = coef[bx * 64 + i * 8 + j] * quantization[i][j];
                         }
+                    }
+                    blocks[bx][0][0] += 1024.0f; // level shift
+                }
 
-#ifdef DUMP_DETAILS
-                        printf("AC Code: %x\n", ac_code);
-                        printf("AC Bit Length: %d\n", ac_bit_length);
-                        printf("AC Value: %d\n", ac_value);
-#endif
+                IDCT8X8(blocks.data(), blocks.data(), blocks_per_line);
 
-                        int index = m_zigzagIndex[ac_index];
-                        block[i][index >> 3][index & 0x07] = ac_value;
+                for (int bx = 0; bx < blocks_per_line; bx++) {
+                    storeBlock(blocks[bx], dest + bx * 8, component.stride);
+                }
+            }
+        }
 
-                        // forward pointers to end of AC
-                        bit_offset += ac_bit_length;
-                        while (bit_offset >= 8 ) {
-                            bit_offset -= 8;
-                            byte_offset++;
-                        }
+        void reconstructCoefficients()
+        {
+            for (auto& component : m_Components) {
+                const int rows = static_cast<int>(component.samples.size() / component.stride) >> 3;
+                parallelFor(rows, [this, &component](const int begin, const int end) {
+                    reconstructBlockRows(component, begin, end);
+                });
+            }
+        }
 
-                        ac_index++;
+        // set up the MCU layout of a scan (ITU-T81 A.2). returns false if the
+        // scan header does not fit in its segment of segment_size bytes, or
+        // references a component which is not in the frame or a table
+        // destination which does not exist
+        bool setupScan(const SCAN_HEADER* pScanHeader, const size_t segment_size)
+        {
+            const SCAN_COMPONENT_SPEC_PARAMS* pScsp = reinterpret_cast<const SCAN_COMPONENT_SPEC_PARAMS*>(
+                    reinterpret_cast<const uint8_t*>(pScanHeader) + sizeof(SCAN_HEADER));
+
+            m_nScanComponents = pScanHeader->NumOfComponents;
+            if (m_nScanComponents < 1 || m_nScanComponents > 4) return false;
+            // Ns component selectors followed by Ss, Se and Ah/Al
+            if (sizeof(SCAN_HEADER) + m_nScanComponents * sizeof(SCAN_COMPONENT_SPEC_PARAMS) + 3 > segment_size) return false;
+
+            for (int i = 0; i < m_nScanComponents; i++) {
+                int component = -1;
+                for (size_t j = 0; j < m_Components.size(); j++) {
+                    if (m_Components[j].id == pScsp[i].ComponentSelector) component = static_cast<int>(j);
+                }
+                if (component < 0) return false;
+
+                m_ScanComponents[i].component = component;
+                m_ScanComponents[i].dc_table = pScsp[i].DcEntropyCodingTableDestSelector();
+                m_ScanComponents[i].ac_table = pScsp[i].AcEntropyCodingTableDestSelector();
+                if (m_ScanComponents[i].dc_table >= kHuffmanDestinations || m_ScanComponents[i].ac_table >= kHuffmanDestinations) return false;
+            }
+
+            const uint8_t* pSpectral = reinterpret_cast<const uint8_t*>(pScsp + m_nScanComponents);
+            m_nSpectralStart = pSpectral[0];
+            m_nSpectralEnd = pSpectral[1];
+            m_nApproxHigh = pSpectral[2] >> 4;
+            m_nApproxLow = pSpectral[2] & 0x0F;
+
+            if (m_bProgressive) {
+                // G.1.1.1.1: DC and AC coefficients never share a scan, AC scans are not interleaved
+                if (m_nSpectralEnd > 63 || m_nSpectralStart > m_nSpectralEnd || m_nApproxLow > 13) return false;
+                if ((m_nSpectralStart == 0) != (m_nSpectralEnd == 0)) return false;
+                if (m_nSpectralStart > 0 && m_nScanComponents != 1) return false;
+            }
+
+            m_nBlocksPerMcu = 0;
+            if (m_nScanComponents == 1) {
+                // non-interleaved, one block per MCU
+                const Component& component = m_Components[m_ScanComponents[0].component];
+                m_McuBlocks[0] = { 0, 1, 1, 0, 0 };
+                m_nBlocksPerMcu = 1;
+                m_nScanMcusPerLine = component.blocks_per_line;
+                m_nScanMcuCount = component.blocks_per_line * component.blocks_per_column;
+            } else {
+                for (int i = 0; i < m_nScanComponents; i++) {
+                    const Component& component = m_Components[m_ScanComponents[i].component];
+                    for (int y = 0; y < component.v; y++) {
+                        for (int x = 0; x < component.h; x++) {
+                            if (m_nBlocksPerMcu == kMaxBlocksPerMcu) return false;
+                            m_McuBlocks[m_nBlocksPerMcu++] = { i, component.h, component.v, x, y };
+                        }
                     }
+                }
+                m_nScanMcusPerLine = mcu_count_x;
+                m_nScanMcuCount = mcu_count_x * mcu_count_y;
+            }
 
-#ifdef DUMP_DETAILS
-                    printf("Extracted Component[%d] 8x8 block: ", i);
-                    std::cerr << block[i];
-#endif
-                    MatrixMulByElement(block[i], block[i], m_tableQuantization[fcsp.QuantizationTableDestSelector]);
-#ifdef DUMP_DETAILS
-                    std::cerr << "After Quantization: " << block[i];
-#endif
-                    block[i][0][0] += 1024.0f; // level shift. same as +128 to each element after IDCT
-                    block[i] = IDCT8X8(block[i]);
-#ifdef DUMP_DETAILS
-                    std::cerr << "After IDCT: " << block[i];
-#endif
-                } 
+            return true;
+        }
+
+        // upsample row y of a component to the full image resolution. returns
+        // the row itself when the component is not subsampled
+        const uint8_t* upsampleRow(const Component& component, const int y, uint8_t* buffer) const
+        {
+            const int ratio_h = (m_nMaxH % component.h) ? 0 : m_nMaxH / component.h;
+            const int ratio_v = (m_nMaxV % component.v) ? 0 : m_nMaxV / component.v;
+
+            const int cy = y * component.v / m_nMaxV;
+            const uint8_t* in = &component.samples[cy * component.stride];
+
+            if (ratio_h == 1 && ratio_v == 1) return in;
+
+            if (ratio_v == 2 && (ratio_h == 1 || ratio_h == 2)) {
+                const bool upper = !(y & 1);
+                const int near_y = upper ? std::max(cy - 1, 0) : std::min(cy + 1, component.height - 1);
+                const uint8_t* near = &component.samples[near_y * component.stride];
+                if (ratio_h == 2) {
+                    UpsampleH2V2Fancy(in, near, component.width, buffer);
+                } else {
+                    UpsampleH1V2Fancy(in, near, component.width, upper ? 1 : 2, buffer);
+                }
+            } else if (ratio_h == 2 && ratio_v == 1) {
+                UpsampleH2V1Fancy(in, component.width, buffer);
+            } else {
+                // any other ratio is replicated
+                for (int x = 0; x < m_nSamplesPerLine; x++) {
+                    buffer[x] = in[x * component.h / m_nMaxH];
+                }
+            }
 
-                assert(m_nComponentsInFrame <= 4);
+            return buffer;
+        }
 
-                YCbCrf ycbcr;
-                RGBf   rgb;
-                int mcu_index_x = mcu_index % mcu_count_x;
-                int mcu_index_y = mcu_index / mcu_count_x;
-                uint8_t* pBuf;
+        // upsampling and color conversion of image rows [first_row, last_row)
+        void outputRows(Image& img, const int first_row, const int last_row) const
+        {
+            std::vector<uint8_t> buffers[3];
+            const uint8_t* rows[3];
+            const int num_of_colors = (m_nComponentsInFrame >= 3) ? 3 : 1;
+            for (int c = 0; c < num_of_colors; c++) {
+                buffers[c].resize(m_Components[c].stride * m_nMaxH + 16);
+            }
 
-                for (int i = 0; i < 8; i++) {
-                    for (int j = 0; j < 8; j++) {
-                        for (int k = 0; k < m_nComponentsInFrame; k++) {
-                            ycbcr[k] = block[k][i][j];
-                        }
+            for (int y = first_row; y < last_row; y++) {
+                for (int c = 0; c < num_of_colors; c++) {
+                    rows[c] = upsampleRow(m_Components[c], y, buffers[c].data());
+                }
 
-                        pBuf = reinterpret_cast<uint8_t*>(img.data)
-                            + (img.pitch * (mcu_index_y * 8 + i) + (mcu_index_x * 8 + j) * (img.bitcount >> 3));
-                        rgb = ConvertYCbCr2RGB(ycbcr);
-                        reinterpret_cast<R8G8B8A8Unorm*>(pBuf)->data[0] = (uint8_t)rgb[0];
-                        reinterpret_cast<R8G8B8A8Unorm*>(pBuf)->data[1] = (uint8_t)rgb[1];
-                        reinterpret_cast<R8G8B8A8Unorm*>(pBuf)->data[2] = (uint8_t)rgb[2];
-                        reinterpret_cast<R8G8B8A8Unorm*>(pBuf)->data[3] = 255;
+                uint8_t* pBuf = img.data + img.pitch * y;
+                if (num_of_colors == 3) {
+                    ConvertYCbCr2RGBA(rows[0], rows[1], rows[2], pBuf, img.Width);
+                } else {
+                    for (uint32_t x = 0; x < img.Width; x++) {
+                        pBuf[x * 4] = pBuf[x * 4 + 1] = pBuf[x * 4 + 2] = rows[0][x];
+                        pBuf[x * 4 + 3] = 255;
                     }
                 }
+            }
+        }
 
-                mcu_index++;
-
-                if (m_nRestartInterval != 0 && (mcu_index % m_nRestartInterval == 0)) {
-					if (bit_offset)
-					{
-						// finish current byte
-						bit_offset = 0;
-						byte_offset++;
-					}
-                    assert(byte_offset == scan_data.size());
-                    break;
+        // run func(begin, end) over [0, count) split in bands, one per thread
+        template <typename Func>
+        void parallelFor(const int count, Func func) const
+        {
+#ifndef OS_WEBASSEMBLY
+            unsigned int thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+            thread_count = std::min(thread_count, static_cast<unsigned int>(std::max(count, 1)));
+            if (m_bMultithreaded && thread_count > 1 && mcu_count_x * mcu_count_y >= kMinMcusForThreading) {
+                std::vector<std::thread> threads;
+                const int band = (count + thread_count - 1) / thread_count;
+                for (unsigned int i = 1; i < thread_count; i++) {
+                    int begin = std::min(static_cast<int>(i) * band, count);
+                    int end = std::min(begin + band, count);
+                    threads.emplace_back([&func, begin, end]() { func(begin, end); });
                 }
+                func(0, std::min(band, count));
+                for (auto& thread : threads) {
+                    thread.join();
+                }
+                return;
             }
+#endif
+            func(0, count);
+        }
 
-            return scanLength;
+        void outputImage(Image& img) const
+        {
+            // rows are independent, split the image in horizontal bands
+            parallelFor(static_cast<int>(img.Height), [this, &img](const int begin, const int end) {
+                outputRows(img, begin, end);
+            });
         }
 
     public:
-        virtual Image Parse(Buffer& buf)
+        // decode restart intervals in parallel, or entropy decoding and
+        // reconstruction on two threads when the image has no restart markers
+        void SetMultithreaded(bool multithreaded) { m_bMultithreaded = multithreaded; }
+
+        // stop a progressive image after the first scan_limit scans, 0 decodes
+        // all of them. the result is a low detail preview of the full image
+        void SetProgressiveScanLimit(int scan_limit) { m_nScanLimit = scan_limit; }
+
+        // the output is always R8G8B8A8, so format needs no handling
+        virtual Image Parse(Buffer& buf, ImageOutputFormat /*format*/ = ImageOutputFormat::kImageOutputFormatNative)
         {
             Image img;
+            int scan_count = 0;
+            bool failed = false;    // the file is corrupt, no image comes out
 
+            // the parser may be reused, forget the frame of the previous file
+            m_Components.clear();
+            m_nRestartInterval = 0;
+            m_bProgressive = false;
             const uint8_t* pData = buf.GetData();
             const uint8_t* pDataEnd = buf.GetData() + buf.GetDataSize();
 
             const JFIF_FILEHEADER* pFileHeader = reinterpret_cast<const JFIF_FILEHEADER*>(pData);
-            pData += sizeof(JFIF_FILEHEADER);
-            if (pFileHeader->SOI == endian_net_unsigned_int((uint16_t)0xFFD8) /* FF D8 */) {
+            if (buf.GetDataSize() >= sizeof(JFIF_FILEHEADER)
+                    && pFileHeader->SOI == endian_net_unsigned_int((uint16_t)0xFFD8) /* FF D8 */) {
                 std::cerr << "Asset is JPEG file" << std::endl;
+                pData += sizeof(JFIF_FILEHEADER);
 
                 while(pData < pDataEnd)
                 {
                     size_t scanLength = 0;
 
+                    // every segment header read below stays inside the segment,
+                    // and the segment inside the file
                     const JPEG_SEGMENT_HEADER* pSegmentHeader = reinterpret_cast<const JPEG_SEGMENT_HEADER*>(pData);
+                    const ptrdiff_t remaining = pDataEnd - pData;
+                    if (remaining < 2) {
+                        std::cerr << "Truncated segment marker!" << std::endl;
+                        failed = true;
+                        break;
+                    }
+                    const uint16_t marker = endian_net_unsigned_int(pSegmentHeader->Marker);
+                    size_t segment_size = 2;
+                    if (marker < 0xFFD0 || marker > 0xFFD9) {
+                        if (remaining < static_cast<ptrdiff_t>(sizeof(JPEG_SEGMENT_HEADER))
+                                || endian_net_unsigned_int(pSegmentHeader->Length) < 2
+                                || endian_net_unsigned_int(pSegmentHeader->Length) + 2 > remaining) {
+                            std::cerr << "Truncated segment!" << std::endl;
+                            failed = true;
+                            break;
+                        }
+                        segment_size = endian_net_unsigned_int(pSegmentHeader->Length) + 2 /* length of marker */;
+                    }
 #if DUMP_DETAILS
                     std::cerr << "============================" << std::endl;
 #endif
-                    switch (endian_net_unsigned_int(pSegmentHeader->Marker)) {
+                    switch (marker) {
                         case 0xFFC0:
                         case 0xFFC2:
                             {
-                                if (endian_net_unsigned_int(pSegmentHeader->Marker) == 0xFFC0)
+                                m_bProgressive = (endian_net_unsigned_int(pSegmentHeader->Marker) == 0xFFC2);
+                                if (!m_bProgressive)
                                     std::cerr << "Start Of Frame0 (baseline DCT)" << std::endl;
                                 else
                                     std::cerr << "Start Of Frame2 (progressive DCT)" << std::endl;
@@ -413,41 +1177,82 @@ namespace My {
                                 std::cerr << "----------------------------" << std::endl;
 
                                 const FRAME_HEADER* pFrameHeader = reinterpret_cast<const FRAME_HEADER*>(pData);
+                                if (segment_size < sizeof(FRAME_HEADER)
+                                        || segment_size < sizeof(FRAME_HEADER) + pFrameHeader->NumOfComponentsInFrame * sizeof(FRAME_COMPONENT_SPEC_PARAMS)) {
+                                    std::cerr << "Invalid frame header!" << std::endl;
+                                    m_Components.clear();
+                                    failed = true;
+                                    pData = pDataEnd;
+                                    break;
+                                }
                                 m_nSamplePrecision = pFrameHeader->SamplePrecision;
                                 m_nLines = endian_net_unsigned_int((uint16_t)pFrameHeader->NumOfLines);
                                 m_nSamplesPerLine = endian_net_unsigned_int((uint16_t)pFrameHeader->NumOfSamplesPerLine);
                                 m_nComponentsInFrame = pFrameHeader->NumOfComponentsInFrame;
-                                mcu_index = 0;
-                                mcu_count_x = ((m_nSamplesPerLine + 7) >> 3);
-                                mcu_count_y = ((m_nLines + 7) >> 3);
-                                mcu_count = mcu_count_x * mcu_count_y;
 
                                 std::cerr << "Sample Precision: " << m_nSamplePrecision << std::endl;
                                 std::cerr << "Num of Lines: " << m_nLines << std::endl;
                                 std::cerr << "Num of Samples per Line: " << m_nSamplesPerLine << std::endl;
                                 std::cerr << "Num of Components In Frame: " << m_nComponentsInFrame << std::endl;
-                                std::cerr << "Total MCU count: " << mcu_count << std::endl;
 
                                 const uint8_t* pTmp = pData + sizeof(FRAME_HEADER);
                                 const FRAME_COMPONENT_SPEC_PARAMS* pFcsp = reinterpret_cast<const FRAME_COMPONENT_SPEC_PARAMS*>(pTmp);
+                                m_Components.clear();
+                                m_nMaxH = m_nMaxV = 1;
+                                bool valid = (m_nComponentsInFrame >= 1 && m_nComponentsInFrame <= 4);
                                 for (uint8_t i = 0; i < pFrameHeader->NumOfComponentsInFrame; i++) {
                                     std::cerr << "\tComponent Identifier: " << (uint16_t)pFcsp->ComponentIdentifier << std::endl;
                                     std::cerr << "\tHorizontal Sampling Factor: " << (uint16_t)pFcsp->HorizontalSamplingFactor() << std::endl;
                                     std::cerr << "\tVertical Sampling Factor: " << (uint16_t)pFcsp->VerticalSamplingFactor() << std::endl;
                                     std::cerr << "\tQuantization Table Destination Selector: " << (uint16_t)pFcsp->QuantizationTableDestSelector << std::endl;
                                     std::cerr << std::endl;
-                                    m_tableFrameComponentsSpec.push_back(*pFcsp);
+
+                                    Component component;
+                                    component.id = pFcsp->ComponentIdentifier;
+                                    component.h = pFcsp->HorizontalSamplingFactor();
+                                    component.v = pFcsp->VerticalSamplingFactor();
+                                    component.quantization_table = pFcsp->QuantizationTableDestSelector & 0x03;
+                                    if (component.h < 1 || component.h > 4 || component.v < 1 || component.v > 4) valid = false;
+                                    m_nMaxH = std::max(m_nMaxH, component.h);
+                                    m_nMaxV = std::max(m_nMaxV, component.v);
+                                    m_Components.push_back(component);
                                     pFcsp++;
-                                } 
+                                }
+
+                                if (!valid || !m_nSamplesPerLine || !m_nLines) {
+                                    std::cerr << "Unsupported frame parameters!" << std::endl;
+                                    m_Components.clear();
+                                    pData = pDataEnd;
+                                    break;
+                                }
+
+                                // an MCU covers Hmax x Vmax blocks of the full resolution image
+                                mcu_count_x = (m_nSamplesPerLine + m_nMaxH * 8 - 1) / (m_nMaxH * 8);
+                                mcu_count_y = (m_nLines + m_nMaxV * 8 - 1) / (m_nMaxV * 8);
+                                std::cerr << "Total MCU count: " << mcu_count_x * mcu_count_y << std::endl;
+
+                                for (auto& component : m_Components) {
+                                    component.width = (m_nSamplesPerLine * component.h + m_nMaxH - 1) / m_nMaxH;
+                                    component.height = (m_nLines * component.v + m_nMaxV - 1) / m_nMaxV;
+                                    component.blocks_per_line = (component.width + 7) >> 3;
+                                    component.blocks_per_column = (component.height + 7) >> 3;
+                                    component.stride = mcu_count_x * component.h * 8;
+                                    component.samples.assign(component.stride * mcu_count_y * component.v * 8, 0);
+                                    if (m_bProgressive) {
+                                        component.coefficients.assign(component.samples.size(), 0);
+                                    }
+                                    component.has_ac = false;
+                                }
+                                scan_count = 0;
 
                                 img.Width = m_nSamplesPerLine;
                                 img.Height = m_nLines;
                                 img.bitcount = 32;
-                                img.pitch = mcu_count_x * 8 * (img.bitcount >> 3);
-                                img.data_size = img.pitch * mcu_count_y * 8 * (img.bitcount >> 3);
+                                img.pitch = img.Width * (img.bitcount >> 3);
+                                img.data_size = img.pitch * img.Height;
                                 img.data = new uint8_t[img.data_size];
 
-                                pData += endian_net_unsigned_int(pSegmentHeader->Length) + 2 /* length of marker */;
+                                pData += segment_size;
                             }
                             break;
                         case 0xFFC4:
@@ -460,23 +1265,55 @@ namespace My {
                                 const uint8_t* pTmp = pData + sizeof(JPEG_SEGMENT_HEADER);
 
                                 while (segmentLength > 0) {
+                                    if (segmentLength < sizeof(HUFFMAN_TABLE_SPEC) || pDataEnd - pTmp < static_cast<ptrdiff_t>(sizeof(HUFFMAN_TABLE_SPEC))) {
+                                        std::cerr << "Invalid Huffman table!" << std::endl;
+                                        failed = true;
+                                        break;
+                                    }
+
                                     const HUFFMAN_TABLE_SPEC* pHtable = reinterpret_cast<const HUFFMAN_TABLE_SPEC*>(pTmp);
                                     std::cerr << "Table Class: " << pHtable->TableClass() << std::endl;
                                     std::cerr << "Destination Identifier: " << pHtable->DestinationIdentifier() << std::endl;
 
-                                    const uint8_t* pCodeValueStart = reinterpret_cast<const uint8_t*>(pHtable) + sizeof(HUFFMAN_TABLE_SPEC);
+                                    if (pHtable->TableClass() > 1 || pHtable->DestinationIdentifier() >= kHuffmanDestinations) {
+                                        std::cerr << "Invalid Huffman table destination!" << std::endl;
+                                        failed = true;
+                                        break;
+                                    }
+                                    const int table_index = pHtable->TableClass() * kHuffmanDestinations + pHtable->DestinationIdentifier();
 
-                                    auto num_symbo = m_treeHuffman[(pHtable->TableClass() << 1) | pHtable->DestinationIdentifier()].PopulateWithHuffmanTable(pHtable->NumOfHuffmanCodes, pCodeValueStart);
+                                    const uint8_t* pCodeValueStart = reinterpret_cast<const uint8_t*>(pHtable) + sizeof(HUFFMAN_TABLE_SPEC);
+                                    const size_t code_size = std::min(segmentLength - sizeof(HUFFMAN_TABLE_SPEC),
+                                            static_cast<size_t>(pDataEnd - pCodeValueStart));
+
+                                    // a parser which is reused keeps the lookup tables of
+                                    // the previous file, they are only rebuilt if they differ
+                                    HuffmanTree<uint8_t>& tree = m_treeHuffman[table_index];
+                                    size_t num_symbo = 0;
+                                    if (tree.IsBuiltFrom(pHtable->NumOfHuffmanCodes, pCodeValueStart, code_size)) {
+                                        for (int i = 0; i < 16; i++) num_symbo += pHtable->NumOfHuffmanCodes[i];
+                                    } else {
+                                        num_symbo = tree.PopulateWithHuffmanTable(pHtable->NumOfHuffmanCodes, pCodeValueStart, code_size);
+                                    }
+                                    if (!num_symbo) {
+                                        std::cerr << "Invalid Huffman table!" << std::endl;
+                                        failed = true;
+                                        break;
+                                    }
 
 #ifdef DUMP_DETAILS
-                                    m_treeHuffman[(pHtable->TableClass() << 1) | pHtable->DestinationIdentifier()].Dump();
+                                    m_treeHuffman[table_index].Dump();
 #endif
 
                                     size_t processed_length = sizeof(HUFFMAN_TABLE_SPEC) + num_symbo;
                                     pTmp += processed_length;
                                     segmentLength -= processed_length;
                                 }
-                                pData += endian_net_unsigned_int(pSegmentHeader->Length) + 2 /* length of marker */;
+                                if (failed) {
+                                    pData = pDataEnd;
+                                    break;
+                                }
+                                pData += segment_size;
                             }
                             break;
                         case 0xFFDB:
@@ -493,6 +1330,14 @@ namespace My {
                                     std::cerr << "Element Precision: " << pQtable->ElementPrecision() << std::endl;
                                     std::cerr << "Destination Identifier: " << pQtable->DestinationIdentifier() << std::endl;
 
+                                    // B.2.4.1: 8 or 16 bit elements, up to 4 tables
+                                    if (pQtable->ElementPrecision() > 1 || pQtable->DestinationIdentifier() > 3
+                                            || segmentLength < sizeof(QUANTIZATION_TABLE_SPEC) + 64 * (pQtable->ElementPrecision() + 1)) {
+                                        std::cerr << "Invalid quantization table!" << std::endl;
+                                        failed = true;
+                                        break;
+                                    }
+
                                     const uint8_t* pElementDataStart = reinterpret_cast<const uint8_t*>(pQtable) + sizeof(QUANTIZATION_TABLE_SPEC);
 
                                     for (int i = 0; i < 64; i++) {
@@ -511,7 +1356,11 @@ namespace My {
                                     pTmp += processed_length;
                                     segmentLength -= processed_length;
                                 }
-                                pData += endian_net_unsigned_int(pSegmentHeader->Length) + 2 /* length of marker */;
+                                if (failed) {
+                                    pData = pDataEnd;
+                                    break;
+                                }
+                                pData += segment_size;
                             }
                             break;
                         case 0xFFDD:
@@ -520,9 +1369,15 @@ namespace My {
                                 std::cerr << "----------------------------" << std::endl;
 
                                 RESTART_INTERVAL_DEF* pRestartHeader = (RESTART_INTERVAL_DEF*) pData;
+                                if (segment_size < sizeof(RESTART_INTERVAL_DEF)) {
+                                    std::cerr << "Invalid restart interval!" << std::endl;
+                                    failed = true;
+                                    pData = pDataEnd;
+                                    break;
+                                }
                                 m_nRestartInterval = endian_net_unsigned_int((uint16_t)pRestartHeader->RestartInterval);
                                 std::cerr << "Restart interval: " << m_nRestartInterval << std::endl;
-                                pData += endian_net_unsigned_int(pSegmentHeader->Length) + 2 /* length of marker */;
+                                pData += segment_size;
                             }
                             break;
                         case 0xFFDA:
@@ -531,16 +1386,29 @@ namespace My {
                                 std::cerr << "----------------------------" << std::endl;
 
                                 SCAN_HEADER* pScanHeader = (SCAN_HEADER*) pData;
+                                if (segment_size < sizeof(SCAN_HEADER) || m_Components.empty() || !setupScan(pScanHeader, segment_size)) {
+                                    std::cerr << "Invalid scan header!" << std::endl;
+                                    failed = true;
+                                    pData = pDataEnd;
+                                    break;
+                                }
                                 std::cerr << "Image Conponents in Scan: " << (uint16_t)pScanHeader->NumOfComponents << std::endl;
-                                assert(pScanHeader->NumOfComponents == m_nComponentsInFrame);
 
-                                const uint8_t* pTmp = pData + sizeof(SCAN_HEADER);
-                                pScsp = reinterpret_cast<const SCAN_COMPONENT_SPEC_PARAMS*>(pTmp);
+                                const uint8_t* pScanData = pData + segment_size;
 
-                                const uint8_t* pScanData = pData + endian_net_unsigned_int((uint16_t)pScanHeader->Length) + 2;
+                                if (m_bProgressive) {
+                                    std::cerr << "Spectral Selection: " << m_nSpectralStart << "-" << m_nSpectralEnd
+                                        << " Successive Approximation: " << m_nApproxHigh << "-" << m_nApproxLow << std::endl;
+                                    scanLength = parseProgressiveScanData(pScanData, pDataEnd);
+                                } else {
+                                    scanLength = parseScanData(pScanData, pDataEnd);
+                                }
+                                pData += segment_size + scanLength;
 
-                                scanLength = parseScanData(pScanData, pDataEnd, img);
-                                pData += endian_net_unsigned_int(pSegmentHeader->Length) + 2 + scanLength /* length of marker */;
+                                if (m_bProgressive && m_nScanLimit > 0 && ++scan_count >= m_nScanLimit) {
+                                    std::cerr << "Stop after " << scan_count << " scans" << std::endl;
+                                    pData = pDataEnd;
+                                }
                             }
                             break;
                         case 0xFFD0:
@@ -552,28 +1420,29 @@ namespace My {
                         case 0xFFD6:
                         case 0xFFD7:
                             {
-#if DUMP_DETAILS
-                                std::cerr << "Restart Of Scan" << std::endl;
-                                std::cerr << "----------------------------" << std::endl;
-#endif
-
-                                const uint8_t* pScanData = pData + 2;
-                                scanLength = parseScanData(pScanData, pDataEnd, img);
-                                pData += 2 + scanLength /* length of marker */;
+                                // restart markers are consumed while decoding the scan
+                                std::cerr << "Unexpected Restart Marker" << std::endl;
+                                pData += 2 /* length of marker */;
                             }
                             break;
                         case 0xFFD9:
                             {
                                 std::cerr << "End Of Scan" << std::endl;
                                 std::cerr << "----------------------------" << std::endl;
-                                pData += 2 /* length of marker */;
+                                // whatever follows EOI is not part of the image
+                                pData = pDataEnd;
                             }
                             break;
                         case 0xFFE0:
                             {
                                 const APP0* pApp0 = reinterpret_cast<const APP0*>(pData);
-                                switch (endian_net_unsigned_int(*(uint32_t*)pApp0->Identifier)) {
+                                uint32_t identifier = 0;
+                                if (segment_size >= sizeof(APP0)) {
+                                    std::memcpy(&identifier, pApp0->Identifier, sizeof(identifier));
+                                }
+                                switch (endian_net_unsigned_int(identifier)) {
                                     case "JFIF\0"_u32: 
+                                        if (segment_size >= sizeof(JFIF_APP0))
                                         {
                                             const JFIF_APP0* pJfifApp0 = reinterpret_cast<const JFIF_APP0*>(pApp0);
                                             std::cerr << "JFIF-APP0" << std::endl;
@@ -595,6 +1464,7 @@ namespace My {
                                         }
                                         break;
                                     case "JFXX\0"_u32:
+                                        if (segment_size >= sizeof(JFXX_APP0))
                                         {
                                             const JFXX_APP0* pJfxxApp0 = reinterpret_cast<const JFXX_APP0*>(pApp0);
                                             std::cerr << "Thumbnail Format: ";
@@ -616,20 +1486,20 @@ namespace My {
                                     default:
                                         std::cerr << "Ignor Unrecognized APP0 segment." << std::endl;
                                 }
-                                pData += endian_net_unsigned_int(pSegmentHeader->Length) + 2 /* length of marker */;
+                                pData += segment_size;
                             }
                             break;
                         case 0xFFFE:
                             {
                                 std::cerr << "Text Comment" << std::endl;
                                 std::cerr << "----------------------------" << std::endl;
-                                pData += endian_net_unsigned_int(pSegmentHeader->Length) + 2 /* length of marker */;
+                                pData += segment_size;
                             }
                             break;
                         default:
                             {
                                 std::printf("Ignor Unrecognized Segment. Marker=%0x\n", endian_net_unsigned_int(pSegmentHeader->Marker));
-                                pData += endian_net_unsigned_int(pSegmentHeader->Length) + 2 /* length of marker */;
+                                pData += segment_size;
                             }
                             break;
                     }
@@ -639,6 +1509,18 @@ namespace My {
                 std::cerr << "File is not a JPEG file!" << std::endl;
             }
 
+            if (failed) {
+                delete[] img.data;
+                img = Image();
+            }
+
+            if (img.data && !m_Components.empty()) {
+                if (m_bProgressive) {
+                    reconstructCoefficients();
+                }
+                outputImage(img);
+            }
+
             img.mipmaps[0].Width = img.Width; 
             img.mipmaps[0].Height = img.Height; 
             img.mipmaps[0].pitch = img.pitch;
@@ -1,12 +1,19 @@
 #pragma once
 #include <cstdio>
+#include <cstdlib>
 #include <iostream>
 #include <string>
 #include <cassert>
 #include <queue>
 #include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include "config.h"
 #include "ImageParser.hpp"
+#include "PixelFormatConversion.hpp"
 #include "portable.hpp"
 #include "zlib.h"
 
@@ -20,7 +27,8 @@ namespace My {
         IHDR = "IHDR"_u32,
         PLTE = "PLTE"_u32,
         IDAT = "IDAT"_u32,
-        IEND = "IEND"_u32
+        IEND = "IEND"_u32,
+        tRNS = "tRNS"_u32
     };
 
 #if DUMP_DETAILS
@@ -83,11 +91,222 @@ namespace My {
         }
     }
 
+    // scan line reconstruction (PNG spec 9.2). raw is the filtered scan line
+    // without its filter type byte, prev the reconstructed line above (all
+    // zero for the first line) and dest receives the reconstructed line.
+    // length is the size of the line in bytes, bpp the bytes per complete
+    // pixel rounded up to 1. each filter type has its own row kernel, the
+    // SSE2 ones process one pixel of 3 or 4 bytes per step.
+    inline void UnfilterRowUp(const uint8_t* raw, const uint8_t* prev, uint8_t* dest, const size_t length)
+    {
+        size_t i = 0;
+#if MYGE_SIMD_SSE
+        for (; i + 16 <= length; i += 16) {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(raw + i));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), _mm_add_epi8(x, b));
+        }
+#endif
+        for (; i < length; i++) {
+            dest[i] = static_cast<uint8_t>(raw[i] + prev[i]);
+        }
+    }
+
+    inline void UnfilterRowSub(const uint8_t* raw, uint8_t* dest, const size_t length, const int bpp)
+    {
+        size_t i = 0;
+        for (; i < static_cast<size_t>(bpp) && i < length; i++) {
+            dest[i] = raw[i];
+        }
+        for (; i < length; i++) {
+            dest[i] = static_cast<uint8_t>(raw[i] + dest[i - bpp]);
+        }
+    }
+
+    inline void UnfilterRowAverage(const uint8_t* raw, const uint8_t* prev, uint8_t* dest, const size_t length, const int bpp)
+    {
+        size_t i = 0;
+        for (; i < static_cast<size_t>(bpp) && i < length; i++) {
+            dest[i] = static_cast<uint8_t>(raw[i] + (prev[i] >> 1));
+        }
+        for (; i < length; i++) {
+            dest[i] = static_cast<uint8_t>(raw[i] + ((dest[i - bpp] + prev[i]) >> 1));
+        }
+    }
+
+    inline void UnfilterRowPaeth(const uint8_t* raw, const uint8_t* prev, uint8_t* dest, const size_t length, const int bpp)
+    {
+        size_t i = 0;
+        // a = c = 0 on the first pixel, the predictor is always b
+        for (; i < static_cast<size_t>(bpp) && i < length; i++) {
+            dest[i] = static_cast<uint8_t>(raw[i] + prev[i]);
+        }
+        for (; i < length; i++) {
+            // p = a + b - c, so |p - a| = |b - c|, |p - b| = |a - c| and |p - c| = |a + b - 2c|
+            const int a = dest[i - bpp];
+            const int b = prev[i];
+            const int c = prev[i - bpp];
+            const int pa = std::abs(b - c);
+            const int pb = std::abs(a - c);
+            const int pc = std::abs(a + b - 2 * c);
+            const int predictor = (pa <= pb && pa <= pc) ? a : ((pb <= pc) ? b : c);
+            dest[i] = static_cast<uint8_t>(raw[i] + predictor);
+        }
+    }
+
+#if MYGE_SIMD_SSE
+    template <int bpp>
+    inline __m128i PngLoadPixel(const uint8_t* p)
+    {
+        int32_t v = 0;
+        std::memcpy(&v, p, bpp);
+        return _mm_cvtsi32_si128(v);
+    }
+
+    template <int bpp>
+    inline void PngStorePixel(uint8_t* p, const __m128i v)
+    {
+        int32_t x = _mm_cvtsi128_si32(v);
+        std::memcpy(p, &x, bpp);
+    }
+
+    template <int bpp>
+    inline void UnfilterRowSubSimd(const uint8_t* raw, uint8_t* dest, const size_t length)
+    {
+        __m128i a = _mm_setzero_si128();
+        for (size_t i = 0; i < length; i += bpp) {
+            a = _mm_add_epi8(a, PngLoadPixel<bpp>(raw + i));
+            PngStorePixel<bpp>(dest + i, a);
+        }
+    }
+
+    template <int bpp>
+    inline void UnfilterRowAverageSimd(const uint8_t* raw, const uint8_t* prev, uint8_t* dest, const size_t length)
+    {
+        const __m128i one = _mm_set1_epi8(1);
+        __m128i a = _mm_setzero_si128();
+        for (size_t i = 0; i < length; i += bpp) {
+            __m128i b = PngLoadPixel<bpp>(prev + i);
+            // _mm_avg_epu8 rounds up, the filter rounds down
+            __m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+            a = _mm_add_epi8(avg, PngLoadPixel<bpp>(raw + i));
+            PngStorePixel<bpp>(dest + i, a);
+        }
+    }
+
+    template <int bpp>
+    inline void UnfilterRowPaethSimd(const uint8_t* raw, const uint8_t* prev, uint8_t* dest, const size_t length)
+    {
+        // branchless Paeth predictor on 16 bit lanes
+        const __m128i zero = _mm_setzero_si128();
+        __m128i a = zero;
+        __m128i c = zero;
+        for (size_t i = 0; i < length; i += bpp) {
+            __m128i b = _mm_unpacklo_epi8(PngLoadPixel<bpp>(prev + i), zero);
+            __m128i x = _mm_unpacklo_epi8(PngLoadPixel<bpp>(raw + i), zero);
+
+            __m128i pa = _mm_sub_epi16(b, c);
+            __m128i pb = _mm_sub_epi16(a, c);
+            __m128i pc = _mm_add_epi16(pa, pb);
+            pa = _mm_max_epi16(pa, _mm_sub_epi16(zero, pa));
+            pb = _mm_max_epi16(pb, _mm_sub_epi16(zero, pb));
+            pc = _mm_max_epi16(pc, _mm_sub_epi16(zero, pc));
+
+            __m128i smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+            __m128i use_b = _mm_cmpeq_epi16(smallest, pb);
+            __m128i nearest = _mm_or_si128(_mm_and_si128(use_b, b), _mm_andnot_si128(use_b, c));
+            __m128i use_a = _mm_cmpeq_epi16(smallest, pa);
+            nearest = _mm_or_si128(_mm_and_si128(use_a, a), _mm_andnot_si128(use_a, nearest));
+
+            // the high bytes stay zero, so the 8 bit add wraps like the filter does
+            a = _mm_add_epi8(x, nearest);
+            PngStorePixel<bpp>(dest + i, _mm_packus_epi16(a, a));
+            c = b;
+        }
+    }
+#endif
+
+    // returns false for an unknown filter type
+    inline bool UnfilterRow(const uint8_t filter_type, const uint8_t* raw, const uint8_t* prev, uint8_t* dest,
+            const size_t length, const int bpp)
+    {
+        switch (filter_type) {
+            case 0:
+                std::memcpy(dest, raw, length);
+                break;
+            case 1:
+#if MYGE_SIMD_SSE
+                if (bpp == 4) { UnfilterRowSubSimd<4>(raw, dest, length); break; }
+                if (bpp == 3) { UnfilterRowSubSimd<3>(raw, dest, length); break; }
+#endif
+                UnfilterRowSub(raw, dest, length, bpp);
+                break;
+            case 2:
+                UnfilterRowUp(raw, prev, dest, length);
+                break;
+            case 3:
+#if MYGE_SIMD_SSE
+                if (bpp == 4) { UnfilterRowAverageSimd<4>(raw, prev, dest, length); break; }
+                if (bpp == 3) { UnfilterRowAverageSimd<3>(raw, prev, dest, length); break; }
+#endif
+                UnfilterRowAverage(raw, prev, dest, length, bpp);
+                break;
+            case 4:
+#if MYGE_SIMD_SSE
+                if (bpp == 4) { UnfilterRowPaethSimd<4>(raw, prev, dest, length); break; }
+                if (bpp == 3) { UnfilterRowPaethSimd<3>(raw, prev, dest, length); break; }
+#endif
+                UnfilterRowPaeth(raw, prev, dest, length, bpp);
+                break;
+            default:
+                return false;
+        }
+
+        return true;
+    }
+
+    // big endian 16 bit samples to native order
+    inline void SwapBytes16Row(const uint8_t* src, uint8_t* dest, const size_t length)
+    {
+        size_t i = 0;
+#if MYGE_SIMD_SSE
+        for (; i + 16 <= length; i += 16) {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8)));
+        }
+#endif
+        for (; i + 1 < length; i += 2) {
+            const uint8_t hi = src[i];
+            dest[i] = src[i + 1];
+            dest[i + 1] = hi;
+        }
+    }
+
+    // palette indices of bit_depth 1, 2, 4 or 8 to R8G8B8A8
+    inline void ExpandPaletteRow(const uint8_t* src, uint8_t* dest, const uint32_t width, const uint8_t bit_depth,
+            const uint8_t palette[256][4])
+    {
+        if (bit_depth == 8) {
+            for (uint32_t x = 0; x < width; x++) {
+                std::memcpy(dest + x * 4, palette[src[x]], 4);
+            }
+            return;
+        }
+
+        const uint32_t mask = (1u << bit_depth) - 1;
+        const uint32_t pixels_per_byte = 8 / bit_depth;
+        for (uint32_t x = 0; x < width; x++) {
+            const uint32_t shift = 8 - bit_depth * (1 + x % pixels_per_byte);
+            const uint32_t index = (src[x / pixels_per_byte] >> shift) & mask;
+            std::memcpy(dest + x * 4, palette[index], 4);
+        }
+    }
+
     class PngParser : implements ImageParser
     {
     protected:
-        uint16_t m_Width;
-        uint16_t m_Height;
+        uint32_t m_Width;
+        uint32_t m_Height;
         uint8_t  m_BitDepth;
         uint8_t  m_ColorType;
         uint8_t  m_CompressionMethod;
@@ -95,19 +314,259 @@ namespace My {
         uint8_t  m_InterlaceMethod;
         int32_t  m_ScanLineSize;
         uint8_t  m_BytesPerPixel;
+        uint8_t  m_Palette[256][4];
+        bool     m_bMultithreaded = true;
+        bool     m_bOutputRGBA = false;
+
+        // the inflate state and its window are allocated once and reset for
+        // every image the parser decodes
+        z_stream m_ZStream;
+        bool     m_bZStreamReady = false;
+
+        // below this much image data the second thread costs more than it saves
+        static const size_t kMinBytesForThreading = 1024 * 1024;
+
+        // the zlib stream of the image is split over the IDAT chunks
+        struct ImageDataChunk {
+            const uint8_t* data;
+            uint32_t       size;
+        };
+
+        // inflate exactly size bytes into out, feeding the IDAT chunks as needed
+        static bool inflateBytes(z_stream& strm, const std::vector<ImageDataChunk>& chunks, size_t& next_chunk,
+                uint8_t* out, const size_t size)
+        {
+            strm.next_out = static_cast<Bytef*>(out);
+            strm.avail_out = static_cast<uInt>(size);
+
+            while (strm.avail_out > 0) {
+                if (strm.avail_in == 0) {
+                    if (next_chunk == chunks.size()) {
+                        std::cerr << "[Error] PNG image data is truncated" << std::endl;
+                        return false;
+                    }
+                    strm.next_in = const_cast<Bytef*>(chunks[next_chunk].data);
+                    strm.avail_in = chunks[next_chunk].size;
+                    next_chunk++;
+                    continue;
+                }
+
+                int ret = inflate(&strm, Z_NO_FLUSH);
+                assert(ret != Z_STREAM_ERROR);
+                if (ret == Z_STREAM_END) {
+                    return strm.avail_out == 0;
+                }
+                if (ret != Z_OK) {
+                    zerr(ret);
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        // palette images are expanded, 16 bit samples are swapped to native
+        // order and RGB gets an alpha channel if requested. the filters work on
+        // the original bytes, so these formats are reconstructed into a line
+        // buffer first and converted to the image while it is still in cache
+        struct LineState {
+            std::vector<uint8_t> zero_line;
+            std::vector<uint8_t> lines;
+            const uint8_t* prev;
+            bool convert;
+        };
+
+        bool expandToRGBA() const
+        {
+            return m_bOutputRGBA && m_ColorType == 2 && (m_BitDepth == 8 || m_BitDepth == 16);
+        }
+
+        void initLineState(LineState& state) const
+        {
+            state.convert = (m_ColorType == 3 || m_BitDepth == 16 || expandToRGBA());
+            state.zero_line.assign(m_ScanLineSize, 0);
+            if (state.convert) state.lines.resize(m_ScanLineSize * 2);
+            state.prev = state.zero_line.data();
+        }
+
+        // reconstruct count lines of raw data (filter type byte + scan line each) starting at row
+        bool reconstructLines(const uint8_t* raw, const uint32_t row, const uint32_t count, LineState& state, Image& img) const
+        {
+            const size_t raw_line_size = m_ScanLineSize + 1;
+            for (uint32_t i = 0; i < count; i++) {
+                const uint8_t* line = raw + raw_line_size * i;
+                uint8_t* dest = img.data + img.pitch * (row + i);
+                uint8_t* out = state.convert ? &state.lines[((row + i) & 1) * m_ScanLineSize] : dest;
+
+                if (!UnfilterRow(line[0], line + 1, state.prev, out, m_ScanLineSize, m_BytesPerPixel)) {
+                    std::cerr << "[Error] Unknown Filter Type!" << std::endl;
+                    return false;
+                }
+
+                if (state.convert) {
+                    if (m_ColorType == 3) {
+                        ExpandPaletteRow(out, dest, m_Width, m_BitDepth, m_Palette);
+                    } else if (expandToRGBA()) {
+                        if (m_BitDepth == 8) {
+                            ExpandRGB8ToRGBA8(out, dest, m_Width);
+                        } else {
+                            ExpandRGB16BEToRGBA16(out, dest, m_Width);
+                        }
+                    } else {
+                        SwapBytes16Row(out, dest, m_ScanLineSize);
+                    }
+                }
+
+                state.prev = out;
+            }
+
+            return true;
+        }
+
+#ifndef OS_WEBASSEMBLY
+        // this thread inflates batches of scan lines into a ring of buffers, a
+        // second thread reconstructs them into the image
+        void decodePipelined(z_stream& strm, const std::vector<ImageDataChunk>& chunks, const uint32_t lines_per_batch, Image& img) const
+        {
+            const uint32_t kPipelineDepth = 4; // batches in flight
+            const size_t batch_bytes = (m_ScanLineSize + 1) * static_cast<size_t>(lines_per_batch);
+            const uint32_t batch_count = (m_Height + lines_per_batch - 1) / lines_per_batch;
+
+            std::vector<uint8_t> ring(batch_bytes * kPipelineDepth);
+            std::mutex lock;
+            std::condition_variable produced_cv;
+            std::condition_variable consumed_cv;
+            uint32_t produced = 0;
+            uint32_t consumed = 0;
+            bool finished = false;
+            bool failed = false;
+
+            std::thread consumer([&]() {
+                LineState state;
+                initLineState(state);
+                for (uint32_t batch = 0; batch < batch_count; batch++) {
+                    {
+                        std::unique_lock<std::mutex> guard(lock);
+                        produced_cv.wait(guard, [&]() { return produced > batch || finished; });
+                        if (produced <= batch) break;
+                    }
+
+                    const uint32_t row = batch * lines_per_batch;
+                    const uint32_t lines = std::min(lines_per_batch, m_Height - row);
+                    bool ok = reconstructLines(&ring[(batch % kPipelineDepth) * batch_bytes], row, lines, state, img);
+
+                    {
+                        std::lock_guard<std::mutex> guard(lock);
+                        consumed = batch + 1;
+                        failed = !ok;
+                    }
+                    consumed_cv.notify_one();
+                    if (!ok) break;
+                }
+            });
+
+            size_t next_chunk = 0;
+            for (uint32_t batch = 0; batch < batch_count; batch++) {
+                {
+                    std::unique_lock<std::mutex> guard(lock);
+                    consumed_cv.wait(guard, [&]() { return batch - consumed < kPipelineDepth || failed; });
+                    if (failed) break;
+                }
+
+                const uint32_t lines = std::min(lines_per_batch, m_Height - batch * lines_per_batch);
+                if (!inflateBytes(strm, chunks, next_chunk, &ring[(batch % kPipelineDepth) * batch_bytes],
+                            (m_ScanLineSize + 1) * static_cast<size_t>(lines))) break;
+
+                {
+                    std::lock_guard<std::mutex> guard(lock);
+                    produced = batch + 1;
+                }
+                produced_cv.notify_one();
+            }
+
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                finished = true;
+            }
+            produced_cv.notify_one();
+            consumer.join();
+        }
+#endif
+
+        // inflate a batch of whole scan lines at a time, then reconstruct them
+        // line by line with the row kernel of their filter type
+        void decodeImageData(const std::vector<ImageDataChunk>& chunks, Image& img)
+        {
+            z_stream& strm = m_ZStream;
+            int ret;
+            if (m_bZStreamReady)
+            {
+                ret = inflateReset(&strm);
+            }
+            else
+            {
+                strm.zalloc = Z_NULL;
+                strm.zfree  = Z_NULL;
+                strm.opaque = Z_NULL;
+                strm.avail_in = 0;
+                strm.next_in = Z_NULL;
+                ret = inflateInit(&strm);
+                m_bZStreamReady = (ret == Z_OK);
+            }
+            if (ret != Z_OK)
+            {
+                std::cerr << "[Error] Failed to init zlib" << std::endl;
+                zerr(ret);
+                return;
+            }
+
+            const size_t kBatchSize = 64 * 1024;
+            const size_t raw_line_size = m_ScanLineSize + 1; // filter type byte + scan line
+            const uint32_t lines_per_batch = static_cast<uint32_t>(std::max<size_t>(kBatchSize / raw_line_size, 1));
+
+#ifndef OS_WEBASSEMBLY
+            if (m_bMultithreaded && std::thread::hardware_concurrency() > 1
+                    && raw_line_size * m_Height >= kMinBytesForThreading && m_Height > lines_per_batch) {
+                decodePipelined(strm, chunks, lines_per_batch, img);
+                return;
+            }
+#endif
+
+            std::vector<uint8_t> raw(raw_line_size * std::min(lines_per_batch, m_Height));
+            LineState state;
+            initLineState(state);
+            size_t next_chunk = 0;
+
+            for (uint32_t row = 0; row < m_Height; row += lines_per_batch) {
+                const uint32_t lines = std::min(lines_per_batch, m_Height - row);
+                if (!inflateBytes(strm, chunks, next_chunk, raw.data(), raw_line_size * lines)) break;
+                if (!reconstructLines(raw.data(), row, lines, state, img)) break;
+            }
+        }
 
     public:
-        virtual Image Parse(Buffer& buf)
+        PngParser() = default;
+        PngParser(const PngParser&) = delete;
+        PngParser& operator=(const PngParser&) = delete;
+
+        virtual ~PngParser()
+        {
+            if (m_bZStreamReady) (void)inflateEnd(&m_ZStream);
+        }
+
+        // inflate and scan line reconstruction on two threads for large images
+        void SetMultithreaded(bool multithreaded) { m_bMultithreaded = multithreaded; }
+
+        virtual Image Parse(Buffer& buf, ImageOutputFormat format = ImageOutputFormat::kImageOutputFormatNative)
         {
             Image img;
+            m_bOutputRGBA = (format == ImageOutputFormat::kImageOutputFormatRGBA);
 
             uint8_t* pData = buf.GetData();
             uint8_t* pDataEnd = buf.GetData() + buf.GetDataSize();
 
-            bool imageDataStarted = false;
             bool imageDataEnded = false;
-            uint8_t* imageDataStartPos = nullptr;
-            uint8_t* imageDataEndPos = nullptr;
+            std::vector<ImageDataChunk> imageDataChunks;
 
             const PNG_FILEHEADER* pFileHeader = reinterpret_cast<const PNG_FILEHEADER*>(pData);
             pData += sizeof(PNG_FILEHEADER);
@@ -121,7 +580,7 @@ namespace My {
                     uint32_t chunk_data_size = endian_net_unsigned_int(pChunkHeader->Length);
 
 #if DUMP_DETAILS
-                    std::cerr << "============================" << std::endl
+                    std::cerr << "============================" << std::endl;
 #endif
 
                     switch (type) 
@@ -141,38 +600,39 @@ namespace My {
                                 m_FilterMethod = pIHDRHeader->FilterMethod;
                                 m_InterlaceMethod = pIHDRHeader->InterlaceMethod;
 
+                                uint32_t channels = 0;
                                 switch(m_ColorType)
                                 {
                                     case 0:  // grayscale
-                                        m_BytesPerPixel = (m_BitDepth + 7) >> 3;
+                                        channels = 1;
                                         break;
                                     case 2:  // rgb true color
-                                        m_BytesPerPixel = (m_BitDepth * 3) >> 3;
+                                        channels = 3;
                                         break;
-                                    case 3:  // indexed
-                                        m_BytesPerPixel = (m_BitDepth + 7) >> 3;
-                                        std::cerr << "Color Type 3 is not supported yet: " << m_ColorType << std::endl;
-                                        assert(0);
+                                    case 3:  // indexed, expanded to RGBA
+                                        channels = 1;
                                         break;
                                     case 4:  // grayscale with alpha
-                                        m_BytesPerPixel = (m_BitDepth * 2) >> 3;
+                                        channels = 2;
                                         std::cerr << "Color Type 4 is not supported yet: " << m_ColorType << std::endl;
                                         assert(0);
                                         break;
                                     case 6:
-                                        m_BytesPerPixel = (m_BitDepth * 4) >> 3;
+                                        channels = 4;
                                         break;
                                     default:
                                         std::cerr << "Unkown Color Type: " << m_ColorType << std::endl;
                                         assert(0);
                                 }
 
-                                m_ScanLineSize = m_BytesPerPixel * m_Width;
-
+                                // filters work on whole bytes, sub byte pixels count as 1
+                                m_BytesPerPixel = std::max((channels * m_BitDepth) >> 3, 1u);
+                                m_ScanLineSize = (m_Width * channels * m_BitDepth + 7) >> 3;
 
                                 img.Width = m_Width;
                                 img.Height = m_Height;
-                                img.bitcount = m_BytesPerPixel * 8;
+                                img.bitcount = (m_ColorType == 3) ? 32 : m_BytesPerPixel * 8;
+                                if (expandToRGBA()) img.bitcount = m_BitDepth * 4;
                                 img.pitch = (img.Width * (img.bitcount >> 3) + 3) & ~3u; // for GPU address alignment
                                 img.data_size = img.pitch * img.Height;
                                 img.data = new uint8_t[img.data_size];
@@ -186,6 +646,9 @@ namespace My {
                                 std::cerr << "Filter Method: " << (int)m_FilterMethod << std::endl;
                                 std::cerr << "Interlace Method: " << (int)m_InterlaceMethod << std::endl;
 #endif
+                                if (m_InterlaceMethod != 0) {
+                                    std::cerr << "Interlaced PNG is not supported yet" << std::endl;
+                                }
                             }
                             break;
                         case PNG_CHUNK_TYPE::PLTE:
@@ -193,12 +656,38 @@ namespace My {
 #if DUMP_DETAILS
                                 std::cerr << "PLTE (Palette)" << std::endl;
                                 std::cerr << "----------------------------" << std::endl;
-                                const PNG_PLTE_HEADER* pPLTEHeader = reinterpret_cast<const PNG_PLTE_HEADER*>(pData);
-                                for (auto i = 0; i < chunk_data_size / sizeof(*pPLTEHeader->pEntries); i++)
+#endif
+                                const uint8_t* pEntries = pData + sizeof(PNG_CHUNK_HEADER);
+                                const uint32_t count = std::min(chunk_data_size / 3, 256u);
+                                memset(m_Palette, 0x00, sizeof(m_Palette));
+                                for (uint32_t i = 0; i < count; i++)
                                 {
-                                    std::cerr << "Entry " << i << ": " << pPLTEHeader->pEntries[i] << std::endl;
+                                    m_Palette[i][0] = pEntries[i * 3];
+                                    m_Palette[i][1] = pEntries[i * 3 + 1];
+                                    m_Palette[i][2] = pEntries[i * 3 + 2];
+                                    m_Palette[i][3] = 0xFF;
+#if DUMP_DETAILS
+                                    std::cerr << "Entry " << i << ": " << (int)m_Palette[i][0] << " " << (int)m_Palette[i][1]
+                                        << " " << (int)m_Palette[i][2] << std::endl;
+#endif
                                 }
+                            }
+                            break;
+                        case PNG_CHUNK_TYPE::tRNS:
+                            {
+#if DUMP_DETAILS
+                                std::cerr << "tRNS (Transparency)" << std::endl;
+                                std::cerr << "----------------------------" << std::endl;
 #endif
+                                // alpha of the palette entries, other color types are not handled
+                                if (m_ColorType == 3) {
+                                    const uint8_t* pAlpha = pData + sizeof(PNG_CHUNK_HEADER);
+                                    const uint32_t count = std::min(chunk_data_size, 256u);
+                                    for (uint32_t i = 0; i < count; i++)
+                                    {
+                                        m_Palette[i][3] = pAlpha[i];
+                                    }
+                                }
                             }
                             break;
                         case PNG_CHUNK_TYPE::IDAT:
@@ -215,18 +704,8 @@ namespace My {
                                     break;
                                 }
 
-                                if (!imageDataStarted) 
-                                {
-                                    imageDataStarted = true;
-                                    imageDataStartPos = pData + sizeof(PNG_CHUNK_HEADER);
-                                    imageDataEndPos   = imageDataStartPos + chunk_data_size;
-                                }
-                                else
-                                {
-                                    // concat the IDAT blocks
-                                    memcpy(imageDataEndPos, pData + sizeof(PNG_CHUNK_HEADER), chunk_data_size);
-                                    imageDataEndPos += chunk_data_size;
-                                }
+                                // inflate reads the chunks one after another, no need to concat them
+                                imageDataChunks.push_back({ pData + sizeof(PNG_CHUNK_HEADER), chunk_data_size });
                             }
                             break;
                         case PNG_CHUNK_TYPE::IEND:
@@ -236,136 +715,16 @@ namespace My {
                                 std::cerr << "----------------------------" << std::endl;
 #endif
 
-                                size_t compressed_data_size = imageDataEndPos - imageDataStartPos;
-
-                                if(!imageDataStarted) {
+                                if(imageDataChunks.empty()) {
                                     std::cerr << "PNG file looks corrupted. Found IEND before IDAT." << std::endl;
                                     break;
                                 } else {
                                     imageDataEnded = true;
                                 }
 
-                                const uint32_t kChunkSize = 256 * 1024;
-                                z_stream strm;
-                                strm.zalloc = Z_NULL;
-                                strm.zfree  = Z_NULL;
-                                strm.opaque = Z_NULL;
-                                strm.avail_in = 0;
-                                strm.next_in = Z_NULL;
-                                int ret = inflateInit(&strm);
-                                if (ret != Z_OK)
-                                {
-                                    std::cerr << "[Error] Failed to init zlib" << std::endl;
-                                    zerr(ret);
-                                    break;
+                                if (img.data) {
+                                    decodeImageData(imageDataChunks, img);
                                 }
-
-                                const uint8_t* pIn = imageDataStartPos;  // point to the start of the input data buffer
-                                uint8_t* pOut = reinterpret_cast<uint8_t*>(img.data);  // point to the start of the input data buffer
-                                uint8_t* pDecompressedBuffer = new uint8_t[kChunkSize];
-                                uint8_t filter_type = 0;
-                                int current_row = 0;
-                                int current_col = -1;   // -1 means we need read filter type
-
-                                do {
-                                    uint32_t next_in_size = (compressed_data_size > kChunkSize) ? kChunkSize : (uint32_t)compressed_data_size;
-                                    if (next_in_size == 0) break;
-                                    compressed_data_size -= next_in_size;
-                                    strm.next_in = const_cast<Bytef*>(pIn); 
-                                    strm.avail_in = next_in_size;
-                                    do {
-                                        strm.avail_out = kChunkSize; // 256K
-                                        strm.next_out = static_cast<Bytef*>(pDecompressedBuffer);
-                                        ret = inflate(&strm, Z_NO_FLUSH);
-                                        assert(ret != Z_STREAM_ERROR);
-                                        switch(ret) {
-                                            case Z_NEED_DICT:
-                                            case Z_DATA_ERROR:
-                                            case Z_MEM_ERROR:
-                                                zerr(ret);
-                                                ret = Z_STREAM_END;
-                                            default:
-                                                // now we de-filter the data into image
-                                                uint8_t* p = pDecompressedBuffer;
-                                                while(p - pDecompressedBuffer < (kChunkSize - strm.avail_out))
-                                                {
-                                                    if(current_col == -1)
-                                                    {
-                                                        // we are at start of scan line, get the filter type and advance the pointer
-                                                        filter_type = *p;
-                                                    }
-                                                    else
-                                                    {
-                                                        //  prediction filter
-                                                        //  X is current value
-                                                        //
-                                                        //  C  B  D
-                                                        //  A  X
-
-                                                        uint8_t A, B, C;
-                                                        if (current_row == 0) {
-                                                            B = C = 0;
-                                                        }
-                                                        else
-                                                        {
-                                                            B = *(pOut + img.pitch * (current_row - 1) + current_col);
-                                                            C = (current_col < m_BytesPerPixel) ? 0 : *(pOut + img.pitch * (current_row - 1) + current_col - m_BytesPerPixel);
-                                                        }
-
-                                                        A = (current_col < m_BytesPerPixel) ? 0 : *(pOut + img.pitch * current_row + current_col - m_BytesPerPixel);
-
-                                                        switch (filter_type) {
-                                                            case 0:
-                                                                *(pOut + img.pitch * current_row + current_col) = *p;
-                                                                break;
-                                                            case 1:
-                                                                *(pOut + img.pitch * current_row + current_col) = *p + A;
-                                                                break;
-                                                            case 2:
-                                                                *(pOut + img.pitch * current_row + current_col) = *p + B;
-                                                                break;
-                                                            case 3:
-                                                                *(pOut + img.pitch * current_row + current_col) = *p + (A + B) / 2;
-                                                                break;
-                                                            case 4:
-                                                                {
-                                                                    int _p = A + B - C;
-                                                                    int pa = abs(_p - A);
-                                                                    int pb = abs(_p - B);
-                                                                    int pc = abs(_p - C);
-                                                                    if (pa <= pb && pa <= pc) {
-                                                                        *(pOut + img.pitch * current_row + current_col) = *p + A;
-                                                                    } else if (pb <= pc) {
-                                                                        *(pOut + img.pitch * current_row + current_col) = *p + B;
-                                                                    } else {
-                                                                        *(pOut + img.pitch * current_row + current_col) = *p + C;
-                                                                    }
-                                                                }
-                                                                break;
-                                                            default:
-                                                                std::cerr << "[Error] Unknown Filter Type!" << std::endl;
-                                                                assert(0);
-                                                        }
-
-                                                    }
-                                                        
-                                                    current_col++;
-                                                    if (current_col == m_ScanLineSize) {
-                                                        current_col = -1;
-                                                        current_row++;
-                                                    }
-
-                                                    p++;
-                                                }
-                                        }
-
-                                    } while (strm.avail_out == 0);
-
-                                    pIn += next_in_size; // move pIn to next chunk
-                                } while (ret != Z_STREAM_END);
-
-                                (void)inflateEnd(&strm);
-                                delete[] pDecompressedBuffer;
                             }
                             break;
                         default:
@@ -389,25 +748,6 @@ namespace My {
             img.mipmaps[0].offset = 0;
             img.mipmaps[0].data_size = img.data_size;
 
-            // now swap the endian
-            if (img.bitcount > 32)
-            {
-                if (img.bitcount <= 64)
-                {
-                    for (uint16_t* p = reinterpret_cast<uint16_t*>(img.data); p < reinterpret_cast<uint16_t*>(img.data + img.data_size); p++)
-                    {
-                        *p = endian_net_unsigned_int(*p);
-                    }
-                }
-                else
-                {
-                    for (uint32_t* p = reinterpret_cast<uint32_t*>(img.data); p < reinterpret_cast<uint32_t*>(img.data + img.data_size); p++)
-                    {
-                        *p = endian_net_unsigned_int(*p);
-                    }
-                }
-            }
-
             return img;
         }
     };
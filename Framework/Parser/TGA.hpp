@@ -1,12 +1,13 @@
 #pragma once
 #include <cstdio>
+#include <cstring>
 #include <iostream>
 #include <string>
-#include <cassert>
-#include <queue>
+#include <vector>
 #include <algorithm>
 #include "config.h"
 #include "ImageParser.hpp"
+#include "PixelFormatConversion.hpp"
 #include "portable.hpp"
 
 namespace My {
@@ -20,10 +21,174 @@ namespace My {
     };
 #pragma pack(pop)
 
+    // uncompressed and run length encoded true color, color mapped and
+    // grayscale images (types 1, 2, 3, 9, 10 and 11)
     class TgaParser : implements ImageParser
     {
+    protected:
+        // how a row of file pixels becomes a row of image pixels, picked
+        // once per image
+        enum class RowKernel {
+            kBGR24,         // B8G8R8
+            kBGRA32,        // B8G8R8A8
+            kBGRX32,        // B8G8R8 and an unused byte
+            kBGR555,        // 15 or 16 bit, through the 16 bit tables
+            kIndexed8,      // 8 bit color map indices or grayscale, through the palette
+            kIndexed16,     // 16 bit color map indices, through the palette
+            kGray8          // grayscale to grayscale
+        };
+
+        // 15/16 bit pixels are little endian 1 bit alpha and 5 bits each of
+        // red, green and blue. widened by bit replication, every 8 bit
+        // channel takes disjoint bits of the low and the high byte, so a
+        // pixel is the OR of one entry of each table, as R8G8B8A8
+        struct BGR555Tables {
+            uint32_t low[256];
+            uint32_t high[2][256]; // alpha from the top bit or opaque
+
+            BGR555Tables()
+            {
+                for (uint32_t i = 0; i < 256; i++)
+                {
+                    // green bits 0-2 are in the low byte and 3-4 in the high byte
+                    const uint32_t blue = i & 0x1F;
+                    const uint32_t green_low = i >> 5;
+                    low[i] = (((blue << 3) | (blue >> 2)) << 16) | (((green_low << 3) | (green_low >> 2)) << 8);
+
+                    const uint32_t red = (i >> 2) & 0x1F;
+                    const uint32_t green_high = i & 0x03;
+                    const uint32_t rgb = ((red << 3) | (red >> 2)) | (((green_high << 6) | (green_high << 1)) << 8);
+                    high[0][i] = rgb | ((i & 0x80) ? 0xFF000000 : 0);
+                    high[1][i] = rgb | 0xFF000000;
+                }
+            }
+        };
+
+        static const BGR555Tables& bgr555Tables()
+        {
+            static const BGR555Tables tables;
+            return tables;
+        }
+
+        // R8G8B8A8 pixels as 4 or 3 bytes
+        static void storePixels(const uint32_t* pixels, uint8_t* dest, const uint32_t pixel_size, const size_t count)
+        {
+            if (pixel_size == 4)
+            {
+                std::memcpy(dest, pixels, count * 4);
+                return;
+            }
+            for (size_t i = 0; i < count; i++)
+            {
+                std::memcpy(dest + i * 3, &pixels[i], 3);
+            }
+        }
+
+        static void expandBGR555(const uint8_t* src, uint8_t* dest, const uint32_t pixel_size, const bool alpha,
+                uint32_t* scratch, const size_t count)
+        {
+            const auto& tables = bgr555Tables();
+            const uint32_t* high = tables.high[alpha ? 0 : 1];
+            for (size_t i = 0; i < count; i++)
+            {
+                scratch[i] = tables.low[src[i * 2]] | high[src[i * 2 + 1]];
+            }
+            storePixels(scratch, dest, pixel_size, count);
+        }
+
+        template <typename Index>
+        static void lookupPalette(const Index* src, uint8_t* dest, const uint32_t pixel_size, const std::vector<uint32_t>& palette,
+                uint32_t* scratch, const size_t count)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                scratch[i] = palette[src[i]];
+            }
+            storePixels(scratch, dest, pixel_size, count);
+        }
+
+        // one packet may cover the end of one row and the start of the next,
+        // what is left of it is carried over
+        struct RleState {
+            uint32_t remaining = 0;
+            bool run = false;
+            uint8_t value[4];
+        };
+
+        static bool decodeRleRow(const uint8_t*& pData, const uint8_t* pDataEnd, const uint32_t width,
+                const uint32_t bytes_per_pixel, RleState& state, uint8_t* row)
+        {
+            uint32_t x = 0;
+            while (x < width)
+            {
+                if (state.remaining == 0)
+                {
+                    if (pData >= pDataEnd) return false;
+                    const uint8_t header = *pData++;
+                    state.remaining = (header & 0x7F) + 1u;
+                    state.run = (header & 0x80) != 0;
+                    if (state.run)
+                    {
+                        if (static_cast<size_t>(pDataEnd - pData) < bytes_per_pixel) return false;
+                        std::memcpy(state.value, pData, bytes_per_pixel);
+                        pData += bytes_per_pixel;
+                    }
+                }
+
+                const uint32_t count = std::min(state.remaining, width - x);
+                uint8_t* pOut = row + static_cast<size_t>(x) * bytes_per_pixel;
+                if (state.run)
+                {
+                    for (uint32_t i = 0; i < count; i++)
+                    {
+                        std::memcpy(pOut + i * bytes_per_pixel, state.value, bytes_per_pixel);
+                    }
+                }
+                else
+                {
+                    const size_t size = static_cast<size_t>(count) * bytes_per_pixel;
+                    if (static_cast<size_t>(pDataEnd - pData) < size) return false;
+                    std::memcpy(pOut, pData, size);
+                    pData += size;
+                }
+                x += count;
+                state.remaining -= count;
+            }
+
+            return true;
+        }
+
+        // count palette entries of entry_size bits to R8G8B8A8
+        static bool readPalette(const uint8_t* pData, const uint32_t entry_size, const bool alpha,
+                std::vector<uint32_t>& palette, const uint32_t first, const uint32_t count)
+        {
+            std::vector<uint32_t> scratch(count);
+            std::vector<uint8_t> entries(static_cast<size_t>(count) * 4);
+            switch (entry_size)
+            {
+                case 15:
+                case 16:
+                    expandBGR555(pData, entries.data(), 4, alpha, scratch.data(), count);
+                    break;
+                case 24:
+                    SwizzleBGR8ToRGBA8(pData, entries.data(), count);
+                    break;
+                case 32:
+                    SwizzleBGRA8ToRGBA8(pData, entries.data(), count);
+                    if (!alpha)
+                    {
+                        for (uint32_t i = 0; i < count; i++) entries[i * 4 + 3] = 0xFF;
+                    }
+                    break;
+                default:
+                    return false;
+            }
+            std::memcpy(palette.data() + first, entries.data(), static_cast<size_t>(count) * 4);
+            return true;
+        }
+
     public:
-        virtual Image Parse(Buffer& buf)
+        virtual Image Parse(Buffer& buf, ImageOutputFormat format = ImageOutputFormat::kImageOutputFormatNative)
         {
             Image img;
 
@@ -32,30 +197,35 @@ namespace My {
 
             std::cerr << "Parsing as TGA file:" << std::endl;
 
+            if (buf.GetDataSize() < sizeof(TGA_FILEHEADER))
+            {
+                std::cerr << "[Error] TGA header is truncated" << std::endl;
+                return img;
+            }
             const TGA_FILEHEADER* pFileHeader = reinterpret_cast<const TGA_FILEHEADER*>(pData);
             pData += sizeof(TGA_FILEHEADER);
 
 #ifdef DEBUG
             std::cerr << "ID Length: " << (uint16_t)pFileHeader->IDLength << std::endl;
             std::cerr << "Color Map Type: " << (uint16_t)pFileHeader->ColorMapType << std::endl;
+            std::cerr << "Image Type: " << (uint16_t)pFileHeader->ImageType << std::endl;
 #endif
-            if (pFileHeader->ColorMapType) {
-                std::cerr << "Unsupported Color Map. Only Type 0 is supported." << std::endl;
+            const uint32_t image_type = pFileHeader->ImageType & ~8u;
+            const bool rle = (pFileHeader->ImageType & 8) != 0;
+            if (pFileHeader->ColorMapType > 1 || image_type < 1 || image_type > 3) {
+                std::cerr << "Unsupported Image Type " << (uint16_t)pFileHeader->ImageType
+                          << ". Only Types 1, 2, 3, 9, 10 and 11 are supported." << std::endl;
                 return img;
             }
-
-#ifdef DEBUG
-            std::cerr << "Image Type: " << (uint16_t)pFileHeader->ImageType << std::endl;
-#endif
-            if (pFileHeader->ImageType != 2) {
-                std::cerr << "Unsupported Image Type. Only Type 2 is supported." << std::endl;
+            if (image_type == 1 && pFileHeader->ColorMapType != 1) {
+                std::cerr << "[Error] TGA color mapped image without a color map" << std::endl;
                 return img;
             }
 
             img.Width = (pFileHeader->ImageSpec[5] << 8) + pFileHeader->ImageSpec[4];
             img.Height = (pFileHeader->ImageSpec[7] << 8) + pFileHeader->ImageSpec[6];
-            uint8_t pixel_depth = pFileHeader->ImageSpec[8];
-            uint8_t alpha_depth = (pFileHeader->ImageSpec[9] & 0x0F);
+            const uint8_t pixel_depth = pFileHeader->ImageSpec[8];
+            const uint8_t alpha_depth = (pFileHeader->ImageSpec[9] & 0x0F);
 #ifdef DEBUG
             std::cerr << "Image Width: " << img.Width << std::endl;
             std::cerr << "Image Height: " << img.Height << std::endl;
@@ -64,71 +234,154 @@ namespace My {
 #endif
             // skip Image ID
             pData += pFileHeader->IDLength;
-            // skip the Color Map. since we assume the Color Map Type is 0,
-            // nothing to skip
 
-            // reading the pixel data
-            img.bitcount = (alpha_depth?32:24);
-            img.pitch = (img.Width * (img.bitcount >> 3) + 3) & ~3u; // for GPU address alignment
+            // the Color Map, it is only used by color mapped images
+            const uint32_t map_first = pFileHeader->ColorMapSpec[0] | (pFileHeader->ColorMapSpec[1] << 8);
+            const uint32_t map_length = pFileHeader->ColorMapSpec[2] | (pFileHeader->ColorMapSpec[3] << 8);
+            const uint32_t map_entry_size = pFileHeader->ColorMapSpec[4];
+            const uint8_t* pColorMap = pData;
+            if (pFileHeader->ColorMapType)
+            {
+                pData += static_cast<size_t>(map_length) * ((map_entry_size + 7) >> 3);
+            }
+            if (pData > pDataEnd)
+            {
+                std::cerr << "[Error] TGA file is truncated" << std::endl;
+                img.Width = img.Height = 0;
+                return img;
+            }
+
+            // pick the row kernel and whether the image has alpha
+            RowKernel kernel = RowKernel::kBGR24;
+            bool alpha = false;
+            uint32_t color_depth = pixel_depth;
+            const bool expand_to_rgba = (format == ImageOutputFormat::kImageOutputFormatRGBA);
+            if (image_type == 1)
+            {
+                color_depth = map_entry_size;
+                if (pixel_depth == 8) kernel = RowKernel::kIndexed8;
+                else if (pixel_depth == 16) kernel = RowKernel::kIndexed16;
+                else color_depth = 0;
+            }
+            else if (image_type == 3)
+            {
+                kernel = expand_to_rgba ? RowKernel::kIndexed8 : RowKernel::kGray8;
+                if (pixel_depth != 8) color_depth = 0;
+            }
+            else
+            {
+                switch (pixel_depth)
+                {
+                    case 15:
+                    case 16: kernel = RowKernel::kBGR555; break;
+                    case 24: kernel = RowKernel::kBGR24; break;
+                    case 32: kernel = (alpha_depth ? RowKernel::kBGRA32 : RowKernel::kBGRX32); break;
+                    default: color_depth = 0;
+                }
+            }
+            if (color_depth != 15 && color_depth != 16 && color_depth != 24 && color_depth != 32 && !(image_type == 3 && color_depth == 8))
+            {
+                std::cerr << "[Error] Unsupported TGA pixel depth " << (uint16_t)pixel_depth << std::endl;
+                img.Width = img.Height = 0;
+                return img;
+            }
+            alpha = alpha_depth && (color_depth == 16 || color_depth == 32);
+
+            // the palette of color mapped and grayscale images, indices outside
+            // of the color map are black
+            std::vector<uint32_t> palette;
+            if (kernel == RowKernel::kIndexed8 || kernel == RowKernel::kIndexed16)
+            {
+                palette.assign(kernel == RowKernel::kIndexed8 ? 256 : 65536, 0xFF000000);
+                if (image_type == 3)
+                {
+                    for (uint32_t i = 0; i < 256; i++) palette[i] = i * 0x010101u | 0xFF000000;
+                }
+                else if (map_first + map_length > palette.size()
+                        || !readPalette(pColorMap, map_entry_size, alpha, palette, map_first, map_length))
+                {
+                    std::cerr << "[Error] Unsupported TGA color map" << std::endl;
+                    img.Width = img.Height = 0;
+                    return img;
+                }
+            }
+
+            // reading the pixel data, images without alpha get an opaque alpha
+            // channel when RGBA is requested. 32 bit pixels always keep 4 bytes
+            if (kernel == RowKernel::kGray8)
+            {
+                img.bitcount = 8;
+            }
+            else
+            {
+                img.bitcount = ((alpha || expand_to_rgba || kernel == RowKernel::kBGRX32)?32:24);
+            }
+            const uint32_t pixel_size = img.bitcount >> 3;
+            img.pitch = (img.Width * pixel_size + 3) & ~3u; // for GPU address alignment
 
             img.data_size = img.pitch * img.Height;
             img.data = new uint8_t[img.data_size];
 
-            uint8_t* pOut = (uint8_t*)img.data;
+            const uint32_t bytes_per_pixel = (pixel_depth + 7) >> 3;
+            const size_t row_size = static_cast<size_t>(img.Width) * bytes_per_pixel;
+            std::vector<uint8_t> rle_row(rle ? row_size : 0);
+            std::vector<uint32_t> scratch(img.Width);
+            // 16 bit indices may not be 2 byte aligned in the buffer
+            std::vector<uint16_t> indices(kernel == RowKernel::kIndexed16 ? img.Width : 0);
+            RleState rle_state;
             for (decltype(img.Height) i = 0; i < img.Height; i++)
             {
-                for (decltype(img.Width) j = 0; j < img.Width; j++)
+                const uint8_t* pRow = pData;
+                bool ok;
+                if (rle)
                 {
-                    switch(pixel_depth)
-                    {
-                        case 15:
-                            {
-                                assert(alpha_depth == 0);
-                                uint16_t color = *(uint16_t*)pData;
-                                pData += 2;
-                                *(pOut + img.pitch * i + j * 3) = ((color & 0x7C00) >> 10);    // R
-                                *(pOut + img.pitch * i + j * 3 + 1) = ((color & 0x03E0) >> 5); // G
-                                *(pOut + img.pitch * i + j * 3 + 2) = (color & 0x001F);        // B
-                            }
-                            break;
-                        case 16:
-                            {
-                                assert(alpha_depth == 1);
-                                uint16_t color = *(uint16_t*)pData;
-                                pData += 2;
-                                *(pOut + img.pitch * i + j * 4) = ((color & 0x7C00) >> 10);    // R
-                                *(pOut + img.pitch * i + j * 4 + 1) = ((color & 0x03E0) >> 5); // G
-                                *(pOut + img.pitch * i + j * 4 + 2) = (color & 0x001F);        // B
-                                *(pOut + img.pitch * i + j * 4 + 3) = ((color & 0x8000)?0xFF:0x00);  // A
-                            }
-                            break;
-                        case 24:
-                            {
-                                assert(alpha_depth == 0);
-                                *(pOut + img.pitch * i + j * 3 + 2) = *pData++; // B
-                                *(pOut + img.pitch * i + j * 3 + 1) = *pData++; // G
-                                *(pOut + img.pitch * i + j * 3 ) = *pData++;    // R
-                            }
-                            break;
-                        case 32:
-                            {
-                                assert(alpha_depth == 8);
-                                *(pOut + img.pitch * i + j * 4 + 3) = *pData++; // A
-                                *(pOut + img.pitch * i + j * 4 + 2) = *pData++; // B
-                                *(pOut + img.pitch * i + j * 4 + 1) = *pData++; // G
-                                *(pOut + img.pitch * i + j * 4 ) = *pData++;    // R
-                            }
-                            break;
-                        default:
-                            ;
-                    }
+                    ok = decodeRleRow(pData, pDataEnd, img.Width, bytes_per_pixel, rle_state, rle_row.data());
+                    pRow = rle_row.data();
+                }
+                else
+                {
+                    ok = (static_cast<size_t>(pDataEnd - pData) >= row_size);
+                    pData += ok ? row_size : 0;
+                }
+                if (!ok)
+                {
+                    std::cerr << "[Error] TGA pixel data is truncated at row " << i << std::endl;
+                    std::memset(img.data + img.pitch * i, 0x00, img.pitch * (img.Height - i));
+                    break;
                 }
-            }
 
-            assert(pData <= pDataEnd);
+                uint8_t* pOut = img.data + img.pitch * i;
+                switch (kernel)
+                {
+                    case RowKernel::kBGR24:
+                        if (pixel_size == 4) SwizzleBGR8ToRGBA8(pRow, pOut, img.Width);
+                        else SwizzleBGR8ToRGB8(pRow, pOut, img.Width);
+                        break;
+                    case RowKernel::kBGRA32:
+                        SwizzleBGRA8ToRGBA8(pRow, pOut, img.Width);
+                        break;
+                    case RowKernel::kBGRX32:
+                        SwizzleBGRA8ToRGBA8(pRow, pOut, img.Width);
+                        for (uint32_t j = 0; j < img.Width; j++) pOut[j * 4 + 3] = 0xFF;
+                        break;
+                    case RowKernel::kBGR555:
+                        expandBGR555(pRow, pOut, pixel_size, alpha, scratch.data(), img.Width);
+                        break;
+                    case RowKernel::kIndexed8:
+                        lookupPalette(pRow, pOut, pixel_size, palette, scratch.data(), img.Width);
+                        break;
+                    case RowKernel::kIndexed16:
+                        std::memcpy(indices.data(), pRow, row_size);
+                        lookupPalette(indices.data(), pOut, pixel_size, palette, scratch.data(), img.Width);
+                        break;
+                    case RowKernel::kGray8:
+                        std::memcpy(pOut, pRow, img.Width);
+                        break;
+                }
+            }
 
-            img.mipmaps[0].Width = img.Width; 
-            img.mipmaps[0].Height = img.Height; 
+            img.mipmaps[0].Width = img.Width;
+            img.mipmaps[0].Height = img.Height;
             img.mipmaps[0].pitch = img.pitch;
             img.mipmaps[0].offset = 0;
             img.mipmaps[0].data_size = img.data_size;
@@ -137,4 +390,3 @@ namespace My {
         }
     };
 }
-
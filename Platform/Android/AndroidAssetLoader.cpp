@@ -38,41 +38,42 @@ void AndroidAssetLoader::CloseFile(AssetFilePtr& fp)
 Buffer AndroidAssetLoader::SyncOpenAndReadText(const char* assetPath)
 {
     AAsset* fp = (AAsset*)OpenFile(assetPath, MY_OPEN_TEXT);
-    Buffer* pBuff = nullptr;
 
     if (fp) {
         size_t fileLength = AAsset_getLength(fp);
         LOGD("asset file size: %zu", fileLength);
 
-        pBuff = new Buffer(fileLength + 1);
-        AAsset_read(fp, pBuff->GetData(), fileLength);
-        pBuff->GetData()[fileLength] = '\0';
+        Buffer buff(fileLength + 1);
+        AAsset_read(fp, buff.GetData(), fileLength);
+        buff.GetData()[fileLength] = '\0';
         AAsset_close(fp);
-    } else {
-        LOGE("Error opening asset file '%s'", assetPath);
-        pBuff = new Buffer();
+        return buff;
     }
 
-    return *pBuff;
+    LOGE("Error opening asset file '%s'", assetPath);
+    return Buffer();
 }
 
 Buffer AndroidAssetLoader::SyncOpenAndReadBinary(const char* assetPath)
 {
     AAsset* fp = (AAsset*)OpenFile(assetPath, MY_OPEN_BINARY);
-    Buffer* pBuff = nullptr;
 
     if (fp) {
         size_t fileLength = AAsset_getLength(fp);
         LOGD("asset file size: %zu", fileLength);
 
-        pBuff = new Buffer(fileLength);
-        AAsset_read(fp, pBuff->GetData(), fileLength);
+        Buffer buff(fileLength);
+        AAsset_read(fp, buff.GetData(), fileLength);
         AAsset_close(fp);
-    } else {
-        LOGE("Error opening asset file '%s'", assetPath);
-        pBuff = new Buffer();
+        return buff;
     }
 
-    return *pBuff;
+    LOGE("Error opening asset file '%s'", assetPath);
+    return Buffer();
 }
 
+// assets live inside the apk, they are read instead
+Buffer AndroidAssetLoader::MapFile(const char* assetPath)
+{
+    return SyncOpenAndReadBinary(assetPath);
+}
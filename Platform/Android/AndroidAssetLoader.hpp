@@ -11,6 +11,7 @@ namespace My {
             void SetPlatformAssetManager(AAssetManager* assetManager);
             Buffer SyncOpenAndReadText(const char* assetPath);
             Buffer SyncOpenAndReadBinary(const char* assetPath);
+            Buffer MapFile(const char* assetPath);
 
         protected:
             AAssetManager* m_pPlatformAssetManager = nullptr;
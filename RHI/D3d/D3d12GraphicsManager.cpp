@@ -659,11 +659,17 @@ static DXGI_FORMAT getDxgiFormat(const Image& img)
                 format = ::DXGI_FORMAT_BC1_UNORM;
                 break;
             case "DXT3"_u32:
-                format = ::DXGI_FORMAT_BC3_UNORM;
+                format = ::DXGI_FORMAT_BC2_UNORM;
                 break;
             case "DXT5"_u32:
+                format = ::DXGI_FORMAT_BC3_UNORM;
+                break;
+            case "BC5U"_u32:
                 format = ::DXGI_FORMAT_BC5_UNORM;
                 break;
+            case "BC7U"_u32:
+                format = ::DXGI_FORMAT_BC7_UNORM;
+                break;
             default:
                 assert(0);
         }
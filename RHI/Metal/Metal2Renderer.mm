@@ -310,11 +310,17 @@ static MTLPixelFormat getMtlPixelFormat(const Image& img)
                 format = MTLPixelFormatBC1_RGBA;
                 break;
             case "DXT3"_u32:
-                format = MTLPixelFormatBC3_RGBA;
+                format = MTLPixelFormatBC2_RGBA;
                 break;
             case "DXT5"_u32:
+                format = MTLPixelFormatBC3_RGBA;
+                break;
+            case "BC5U"_u32:
                 format = MTLPixelFormatBC5_RGUnorm;
                 break;
+            case "BC7U"_u32:
+                format = MTLPixelFormatBC7_RGBAUnorm;
+                break;
             default:
                 assert(0);
         }
@@ -72,6 +72,12 @@ void OpenGLGraphicsManager::getOpenGLTextureFormat(const Image& img, uint32_t& f
             case "DXT5"_u32:
                 internal_format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
                 break;
+            case "BC5U"_u32:
+                internal_format = GL_COMPRESSED_RG_RGTC2;
+                break;
+            case "BC7U"_u32:
+                internal_format = GL_COMPRESSED_RGBA_BPTC_UNORM;
+                break;
             default:
                 assert(0);
         }
@@ -302,22 +302,49 @@ void OpenGLGraphicsManagerCommonBase::initializeGeometries(const Scene& scene)
                             glBindTexture(GL_TEXTURE_2D, texture_id);
                             uint32_t format, internal_format, type;
                             getOpenGLTextureFormat(*texture, format, internal_format, type);
-                            if (texture->compressed)
+                            // a DDS file may leave its mip count at 0 and still carry
+                            // level 0, and the chain of a non square image stops at the
+                            // first empty entry
+                            const uint32_t level_count = std::max(texture->mipmap_count, 1u);
+                            uint32_t uploaded = 0;
+                            for (uint32_t level = 0; level < level_count; level++)
                             {
-                                glCompressedTexImage2D(GL_TEXTURE_2D, 0, internal_format, texture->Width, texture->Height, 
-                                    0, static_cast<int32_t>(texture->data_size), texture->data);
-                            }
-                            else
-                            {
-                                glTexImage2D(GL_TEXTURE_2D, 0, internal_format, texture->Width, texture->Height, 
-                                    0, format, type, texture->data);
+                                Image::Mipmap mip = texture->mipmaps[level];
+                                if (level == 0 && !mip.data_size)
+                                {
+                                    mip.Width = texture->Width;
+                                    mip.Height = texture->Height;
+                                    mip.offset = 0;
+                                    mip.data_size = texture->data_size;
+                                }
+                                if (!mip.Width || !mip.Height || !mip.data_size) break;
+
+                                if (texture->compressed)
+                                {
+                                    glCompressedTexImage2D(GL_TEXTURE_2D, level, internal_format, mip.Width, mip.Height, 
+                                        0, static_cast<int32_t>(mip.data_size), texture->data + mip.offset);
+                                }
+                                else
+                                {
+                                    glTexImage2D(GL_TEXTURE_2D, level, internal_format, mip.Width, mip.Height, 
+                                        0, format, type, texture->data + mip.offset);
+                                }
+                                uploaded++;
                             }
 
                             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
                             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
                             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
                             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-                            glGenerateMipmap(GL_TEXTURE_2D);
+                            if (uploaded > 1)
+                            {
+                                // the chain stops where either side reaches 1
+                                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, uploaded - 1);
+                            }
+                            else
+                            {
+                                glGenerateMipmap(GL_TEXTURE_2D);
+                            }
 
                             glBindTexture(GL_TEXTURE_2D, 0);
 
@@ -498,8 +525,9 @@ void OpenGLGraphicsManagerCommonBase::initializeSkyBox(const Scene& scene)
         getOpenGLTextureFormat(*pImage, format, internal_format, type);
 
         int32_t zoffset = (i % 6) + 6;
-        for (decltype(pImage->mipmap_count) level = 0; level < min(pImage->mipmap_count, kMaxMipLevels); level++)
+        for (decltype(pImage->mipmap_count) level = 0; level < min(max(pImage->mipmap_count, 1u), kMaxMipLevels); level++)
         {
+            if (!pImage->mipmaps[level].data_size) break;
             if (pImage->compressed)
             {
                 glCompressedTexSubImage3D(target, level, 0, 0, zoffset, pImage->mipmaps[level].Width, pImage->mipmaps[level].Height, 1,
@@ -598,7 +626,7 @@ void OpenGLGraphicsManagerCommonBase::initializeTerrain(const Scene& scene)
     if (pImage->compressed)
     {
         glCompressedTexImage2D(GL_TEXTURE_2D, 0, internal_format, pImage->Width, pImage->Height, 
-            0, static_cast<int32_t>(pImage->data_size), pImage->data);
+            0, static_cast<int32_t>(pImage->mipmaps[0].data_size), pImage->data);
     }
     else
     {
@@ -1,5 +1,10 @@
+#include <chrono>
+#include <cstring>
+#include <future>
 #include <iostream>
 #include <string>
+#include <thread>
+#include <vector>
 #include "AssetLoader.hpp"
 #include "MemoryManager.hpp"
 
@@ -23,12 +28,122 @@ int main(int , char** )
 
     cout << shader_pgm;
 
+    int result = 0;
+
+    // the directory index finds files with their logical name, other
+    // spellings are still found by trying every search path
+    {
+        const bool ok = g_pAssetLoader->FileExists("Shaders/HLSL/basic.vert.hlsl")
+            && g_pAssetLoader->FileExists("Shaders/HLSL/./basic.vert.hlsl")
+            && g_pAssetLoader->FileExists("Shaders//HLSL/basic.vert.hlsl")
+            && g_pAssetLoader->FileExists("Shaders/HLSL/../HLSL/basic.vert.hlsl")
+            && !g_pAssetLoader->FileExists("Shaders/no_such_file");
+        cout << endl << "resolve path: " << (ok ? "ok" : "FAILED") << endl;
+        if (!ok) result = 1;
+    }
+
+    // a mapped file has the same bytes as one which is read
+    {
+        Buffer read = g_pAssetLoader->SyncOpenAndReadBinary("Shaders/HLSL/basic.vert.hlsl");
+        Buffer mapped = g_pAssetLoader->MapFile("Shaders/HLSL/basic.vert.hlsl");
+        bool ok = read.GetDataSize() > 0 && mapped.GetDataSize() == read.GetDataSize()
+            && memcmp(mapped.GetData(), read.GetData(), read.GetDataSize()) == 0;
+
+        // moving hands the mapping over, copying gives a buffer of its own
+        const uint8_t* data = mapped.GetData();
+        Buffer moved(std::move(mapped));
+        Buffer copied(moved);
+        ok = ok && moved.GetData() == data && !mapped.GetData()
+            && copied.GetData() != data && memcmp(copied.GetData(), data, copied.GetDataSize()) == 0;
+
+        // assigning to a mapped buffer replaces the mapping rather than writing into it
+        Buffer assigned = g_pAssetLoader->MapFile("Shaders/HLSL/basic.vert.hlsl");
+        const uint8_t* mapping = assigned.GetData();
+        assigned = copied;
+        ok = ok && mapping && assigned.GetData() != mapping && assigned.GetDataSize() == copied.GetDataSize()
+            && memcmp(assigned.GetData(), copied.GetData(), copied.GetDataSize()) == 0;
+
+        cout << "map file: " << (ok ? "ok" : "FAILED") << endl;
+        if (!ok) result = 1;
+
+        Buffer missing = g_pAssetLoader->MapFile("Shaders/no_such_file");
+        if (missing.GetData() || missing.GetDataSize()) result = 1;
+    }
+
+    // async loads give the same bytes, callbacks only run in Tick()
+    {
+        const char* kFile = "Shaders/HLSL/basic.vert.hlsl";
+        Buffer expected = g_pAssetLoader->SyncOpenAndReadBinary(kFile);
+        g_pAssetLoader->SetIoThreadCount(2);
+
+        vector<future<Buffer>> futures;
+        for (int i = 0; i < 16; i++) {
+            futures.push_back(g_pAssetLoader->AsyncLoad(kFile, i % 3));
+        }
+
+        int callbacks = 0;
+        bool same = true;
+        auto check = [&](Buffer& buf) {
+            callbacks++;
+            same = same && buf.GetDataSize() == expected.GetDataSize()
+                && memcmp(buf.GetData(), expected.GetData(), expected.GetDataSize()) == 0;
+        };
+        vector<AssetLoader::AsyncLoadId> ids;
+        for (int i = 0; i < 16; i++) {
+            ids.push_back(g_pAssetLoader->AsyncLoad(kFile, check, i % 3));
+        }
+
+        // whatever is cancelled in time never calls back
+        int cancelled = 0;
+        for (size_t i = 0; i < ids.size(); i += 4) {
+            if (g_pAssetLoader->CancelLoad(ids[i])) cancelled++;
+        }
+
+        for (auto& f : futures) {
+            Buffer buf = f.get();
+            same = same && buf.GetDataSize() == expected.GetDataSize()
+                && memcmp(buf.GetData(), expected.GetData(), expected.GetDataSize()) == 0;
+        }
+
+        // without the file every comparison below is against nothing
+        bool ok = (expected.GetDataSize() > 0) && (callbacks == 0);
+        for (int i = 0; i < 1000 && callbacks + cancelled < 16; i++) {
+            g_pAssetLoader->Tick();
+            this_thread::sleep_for(chrono::milliseconds(1));
+        }
+        ok = ok && same && callbacks + cancelled == 16 && !g_pAssetLoader->CancelLoad(ids[1]);
+
+        // a missing file gives an empty buffer
+        Buffer missing = g_pAssetLoader->AsyncLoad("Shaders/no_such_file").get();
+        ok = ok && !missing.GetData();
+
+        cout << "async load: " << callbacks << " callbacks, " << cancelled << " cancelled " << (ok ? "ok" : "FAILED") << endl;
+        if (!ok) result = 1;
+
+        // a full queue makes AsyncLoad wait rather than lose requests
+        g_pAssetLoader->SetMaxPendingRequests(1);
+        futures.clear();
+        for (int i = 0; i < 32; i++) {
+            futures.push_back(g_pAssetLoader->AsyncLoad(kFile));
+        }
+        ok = expected.GetDataSize() > 0;
+        for (auto& f : futures) {
+            Buffer buf = f.get();
+            ok = ok && buf.GetDataSize() == expected.GetDataSize()
+                && memcmp(buf.GetData(), expected.GetData(), expected.GetDataSize()) == 0;
+        }
+        g_pAssetLoader->SetMaxPendingRequests(1024);
+
+        cout << "bounded queue: " << (ok ? "ok" : "FAILED") << endl;
+        if (!ok) result = 1;
+    }
+
     g_pAssetLoader->Finalize();
     g_pMemoryManager->Finalize();
 
     delete g_pAssetLoader;
     delete g_pMemoryManager;
 
-    return 0;
+    return result;
 }
 
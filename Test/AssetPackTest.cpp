@@ -0,0 +1,191 @@
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "AssetLoader.hpp"
+#include "AssetPack.hpp"
+
+using namespace std;
+using namespace My;
+
+static const char* kPackPath = "AssetPackTest.pack";
+
+struct TestFile {
+    string name;
+    string path;
+    vector<uint8_t> data;
+};
+
+static bool writeFile(const TestFile& file)
+{
+    FILE* fp = fopen(file.path.c_str(), "wb");
+    if (!fp) return false;
+    const bool ok = file.data.empty() || fwrite(file.data.data(), 1, file.data.size(), fp) == file.data.size();
+    return (fclose(fp) == 0) && ok;
+}
+
+static bool sameData(const Buffer& buf, const vector<uint8_t>& data, size_t offset = 0, size_t length = SIZE_MAX)
+{
+    length = min(length, data.size() - offset);
+    return buf.GetDataSize() == length && (!length || memcmp(buf.GetData(), data.data() + offset, length) == 0);
+}
+
+int main(int argc, const char** argv)
+{
+    int result = 0;
+
+    // text which deflates well and spans many chunks, noise which does not
+    // deflate and is stored as is, and an empty file
+    vector<TestFile> files(4);
+    files[0].name = "Text/lorem.txt";
+    const string line = "Lorem ipsum dolor sit amet, consectetur adipiscing elit.\n";
+    for (int i = 0; i < 4000; i++) files[0].data.insert(files[0].data.end(), line.begin(), line.end());
+    files[1].name = "Data/noise.bin";
+    uint32_t seed = 12345;
+    for (int i = 0; i < 100000; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        files[1].data.push_back(static_cast<uint8_t>(seed >> 24));
+    }
+    files[2].name = "empty.bin";
+    files[3].name = "Data/small.txt";
+    files[3].data.assign(line.begin(), line.end());
+
+    AssetPackWriter writer;
+    writer.SetChunkSize(4096);
+    for (size_t i = 0; i < files.size(); i++) {
+        files[i].path = "AssetPackTest_" + to_string(i) + ".tmp";
+        if (!writeFile(files[i])) {
+            cerr << "Can not write " << files[i].path << endl;
+            return 1;
+        }
+        writer.AddFile(files[i].name, files[i].path);
+    }
+    const bool written = writer.Write(kPackPath);
+    for (const auto& file : files) remove(file.path.c_str());
+    if (!written) {
+        cout << "write: FAILED" << endl;
+        return 1;
+    }
+
+    // every asset comes back as it was, inflated on the I/O threads of a
+    // loader or not
+    for (int multithreaded = 0; multithreaded < 2; multithreaded++) {
+        AssetLoader io_threads;
+        io_threads.SetIoThreadCount(4);
+        AssetPack pack;
+        bool ok = pack.Open(kPackPath) && pack.GetEntryCount() == files.size();
+        pack.SetIoThreads(&io_threads);
+        pack.SetMultithreaded(multithreaded != 0);
+        for (const auto& file : files) {
+            Buffer buf;
+            ok = ok && pack.Read(file.name.c_str(), buf) && sameData(buf, file.data);
+        }
+        Buffer missing;
+        ok = ok && !pack.Read("Text/missing.txt", missing) && !pack.Contains("lorem.txt");
+        cout << "read " << (multithreaded ? "threaded: " : "single: ") << (ok ? "ok" : "FAILED") << endl;
+        if (!ok) result = 1;
+    }
+
+    // ranges which start and end inside chunks, and text mode
+    {
+        AssetPack pack;
+        bool ok = pack.Open(kPackPath);
+        const size_t kRanges[][2] = { { 0, 1 }, { 4000, 10000 }, { 4096, 4096 }, { 12345, 100000 }, { files[0].data.size() - 7, 7 } };
+        for (const auto& range : kRanges) {
+            Buffer buf;
+            ok = ok && pack.ReadRange(files[0].name.c_str(), range[0], range[1], buf) && sameData(buf, files[0].data, range[0], range[1]);
+            ok = ok && pack.ReadRange(files[1].name.c_str(), range[0] % 90000, 5000, buf) && sameData(buf, files[1].data, range[0] % 90000, 5000);
+        }
+        Buffer buf;
+        ok = ok && !pack.ReadRange(files[3].name.c_str(), 0, files[3].data.size() + 1, buf);
+
+        Buffer text;
+        ok = ok && pack.Read(files[3].name.c_str(), text, true) && text.GetDataSize() == files[3].data.size() + 1
+            && text.GetData()[files[3].data.size()] == '\0' && memcmp(text.GetData(), files[3].data.data(), files[3].data.size()) == 0;
+        cout << "read range: " << (ok ? "ok" : "FAILED") << endl;
+        if (!ok) result = 1;
+    }
+
+    // a range which does not start at a page boundary maps the same bytes
+    {
+        bool ok = false;
+        FILE* fp = fopen(kPackPath, "rb");
+        if (fp) {
+            vector<uint8_t> expected(1000);
+            Buffer mapped = AssetLoader::MapFileRange(fp, 5000, expected.size());
+            ok = fseek(fp, 5000, SEEK_SET) == 0 && fread(expected.data(), 1, expected.size(), fp) == expected.size();
+            ok = ok && sameData(mapped, expected);
+            fclose(fp);
+        }
+        cout << "map range: " << (ok ? "ok" : "FAILED") << endl;
+        if (!ok) result = 1;
+    }
+
+    // the pack as a search path of the asset loader
+    {
+        AssetLoader loader;
+        loader.Initialize();
+        bool ok = loader.AddSearchPath(kPackPath) && loader.FileExists("Text/lorem.txt");
+        ok = ok && sameData(loader.SyncOpenAndReadBinary("Data/noise.bin"), files[1].data);
+        ok = ok && sameData(loader.MapFile("Text/lorem.txt"), files[0].data);
+        ok = ok && sameData(loader.AsyncLoad("Data/small.txt").get(), files[3].data);
+        const string text = loader.SyncOpenAndReadTextFileToString("Data/small.txt");
+        ok = ok && text == line;
+        ok = ok && loader.RemoveSearchPath(kPackPath) && !loader.FileExists("Text/lorem.txt");
+        ok = ok && !loader.AddSearchPath("AssetPackTest_missing.pack");
+        loader.Finalize();
+        cout << "asset loader: " << (ok ? "ok" : "FAILED") << endl;
+        if (!ok) result = 1;
+    }
+
+    // entries which reach past the end of the file or do not add up are
+    // refused when the pack is opened
+    {
+        vector<uint8_t> pack_data;
+        FILE* fp = fopen(kPackPath, "rb");
+        if (fp) {
+            fseek(fp, 0, SEEK_END);
+            pack_data.resize(static_cast<size_t>(ftell(fp)));
+            fseek(fp, 0, SEEK_SET);
+            if (fread(pack_data.data(), 1, pack_data.size(), fp) != pack_data.size()) pack_data.clear();
+            fclose(fp);
+        }
+
+        bool ok = pack_data.size() >= sizeof(ASSET_PACK_HEADER);
+        ASSET_PACK_HEADER header;
+        if (ok) memcpy(&header, pack_data.data(), sizeof(header));
+        for (uint32_t i = 0; ok && i < header.EntryCount; i++) {
+            const size_t at = static_cast<size_t>(header.IndexOffset) + i * sizeof(ASSET_PACK_ENTRY);
+            ASSET_PACK_ENTRY entry;
+            memcpy(&entry, pack_data.data() + at, sizeof(entry));
+
+            vector<ASSET_PACK_ENTRY> corrupt(3, entry);
+            corrupt[0].Size = corrupt[0].StoredSize = 1024 * 1024;
+            corrupt[1].DataOffset = pack_data.size() - entry.StoredSize + 1;
+            if (entry.ChunkCount) {
+                corrupt[2].ChunkCount++;
+            } else {
+                corrupt[2].Size++;
+            }
+
+            for (const auto& patched : corrupt) {
+                const string path = "AssetPackTest_corrupt.pack";
+                vector<uint8_t> data = pack_data;
+                memcpy(data.data() + at, &patched, sizeof(patched));
+                TestFile file;
+                file.path = path;
+                file.data = data;
+                AssetPack pack;
+                ok = ok && writeFile(file) && !pack.Open(path.c_str());
+                remove(path.c_str());
+            }
+        }
+        cout << "corrupt packs: " << (ok ? "ok" : "FAILED") << endl;
+        if (!ok) result = 1;
+    }
+
+    remove(kPackPath);
+
+    return result;
+}
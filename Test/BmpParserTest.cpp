@@ -0,0 +1,104 @@
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include "BMP.hpp"
+
+using namespace std;
+using namespace My;
+
+static const int32_t kHeight = 5;
+
+// an uncompressed BMP, pixel (x, y) counted from the top is B = x, G = y,
+// R = x + y and A = 200. row padding is filled with junk
+static Buffer makeBmp(int32_t width, uint16_t bit_count, bool top_down)
+{
+    const uint32_t byte_count = bit_count >> 3;
+    const uint32_t pitch = (width * byte_count + 3) & ~3u;
+    vector<uint8_t> file(BITMAP_FILEHEADER_SIZE + sizeof(BITMAP_HEADER) + pitch * kHeight, 0xEE);
+
+    BITMAP_FILEHEADER file_header = {};
+    file_header.Signature = 0x4D42;
+    file_header.Size = static_cast<uint32_t>(file.size());
+    file_header.BitsOffset = BITMAP_FILEHEADER_SIZE + sizeof(BITMAP_HEADER);
+    memcpy(file.data(), &file_header, BITMAP_FILEHEADER_SIZE);
+
+    BITMAP_HEADER header = {};
+    header.HeaderSize = sizeof(BITMAP_HEADER);
+    header.Width = width;
+    header.Height = top_down ? -kHeight : kHeight;
+    header.Planes = 1;
+    header.BitCount = bit_count;
+    memcpy(file.data() + BITMAP_FILEHEADER_SIZE, &header, sizeof(header));
+
+    // 8 bit images are only used to check they are refused, their pixels are junk
+    for (int32_t y = 0; byte_count >= 3 && y < kHeight; y++)
+    {
+        const int32_t row = top_down ? y : kHeight - y - 1;
+        for (int32_t x = 0; x < width; x++)
+        {
+            uint8_t* pixel = file.data() + file_header.BitsOffset + row * pitch + x * byte_count;
+            pixel[0] = static_cast<uint8_t>(x);
+            pixel[1] = static_cast<uint8_t>(y);
+            pixel[2] = static_cast<uint8_t>(x + y);
+            if (byte_count == 4) pixel[3] = 200;
+        }
+    }
+
+    Buffer buf(file.size());
+    memcpy(buf.GetData(), file.data(), file.size());
+    return buf;
+}
+
+int main(int argc, const char** argv)
+{
+    int result = 0;
+    auto cerr_buf = cerr.rdbuf(nullptr);
+
+    BmpParser parser;
+    for (uint16_t bit_count : { 24, 32 })
+    {
+        for (int top_down = 0; top_down < 2; top_down++)
+        {
+            for (int rgba = 0; rgba < 2; rgba++)
+            {
+                bool ok = true;
+                for (int32_t width : { 1, 3, 7, 21 })
+                {
+                    Buffer buf = makeBmp(width, bit_count, top_down != 0);
+                    Image image = parser.Parse(buf, rgba ? ImageOutputFormat::kImageOutputFormatRGBA : ImageOutputFormat::kImageOutputFormatNative);
+                    const uint32_t expected_bitcount = (bit_count == 32 || rgba) ? 32 : 24;
+                    ok = ok && image.data && image.Width == static_cast<uint32_t>(width) && image.Height == static_cast<uint32_t>(kHeight)
+                        && image.bitcount == expected_bitcount;
+                    for (int32_t y = 0; ok && y < kHeight; y++)
+                    {
+                        for (int32_t x = 0; ok && x < width; x++)
+                        {
+                            const uint8_t* pixel = image.data + image.pitch * y + x * (image.bitcount >> 3);
+                            ok = pixel[0] == x + y && pixel[1] == y && pixel[2] == x
+                                && (image.bitcount == 24 || pixel[3] == (bit_count == 32 ? 200 : 255));
+                        }
+                    }
+                    delete[] image.data;
+                }
+                cout << bit_count << " bit" << (top_down ? " top down" : "") << (rgba ? " to RGBA: " : ": ") << (ok ? "ok" : "FAILED") << endl;
+                if (!ok) result = 1;
+            }
+        }
+    }
+
+    // unsupported depths and truncated files give an empty image
+    {
+        Buffer indexed = makeBmp(4, 8, false);
+        Buffer truncated = makeBmp(16, 24, false);
+        Buffer short_buf(truncated.GetDataSize() - 8);
+        memcpy(short_buf.GetData(), truncated.GetData(), short_buf.GetDataSize());
+        Image a = parser.Parse(indexed);
+        Image b = parser.Parse(short_buf);
+        const bool ok = !a.data && !b.data;
+        cout << "unsupported: " << (ok ? "ok" : "FAILED") << endl;
+        if (!ok) result = 1;
+    }
+
+    cerr.rdbuf(cerr_buf);
+    return result;
+}
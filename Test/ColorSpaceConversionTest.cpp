@@ -1,4 +1,6 @@
+#include <cstdlib>
 #include <iostream>
+#include <vector>
 #include "ColorSpaceConversion.hpp"
 
 using namespace std;
@@ -15,6 +17,41 @@ int main(int argc, const char** argv)
     rgb = ConvertYCbCr2RGB(ycbcr);
     cout << "Now transformed back to RGB: " << rgb;
 
+    // the batched conversion must agree with the per pixel one
+    const size_t count = 16 * 16 * 16;
+    vector<uint8_t> y(count), cb(count), cr(count), rgba(count * 4);
+    for (size_t i = 0; i < count; i++) {
+        y[i]  = static_cast<uint8_t>((i & 0xF) * 17);
+        cb[i] = static_cast<uint8_t>(((i >> 4) & 0xF) * 17);
+        cr[i] = static_cast<uint8_t>((i >> 8) * 17);
+    }
+    ConvertYCbCr2RGBA(y.data(), cb.data(), cr.data(), rgba.data(), count);
+
+    int max_error = 0;
+    for (size_t i = 0; i < count; i++) {
+        RGBf reference = ConvertYCbCr2RGB({ static_cast<float>(y[i]), static_cast<float>(cb[i]), static_cast<float>(cr[i]) });
+        for (int c = 0; c < 3; c++) {
+            max_error = max(max_error, abs(static_cast<int>(rgba[i * 4 + c]) - static_cast<int>(reference[c])));
+        }
+        if (rgba[i * 4 + 3] != 255) max_error = 255;
+    }
+    cout << "Batched YCbCr to RGBA max error: " << max_error << endl;
+    if (max_error > 1) result = 1;
+
+    // and the other way round, from the RGBA we just produced
+    vector<uint8_t> y2(count), cb2(count), cr2(count);
+    ConvertRGB2YCbCr(rgba.data(), 4, y2.data(), cb2.data(), cr2.data(), count);
+
+    max_error = 0;
+    for (size_t i = 0; i < count; i++) {
+        YCbCrf reference = ConvertRGB2YCbCr({ static_cast<float>(rgba[i * 4]), static_cast<float>(rgba[i * 4 + 1]), static_cast<float>(rgba[i * 4 + 2]) });
+        max_error = max(max_error, abs(static_cast<int>(y2[i]) - static_cast<int>(reference[0])));
+        max_error = max(max_error, abs(static_cast<int>(cb2[i]) - static_cast<int>(reference[1])));
+        max_error = max(max_error, abs(static_cast<int>(cr2[i]) - static_cast<int>(reference[2])));
+    }
+    cout << "Batched RGB to YCbCr max error: " << max_error << endl;
+    if (max_error > 1) result = 1;
+
     return result;
 }
 
@@ -0,0 +1,148 @@
+#include <cfloat>
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <assert.h>
+#include "geommath.hpp"
+
+using namespace std;
+using namespace My;
+
+#ifdef USE_ISPC
+namespace Backend = ispc;
+#else
+namespace Backend = Dummy;
+#endif
+
+// float results may differ from the reference by the rounding of the 64
+// products summed for each value, relative to the largest value of the block
+static const float kRelativeTolerance = 64 * FLT_EPSILON;
+
+static float blockPeak(const Matrix8X8f& block)
+{
+    float peak = 1.0f;
+    for (int i = 0; i < 8; i++)
+        for (int j = 0; j < 8; j++)
+            peak = max(peak, fabs(block[i][j]));
+    return peak;
+}
+
+// compare the separable DCT / IDCT kernels against the reference implementation
+int main()
+{
+    // as many blocks as an IEEE 1180 run, the timings only use the first few
+    const size_t kBlocks = 10000;
+    const size_t kTimedBlocks = 64;
+    default_random_engine generator(1);
+    uniform_int_distribution<int> pixel(-128, 127);
+
+    vector<Matrix8X8f> pixels(kBlocks);
+    for (auto& block : pixels)
+    {
+        for (int i = 0; i < 8; i++)
+            for (int j = 0; j < 8; j++)
+                block[i][j] = static_cast<float>(pixel(generator));
+    }
+
+    vector<Matrix8X8f> coefficients(kBlocks);
+    vector<Matrix8X8f> reference(kBlocks);
+    float max_error = 0.0f;
+
+    // forward
+    DCT8X8(pixels.data(), coefficients.data(), kBlocks);
+    for (size_t n = 0; n < kBlocks; n++)
+    {
+        Backend::DCT8X8(pixels[n], reference[n]);
+        const float peak = blockPeak(reference[n]);
+        for (int i = 0; i < 8; i++)
+            for (int j = 0; j < 8; j++)
+                max_error = max(max_error, fabs(coefficients[n][i][j] - reference[n][i][j]) / peak);
+    }
+    cout << "DCT8X8 max relative error: " << max_error << endl;
+    assert(max_error <= kRelativeTolerance);
+
+    // quantize to integer coefficients as in a JPEG file
+    vector<Matrix8X8i16> coefficients_i16(kBlocks);
+    for (size_t n = 0; n < kBlocks; n++)
+    {
+        for (int i = 0; i < 8; i++)
+            for (int j = 0; j < 8; j++)
+            {
+                coefficients_i16[n][i][j] = static_cast<int16_t>(lrintf(reference[n][i][j]));
+                coefficients[n][i][j] = coefficients_i16[n][i][j];
+            }
+    }
+
+    // inverse
+    vector<Matrix8X8f> samples(kBlocks);
+    vector<Matrix8X8i16> samples_i16(kBlocks);
+    IDCT8X8(coefficients.data(), samples.data(), kBlocks);
+    IDCT8X8(coefficients_i16.data(), samples_i16.data(), kBlocks);
+    max_error = 0.0f;
+    // the int16 kernel against the rounded reference, as in IEEE 1180:
+    // no sample off by more than 1, a mean square error of at most 0.02
+    // and a mean error of at most 0.0015
+    int max_error_i16 = 0;
+    double square_error_i16 = 0.0;
+    double sum_error_i16 = 0.0;
+    for (size_t n = 0; n < kBlocks; n++)
+    {
+        Backend::IDCT8X8(coefficients[n], reference[n]);
+        const float peak = blockPeak(reference[n]);
+        for (int i = 0; i < 8; i++)
+            for (int j = 0; j < 8; j++)
+            {
+                max_error = max(max_error, fabs(samples[n][i][j] - reference[n][i][j]) / peak);
+                const int error = samples_i16[n][i][j] - static_cast<int>(lrintf(reference[n][i][j]));
+                max_error_i16 = max(max_error_i16, abs(error));
+                square_error_i16 += error * error;
+                sum_error_i16 += error;
+            }
+    }
+    const double samples_count = static_cast<double>(kBlocks * 64);
+    cout << "IDCT8X8 max relative error: " << max_error << endl;
+    cout << "IDCT8X8 (int16) peak error: " << max_error_i16
+        << " mean square error: " << square_error_i16 / samples_count
+        << " mean error: " << sum_error_i16 / samples_count << endl;
+    assert(max_error <= kRelativeTolerance);
+    assert(max_error_i16 <= 1);
+    assert(square_error_i16 / samples_count <= 0.02);
+    assert(fabs(sum_error_i16 / samples_count) <= 0.0015);
+
+    // in place
+    vector<Matrix8X8f> in_place = coefficients;
+    IDCT8X8(in_place.data(), in_place.data(), kBlocks);
+    for (size_t n = 0; n < kBlocks; n++)
+        for (int i = 0; i < 8; i++)
+            for (int j = 0; j < 8; j++)
+                assert(in_place[n][i][j] == samples[n][i][j]);
+
+    // speed
+    const int kIterations = 100;
+    auto start = chrono::high_resolution_clock::now();
+    for (int k = 0; k < kIterations; k++)
+        for (size_t n = 0; n < kTimedBlocks; n++)
+            Backend::IDCT8X8(coefficients[n], reference[n]);
+    auto end = chrono::high_resolution_clock::now();
+    chrono::duration<double, micro> reference_time = end - start;
+
+    start = chrono::high_resolution_clock::now();
+    for (int k = 0; k < kIterations; k++)
+        IDCT8X8(coefficients.data(), samples.data(), kTimedBlocks);
+    end = chrono::high_resolution_clock::now();
+    chrono::duration<double, micro> fast_time = end - start;
+
+    start = chrono::high_resolution_clock::now();
+    for (int k = 0; k < kIterations; k++)
+        IDCT8X8(coefficients_i16.data(), samples_i16.data(), kTimedBlocks);
+    end = chrono::high_resolution_clock::now();
+    chrono::duration<double, micro> fast_i16_time = end - start;
+
+    const double blocks = static_cast<double>(kIterations * kTimedBlocks);
+    cout << "IDCT8X8 reference: " << reference_time.count() / blocks << " us/block" << endl;
+    cout << "IDCT8X8 separable: " << fast_time.count() / blocks << " us/block" << endl;
+    cout << "IDCT8X8 separable (int16): " << fast_i16_time.count() / blocks << " us/block" << endl;
+
+    return 0;
+}
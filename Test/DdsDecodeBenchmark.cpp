@@ -0,0 +1,104 @@
+#include <iostream>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "AssetLoader.hpp"
+#include "MemoryManager.hpp"
+#include "DDS.hpp"
+
+using namespace std;
+using namespace My;
+
+namespace My {
+    IMemoryManager* g_pMemoryManager = new MemoryManager();
+    AssetLoader*   g_pAssetLoader = new AssetLoader();
+}
+
+int main(int argc, const char** argv)
+{
+    g_pMemoryManager->Initialize();
+    g_pAssetLoader->Initialize();
+
+#ifdef __ORBIS__
+    g_pAssetLoader->AddSearchPath("/app0");
+#endif
+
+    vector<string> files;
+    if (argc >= 2) {
+        for (int i = 1; i < argc; i++) files.push_back(argv[i]);
+    } else {
+        files = {
+            "Textures/icelogo-color.dds",
+            "Textures/icelogo-normal.dds",
+            "Textures/cubemap.dds",
+            "Textures/sor_sea/sea_radiance.dds"
+        };
+    }
+
+    const int kIterations = 10;
+
+    for (bool multithreaded : { false, true })
+    {
+        cout << (multithreaded ? "Multithreaded" : "Single threaded") << endl;
+
+        size_t total_pixels = 0;
+        double total_time = 0.0;
+
+        for (const auto& file : files)
+        {
+            Buffer buf = g_pAssetLoader->SyncOpenAndReadBinary(file.c_str());
+            if (!buf.GetDataSize()) continue;
+
+            // the parser logs the header, keep that out of the measurement
+            auto cerr_buf = cerr.rdbuf(nullptr);
+            DdsParser dds_parser;
+            Image image = dds_parser.Parse(buf);
+            const bool compressed = image.compressed;
+
+            dds_parser.SetDecompress(true);
+            dds_parser.SetMultithreaded(multithreaded);
+            auto start = chrono::high_resolution_clock::now();
+            for (int i = 0; compressed && i < kIterations; i++)
+            {
+                delete[] image.data;
+                image = dds_parser.Parse(buf);
+            }
+            auto end = chrono::high_resolution_clock::now();
+            cerr.rdbuf(cerr_buf);
+            cerr.clear();
+
+            if (!compressed) {
+                delete[] image.data;
+                cout << file << ": not block compressed, skipped" << endl;
+                continue;
+            }
+
+            // all mip levels are decoded
+            size_t pixels = 0;
+            for (uint32_t i = 0; i < image.mipmap_count; i++) {
+                pixels += static_cast<size_t>(image.mipmaps[i].Width) * image.mipmaps[i].Height;
+            }
+            delete[] image.data;
+
+            chrono::duration<double, milli> elapsed = end - start;
+            double ms = elapsed.count() / kIterations;
+            cout << file << " (" << image.Width << "x" << image.Height << ", " << image.mipmap_count << " mips): "
+                 << ms << " ms, " << pixels / ms / 1000.0 << " MPixel/s" << endl;
+
+            total_pixels += pixels;
+            total_time += ms;
+        }
+
+        if (total_time > 0.0) {
+            cout << "Total: " << total_pixels / total_time / 1000.0 << " MPixel/s" << endl;
+        }
+    }
+
+    g_pAssetLoader->Finalize();
+    g_pMemoryManager->Finalize();
+
+    delete g_pAssetLoader;
+    delete g_pMemoryManager;
+
+    return 0;
+}
@@ -0,0 +1,120 @@
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include "geommath.hpp"
+
+using namespace std;
+using namespace My;
+
+#ifdef USE_ISPC
+namespace Backend = ispc;
+#else
+namespace Backend = Dummy;
+#endif
+
+// the per-element out-of-line kernel calls used before the inline fast path
+static void OutOfLineMatrixMultiply(Matrix4X4f& result, const Matrix4X4f& matrix1, const Matrix4X4f& matrix2)
+{
+    Matrix4X4f matrix2_transpose;
+    Backend::Transpose(matrix2, matrix2_transpose, 4, 4);
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++) {
+            float products[4];
+            Backend::MulByElement(matrix1[i], matrix2_transpose[j], products, 4);
+            result[i][j] = products[0] + products[1] + products[2] + products[3];
+        }
+    }
+}
+
+template <typename Func>
+static double Measure(const char* name, const size_t iterations, Func&& func)
+{
+    auto start = chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < iterations; i++)
+    {
+        func(i);
+    }
+    auto end = chrono::high_resolution_clock::now();
+
+    chrono::duration<double, nano> elapsed = end - start;
+    double ns_per_op = elapsed.count() / iterations;
+    cout << name << ": " << ns_per_op << " ns/op" << endl;
+
+    return ns_per_op;
+}
+
+int main()
+{
+    const size_t kIterations = 2000000;
+    const size_t kDataSize = 1024;
+
+    vector<Matrix4X4f> matrices(kDataSize);
+    vector<Vector4f> vectors(kDataSize);
+    vector<Vector3f> vectors3(kDataSize);
+    for (size_t i = 0; i < kDataSize; i++)
+    {
+        MatrixRotationYawPitchRoll(matrices[i], 0.01f * i, 0.02f * i, 0.03f * i);
+        vectors[i] = { 1.0f * i, 2.0f, -3.0f, 1.0f };
+        vectors3[i] = { 0.5f * i, -1.0f, 2.0f };
+    }
+
+    cout << fixed;
+
+    // MatrixMultiply
+    {
+        Matrix4X4f acc;
+        BuildIdentityMatrix(acc);
+        double inline_time = Measure("MatrixMultiply (inline)", kIterations, [&](size_t i) {
+            MatrixMultiply(acc, acc, matrices[i % kDataSize]);
+        });
+        Matrix4X4f acc2;
+        BuildIdentityMatrix(acc2);
+        double call_time = Measure("MatrixMultiply (out-of-line)", kIterations, [&](size_t i) {
+            Matrix4X4f tmp;
+            OutOfLineMatrixMultiply(tmp, acc2, matrices[i % kDataSize]);
+            acc2 = tmp;
+        });
+        cout << "Speedup: " << call_time / inline_time << "x" << endl;
+        cout << "Checksum: " << acc[3] << "          " << acc2[3];
+    }
+
+    // Transform
+    {
+        Vector4f acc = { 0.0f, 0.0f, 0.0f, 0.0f };
+        double inline_time = Measure("Transform (inline)", kIterations, [&](size_t i) {
+            Vector4f v = vectors[i % kDataSize];
+            Transform(v, matrices[i % kDataSize]);
+            acc = acc + v;
+        });
+        Vector4f acc2 = { 0.0f, 0.0f, 0.0f, 0.0f };
+        double call_time = Measure("Transform (out-of-line)", kIterations, [&](size_t i) {
+            Vector4f v = vectors[i % kDataSize];
+            Backend::Transform(v, matrices[i % kDataSize]);
+            Backend::AddByElement(acc2, v, acc2, 4);
+        });
+        cout << "Speedup: " << call_time / inline_time << "x" << endl;
+        cout << "Checksum: " << acc << "          " << acc2;
+    }
+
+    // CrossProduct
+    {
+        Vector3f acc = { 1.0f, 0.0f, 0.0f };
+        double inline_time = Measure("CrossProduct (inline)", kIterations, [&](size_t i) {
+            CrossProduct(acc, acc, vectors3[i % kDataSize]);
+            Normalize(acc);
+        });
+        Vector3f acc2 = { 1.0f, 0.0f, 0.0f };
+        double call_time = Measure("CrossProduct (out-of-line)", kIterations, [&](size_t i) {
+            Vector3f tmp;
+            Backend::CrossProduct(acc2, vectors3[i % kDataSize], tmp);
+            float length;
+            DotProduct(length, static_cast<float*>(tmp), static_cast<float*>(tmp), 3);
+            Backend::Normalize(3, tmp, std::sqrt(length));
+            acc2 = tmp;
+        });
+        cout << "Speedup: " << call_time / inline_time << "x" << endl;
+        cout << "Checksum: " << acc << "          " << acc2;
+    }
+
+    return 0;
+}
@@ -214,12 +214,90 @@ void matrix_test()
     cout << "DCT-IDCT error: " << pixel_error;
 }
 
+void batch_test()
+{
+    const size_t count = 37;
+    Matrix4X4f m;
+    MatrixRotationYawPitchRoll(m, 0.3f, -0.7f, 1.1f);
+    Matrix4X4f t;
+    MatrixTranslation(t, 1.0f, -2.0f, 3.0f);
+    m = m * t;
+
+    Vector3f points[count];
+    Vector3f transformed[count];
+    Vector4f vectors[count];
+    Vector4f vectors_transformed[count];
+    Matrix4X4f matrices[count];
+    Matrix4X4f products[count];
+    for (size_t i = 0; i < count; i++)
+    {
+        points[i] = { 0.5f * i, -1.0f * i, 2.0f - i };
+        vectors[i] = { 1.0f * i, 2.0f, -3.0f, (i & 1) ? 1.0f : 0.0f };
+        MatrixRotationYawPitchRoll(matrices[i], 0.1f * i, 0.2f * i, 0.3f * i);
+    }
+
+    TransformPoints(count, points, transformed, m);
+    TransformVectors(count, vectors, vectors_transformed, m);
+    MultiplyMatrixArray(count, matrices, m, products);
+    for (size_t i = 0; i < count; i++)
+    {
+        Vector4f expected = { points[i][0], points[i][1], points[i][2], 1.0f };
+        Transform(expected, m);
+        for (int j = 0; j < 3; j++) assert(fabs(expected[j] - transformed[i][j]) < 1e-4f);
+
+        expected = vectors[i];
+        Transform(expected, m);
+        for (int j = 0; j < 4; j++) assert(fabs(expected[j] - vectors_transformed[i][j]) < 1e-4f);
+
+        Matrix4X4f product = matrices[i] * m;
+        for (int j = 0; j < 4; j++)
+            for (int k = 0; k < 4; k++)
+                assert(fabs(product[j][k] - products[i][j][k]) < 1e-4f);
+    }
+    cout << "TransformPoints / TransformVectors / MultiplyMatrixArray match the single versions" << endl;
+
+    Vector3f bbmin (numeric_limits<float>::max());
+    Vector3f bbmax (numeric_limits<float>::lowest());
+    CalculateAabb(count, points, bbmin, bbmax);
+    cout << "Bounding box of points: " << bbmin << bbmax;
+    assert(bbmin[0] == 0.0f && bbmin[1] == -1.0f * (count - 1) && bbmin[2] == 2.0f - (count - 1));
+    assert(bbmax[0] == 0.5f * (count - 1) && bbmax[1] == 0.0f && bbmax[2] == 2.0f);
+
+    Vector3f centroid = (bbmax + bbmin) * 0.5f;
+    Vector3f extent = (bbmax - bbmin) * 0.5f;
+    Vector3f out_centroid, out_extent;
+    TransformAabbArray(1, &centroid, &extent, &out_centroid, &out_extent, m);
+    Vector3f tmin (numeric_limits<float>::max());
+    Vector3f tmax (numeric_limits<float>::lowest());
+    CalculateAabb(count, transformed, tmin, tmax);
+    for (int j = 0; j < 3; j++)
+    {
+        // the transformed box must enclose every transformed point
+        assert(out_centroid[j] - out_extent[j] <= tmin[j] + 1e-4f);
+        assert(out_centroid[j] + out_extent[j] >= tmax[j] - 1e-4f);
+    }
+    cout << "Transformed bounding box: " << out_centroid << out_extent;
+
+    NormalizeArray(count, points);
+    for (size_t i = 0; i < count; i++)
+    {
+        float length;
+        DotProduct(length, points[i], points[i]);
+        assert(i == 0 || fabs(length - 1.0f) < 1e-4f);
+    }
+    assert(points[0][0] == 0.0f && points[0][2] == 1.0f);
+    cout << "NormalizeArray OK" << endl;
+}
+
 int main()
 {
     cout << fixed;
 
+    cout << "SIMD Target: " << GetSimdTargetName() << " (" << GetSimdWidth() << " lanes)" << endl;
+
     vector_test();
     matrix_test();
+    batch_test();
 
 	return 0;
 }
@@ -1,5 +1,8 @@
+#include <cmath>
+#include <cstring>
 #include <iostream>
 #include <string>
+#include <vector>
 #include "AssetLoader.hpp"
 #include "MemoryManager.hpp"
 #include "HDR.hpp"
@@ -7,6 +10,75 @@
 using namespace std;
 using namespace My;
 
+static const uint32_t kWidth = 20;
+static const uint32_t kHeight = 3;
+
+// RGBE pixels with runs in R and B, and no two equal neighbours in G
+static vector<uint8_t> testPixels()
+{
+    vector<uint8_t> pixels;
+    for (uint32_t y = 0; y < kHeight; y++) {
+        for (uint32_t x = 0; x < kWidth; x++) {
+            pixels.push_back(static_cast<uint8_t>((x / 4) * 10 + 5));
+            pixels.push_back(static_cast<uint8_t>(x * 13 + y + 7));
+            pixels.push_back(200);
+            pixels.push_back(static_cast<uint8_t>(128 + y));
+        }
+    }
+    return pixels;
+}
+
+// a -Y kHeight +X kWidth file, the scan lines flat or with the per channel
+// run length encoding, runs of 3 or more equal values as runs
+static Buffer makeHdr(const vector<uint8_t>& pixels, bool rle)
+{
+    const string header = "#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n\n-Y " + to_string(kHeight) + " +X " + to_string(kWidth) + "\n";
+    vector<uint8_t> file(header.begin(), header.end());
+    for (uint32_t y = 0; y < kHeight; y++) {
+        const uint8_t* line = pixels.data() + y * kWidth * 4;
+        if (!rle) {
+            file.insert(file.end(), line, line + kWidth * 4);
+            continue;
+        }
+
+        file.insert(file.end(), { 2, 2, static_cast<uint8_t>(kWidth >> 8), static_cast<uint8_t>(kWidth & 0xFF) });
+        for (uint32_t channel = 0; channel < 4; channel++) {
+            uint32_t x = 0;
+            while (x < kWidth) {
+                uint32_t run = 1;
+                while (x + run < kWidth && run < 127 && line[(x + run) * 4 + channel] == line[x * 4 + channel]) run++;
+                if (run >= 3) {
+                    file.insert(file.end(), { static_cast<uint8_t>(128 + run), line[x * 4 + channel] });
+                    x += run;
+                    continue;
+                }
+
+                // a literal span up to the next run
+                uint32_t count = 0;
+                while (x + count < kWidth && count < 128) {
+                    const uint32_t i = x + count;
+                    if (i + 2 < kWidth && line[i * 4 + channel] == line[(i + 1) * 4 + channel]
+                            && line[i * 4 + channel] == line[(i + 2) * 4 + channel]) break;
+                    count++;
+                }
+                file.push_back(static_cast<uint8_t>(count));
+                for (uint32_t i = 0; i < count; i++) file.push_back(line[(x + i) * 4 + channel]);
+                x += count;
+            }
+        }
+    }
+
+    Buffer buf(file.size());
+    memcpy(buf.GetData(), file.data(), file.size());
+    return buf;
+}
+
+static bool sameImage(const Image& a, const Image& b)
+{
+    return a.data && b.data && a.Width == b.Width && a.Height == b.Height && a.bitcount == b.bitcount
+        && a.data_size == b.data_size && memcmp(a.data, b.data, a.data_size) == 0;
+}
+
 namespace My {
     IMemoryManager* g_pMemoryManager = new MemoryManager();
     AssetLoader*   g_pAssetLoader = new AssetLoader();
@@ -14,6 +86,8 @@ namespace My {
 
 int main(int argc, const char** argv)
 {
+    int result = 0;
+
     g_pMemoryManager->Initialize();
     g_pAssetLoader->Initialize();
 
@@ -34,6 +108,36 @@ int main(int argc, const char** argv)
         Image image = hdr_parser.Parse(buf);
 
         cout << image;
+        delete[] image.data;
+    }
+
+    // run length encoded scan lines decode the same as flat ones, to float
+    // and to half float
+    {
+        const vector<uint8_t> pixels = testPixels();
+        Buffer flat = makeHdr(pixels, false);
+        Buffer rle = makeHdr(pixels, true);
+        bool ok = rle.GetDataSize() < flat.GetDataSize();
+
+        for (int half_float = 0; half_float < 2; half_float++) {
+            HdrParser hdr_parser;
+            hdr_parser.SetHalfFloatOutput(half_float != 0);
+            Image from_flat = hdr_parser.Parse(flat);
+            Image from_rle = hdr_parser.Parse(rle);
+            ok = ok && sameImage(from_flat, from_rle);
+            delete[] from_flat.data;
+            delete[] from_rle.data;
+        }
+
+        // mantissa * 2^(exponent - 136), the second line has exponent 129
+        HdrParser hdr_parser;
+        Image image = hdr_parser.Parse(rle);
+        const float* pixel = reinterpret_cast<const float*>(image.data + image.pitch);
+        ok = ok && image.data && pixel[0] == ldexpf(5.0f, 129 - 136) && pixel[2] == ldexpf(200.0f, 129 - 136);
+        delete[] image.data;
+
+        cout << "run length encoding: " << (ok ? "ok" : "FAILED") << endl;
+        if (!ok) result = 1;
     }
 
     g_pAssetLoader->Finalize();
@@ -42,6 +146,6 @@ int main(int argc, const char** argv)
     delete g_pAssetLoader;
     delete g_pMemoryManager;
 
-    return 0;
+    return result;
 }
 
@@ -0,0 +1,175 @@
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "ImageCache.hpp"
+#include "TGA.hpp"
+
+using namespace std;
+using namespace My;
+
+// an uncompressed 32 bit TGA
+static vector<uint8_t> makeTga(uint32_t width, uint32_t height, uint8_t seed)
+{
+    vector<uint8_t> file(18, 0);
+    file[2] = 2;
+    file[12] = width & 0xFF;
+    file[13] = width >> 8;
+    file[14] = height & 0xFF;
+    file[15] = height >> 8;
+    file[16] = 32;
+    for (uint32_t i = 0; i < width * height * 4; i++) file.push_back(static_cast<uint8_t>(i * 3 + seed));
+    return file;
+}
+
+struct Loader {
+    vector<uint8_t> content;
+    int reads = 0;
+    int decodes = 0;
+
+    Loader() = default;
+    explicit Loader(const vector<uint8_t>& file) : content(file) {}
+
+    shared_ptr<Image> load(ImageCache& cache, const string& name)
+    {
+        auto read = [this]() -> Buffer {
+            reads++;
+            Buffer buf(content.size());
+            if (!content.empty()) memcpy(buf.GetData(), content.data(), content.size());
+            return buf;
+        };
+        auto decode = [this](Buffer& buf) -> Image {
+            decodes++;
+            TgaParser parser;
+            return buf.GetDataSize() ? parser.Parse(buf) : Image();
+        };
+        return cache.Load(name, read, decode);
+    }
+};
+
+static bool check(const char* what, bool ok)
+{
+    cout << what << ": " << (ok ? "ok" : "FAILED") << endl;
+    return ok;
+}
+
+int main(int argc, const char** argv)
+{
+    int result = 0;
+
+    const struct {
+        const char* name;
+        const char* canonical;
+    } kNames[] = {
+        { "Textures/a.tga", "Textures/a.tga" },
+        { "./Textures\\a.tga", "Textures/a.tga" },
+        { "Textures/../Textures//a.tga", "Textures/a.tga" },
+        { "../Asset/./b.tga", "../Asset/b.tga" },
+        { "a/b/../../../c.tga", "../c.tga" }
+    };
+    bool ok = true;
+    for (const auto& name : kNames) ok = ok && ImageCache::CanonicalName(name.name) == name.canonical;
+    if (!check("canonical name", ok)) result = 1;
+
+    const vector<uint8_t> first = makeTga(16, 16, 1);
+    const vector<uint8_t> second = makeTga(16, 16, 2);
+    const size_t image_size = 16 * 16 * 4;
+
+    // the same file by name, the same content under another name
+    {
+        ImageCache cache;
+        Loader loader(first);
+        shared_ptr<Image> a = loader.load(cache, "Textures/a.tga");
+        shared_ptr<Image> b = loader.load(cache, "./Textures\\a.tga");
+        ok = a && a->data && a == b && loader.reads == 1 && loader.decodes == 1;
+        if (!check("same name", ok)) result = 1;
+
+        shared_ptr<Image> copy = loader.load(cache, "Textures/copy_of_a.tga");
+        ok = copy == a && loader.reads == 2 && loader.decodes == 1;
+        loader.content = second;
+        shared_ptr<Image> other = loader.load(cache, "Textures/b.tga");
+        ok = ok && other && other != a && loader.decodes == 2 && memcmp(other->data, a->data, image_size) != 0;
+        const ImageCache::Stats stats = cache.GetStats();
+        ok = ok && stats.hits == 2 && stats.misses == 2 && stats.retained_count == 2 && stats.retained_bytes == 2 * image_size;
+        if (!check("same content", ok)) result = 1;
+    }
+
+    // files which differ only in the top bits of two 64 bit words, which
+    // cancelled out when the hash folded whole words
+    {
+        vector<uint8_t> flipped = first;
+        flipped[23] ^= 0x80;
+        flipped[31] ^= 0x80;
+        Buffer a(first.size()), b(flipped.size());
+        memcpy(a.GetData(), first.data(), first.size());
+        memcpy(b.GetData(), flipped.data(), flipped.size());
+        ok = ImageCache::ContentHash(a) != ImageCache::ContentHash(b) && ImageCache::ContentCheck(a) != ImageCache::ContentCheck(b);
+
+        ImageCache cache;
+        Loader loader(first);
+        shared_ptr<Image> original = loader.load(cache, "Textures/a.tga");
+        loader.content = flipped;
+        shared_ptr<Image> other = loader.load(cache, "Textures/flipped.tga");
+        ok = ok && original && other && original != other && loader.decodes == 2
+            && memcmp(original->data, other->data, image_size) != 0;
+        if (!check("similar content", ok)) result = 1;
+    }
+
+    // images out of use stay while they fit the budget, least recently used go first
+    {
+        ImageCache cache(2 * image_size);
+        Loader loader;
+        for (uint8_t i = 0; i < 3; i++) {
+            loader.content = makeTga(16, 16, 10 + i);
+            loader.load(cache, "Textures/" + to_string(i) + ".tga");
+        }
+        ImageCache::Stats stats = cache.GetStats();
+        ok = stats.misses == 3 && stats.retained_count == 2 && stats.retained_bytes == 2 * image_size;
+
+        loader.content = makeTga(16, 16, 12);
+        loader.load(cache, "Textures/2.tga");
+        loader.content = makeTga(16, 16, 11);
+        loader.load(cache, "Textures/1.tga");
+        loader.content = makeTga(16, 16, 10);
+        loader.load(cache, "Textures/0.tga");
+        stats = cache.GetStats();
+        ok = ok && stats.hits == 2 && stats.misses == 4 && loader.decodes == 4;
+
+        // 1 was used after 2, so 2 goes when the budget shrinks
+        cache.SetByteBudget(image_size);
+        loader.content = makeTga(16, 16, 12);
+        loader.load(cache, "Textures/2.tga");
+        stats = cache.GetStats();
+        ok = ok && stats.misses == 5 && stats.retained_count == 1;
+        if (!check("byte budget", ok)) result = 1;
+    }
+
+    // with no budget images are shared only while something holds them
+    {
+        ImageCache cache(0);
+        Loader loader(first);
+        shared_ptr<Image> held = loader.load(cache, "Textures/a.tga");
+        ok = loader.load(cache, "Textures/a.tga") == held && cache.GetStats().retained_count == 0;
+        held.reset();
+        ok = ok && loader.load(cache, "Textures/a.tga") && loader.decodes == 2;
+        if (!check("weak references", ok)) result = 1;
+    }
+
+    // failed decodes are not cached, clear forgets everything
+    {
+        ImageCache cache;
+        Loader loader;
+        ok = !loader.load(cache, "Textures/missing.tga")->data && !loader.load(cache, "Textures/missing.tga")->data;
+        ok = ok && loader.reads == 2 && loader.decodes == 2;
+        loader.content = first;
+        shared_ptr<Image> a = loader.load(cache, "Textures/a.tga");
+        cache.Clear();
+        shared_ptr<Image> b = loader.load(cache, "Textures/a.tga");
+        ok = ok && a && b && a != b && loader.decodes == 4 && memcmp(a->data, b->data, image_size) == 0;
+        cache.ResetStats();
+        ok = ok && cache.GetStats().hits == 0 && cache.GetStats().misses == 0;
+        if (!check("misses", ok)) result = 1;
+    }
+
+    return result;
+}
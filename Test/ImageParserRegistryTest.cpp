@@ -0,0 +1,160 @@
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <zlib.h>
+#include "ImageParserRegistry.hpp"
+
+using namespace std;
+using namespace My;
+
+static Buffer makeBuffer(const vector<uint8_t>& bytes)
+{
+    Buffer buf(bytes.size());
+    memcpy(buf.GetData(), bytes.data(), bytes.size());
+    return buf;
+}
+
+static void appendBigEndian(vector<uint8_t>& out, uint32_t value)
+{
+    out.push_back(value >> 24);
+    out.push_back((value >> 16) & 0xFF);
+    out.push_back((value >> 8) & 0xFF);
+    out.push_back(value & 0xFF);
+}
+
+static void appendChunk(vector<uint8_t>& out, const char* type, const vector<uint8_t>& data)
+{
+    appendBigEndian(out, static_cast<uint32_t>(data.size()));
+    const size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    appendBigEndian(out, static_cast<uint32_t>(crc32(0, out.data() + start, static_cast<uInt>(out.size() - start))));
+}
+
+// an 8 bit RGB (color type 2) or RGBA (color type 6) PNG of a gradient
+static Buffer makePng(uint32_t width, uint32_t height, uint8_t color_type, uint8_t seed)
+{
+    const uint32_t channels = (color_type == 6) ? 4 : 3;
+    vector<uint8_t> raw;
+    for (uint32_t y = 0; y < height; y++)
+    {
+        raw.push_back(y % 5); // every filter type
+        for (uint32_t x = 0; x < width * channels; x++) raw.push_back(static_cast<uint8_t>(x * 7 + y * 13 + seed));
+    }
+    uLongf compressed_size = compressBound(static_cast<uLong>(raw.size()));
+    vector<uint8_t> compressed(compressed_size);
+    compress(compressed.data(), &compressed_size, raw.data(), static_cast<uLong>(raw.size()));
+    compressed.resize(compressed_size);
+
+    vector<uint8_t> file = { 0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A };
+    vector<uint8_t> header;
+    appendBigEndian(header, width);
+    appendBigEndian(header, height);
+    header.insert(header.end(), { 8, color_type, 0, 0, 0 });
+    appendChunk(file, "IHDR", header);
+    appendChunk(file, "IDAT", compressed);
+    appendChunk(file, "IEND", vector<uint8_t>());
+    return makeBuffer(file);
+}
+
+// an uncompressed 24 bit TGA
+static Buffer makeTga(uint32_t width, uint32_t height, uint8_t seed)
+{
+    vector<uint8_t> file(18, 0);
+    file[2] = 2;
+    file[12] = width & 0xFF;
+    file[13] = width >> 8;
+    file[14] = height & 0xFF;
+    file[15] = height >> 8;
+    file[16] = 24;
+    for (uint32_t i = 0; i < width * height * 3; i++) file.push_back(static_cast<uint8_t>(i * 3 + seed));
+    return makeBuffer(file);
+}
+
+static bool sameImage(const Image& a, const Image& b)
+{
+    return a.data && b.data && a.Width == b.Width && a.Height == b.Height && a.bitcount == b.bitcount
+        && a.data_size == b.data_size && memcmp(a.data, b.data, a.data_size) == 0;
+}
+
+int main(int argc, const char** argv)
+{
+    int result = 0;
+    auto cerr_buf = cerr.rdbuf(nullptr);
+
+    // formats come from the first bytes of the buffer
+    const struct {
+        vector<uint8_t> bytes;
+        ImageFileFormat format;
+    } kSignatures[] = {
+        { { 0xFF, 0xD8, 0xFF, 0xE0, 0, 0x10 }, ImageFileFormat::kImageFileFormatJPEG },
+        { { 0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A, 0 }, ImageFileFormat::kImageFileFormatPNG },
+        { { 'D', 'D', 'S', ' ', 124, 0, 0, 0 }, ImageFileFormat::kImageFileFormatDDS },
+        { { '#', '?', 'R', 'A', 'D', 'I', 'A', 'N', 'C', 'E', '\n' }, ImageFileFormat::kImageFileFormatHDR },
+        { { 'B', 'M', 0x36, 0, 0, 0 }, ImageFileFormat::kImageFileFormatBMP },
+        { { 0, 0, 10, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0, 4, 0, 32, 8 }, ImageFileFormat::kImageFileFormatTGA },
+        { { 0, 0, 7, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0, 4, 0, 32, 8 }, ImageFileFormat::kImageFileFormatUnknown },
+        { { 'G', 'I', 'F', '8', '9', 'a' }, ImageFileFormat::kImageFileFormatUnknown },
+        { { 0xFF }, ImageFileFormat::kImageFileFormatUnknown }
+    };
+    for (const auto& signature : kSignatures)
+    {
+        Buffer buf = makeBuffer(signature.bytes);
+        if (ImageParserRegistry::DetectFormat(buf) != signature.format)
+        {
+            cout << "detect format " << static_cast<int>(signature.format) << ": FAILED" << endl;
+            result = 1;
+        }
+    }
+    cout << "detect format: " << (result ? "FAILED" : "ok") << endl;
+
+    // an unknown format gives an empty image
+    ImageParserRegistry registry;
+    {
+        Buffer buf = makeBuffer({ 'G', 'I', 'F', '8', '9', 'a', 0, 0 });
+        Image image = registry.Parse(buf);
+        const bool ok = !image.data && image.Width == 0;
+        cout << "unknown format: " << (ok ? "ok" : "FAILED") << endl;
+        if (!ok) result = 1;
+    }
+
+    // one registry decodes a mix of files the same as fresh parsers do
+    vector<Buffer> files;
+    files.push_back(makePng(33, 17, 2, 0));
+    files.push_back(makeTga(19, 7, 1));
+    files.push_back(makePng(64, 3, 6, 2));
+    files.push_back(makePng(5, 40, 2, 3));
+    files.push_back(makeTga(40, 21, 4));
+    files.push_back(makePng(33, 17, 6, 5));
+    for (int pass = 0; pass < 2; pass++)
+    {
+        for (size_t i = 0; i < files.size(); i++)
+        {
+            Image reused = registry.Parse(files[i], ImageOutputFormat::kImageOutputFormatRGBA);
+            Image fresh;
+            if (ImageParserRegistry::DetectFormat(files[i]) == ImageFileFormat::kImageFileFormatPNG)
+            {
+                PngParser png_parser;
+                fresh = png_parser.Parse(files[i], ImageOutputFormat::kImageOutputFormatRGBA);
+            }
+            else
+            {
+                TgaParser tga_parser;
+                fresh = tga_parser.Parse(files[i], ImageOutputFormat::kImageOutputFormatRGBA);
+            }
+            const bool ok = sameImage(reused, fresh) && reused.bitcount == 32;
+            cout << "reuse pass " << pass << " file " << i << ": " << (ok ? "ok" : "FAILED") << endl;
+            if (!ok) result = 1;
+            delete[] reused.data;
+            delete[] fresh.data;
+        }
+    }
+
+    // every thread has its own registry
+    const bool ok = &ImageParserRegistry::ThreadInstance() == &ImageParserRegistry::ThreadInstance();
+    cout << "thread instance: " << (ok ? "ok" : "FAILED") << endl;
+    if (!ok) result = 1;
+
+    cerr.rdbuf(cerr_buf);
+    return result;
+}
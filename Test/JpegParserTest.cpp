@@ -1,5 +1,7 @@
+#include <cstring>
 #include <iostream>
 #include <string>
+#include <vector>
 #include "AssetLoader.hpp"
 #include "MemoryManager.hpp"
 #include "JPEG.hpp"
@@ -7,6 +9,56 @@
 using namespace std;
 using namespace My;
 
+static void appendSegment(vector<uint8_t>& file, uint16_t marker, const vector<uint8_t>& payload)
+{
+    const size_t length = payload.size() + 2;
+    file.push_back(marker >> 8);
+    file.push_back(marker & 0xFF);
+    file.push_back(static_cast<uint8_t>(length >> 8));
+    file.push_back(static_cast<uint8_t>(length & 0xFF));
+    file.insert(file.end(), payload.begin(), payload.end());
+}
+
+// a DHT with the code counts of each length and as many values as they add up to
+static vector<uint8_t> huffmanTable(uint8_t class_and_destination, const vector<uint8_t>& counts)
+{
+    vector<uint8_t> payload(1, class_and_destination);
+    payload.insert(payload.end(), counts.begin(), counts.end());
+    payload.resize(17, 0);
+    size_t values = 0;
+    for (size_t i = 1; i < 17; i++) values += payload[i];
+    for (size_t i = 0; i < values; i++) payload.push_back(static_cast<uint8_t>(i));
+    return payload;
+}
+
+// an 8x8 gray baseline frame with quantization table 0 all ones
+static vector<uint8_t> grayFrame()
+{
+    vector<uint8_t> file = { 0xFF, 0xD8 };
+    vector<uint8_t> quantization(65, 1);
+    quantization[0] = 0x00;
+    appendSegment(file, 0xFFDB, quantization);
+    appendSegment(file, 0xFFC0, { 8, 0, 8, 0, 8, 1, 1, 0x11, 0 });
+    return file;
+}
+
+static Image parse(const vector<uint8_t>& file)
+{
+    Buffer buf(file.size());
+    memcpy(buf.GetData(), file.data(), file.size());
+    JfifParser jfif_parser;
+    return jfif_parser.Parse(buf);
+}
+
+// corrupt files give no image, and are never read past their end
+static bool parsesAsCorrupt(const vector<uint8_t>& file)
+{
+    Image image = parse(file);
+    const bool corrupt = !image.data;
+    delete[] image.data;
+    return corrupt;
+}
+
 namespace My {
     IMemoryManager* g_pMemoryManager = new MemoryManager();
     AssetLoader*   g_pAssetLoader = new AssetLoader();
@@ -36,12 +88,107 @@ int main(int argc, const char** argv)
         cout << image;
     }
 
+    int result = 0;
+
+    // tables 2 and 3 are used as such, not as tables 0 and 1. the only DC
+    // code is category 4, the only AC code the end of block
+    {
+        vector<uint8_t> file = grayFrame();
+        appendSegment(file, 0xFFC4, huffmanTable(0x02, { 1 }));
+        file.back() = 4;
+        appendSegment(file, 0xFFC4, huffmanTable(0x13, { 1 }));
+        appendSegment(file, 0xFFDA, { 1, 1, 0x23, 0, 63, 0 });
+        // DC code 0, value 1111 (15), EOB code 0, padded with 1 bits
+        file.insert(file.end(), { 0x7B, 0xFF, 0xD9 });
+        Image image = parse(file);
+        // a DC of 15 lifts every sample by 15 / 8
+        const bool ok = image.data && image.Width == 8 && image.Height == 8 && image.data[0] >= 129 && image.data[0] <= 131;
+        delete[] image.data;
+        cout << "table selectors: " << (ok ? "ok" : "FAILED") << endl;
+        if (!ok) result = 1;
+    }
+
+    {
+        const vector<uint8_t> soi = { 0xFF, 0xD8 };
+        bool ok = true;
+
+        // more than 256 symbols
+        vector<uint8_t> file = soi;
+        appendSegment(file, 0xFFC4, huffmanTable(0x00, { 0, 0, 0, 0, 0, 0, 0, 255, 45 }));
+        ok = ok && parsesAsCorrupt(file);
+
+        // three codes of length 1
+        file = soi;
+        appendSegment(file, 0xFFC4, huffmanTable(0x00, { 3 }));
+        ok = ok && parsesAsCorrupt(file);
+
+        // the values end with the file
+        file = soi;
+        appendSegment(file, 0xFFC4, huffmanTable(0x00, { 0, 2, 8 }));
+        file.resize(file.size() - 8);
+        ok = ok && parsesAsCorrupt(file);
+
+        // table class 12, and a destination past the 4 of each class
+        file = soi;
+        appendSegment(file, 0xFFC4, huffmanTable(0xC1, { 0, 2 }));
+        ok = ok && parsesAsCorrupt(file);
+        file = soi;
+        appendSegment(file, 0xFFC4, huffmanTable(0x05, { 0, 2 }));
+        ok = ok && parsesAsCorrupt(file);
+        file = soi;
+        appendSegment(file, 0xFFC4, huffmanTable(0x08, { 0, 2 }));
+        ok = ok && parsesAsCorrupt(file);
+
+        // table selectors past the 4 destinations
+        file = grayFrame();
+        appendSegment(file, 0xFFDA, { 1, 1, 0x44, 0, 63, 0 });
+        file.insert(file.end(), { 0x00, 0xFF, 0xD9 });
+        ok = ok && parsesAsCorrupt(file);
+
+        // the file ends inside the scan header
+        file = grayFrame();
+        appendSegment(file, 0xFFDA, { 1, 1, 0x00, 0, 63, 0 });
+        file.resize(file.size() - 3);
+        ok = ok && parsesAsCorrupt(file);
+
+        // the scan header is longer than its segment
+        file = grayFrame();
+        appendSegment(file, 0xFFDA, { 4, 1, 0x00 });
+        file.insert(file.end(), { 0x00, 0xFF, 0xD9 });
+        ok = ok && parsesAsCorrupt(file);
+
+        // a frame header longer than its segment, and one cut by the end of the file
+        file = soi;
+        appendSegment(file, 0xFFC0, { 8, 0, 8, 0, 8, 3, 1, 0x11, 0 });
+        ok = ok && parsesAsCorrupt(file);
+        file = grayFrame();
+        file.resize(file.size() - 4);
+        ok = ok && parsesAsCorrupt(file);
+
+        // a quantization table for destination 4, and one shorter than 64 elements
+        file = soi;
+        appendSegment(file, 0xFFDB, vector<uint8_t>(65, 0x04));
+        ok = ok && parsesAsCorrupt(file);
+        file = soi;
+        appendSegment(file, 0xFFDB, vector<uint8_t>(33, 0x00));
+        ok = ok && parsesAsCorrupt(file);
+
+        // nothing but a marker
+        file = { 0xFF };
+        ok = ok && parsesAsCorrupt(file);
+        file = { 0xFF, 0xD8, 0xFF };
+        ok = ok && parsesAsCorrupt(file);
+
+        cout << "corrupt files: " << (ok ? "ok" : "FAILED") << endl;
+        if (!ok) result = 1;
+    }
+
     g_pAssetLoader->Finalize();
     g_pMemoryManager->Finalize();
 
     delete g_pAssetLoader;
     delete g_pMemoryManager;
 
-    return 0;
+    return result;
 }
 
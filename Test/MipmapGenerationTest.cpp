@@ -0,0 +1,163 @@
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include "MipmapGeneration.hpp"
+
+using namespace std;
+using namespace My;
+
+static Image makeImage(uint32_t width, uint32_t height, uint32_t bitcount, bool is_float)
+{
+    Image image;
+    image.Width = width;
+    image.Height = height;
+    image.bitcount = bitcount;
+    image.is_float = is_float;
+    image.pitch = width * (bitcount >> 3);
+    image.data_size = static_cast<size_t>(image.pitch) * height;
+    image.data = new uint8_t[image.data_size];
+    image.mipmaps[0].Width = width;
+    image.mipmaps[0].Height = height;
+    image.mipmaps[0].pitch = image.pitch;
+    image.mipmaps[0].data_size = image.data_size;
+    return image;
+}
+
+// levels follow each other without gaps
+static bool checkLayout(const Image& mipmapped, uint32_t expected_levels)
+{
+    if (mipmapped.mipmap_count != expected_levels) return false;
+    size_t offset = 0;
+    for (uint32_t i = 0; i < mipmapped.mipmap_count; i++)
+    {
+        const auto& mip = mipmapped.mipmaps[i];
+        if (mip.Width != mipmapped.Width >> i || mip.Height != mipmapped.Height >> i) return false;
+        if (mip.offset != offset || mip.pitch != mip.Width * (mipmapped.bitcount >> 3)) return false;
+        if (mip.data_size != static_cast<size_t>(mip.pitch) * mip.Height) return false;
+        offset += mip.data_size;
+    }
+    return offset == mipmapped.data_size;
+}
+
+int main(int argc, const char** argv)
+{
+    int result = 0;
+    const MipmapFilter kFilters[] = { MipmapFilter::kMipmapFilterBox, MipmapFilter::kMipmapFilterKaiser, MipmapFilter::kMipmapFilterLanczos };
+
+    // a flat color stays flat with every filter, in linear and sRGB mode
+    Image flat = makeImage(131, 67, 32, false);
+    for (size_t i = 0; i < flat.data_size; i += 4)
+    {
+        flat.data[i] = 30;
+        flat.data[i + 1] = 128;
+        flat.data[i + 2] = 250;
+        flat.data[i + 3] = 77;
+    }
+    for (auto filter : kFilters)
+    {
+        for (int srgb = 0; srgb < 2; srgb++)
+        {
+            MipmapGenerator generator;
+            generator.SetFilter(filter);
+            generator.SetSRGB(srgb != 0);
+            Image mipmapped = generator.Generate(flat);
+            bool ok = checkLayout(mipmapped, 7);
+            for (size_t i = 0; ok && i < mipmapped.data_size; i++)
+            {
+                ok = (mipmapped.data[i] == flat.data[i & 3]);
+            }
+            cout << "flat " << MipmapGenerator::FilterName(filter) << (srgb ? " srgb: " : " linear: ") << (ok ? "ok" : "FAILED") << endl;
+            if (!ok) result = 1;
+            delete[] mipmapped.data;
+        }
+    }
+    delete[] flat.data;
+
+    // a black and white checker averages to half the light in sRGB mode and
+    // to half the code value in linear mode. alpha is always linear
+    Image checker = makeImage(64, 64, 32, false);
+    for (uint32_t y = 0; y < checker.Height; y++)
+    {
+        for (uint32_t x = 0; x < checker.Width; x++)
+        {
+            uint8_t* pixel = checker.data + y * checker.pitch + x * 4;
+            const uint8_t value = ((x + y) & 1) ? 255 : 0;
+            pixel[0] = pixel[1] = pixel[2] = pixel[3] = value;
+        }
+    }
+    for (int srgb = 0; srgb < 2; srgb++)
+    {
+        MipmapGenerator generator;
+        generator.SetSRGB(srgb != 0);
+        Image mipmapped = generator.Generate(checker);
+        const uint8_t* pixel = mipmapped.data + mipmapped.mipmaps[1].offset + mipmapped.mipmaps[1].pitch * 5 + 7 * 4;
+        const uint8_t expected = srgb ? 188 : 128;
+        const bool ok = checkLayout(mipmapped, 7) && pixel[0] == expected && pixel[3] == 128;
+        cout << "checker " << (srgb ? "srgb: " : "linear: ") << static_cast<int>(pixel[0]) << " " << static_cast<int>(pixel[3])
+             << (ok ? " ok" : " FAILED") << endl;
+        if (!ok) result = 1;
+        delete[] mipmapped.data;
+    }
+    delete[] checker.data;
+
+    // float and half float HDR images keep values above 1.0
+    Image hdr = makeImage(40, 24, 128, true);
+    for (size_t i = 0; i < hdr.data_size / sizeof(float); i++)
+    {
+        reinterpret_cast<float*>(hdr.data)[i] = 12.5f;
+    }
+    Image half = makeImage(40, 24, 64, true);
+    for (size_t i = 0; i < half.data_size / sizeof(uint16_t); i++)
+    {
+        reinterpret_cast<uint16_t*>(half.data)[i] = 0x4A40; // 12.5
+    }
+    for (auto filter : kFilters)
+    {
+        MipmapGenerator generator;
+        generator.SetFilter(filter);
+        Image hdr_mipmapped = generator.Generate(hdr);
+        Image half_mipmapped = generator.Generate(half);
+        bool ok = checkLayout(hdr_mipmapped, 5) && checkLayout(half_mipmapped, 5);
+        for (size_t i = 0; ok && i < hdr_mipmapped.data_size / sizeof(float); i++)
+        {
+            ok = fabs(reinterpret_cast<const float*>(hdr_mipmapped.data)[i] - 12.5f) < 1e-4f;
+        }
+        for (size_t i = 0; ok && i < half_mipmapped.data_size / sizeof(uint16_t); i++)
+        {
+            ok = reinterpret_cast<const uint16_t*>(half_mipmapped.data)[i] == 0x4A40;
+        }
+        cout << "hdr " << MipmapGenerator::FilterName(filter) << ": " << (ok ? "ok" : "FAILED") << endl;
+        if (!ok) result = 1;
+        delete[] hdr_mipmapped.data;
+        delete[] half_mipmapped.data;
+    }
+    delete[] hdr.data;
+    delete[] half.data;
+
+    // threads give the same result as a single one
+    Image noise = makeImage(600, 300, 24, false);
+    uint32_t seed = 12345;
+    for (size_t i = 0; i < noise.data_size; i++)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        noise.data[i] = static_cast<uint8_t>(seed >> 24);
+    }
+    for (auto filter : kFilters)
+    {
+        MipmapGenerator generator;
+        generator.SetFilter(filter);
+        generator.SetSRGB(true);
+        Image threaded = generator.Generate(noise);
+        generator.SetMultithreaded(false);
+        Image single = generator.Generate(noise);
+        const bool ok = checkLayout(threaded, 9) && checkLayout(single, 9)
+            && memcmp(threaded.data, single.data, threaded.data_size) == 0;
+        cout << "threads " << MipmapGenerator::FilterName(filter) << ": " << (ok ? "ok" : "FAILED") << endl;
+        if (!ok) result = 1;
+        delete[] threaded.data;
+        delete[] single.data;
+    }
+    delete[] noise.data;
+
+    return result;
+}
@@ -0,0 +1,99 @@
+#include <iostream>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "AssetLoader.hpp"
+#include "MemoryManager.hpp"
+#include "PNG.hpp"
+
+using namespace std;
+using namespace My;
+
+namespace My {
+    IMemoryManager* g_pMemoryManager = new MemoryManager();
+    AssetLoader*   g_pAssetLoader = new AssetLoader();
+}
+
+int main(int argc, const char** argv)
+{
+    g_pMemoryManager->Initialize();
+    g_pAssetLoader->Initialize();
+
+#ifdef __ORBIS__
+    g_pAssetLoader->AddSearchPath("/app0");
+#endif
+
+    vector<string> files;
+    if (argc >= 2) {
+        for (int i = 1; i < argc; i++) files.push_back(argv[i]);
+    } else {
+        files = {
+            "Textures/octostoneNormalc.png",
+            "Textures/octostoneAlbedo.png",
+            "Textures/redbricks2b-rough.png",
+            "Textures/redbricks2b-albedo.png",
+            "Textures/redbricks2b-normal.png",
+            "Textures/redbricks2b-ao.png",
+            "Textures/rustediron2_basecolor.png",
+            "Textures/mixedmoss-normal2.png"
+        };
+    }
+
+    const int kIterations = 5;
+
+    for (bool multithreaded : { false, true })
+    {
+        cout << (multithreaded ? "Multithreaded" : "Single threaded") << endl;
+
+        size_t total_bytes = 0;
+        size_t total_pixels = 0;
+        double total_time = 0.0;
+
+        for (const auto& file : files)
+        {
+            Buffer buf = g_pAssetLoader->SyncOpenAndReadBinary(file.c_str());
+            if (!buf.GetDataSize()) continue;
+
+            // the parser logs every segment, keep that out of the measurement
+            auto cerr_buf = cerr.rdbuf(nullptr);
+            Image image;
+            auto start = chrono::high_resolution_clock::now();
+            for (int i = 0; i < kIterations; i++)
+            {
+                delete[] image.data;
+                PngParser png_parser;
+                png_parser.SetMultithreaded(multithreaded);
+                image = png_parser.Parse(buf);
+            }
+            auto end = chrono::high_resolution_clock::now();
+            cerr.rdbuf(cerr_buf);
+            cerr.clear();
+
+            chrono::duration<double, milli> elapsed = end - start;
+            double ms = elapsed.count() / kIterations;
+            size_t pixels = static_cast<size_t>(image.Width) * image.Height;
+            cout << file << " (" << image.Width << "x" << image.Height << ", " << buf.GetDataSize() << " bytes): "
+                 << ms << " ms, " << pixels / ms / 1000.0 << " MPixel/s, "
+                 << buf.GetDataSize() / ms / 1000.0 << " MB/s" << endl;
+
+            total_bytes += buf.GetDataSize();
+            total_pixels += pixels;
+            total_time += ms;
+
+            delete[] image.data;
+        }
+
+        if (total_time > 0.0) {
+            cout << "Total: " << total_pixels / total_time / 1000.0 << " MPixel/s, "
+                 << total_bytes / total_time / 1000.0 << " MB/s" << endl;
+        }
+    }
+
+    g_pAssetLoader->Finalize();
+    g_pMemoryManager->Finalize();
+
+    delete g_pAssetLoader;
+    delete g_pMemoryManager;
+
+    return 0;
+}
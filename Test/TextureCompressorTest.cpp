@@ -0,0 +1,132 @@
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "TextureCompressor.hpp"
+
+using namespace std;
+using namespace My;
+
+// the cache with its file names in reach, to clean up after
+class TestCompressionCache : public TextureCompressionCache
+{
+public:
+    using TextureCompressionCache::TextureCompressionCache;
+    using TextureCompressionCache::cachePath;
+};
+
+int main(int argc, const char** argv)
+{
+    int result = 0;
+
+    // smooth gradients and hard edges, with a size which is not a multiple of 4
+    Image image;
+    image.Width = 131;
+    image.Height = 67;
+    image.bitcount = 32;
+    image.pitch = image.Width * 4;
+    image.data_size = image.pitch * image.Height;
+    image.data = new uint8_t[image.data_size];
+    for (uint32_t y = 0; y < image.Height; y++) {
+        for (uint32_t x = 0; x < image.Width; x++) {
+            uint8_t* pixel = image.data + y * image.pitch + x * 4;
+            pixel[0] = static_cast<uint8_t>(128 + 100 * sin(x / 13.0));
+            pixel[1] = static_cast<uint8_t>(255 * y / image.Height);
+            pixel[2] = (((x >> 3) + (y >> 3)) & 1) ? 200 : 40;
+            pixel[3] = static_cast<uint8_t>(255 * x / image.Width);
+        }
+    }
+    image.mipmaps[0].Width = image.Width;
+    image.mipmaps[0].Height = image.Height;
+    image.mipmaps[0].pitch = image.pitch;
+    image.mipmaps[0].data_size = image.data_size;
+
+    const struct {
+        TextureCompressionFormat format;
+        int channels;
+    } kCases[] = {
+        { TextureCompressionFormat::kTextureCompressionFormatBC1, 3 },
+        { TextureCompressionFormat::kTextureCompressionFormatBC3, 4 },
+        { TextureCompressionFormat::kTextureCompressionFormatBC5, 2 },
+        { TextureCompressionFormat::kTextureCompressionFormatBC7, 4 }
+    };
+
+    for (const auto& test_case : kCases) {
+        TextureCompressor compressor;
+        compressor.SetFormat(test_case.format);
+        Image compressed = compressor.Compress(image);
+
+        // write it out and read it back as the engine would
+        Buffer dds = DdsWriter().Write(compressed);
+        DdsParser dds_parser;
+        dds_parser.SetDecompress(true);
+        auto cerr_buf = cerr.rdbuf(nullptr);
+        Image decoded = dds_parser.Parse(dds);
+        cerr.rdbuf(cerr_buf);
+
+        double squared_error = 0.0;
+        for (uint32_t y = 0; y < image.Height; y++) {
+            for (uint32_t x = 0; x < image.Width; x++) {
+                for (int c = 0; c < test_case.channels; c++) {
+                    const double d = image.data[y * image.pitch + x * 4 + c] - decoded.data[y * decoded.pitch + x * 4 + c];
+                    squared_error += d * d;
+                }
+            }
+        }
+        const double mse = squared_error / (image.Width * image.Height * test_case.channels);
+        const double psnr = 10.0 * log10(255.0 * 255.0 / max(mse, 1e-6));
+        cout << TextureCompressor::FormatName(test_case.format) << ": " << compressed.mipmap_count << " mips, "
+             << compressed.data_size << " bytes, PSNR " << psnr << " dB" << endl;
+
+        if (decoded.mipmap_count != compressed.mipmap_count || compressed.mipmap_count != 7 || psnr < 35.0) result = 1;
+
+        delete[] compressed.data;
+        delete[] decoded.data;
+    }
+
+    // a cached texture is only reused with the settings it was made with
+    {
+        TestCompressionCache cache(".", TextureCompressionFormat::kTextureCompressionFormatBC1);
+        Buffer source(16);
+        memset(source.GetData(), 0x42, source.GetDataSize());
+        int decodes = 0;
+        auto decode = [&]() -> Image {
+            decodes++;
+            Image copy = image;
+            copy.data = new uint8_t[image.data_size];
+            memcpy(copy.data, image.data, image.data_size);
+            return copy;
+        };
+
+        vector<string> paths;
+        const int kSettings = 4;
+        auto cerr_buf = cerr.rdbuf(nullptr);
+        for (int pass = 0; pass < 2; pass++) {
+            for (int setting = 0; setting < kSettings; setting++) {
+                cache.GetCompressor().SetGenerateMipmaps(setting != 1);
+                cache.GetCompressor().SetMipmapFilter(setting == 2 ? MipmapFilter::kMipmapFilterKaiser : MipmapFilter::kMipmapFilterBox);
+                cache.GetCompressor().SetSRGB(setting == 3);
+                if (pass == 0) paths.push_back(cache.cachePath("Textures/cache_test.png", source));
+                Image loaded = cache.Load("Textures/cache_test.png", source, decode);
+                if (!loaded.compressed || loaded.mipmap_count != (setting == 1 ? 1u : 7u)) result = 1;
+                delete[] loaded.data;
+            }
+        }
+
+        cerr.rdbuf(cerr_buf);
+
+        bool ok = (decodes == kSettings);
+        for (size_t i = 0; i < paths.size(); i++) {
+            for (size_t j = i + 1; j < paths.size(); j++) ok = ok && paths[i] != paths[j];
+            ok = ok && remove(paths[i].c_str()) == 0;
+        }
+        cout << "cache settings: " << (ok ? "ok" : "FAILED") << endl;
+        if (!ok) result = 1;
+    }
+
+    delete[] image.data;
+
+    return result;
+}
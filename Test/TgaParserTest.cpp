@@ -1,5 +1,6 @@
 #include <iostream>
 #include <string>
+#include <vector>
 #include "AssetLoader.hpp"
 #include "MemoryManager.hpp"
 #include "TGA.hpp"
@@ -12,6 +13,177 @@ namespace My {
     AssetLoader*   g_pAssetLoader = new AssetLoader();
 }
 
+static const uint32_t kWidth = 37;
+static const uint32_t kHeight = 5;
+
+// pixel i of the test image as R8G8B8A8, runs of 6 which cross rows with
+// a few noisy pixels at the start of each row for the raw packets
+static uint32_t testPixel(uint32_t i)
+{
+    static const uint32_t kColors[7] = { 0x80102030, 0xFFFFFFFF, 0x00000000, 0xFF0000FF, 0x4000FF00, 0xFFFF0000, 0xC0808080 };
+    if (i % kWidth < 8) return (i * 0x9E3779B1u) ^ 0x5A5A5A5A;
+    return kColors[(i / 6) % 7];
+}
+
+static uint8_t testIndex(uint32_t i)
+{
+    return static_cast<uint8_t>((testPixel(i) >> 3) % 16);
+}
+
+// the file bytes of one pixel of the given depth
+static void encodePixel(uint32_t rgba, uint32_t depth, vector<uint8_t>& out)
+{
+    const uint8_t r = rgba & 0xFF, g = (rgba >> 8) & 0xFF, b = (rgba >> 16) & 0xFF, a = rgba >> 24;
+    switch (depth)
+    {
+        case 8:
+            out.push_back(r);
+            break;
+        case 16:
+            {
+                const uint16_t value = ((a & 0x80) << 8) | ((r >> 3) << 10) | ((g >> 3) << 5) | (b >> 3);
+                out.push_back(value & 0xFF);
+                out.push_back(value >> 8);
+            }
+            break;
+        default:
+            out.push_back(b);
+            out.push_back(g);
+            out.push_back(r);
+            if (depth == 32) out.push_back(a);
+    }
+}
+
+// what the parser should give for a pixel stored at depth
+static uint32_t expectedPixel(uint32_t rgba, uint32_t depth)
+{
+    const uint32_t r = rgba & 0xFF, g = (rgba >> 8) & 0xFF, b = (rgba >> 16) & 0xFF, a = rgba >> 24;
+    switch (depth)
+    {
+        case 8:
+            return r * 0x010101u | 0xFF000000;
+        case 16:
+            {
+                const uint32_t r5 = r >> 3, g5 = g >> 3, b5 = b >> 3;
+                return ((r5 << 3) | (r5 >> 2)) | (((g5 << 3) | (g5 >> 2)) << 8) | (((b5 << 3) | (b5 >> 2)) << 16)
+                    | ((a & 0x80) ? 0xFF000000 : 0);
+            }
+        case 24:
+            return rgba | 0xFF000000;
+        default:
+            return rgba;
+    }
+}
+
+// runs of equal pixels become run packets, everything else raw packets
+static void encodeRle(const vector<vector<uint8_t>>& pixels, vector<uint8_t>& out)
+{
+    size_t i = 0;
+    while (i < pixels.size())
+    {
+        size_t run = 1;
+        while (i + run < pixels.size() && run < 128 && pixels[i + run] == pixels[i]) run++;
+        if (run > 1)
+        {
+            out.push_back(static_cast<uint8_t>(0x80 | (run - 1)));
+            out.insert(out.end(), pixels[i].begin(), pixels[i].end());
+            i += run;
+            continue;
+        }
+        size_t raw = 1;
+        while (i + raw < pixels.size() && raw < 128 && !(i + raw + 1 < pixels.size() && pixels[i + raw] == pixels[i + raw + 1])) raw++;
+        out.push_back(static_cast<uint8_t>(raw - 1));
+        for (size_t k = 0; k < raw; k++) out.insert(out.end(), pixels[i + k].begin(), pixels[i + k].end());
+        i += raw;
+    }
+}
+
+// a TGA file of the test image. color mapped images use a 16 entry map
+// of 24 bit entries, grayscale images the red channel
+static Buffer makeTga(uint8_t image_type, uint32_t depth, bool alpha)
+{
+    const bool color_mapped = (image_type & ~8) == 1;
+    vector<uint8_t> file(18, 0);
+    file[0] = 3; // ID
+    file[1] = color_mapped ? 1 : 0;
+    file[2] = image_type;
+    if (color_mapped)
+    {
+        file[5] = 16; // map length
+        file[7] = 24; // entry size
+    }
+    file[12] = kWidth;
+    file[14] = kHeight;
+    file[16] = static_cast<uint8_t>(color_mapped ? 8 : depth);
+    file[17] = alpha ? (depth == 32 ? 8 : 1) : 0;
+    file.insert(file.end(), { 'I', 'D', '!' });
+    if (color_mapped)
+    {
+        for (uint32_t i = 0; i < 16; i++) encodePixel(i * 0x00100F07u, 24, file);
+    }
+
+    vector<vector<uint8_t>> pixels;
+    for (uint32_t i = 0; i < kWidth * kHeight; i++)
+    {
+        vector<uint8_t> pixel;
+        if (color_mapped) pixel.push_back(testIndex(i));
+        else encodePixel(testPixel(i), depth, pixel);
+        pixels.push_back(pixel);
+    }
+    if (image_type & 8)
+    {
+        encodeRle(pixels, file);
+    }
+    else
+    {
+        for (const auto& pixel : pixels) file.insert(file.end(), pixel.begin(), pixel.end());
+    }
+
+    Buffer buf(file.size());
+    memcpy(buf.GetData(), file.data(), file.size());
+    return buf;
+}
+
+static bool checkDecode(uint8_t image_type, uint32_t depth, bool alpha)
+{
+    Buffer buf = makeTga(image_type, depth, alpha);
+    TgaParser tga_parser;
+    auto cerr_buf = cerr.rdbuf(nullptr);
+    Image image = tga_parser.Parse(buf, ImageOutputFormat::kImageOutputFormatRGBA);
+    cerr.rdbuf(cerr_buf);
+
+    bool ok = (image.Width == kWidth && image.Height == kHeight && image.bitcount == 32);
+    for (uint32_t i = 0; ok && i < kWidth * kHeight; i++)
+    {
+        uint32_t expected;
+        if ((image_type & ~8) == 1) expected = expectedPixel(testIndex(i) * 0x00100F07u, 24);
+        else expected = expectedPixel(alpha || depth == 8 ? testPixel(i) : testPixel(i) | 0xFF000000, depth);
+
+        uint32_t pixel;
+        memcpy(&pixel, image.data + image.pitch * (i / kWidth) + (i % kWidth) * 4, 4);
+        ok = (pixel == expected);
+    }
+
+    // the native layout has the same pixels without a made up alpha
+    // channel, and one channel for grayscale
+    cerr_buf = cerr.rdbuf(nullptr);
+    Image native = tga_parser.Parse(buf);
+    cerr.rdbuf(cerr_buf);
+    const uint32_t native_size = ((image_type & ~8) == 3) ? 1 : ((alpha || depth == 32) ? 4 : 3);
+    ok = ok && native.bitcount == native_size * 8;
+    for (uint32_t i = 0; ok && i < kWidth * kHeight; i++)
+    {
+        ok = memcmp(native.data + native.pitch * (i / kWidth) + (i % kWidth) * native_size,
+                image.data + image.pitch * (i / kWidth) + (i % kWidth) * 4, native_size) == 0;
+    }
+    delete[] native.data;
+
+    cout << "type " << (uint32_t)image_type << ", " << depth << " bit" << (alpha ? " with alpha: " : ": ") << (ok ? "ok" : "FAILED") << endl;
+
+    delete[] image.data;
+    return ok;
+}
+
 int main(int argc, const char** argv)
 {
     g_pMemoryManager->Initialize();
@@ -21,6 +193,8 @@ int main(int argc, const char** argv)
     g_pAssetLoader->AddSearchPath("/app0");
 #endif
 
+    int result = 0;
+
     {
         Buffer buf;
         if (argc >= 2) {
@@ -36,12 +210,27 @@ int main(int argc, const char** argv)
         cout << image;
     }
 
+    // every image type and pixel depth, uncompressed and run length encoded
+    const struct {
+        uint8_t image_type;
+        uint32_t depth;
+        bool alpha;
+    } kCases[] = {
+        { 2, 24, false }, { 2, 32, true }, { 2, 32, false }, { 2, 16, true }, { 2, 16, false },
+        { 10, 24, false }, { 10, 32, true }, { 10, 16, true },
+        { 1, 8, false }, { 9, 8, false },
+        { 3, 8, false }, { 11, 8, false }
+    };
+    for (const auto& test_case : kCases)
+    {
+        if (!checkDecode(test_case.image_type, test_case.depth, test_case.alpha)) result = 1;
+    }
+
     g_pAssetLoader->Finalize();
     g_pMemoryManager->Finalize();
 
     delete g_pAssetLoader;
     delete g_pMemoryManager;
 
-    return 0;
+    return result;
 }
-
@@ -0,0 +1,110 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "AssetLoader.hpp"
+#include "AssetPack.hpp"
+#include "config.h"
+
+using namespace std;
+using namespace My;
+
+// packs every file below an Asset directory into one .pack, which is then
+// added to the AssetLoader with AddSearchPath instead of the directory
+static void usage()
+{
+    cerr << "Usage: AssetPackCook [-z 0-9] [--chunk-size bytes] <asset directory> <output.pack>" << endl;
+}
+
+// the absolute form of path, so two spellings of one file compare equal
+static string fullPath(const string& path)
+{
+#if defined(OS_WINDOWS)
+    char full[_MAX_PATH];
+    return _fullpath(full, path.c_str(), _MAX_PATH) ? string(full) : path;
+#else
+    char* full = realpath(path.c_str(), nullptr);
+    if (!full) return path;
+    string result = full;
+    free(full);
+    return result;
+#endif
+}
+
+int main(int argc, const char** argv)
+{
+    AssetPackWriter writer;
+    const char* input = nullptr;
+    const char* output = nullptr;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-z") && i + 1 < argc)
+        {
+            const int level = atoi(argv[++i]);
+            if (level < 0 || level > 9)
+            {
+                usage();
+                return 1;
+            }
+            writer.SetCompressionLevel(level);
+        }
+        else if (!strcmp(argv[i], "--chunk-size") && i + 1 < argc)
+        {
+            writer.SetChunkSize(static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10)));
+        }
+        else if (!input)
+        {
+            input = argv[i];
+        }
+        else if (!output)
+        {
+            output = argv[i];
+        }
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+
+    if (!input || !output)
+    {
+        usage();
+        return 1;
+    }
+
+    string root = input;
+    if (root.back() != '/' && root.back() != '\\') root.push_back('/');
+
+    vector<string> files;
+    AssetLoader::ListFiles(root, files);
+
+    // a pack written into the directory it packs, e.g. by an earlier run,
+    // is not packed into itself
+    const string output_path = fullPath(output);
+    size_t count = 0;
+    for (const auto& file : files)
+    {
+        if (fullPath(root + file) == output_path) continue;
+        writer.AddFile(file, root + file);
+        count++;
+    }
+
+    if (!count)
+    {
+        cerr << "No files in " << input << endl;
+        return 1;
+    }
+
+    auto start = chrono::high_resolution_clock::now();
+    if (!writer.Write(output)) return 1;
+    auto end = chrono::high_resolution_clock::now();
+
+    cout << input << " -> " << output << " (" << count << " files): "
+         << chrono::duration<double, milli>(end - start).count() << " ms" << endl;
+
+    return 0;
+}
@@ -0,0 +1,151 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include "ImageParserRegistry.hpp"
+#include "TextureCompressor.hpp"
+
+using namespace std;
+using namespace My;
+
+// offline counterpart of TextureCompressionCache: compresses a PNG, JPEG,
+// BMP or TGA file to a .dds with BC1, BC3, BC5 or BC7 blocks and mipmaps
+static void usage()
+{
+    cerr << "Usage: TextureCook [-f bc1|bc3|bc5|bc7] [--filter box|kaiser|lanczos] [--srgb] [--no-mipmaps] [--single-threaded] <input> <output.dds>" << endl;
+}
+
+static bool readFile(const char* path, Buffer& buf)
+{
+    FILE* fp = fopen(path, "rb");
+    if (!fp) return false;
+    fseek(fp, 0, SEEK_END);
+    const long length = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    bool result = false;
+    if (length > 0)
+    {
+        buf = Buffer(static_cast<size_t>(length));
+        result = (fread(buf.GetData(), buf.GetDataSize(), 1, fp) == 1);
+    }
+    fclose(fp);
+    return result;
+}
+
+int main(int argc, const char** argv)
+{
+    TextureCompressor compressor;
+    const char* input = nullptr;
+    const char* output = nullptr;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-f") && i + 1 < argc)
+        {
+            TextureCompressionFormat format;
+            if (!TextureCompressor::ParseFormatName(argv[++i], format))
+            {
+                cerr << "Unknown format " << argv[i] << endl;
+                usage();
+                return 1;
+            }
+            compressor.SetFormat(format);
+        }
+        else if (!strcmp(argv[i], "--filter") && i + 1 < argc)
+        {
+            MipmapFilter filter;
+            if (!MipmapGenerator::ParseFilterName(argv[++i], filter))
+            {
+                cerr << "Unknown filter " << argv[i] << endl;
+                usage();
+                return 1;
+            }
+            compressor.SetMipmapFilter(filter);
+        }
+        else if (!strcmp(argv[i], "--srgb"))
+        {
+            compressor.SetSRGB(true);
+        }
+        else if (!strcmp(argv[i], "--no-mipmaps"))
+        {
+            compressor.SetGenerateMipmaps(false);
+        }
+        else if (!strcmp(argv[i], "--single-threaded"))
+        {
+            compressor.SetMultithreaded(false);
+        }
+        else if (!input)
+        {
+            input = argv[i];
+        }
+        else if (!output)
+        {
+            output = argv[i];
+        }
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+
+    if (!input || !output)
+    {
+        usage();
+        return 1;
+    }
+
+    Buffer buf;
+    if (!readFile(input, buf))
+    {
+        cerr << "Error reading " << input << endl;
+        return 1;
+    }
+
+    // already compressed or HDR images are not cooked
+    const ImageFileFormat format = ImageParserRegistry::DetectFormat(buf);
+    if (format == ImageFileFormat::kImageFileFormatUnknown || format == ImageFileFormat::kImageFileFormatDDS
+            || format == ImageFileFormat::kImageFileFormatHDR)
+    {
+        cerr << "Unsupported input " << input << endl;
+        return 1;
+    }
+
+    ImageParserRegistry registry;
+    Image image = registry.Parse(buf, ImageOutputFormat::kImageOutputFormatRGBA);
+
+    if (!image.data)
+    {
+        cerr << "Error decoding " << input << endl;
+        return 1;
+    }
+
+    auto start = chrono::high_resolution_clock::now();
+    Image compressed = compressor.Compress(image);
+    auto end = chrono::high_resolution_clock::now();
+    delete[] image.data;
+    if (!compressed.data)
+    {
+        return 1;
+    }
+
+    Buffer dds = DdsWriter().Write(compressed);
+    delete[] compressed.data;
+
+    FILE* fp = fopen(output, "wb");
+    if (!fp || fwrite(dds.GetData(), dds.GetDataSize(), 1, fp) != 1)
+    {
+        cerr << "Error writing " << output << endl;
+        if (fp) fclose(fp);
+        return 1;
+    }
+    fclose(fp);
+
+    chrono::duration<double, milli> elapsed = end - start;
+    cout << input << " -> " << output << " (" << compressed.Width << "x" << compressed.Height << ", "
+         << compressed.mipmap_count << " mips, " << TextureCompressor::FormatName(compressor.GetFormat()) << "): "
+         << elapsed.count() << " ms" << endl;
+
+    return 0;
+}